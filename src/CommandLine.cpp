@@ -0,0 +1,362 @@
+#include "CommandLine.hpp"
+#include "core/LineIndex.hpp"
+#include "core/MappedFile.hpp"
+#include "core/TaskScheduler.hpp"
+#include "core/TextSearch.hpp"
+#include "core/Timestamp.hpp"
+#include "core/TrigramIndex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace
+{
+// Number of lines checked against the level and time filters by one task
+constexpr size_t FILTER_CHUNK_LINES = 64 * 1024;
+
+// Results are written to stdout in blocks of this size
+constexpr size_t OUTPUT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+// Writes to stdout through one big buffer instead of the small buffer of the C library
+class OutputBuffer
+{
+public:
+    OutputBuffer()
+    {
+        buffer.reserve(OUTPUT_BUFFER_SIZE);
+    }
+
+    ~OutputBuffer()
+    {
+        flush();
+    }
+
+    void write(const std::string_view text)
+    {
+        if (buffer.size() + text.size() > OUTPUT_BUFFER_SIZE)
+        {
+            flush();
+        }
+        // Long texts are written directly, without copying them to the buffer first
+        if (text.size() >= OUTPUT_BUFFER_SIZE)
+        {
+            writeToStdout(text);
+            return;
+        }
+        buffer.append(text);
+    }
+
+    void flush()
+    {
+        writeToStdout(buffer);
+        buffer.clear();
+    }
+
+    // False once a write failed, e.g. because the reading end of a pipe was closed
+    bool isGood() const
+    {
+        return good;
+    }
+
+private:
+    void writeToStdout(const std::string_view text)
+    {
+        if (good && !text.empty())
+        {
+            good = std::fwrite(text.data(), 1, text.size(), stdout) == text.size() && std::fflush(stdout) == 0;
+        }
+    }
+
+    std::string buffer;
+    bool good = true;
+};
+
+class Stopwatch
+{
+public:
+    double lap()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - start).count();
+        start = now;
+        return seconds;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+// Parse "FROM..TO", where either end can be empty
+bool parseTimeRange(const std::string_view text, CommandLineOptions& options)
+{
+    const size_t separator = text.find("..");
+    if (separator == std::string_view::npos)
+    {
+        return false;
+    }
+    const std::string_view from = text.substr(0, separator);
+    const std::string_view to = text.substr(separator + 2);
+    size_t parsedLength = 0;
+    if (!from.empty() && (!(options.timeFrom = parseTimestamp(from, &parsedLength)) || parsedLength != from.size()))
+    {
+        return false;
+    }
+    if (!to.empty() && (!(options.timeTo = parseTimestamp(to, &parsedLength)) || parsedLength != to.size()))
+    {
+        return false;
+    }
+    return true;
+}
+
+bool matchesFilters(const CommandLineOptions& options, const std::string_view line)
+{
+    if (options.minimumLevel)
+    {
+        const auto level = findLogLevel(line);
+        if (!level || *level < *options.minimumLevel)
+        {
+            return false;
+        }
+    }
+    if (options.timeFrom || options.timeTo)
+    {
+        const auto timestamp = findTimestamp(line);
+        if (!timestamp || (options.timeFrom && *timestamp < *options.timeFrom) ||
+            (options.timeTo && *timestamp >= *options.timeTo))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Lines that may contain the text according to the saved search index of the file or the block summaries.
+// Returns nothing if they cannot skip at least half of the blocks.
+std::unique_ptr<std::vector<uint32_t>> findCandidateLines(const MappedFile& file, const LineIndex& lineIndex,
+                                                          const std::string& text)
+{
+    const std::string indexPath = TrigramIndex::getIndexPath(file.getPath());
+    std::error_code error;
+    if (std::filesystem::exists(indexPath, error))
+    {
+        TrigramIndex index;
+        if (index.load(indexPath, file.data(), lineIndex.getLines()))
+        {
+            const auto blocks = index.findCandidateBlocks(text);
+            if (blocks && blocks->size() <= index.getNumberOfBlocks() / 2)
+            {
+                return std::make_unique<std::vector<uint32_t>>(index.getLinesOfBlocks(*blocks));
+            }
+        }
+    }
+
+    const BlockSummaries& summaries = lineIndex.getBlockSummaries();
+    const auto blocks = summaries.findCandidateBlocks(text);
+    if (blocks && blocks->size() <= summaries.getNumberOfBlocks() / 2)
+    {
+        return std::make_unique<std::vector<uint32_t>>(summaries.getLinesOfBlocks(*blocks));
+    }
+    return nullptr;
+}
+
+// Sorted indices of the lines matching all options
+std::vector<uint32_t> findLines(const CommandLineOptions& options, const MappedFile& file, const LineIndex& lineIndex,
+                                TaskScheduler& scheduler)
+{
+    std::vector<uint32_t> matchingLines;
+    if (options.grep)
+    {
+        TextSearch textSearch(file.data(), file.size(), lineIndex.getLines());
+        textSearch.setScheduler(&scheduler, TaskPriority::Interactive);
+        const auto candidateLines = findCandidateLines(file, lineIndex, *options.grep);
+        matchingLines = textSearch.findMatchingLines(*options.grep, candidateLines.get(), {}).value_or(matchingLines);
+    }
+    else
+    {
+        // The empty line after the last newline of the file (or of an empty file) is not a line of the log
+        const bool endsWithNewline = file.size() == 0 || file.data()[file.size() - 1] == '\n';
+        matchingLines.resize(endsWithNewline && !lineIndex.empty() ? lineIndex.size() - 1 : lineIndex.size());
+        for (size_t i = 0; i < matchingLines.size(); i++)
+        {
+            matchingLines[i] = static_cast<uint32_t>(i);
+        }
+    }
+
+    if (!options.minimumLevel && !options.timeFrom && !options.timeTo)
+    {
+        return matchingLines;
+    }
+
+    const size_t numberOfChunks = (matchingLines.size() + FILTER_CHUNK_LINES - 1) / FILTER_CHUNK_LINES;
+    std::vector<std::vector<uint32_t>> chunkResults(numberOfChunks);
+    scheduler.parallelFor(matchingLines.size(), FILTER_CHUNK_LINES, TaskPriority::Interactive, {},
+                          [&](size_t begin, size_t end, size_t) {
+                              auto& result = chunkResults[begin / FILTER_CHUNK_LINES];
+                              for (size_t i = begin; i < end; i++)
+                              {
+                                  if (matchesFilters(options, lineIndex.getLineText(matchingLines[i])))
+                                  {
+                                      result.push_back(matchingLines[i]);
+                                  }
+                              }
+                          });
+
+    std::vector<uint32_t> filteredLines;
+    for (const auto& result : chunkResults)
+    {
+        filteredLines.insert(filteredLines.end(), result.begin(), result.end());
+    }
+    return filteredLines;
+}
+} // namespace
+
+std::optional<CommandLineOptions> CommandLineOptions::parse(const int argc, char** argv, std::string& errorMessage)
+{
+    CommandLineOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--grep" && hasValue)
+        {
+            options.grep = argv[++i];
+            if (options.grep->empty())
+            {
+                errorMessage = "Empty search text";
+                return std::nullopt;
+            }
+            options.headless = true;
+        }
+        else if (argument == "--filter-level" && hasValue)
+        {
+            options.minimumLevel = parseLogLevel(argv[++i]);
+            if (!options.minimumLevel)
+            {
+                errorMessage = "Unknown log level: " + std::string(argv[i]);
+                return std::nullopt;
+            }
+            options.headless = true;
+        }
+        else if (argument == "--time-range" && hasValue)
+        {
+            if (!parseTimeRange(argv[++i], options))
+            {
+                errorMessage = "Invalid time range: " + std::string(argv[i]) + " (expected FROM..TO)";
+                return std::nullopt;
+            }
+            options.headless = true;
+        }
+        else if (argument == "--count")
+        {
+            options.count = true;
+            options.headless = true;
+        }
+        else if (argument == "--stats")
+        {
+            options.stats = true;
+            options.headless = true;
+        }
+        else if (argument == "--")
+        {
+            options.files.insert(options.files.end(), argv + i + 1, argv + argc);
+            break;
+        }
+        else if (argument.starts_with("--"))
+        {
+            errorMessage = "Unknown option or missing value: " + std::string(argument);
+            return std::nullopt;
+        }
+        else
+        {
+            options.files.emplace_back(argument);
+        }
+    }
+
+    if (options.headless && options.files.empty())
+    {
+        errorMessage = "No input files";
+        return std::nullopt;
+    }
+    return options;
+}
+
+int runHeadless(const CommandLineOptions& options)
+{
+    TaskScheduler scheduler;
+    OutputBuffer output;
+    bool anyMatch = false;
+    bool anyError = false;
+
+    for (const std::string& path : options.files)
+    {
+        Stopwatch stopwatch;
+        const MappedFile file(path);
+        if (!file.isOpen())
+        {
+            std::fprintf(stderr, "%s\n", file.getErrorMessage().c_str());
+            anyError = true;
+            continue;
+        }
+
+        LineIndex lineIndex;
+        lineIndex.build(file.data(), file.size(), &scheduler);
+        const double indexTime = stopwatch.lap();
+
+        const std::vector<uint32_t> matchingLines = findLines(options, file, lineIndex, scheduler);
+        const double searchTime = stopwatch.lap();
+        anyMatch = anyMatch || !matchingLines.empty();
+
+        // Prefix the results with the file name when there is more than one file, like grep
+        const std::string prefix = options.files.size() > 1 ? path + ":" : "";
+        if (options.count)
+        {
+            output.write(prefix + std::to_string(matchingLines.size()) + "\n");
+        }
+        else
+        {
+            const char* data = file.data();
+            for (size_t i = 0; i < matchingLines.size() && output.isGood(); i++)
+            {
+                // Adjacent lines are written at once together with the newlines between them
+                const size_t first = i;
+                while (i + 1 < matchingLines.size() && matchingLines[i + 1] == matchingLines[i] + 1 &&
+                       prefix.empty())
+                {
+                    i++;
+                }
+                output.write(prefix);
+                const size_t begin = lineIndex[matchingLines[first]].first;
+                const size_t end = lineIndex[matchingLines[i]].second;
+                output.write(std::string_view(data + begin, end - begin));
+                output.write("\n");
+            }
+        }
+        output.flush();
+        const double outputTime = stopwatch.lap();
+
+        if (options.stats)
+        {
+            const double megabytes = static_cast<double>(file.size()) / (1024 * 1024);
+            std::fprintf(stderr,
+                         "%s: %.1f MiB, %zu lines, %zu matching, index %.3f s (%.0f MiB/s), search %.3f s, "
+                         "output %.3f s, %zu workers\n",
+                         path.c_str(), megabytes, lineIndex.size(), matchingLines.size(), indexTime,
+                         megabytes / std::max(indexTime, 1e-9), searchTime, outputTime,
+                         scheduler.getNumberOfWorkers());
+        }
+        if (!output.isGood())
+        {
+            break;
+        }
+    }
+
+    if (anyError)
+    {
+        return 2;
+    }
+    return anyMatch ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "core/LogLevel.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Options of the headless mode, e.g.
+//   LogViewer --grep "timeout" --filter-level warn --time-range 2024-01-15T10:00:00..2024-01-16 app.log
+// Without any of the options below the viewer window is opened with the given file, "-" shows the standard input.
+// Lines without a level or a timestamp never pass the level or time filters.
+struct CommandLineOptions
+{
+    std::optional<std::string> grep;      // --grep TEXT: lines containing the text
+    std::optional<LogLevel> minimumLevel; // --filter-level LEVEL: lines with at least this severity
+    std::optional<int64_t> timeFrom;      // --time-range FROM..TO: lines with a timestamp in [FROM, TO),
+    std::optional<int64_t> timeTo;        // either end can be left out
+    bool count = false;                   // --count: print the number of lines instead of the lines
+    bool stats = false;                   // --stats: print the time of every stage to stderr
+    bool headless = false;
+    std::vector<std::string> files;
+
+    // Returns std::nullopt and sets the error message if the arguments are not valid.
+    static std::optional<CommandLineOptions> parse(int argc, char** argv, std::string& errorMessage);
+};
+
+// Print the matching lines of all files to stdout, using the same engines as the viewer.
+// Returns the exit code: 0 if any line matched, 1 if none did and 2 on errors, like grep.
+int runHeadless(const CommandLineOptions& options);
@@ -1,25 +1,46 @@
+#include "CommandLine.hpp"
 #include "Window.hpp"
 
 #include <FL/Fl.H>
-#include <cassert>
-#include <fstream>
+
+#include <cstdio>
 #include <string>
+#include <vector>
 
-std::string readFile(const std::string& filename)
+int main(int argc, char** argv)
 {
-    std::ifstream file(filename);
-    assert(file.is_open());
-    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    return content;
-}
+    std::string errorMessage;
+    const auto options = CommandLineOptions::parse(argc, argv, errorMessage);
+    if (!options)
+    {
+        std::fprintf(stderr, "%s\n", errorMessage.c_str());
+        std::fprintf(stderr, "Usage: %s [--grep TEXT] [--filter-level LEVEL] [--time-range FROM..TO] [--count] "
+                             "[--stats] FILE...\n",
+                     argv[0]);
+        return 2;
+    }
+    if (options->headless)
+    {
+        return runHeadless(*options);
+    }
 
-int main()
-{
+    Fl::lock(); // Enable multithreading support, background tasks post their results with Fl::awake
     Fl::get_system_colors();
-    const std::string content = readFile("pan-tadeusz.txt");
 
     Window window(600, 500);
-    window.loadData(content.c_str(), content.size());
+    const std::vector<std::string> paths =
+        options->files.empty() ? std::vector<std::string>{"pan-tadeusz.txt"} : options->files;
+    for (const std::string& path : paths) // every file in its own tab
+    {
+        if (path == "-")
+        {
+            window.openStandardInput(); // e.g. kubectl logs -f pod | LogViewer -
+        }
+        else
+        {
+            window.openFile(path);
+        }
+    }
     window.show();
 
     return Fl::run();
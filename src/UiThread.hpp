@@ -0,0 +1,24 @@
+#pragma once
+#include <FL/Fl.H>
+#include <functional>
+#include <memory>
+
+// Schedule a task to be executed on the main (UI) thread.
+// Background threads must not touch widgets directly, they post their results with this function instead.
+// Requires Fl::lock() to be called once in main() before the event loop starts.
+inline void runOnUiThread(std::function<void()> task)
+{
+    auto* message = new std::function<void()>(std::move(task));
+    const int result = Fl::awake(
+        [](void* data) {
+            const std::unique_ptr<std::function<void()>> task(static_cast<std::function<void()>*>(data));
+            (*task)();
+        },
+        message);
+
+    if (result != 0)
+    {
+        // The awake queue is full, the task is dropped
+        delete message;
+    }
+}
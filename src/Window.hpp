@@ -1,15 +1,54 @@
 #pragma once
+#include "UiThread.hpp"
+#include "core/AggregationQuery.hpp"
+#include "core/FieldSort.hpp"
+#include "core/FieldStore.hpp"
+#include "core/FileExporter.hpp"
+#include "core/FileSearch.hpp"
+#include "core/LogDiff.hpp"
+#include "core/LogFormat.hpp"
+#include "core/MappedFile.hpp"
+#include "core/SearchCache.hpp"
+#include "core/StreamBuffer.hpp"
+#include "core/TaskScheduler.hpp"
+#include "core/TemplateMiner.hpp"
+#include "core/TextEncoding.hpp"
+#include "core/TextSearch.hpp"
+#include "core/TimeGaps.hpp"
+#include "core/TrigramIndex.hpp"
+#include "widgets/DiffWindow.hpp"
+#include "widgets/FileSearchWindow.hpp"
 #include "widgets/LogDisplayWidget.hpp"
 #include "widgets/MenuBarWidget.hpp"
+#include "widgets/QueryWindow.hpp"
+#include "widgets/TemplatesWindow.hpp"
 #include "widgets/SearchBarWidget.hpp"
 #include "widgets/StatusBarWidget.hpp"
+#include "widgets/TabBarWidget.hpp"
 #include <FL/Fl_Window.H>
+#include <FL/fl_ask.H>
+
+#include <atomic>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
 
 namespace
 {
 constexpr int MENU_BAR_HEIGHT = 25;
 constexpr int STATUS_BAR_HEIGHT = 25;
 constexpr int SEARCH_BAR_HEIGHT = 25;
+constexpr int TAB_BAR_HEIGHT = 25;
 } // namespace
 
 struct AppContext
@@ -17,6 +56,7 @@ struct AppContext
     Fl_Window* window;
     MenuBarWidget* menuBar;
     SearchBarWidget* searchBar;
+    TabBarWidget* tabBar;
     StatusBarWidget* statusBar;
     LogDisplayWidget* logDisplay;
 };
@@ -30,24 +70,566 @@ public:
         createMenuBarWidget();
         createSearchBarWidget();
         createStatusBarWidget();
+        createTabBarWidget();
         createLogDisplayWidget();
 
         context.window->show();
     }
 
+    ~Window()
+    {
+        openTask = TaskHandle(); // it may wait for a sidecar to be saved
+        for (Document& document : documents)
+        {
+            removeSidecar(document);
+        }
+    }
+
     void show()
     {
         context.window->show();
     }
 
-    void loadData(const char* data, size_t size)
+    // Open the file in a new tab, or show its tab if it is open already. The other documents stay open in their tabs.
+    // If a line is given, the view is moved to it once the file is loaded.
+    void openFile(const std::string& path, const std::optional<size_t> lineIndex = std::nullopt)
+    {
+        for (size_t i = 0; i < documents.size(); i++)
+        {
+            if (!documents[i].stream && documents[i].path == path)
+            {
+                showDocument(i, lineIndex);
+                return;
+            }
+        }
+        addDocument(path, std::filesystem::path(path).filename().string());
+        loadDocument(lineIndex);
+    }
+    // Display the text piped to the standard input, e.g. "kubectl logs -f pod | LogViewer -", while it arrives.
+    // A reader thread appends the text to a stream buffer, which never moves it, and posts updates a few times
+    // per second. Only the new lines are indexed with every update and the view follows the end of the log.
+    void openStandardInput()
+    {
+        const auto open = std::find_if(documents.begin(), documents.end(), [](const auto& document) {
+            return document.stream != nullptr;
+        });
+        if (open != documents.end()) // it can be read only once
+        {
+            showDocument(static_cast<size_t>(open - documents.begin()));
+            return;
+        }
+        auto buffer = std::make_shared<StreamBuffer>();
+        if (!buffer->isOpen())
+        {
+            context.statusBar->setStatusInformation(buffer->getErrorMessage());
+            return;
+        }
+        addDocument("-", "Standard input");
+        documents[currentDocument].stream = buffer;
+        stream = buffer;
+        context.logDisplay->setData(buffer->data(), 0, std::make_shared<LineIndex>());
+        context.statusBar->setStatusInformation("Reading standard input...");
+
+        streamReader = std::jthread([this, buffer](std::stop_token stopToken) {
+            auto lastUpdate = std::chrono::steady_clock::now() - STREAM_UPDATE_INTERVAL;
+            while (!stopToken.stop_requested())
+            {
+                const bool reading = buffer->readStandardInput(STREAM_UPDATE_INTERVAL / 4);
+                const bool allShown = buffer->size() == streamShownSize;
+                if (!reading && allShown)
+                {
+                    break;
+                }
+                const auto now = std::chrono::steady_clock::now();
+                if (!allShown && now - lastUpdate >= STREAM_UPDATE_INTERVAL)
+                {
+                    lastUpdate = now;
+                    runOnUiThread([this, buffer] { showStreamData(buffer); });
+                }
+                if (!reading)
+                {
+                    std::this_thread::sleep_for(STREAM_UPDATE_INTERVAL / 4);
+                }
+            }
+            runOnUiThread([this, buffer] { showStreamData(buffer); });
+        });
+    }
+
+    // Close the current document and its tab and show the most recently used of the other documents
+    void closeFile()
     {
-        context.logDisplay->setData(data, size);
-        context.statusBar->setNumberOfLines(context.logDisplay->getLines().size());
-        context.statusBar->setStatusInformation("File loaded successfully");
+        if (documents.empty())
+        {
+            return;
+        }
+        if (stream)
+        {
+            streamReader = std::jthread();
+            streamShownSize = 0;
+        }
+        resetDocumentState();
+        removeSidecar(documents[currentDocument]);
+        documents.erase(documents.begin() + static_cast<std::ptrdiff_t>(currentDocument));
+        context.tabBar->removeTab(currentDocument);
+        if (documents.empty())
+        {
+            currentDocument = 0;
+            return;
+        }
+
+        const auto mostRecent = std::max_element(documents.begin(), documents.end(), [](const auto& a, const auto& b) {
+            return a.lastUse < b.lastUse;
+        });
+        currentDocument = static_cast<size_t>(mostRecent - documents.begin());
+        context.tabBar->selectTab(currentDocument);
+        restoreDocument(std::nullopt);
     }
 
 private:
+    // Files bigger than this are displayed approximately while they are indexed, smaller ones are indexed at once
+    static constexpr size_t APPROXIMATE_VIEW_SIZE = 256 * 1024;
+
+    // The encoding of a file is detected from this many bytes at its beginning
+    static constexpr size_t ENCODING_SAMPLE_SIZE = 64 * 1024;
+
+    // The standard input is shown at most this often, with at most STREAM_UPDATE_SIZE new bytes at a time
+    static constexpr std::chrono::milliseconds STREAM_UPDATE_INTERVAL{250};
+    static constexpr size_t STREAM_UPDATE_SIZE = 128 * 1024 * 1024;
+
+    // Fields of the standard input are detected with every update until it has this many lines
+    static constexpr size_t STREAM_FIELD_DETECTION_LINES = 1000;
+
+    // Inactive documents may keep this much in memory when the size of the physical memory is unknown
+    static constexpr size_t DEFAULT_INACTIVE_DOCUMENTS_BUDGET = size_t{1} << 30;
+
+    // An open log with its tab. The current document lives in the widgets and the members of the window,
+    // an inactive one keeps its mapping and line index, until it is evicted, and the position of its view.
+    struct Document
+    {
+        std::string path; // "-" for the standard input
+        std::shared_ptr<MappedFile> file;
+        std::shared_ptr<StreamBuffer> stream;
+        std::shared_ptr<LineIndex> index;
+        std::shared_ptr<SearchCache> searchCache;
+        size_t topLine = 0;
+        std::pair<size_t, size_t> selection{0, 0};
+        uint64_t lastUse = 0;
+        TaskHandle saveTask;     // saves the index of the evicted document to its sidecar
+        bool hasSidecar = false; // the index has been saved to the sidecar, which is removed with the document
+    };
+
+    // Add a document with its tab and make it the current one. The previous one stays open in its tab.
+    void addDocument(std::string path, const std::string& label)
+    {
+        putAsideCurrentDocument();
+        Document document;
+        document.path = std::move(path);
+        document.lastUse = ++documentUseCounter;
+        documents.push_back(std::move(document));
+        currentDocument = documents.size() - 1;
+        context.tabBar->addTab(label);
+        evictInactiveDocuments();
+    }
+
+    // Map and index the file of the current document in the background. A big file is displayed approximately
+    // (positioned by byte offset, with estimated line numbers) until the index of all lines is built. Unless the user
+    // has chosen an encoding, it is detected from the beginning of the file. An evicted document is given the task
+    // saving its index, the job waits for it and loads the index from the sidecar, if the file has not changed since.
+    void loadDocument(const std::optional<size_t> lineIndex, TaskHandle saveTask = TaskHandle())
+    {
+        const std::string path = documents[currentDocument].path;
+        context.statusBar->setStatusInformation("Opening " + path + "...");
+
+        const bool evicted = saveTask.hasJob();
+        openTask = scheduler.start(
+            [this, path, lineIndex, evicted, pendingSave = std::make_shared<TaskHandle>(std::move(saveTask)),
+             budget = memoryBudget, chosenEncoding = textEncoding](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                auto mappedFile = std::make_shared<MappedFile>(path);
+                if (!mappedFile->isOpen())
+                {
+                    runOnUiThread([this, message = mappedFile->getErrorMessage(), stopToken] {
+                        if (!stopToken.stop_requested())
+                        {
+                            context.statusBar->setStatusInformation(message);
+                        }
+                    });
+                    return;
+                }
+                mappedFile->setMemoryBudget(budget.value_or(getDefaultMemoryBudget(mappedFile->size())));
+                const LineIndex::AccessCallback onAccess = [&mappedFile](size_t begin, size_t end) {
+                    mappedFile->touch(begin, end);
+                };
+
+                const char* data = mappedFile->data();
+                const size_t size = mappedFile->size();
+                auto index = std::make_shared<LineIndex>();
+                bool indexed = false;
+                if (evicted)
+                {
+                    pendingSave->wait();
+                    const std::string indexPath = LineIndex::getIndexPath(path);
+                    indexed = index->load(indexPath, data, size) &&
+                              (!chosenEncoding || index->getEncoding() == *chosenEncoding);
+                    std::remove(indexPath.c_str());
+                }
+
+                if (!indexed)
+                {
+                    const TextEncoding encoding =
+                        chosenEncoding.value_or(detectTextEncoding({data, std::min(size, ENCODING_SAMPLE_SIZE)}));
+
+                    // The approximate view scans for UTF-8 newlines in the raw data
+                    if (size > APPROXIMATE_VIEW_SIZE && encoding == TextEncoding::Utf8)
+                    {
+                        runOnUiThread([this, data, size, stopToken] {
+                            if (!stopToken.stop_requested())
+                            {
+                                context.logDisplay->setApproximateData(data, size);
+                                context.statusBar->setStatusInformation("Indexing...");
+                            }
+                        });
+                    }
+
+                    if (!index->build(data, size, &scheduler, onAccess, stopToken, encoding))
+                    {
+                        return;
+                    }
+                }
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                runOnUiThread([this, mappedFile, index, elapsed, lineIndex, stopToken] {
+                    if (stopToken.stop_requested())
+                    {
+                        return;
+                    }
+                    loadFile(mappedFile, index, elapsed);
+                    const auto& lines = context.logDisplay->getLines();
+                    if (lineIndex && !lines.empty())
+                    {
+                        context.logDisplay->goToOffset(lines[std::min(*lineIndex, lines.size() - 1)].first);
+                    }
+                });
+            },
+            TaskPriority::Interactive);
+    }
+
+    // Display the document of the tab. A document that is shown already only moves to the line.
+    void showDocument(const size_t index, const std::optional<size_t> lineIndex = std::nullopt)
+    {
+        if (index == currentDocument)
+        {
+            const auto& lines = context.logDisplay->getLines();
+            if (lineIndex && openTask.isFinished() && !lines.empty())
+            {
+                context.logDisplay->goToOffset(lines[std::min(*lineIndex, lines.size() - 1)].first);
+            }
+            return;
+        }
+        putAsideCurrentDocument();
+        currentDocument = index;
+        context.tabBar->selectTab(index);
+        restoreDocument(lineIndex);
+        evictInactiveDocuments();
+    }
+
+    // Keep the current document in its tab while another one is displayed: its mapping, line index, search cache
+    // and position. A document that is still being opened is opened again when its tab is selected.
+    void putAsideCurrentDocument()
+    {
+        if (documents.empty())
+        {
+            return;
+        }
+        Document& document = documents[currentDocument];
+        const bool loaded = openTask.isFinished() && (file || stream);
+        cancelDocumentTasks(); // before the lines that they read are taken from the widget
+        if (loaded)
+        {
+            document.topLine = context.logDisplay->getTopLine();
+            document.selection = context.logDisplay->getSelection();
+            document.file = file;
+            document.searchCache = searchCache;
+            document.index = context.logDisplay->takeData();
+        }
+        resetDocumentState();
+    }
+
+    // Display the current document again with what its tab has kept. An evicted document is opened again.
+    void restoreDocument(const std::optional<size_t> lineIndex)
+    {
+        Document& document = documents[currentDocument];
+        document.lastUse = ++documentUseCounter;
+        if (!document.index)
+        {
+            loadDocument(lineIndex.value_or(document.topLine), std::move(document.saveTask));
+            return;
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        auto index = std::move(document.index);
+        searchCache = std::move(document.searchCache);
+        if (document.stream)
+        {
+            stream = document.stream;
+            context.logDisplay->setData(stream->data(), streamShownSize, std::move(index));
+            context.statusBar->setNumberOfLines(context.logDisplay->getLines().size());
+            context.statusBar->setStatusInformation("Reading standard input...");
+            parseStreamLines(true);
+            if (timeGapsShown)
+            {
+                analyzeTimeGaps();
+            }
+            showStreamData(stream); // the text that arrived in the meantime
+        }
+        else
+        {
+            const auto elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+            loadFile(std::move(document.file), std::move(index), elapsed);
+        }
+
+        const auto& lines = context.logDisplay->getLines();
+        if (lineIndex && !lines.empty())
+        {
+            context.logDisplay->goToOffset(lines[std::min(*lineIndex, lines.size() - 1)].first);
+            return;
+        }
+        context.logDisplay->scrollToLine(document.topLine);
+        context.logDisplay->select(document.selection.first, document.selection.second);
+    }
+
+    // Inactive documents keep their mappings and line indexes while they fit in the budget together, beyond it
+    // the least recently used ones are evicted. The index of an evicted document is saved to its sidecar
+    // in the background, then the index is released and the file is unmapped.
+    // The standard input cannot be read again, so it is never evicted.
+    void evictInactiveDocuments()
+    {
+        const auto isEvictable = [this](const Document& document) {
+            return &document != &documents[currentDocument] && document.file && document.index;
+        };
+        const auto getMemoryUsage = [](const Document& document) {
+            const size_t mappedSize = document.file->getMemoryBudget() > 0 ? document.file->getMemoryBudget()
+                                                                           : document.file->size();
+            return mappedSize + document.index->getMemoryUsage();
+        };
+
+        size_t memoryUsage = 0;
+        for (const Document& document : documents)
+        {
+            if (isEvictable(document))
+            {
+                memoryUsage += getMemoryUsage(document);
+            }
+        }
+
+        const size_t budget = getInactiveDocumentsBudget();
+        while (memoryUsage > budget)
+        {
+            Document* leastRecent = nullptr;
+            for (Document& document : documents)
+            {
+                if (isEvictable(document) && (leastRecent == nullptr || document.lastUse < leastRecent->lastUse))
+                {
+                    leastRecent = &document;
+                }
+            }
+            memoryUsage -= getMemoryUsage(*leastRecent);
+            leastRecent->hasSidecar = true;
+            leastRecent->saveTask = scheduler.start(
+                [evictedFile = std::move(leastRecent->file), index = std::move(leastRecent->index)](std::stop_token) {
+                    index->save(LineIndex::getIndexPath(evictedFile->getPath()));
+                },
+                TaskPriority::Background);
+        }
+    }
+
+    // Inactive documents may use a quarter of the physical memory together
+    static size_t getInactiveDocumentsBudget()
+    {
+        const size_t physicalMemory = MappedFile::getPhysicalMemorySize();
+        return physicalMemory > 0 ? physicalMemory / 4 : DEFAULT_INACTIVE_DOCUMENTS_BUDGET;
+    }
+
+    // Sidecars are only needed while their documents are open, so they do not pile up next to the logs
+    static void removeSidecar(Document& document)
+    {
+        document.saveTask = TaskHandle();
+        if (document.hasSidecar)
+        {
+            std::remove(LineIndex::getIndexPath(document.path).c_str());
+        }
+    }
+
+    // The tasks share ownership of what they read, so they are only stopped and the document can be released
+    // without waiting for them. Exports keep their own reference to the file and finish anyway.
+    void cancelDocumentTasks()
+    {
+        for (TaskHandle* task : {&openTask, &searchTask, &indexTask, &queryTask, &templateTask, &gapTask, &sortTask})
+        {
+            stopTask(*task);
+        }
+    }
+
+    // Cancel all work on the current document and release its state. Its tab keeps what brings it back.
+    void resetDocumentState()
+    {
+        cancelDocumentTasks();
+
+        context.logDisplay->setFieldStore(nullptr);
+        context.logDisplay->setTimeGaps(nullptr);
+        context.logDisplay->setData(nullptr, 0, std::make_shared<LineIndex>());
+        context.statusBar->setNumberOfLines(0);
+        context.statusBar->setStatusInformation(" ");
+        fieldStore.reset();
+        trigramIndex.reset();
+        templateMiner.reset();
+        lastQuery.reset();
+        timeGaps.reset();
+        nextGapRank = 0;
+        jumpToGapWhenAnalyzed = false;
+        if (queryWindow != nullptr)
+        {
+            queryWindow->setResults({});
+            queryWindow->setRunning(false);
+            queryWindow->setStatus(" ");
+        }
+        if (templatesWindow != nullptr)
+        {
+            templatesWindow->setTemplates({});
+            templatesWindow->setStatus(" ");
+        }
+        searchCache = std::make_shared<SearchCache>();
+        lastViewportBegin = 0;
+        file.reset();
+        stream.reset();
+    }
+
+    // Index and display the text read from the standard input since the last update. The lines are extended
+    // on the UI thread, so the update waits while a background task reads them, the reader posts it again.
+    void showStreamData(const std::shared_ptr<StreamBuffer>& buffer)
+    {
+        if (buffer != stream)
+        {
+            return;
+        }
+        const size_t shownSize = streamShownSize;
+        const size_t size = std::min(buffer->size(), shownSize + STREAM_UPDATE_SIZE);
+        if (size != shownSize && !areLinesRead())
+        {
+            const size_t previousNumberOfLines = context.logDisplay->getLines().size();
+            context.logDisplay->appendData(size, &scheduler);
+            streamShownSize = size;
+            searchCache = std::make_shared<SearchCache>(); // the cached lines miss the new ones
+            context.statusBar->setNumberOfLines(context.logDisplay->getLines().size());
+            parseStreamLines(previousNumberOfLines < STREAM_FIELD_DETECTION_LINES);
+        }
+
+        if (buffer->hasEnded() && streamShownSize == buffer->size())
+        {
+            const std::string& error = buffer->getErrorMessage();
+            context.statusBar->setStatusInformation(error.empty() ? "Standard input closed" : error);
+        }
+    }
+
+    // Extend the fields and the time gaps of the standard input to the appended lines. Until fields are found,
+    // they are detected again if asked to, the detection samples only the first lines.
+    void parseStreamLines(const bool detectFields)
+    {
+        if (!canParseLines())
+        {
+            return;
+        }
+        if (fieldStore)
+        {
+            fieldStore->extend();
+        }
+        else if (detectFields)
+        {
+            const auto& lines = context.logDisplay->getLines();
+            if (auto extractor = createFieldExtractor(context.logDisplay->getData(), lines))
+            {
+                fieldStore = std::make_shared<FieldStore>(context.logDisplay->getData(), lines, std::move(extractor));
+                context.logDisplay->setFieldStore(fieldStore.get());
+                showFieldColumns();
+            }
+        }
+        if (timeGaps)
+        {
+            analyzeTimeGaps();
+        }
+    }
+
+    void loadFile(std::shared_ptr<MappedFile> mappedFile, std::shared_ptr<LineIndex> index,
+                  std::chrono::milliseconds elapsed)
+    {
+        file = std::move(mappedFile);
+        const char* data = file->data();
+        context.logDisplay->setData(data, file->size(), std::move(index));
+        const auto& lines = context.logDisplay->getLines();
+        context.statusBar->setNumberOfLines(lines.size());
+        std::string status = "File loaded in " + std::to_string(elapsed.count()) + " ms";
+        const TextEncoding encoding = context.logDisplay->getIndexedLines().getEncoding();
+        if (encoding != TextEncoding::Utf8)
+        {
+            status += " (" + std::string(getEncodingName(encoding)) + ")";
+        }
+        if (auto extractor = canParseLines() ? createFieldExtractor(data, lines) : nullptr)
+        {
+            status += " (" + std::string(extractor->getName()) + " fields detected)";
+            fieldStore = std::make_shared<FieldStore>(data, lines, std::move(extractor));
+        }
+
+        const auto& invalidChunks = context.logDisplay->getIndexedLines().getInvalidUtf8Chunks();
+        if (!invalidChunks.empty())
+        {
+            status += ", invalid UTF-8 near offset " + std::to_string(invalidChunks.front() * LineIndex::CHUNK_SIZE);
+        }
+        if (file->getMemoryBudget() > 0)
+        {
+            status += ", memory budget " + std::to_string(file->getMemoryBudget() >> 20) + " MiB";
+        }
+        context.statusBar->setStatusInformation(status);
+        context.logDisplay->setFieldStore(fieldStore.get());
+        if (searchIndexEnabled)
+        {
+            buildSearchIndex();
+        }
+        if (templatesWindow != nullptr && templatesWindow->shown() && canParseLines())
+        {
+            mineTemplates();
+        }
+        if (timeGapsShown)
+        {
+            analyzeTimeGaps();
+        }
+    }
+
+    // Fields, timestamps and templates are parsed in the original bytes of the file or the standard input,
+    // which works only where ASCII characters are single bytes
+    bool canParseLines() const
+    {
+        return (file || stream) && isAsciiCompatible(context.logDisplay->getIndexedLines().getEncoding());
+    }
+
+    // The query in the encoding of the displayed text, nothing if the encoding cannot represent it
+    std::optional<std::string> encodeQuery(const std::string& query) const
+    {
+        return encodeFromUtf8(query, context.logDisplay->getIndexedLines().getEncoding());
+    }
+
+    // The format chosen by the user or the one detected in the lines
+    std::unique_ptr<FieldExtractor> createFieldExtractor(const char* data,
+                                                         const std::vector<std::pair<size_t, size_t>>& lines) const
+    {
+        if (logFormat.empty())
+        {
+            return detectFieldExtractor(data, lines);
+        }
+        std::string errorMessage;
+        return FormatFieldExtractor::create(logFormat, errorMessage);
+    }
+
     void createWindowWidget()
     {
         auto window = new Fl_Window(600, 500);
@@ -69,6 +651,30 @@ private:
         window->begin();
         context.menuBar = new MenuBarWidget(0, 0, context.window->w(), MENU_BAR_HEIGHT);
         window->end();
+
+        context.menuBar->onOpenFile([this](const std::string& path) { openFile(path); });
+        context.menuBar->onCloseFile([this] { closeFile(); });
+        context.menuBar->onCompareWith([this](const std::string& path) { compareWith(path); });
+        context.menuBar->onExportSelection([this](const std::string& path) { exportSelection(path); });
+        context.menuBar->onExportMatchingLines([this](const std::string& path) { exportMatchingLines(path); });
+        context.menuBar->onFieldColumns([this] { chooseFieldColumns(); });
+        context.menuBar->onSortByField([this] { sortByField(); });
+        context.menuBar->onLogFormat([this] { chooseLogFormat(); });
+        context.menuBar->onEncoding([this] { chooseEncoding(); });
+        context.menuBar->onMemoryBudget([this] { chooseMemoryBudget(); });
+        context.menuBar->onAggregate([this] { showQueryWindow(); });
+        context.menuBar->onLogTemplates([this] { showTemplatesWindow(); });
+        context.menuBar->onWordWrap([this](bool enabled) { context.logDisplay->setWrapEnabled(enabled); });
+        context.menuBar->onTimeGaps([this](bool shown) { setTimeGapsShown(shown); });
+        context.menuBar->onSearchIndex([this](bool enabled) { setSearchIndexEnabled(enabled); });
+        context.menuBar->onGoTo([this] { goTo(); });
+        context.menuBar->onNextLargestGap([this] { nextLargestGap(); });
+        context.menuBar->onSearchInFiles([this] { showFileSearchWindow(); });
+        context.menuBar->onClearFilter([this] {
+            context.logDisplay->clearLineFilter();
+            context.statusBar->setNumberOfLines(context.logDisplay->getLines().size());
+            context.statusBar->setStatusInformation("Filter cleared");
+        });
     }
 
     void createSearchBarWidget()
@@ -78,13 +684,15 @@ private:
         context.searchBar = new SearchBarWidget(0, MENU_BAR_HEIGHT, window->w(), SEARCH_BAR_HEIGHT);
         window->end();
 
-        context.searchBar->onSearch([this](const std::string& query) { search(query); });
+        context.searchBar->onSearch([this](const std::string& query) { findNext(query); });
+        context.searchBar->onQueryChanged([this](const std::string& query) { search(query); });
 
         context.searchBar->onClose([this] {
             const auto window = context.window;
             context.searchBar->hide();
-            context.logDisplay->resize(0, MENU_BAR_HEIGHT, window->w(),
-                                       window->h() - MENU_BAR_HEIGHT - STATUS_BAR_HEIGHT);
+            context.tabBar->position(0, MENU_BAR_HEIGHT);
+            context.logDisplay->resize(0, MENU_BAR_HEIGHT + TAB_BAR_HEIGHT, window->w(),
+                                       window->h() - MENU_BAR_HEIGHT - TAB_BAR_HEIGHT - STATUS_BAR_HEIGHT);
         });
     }
 
@@ -96,47 +704,1307 @@ private:
         window->end();
     }
 
+    void createTabBarWidget()
+    {
+        auto window = context.window;
+        window->begin();
+        context.tabBar = new TabBarWidget(0, MENU_BAR_HEIGHT + SEARCH_BAR_HEIGHT, window->w(), TAB_BAR_HEIGHT);
+        window->end();
+
+        context.tabBar->onTabSelected([this](size_t index) { showDocument(index); });
+    }
+
     void createLogDisplayWidget()
     {
         auto window = context.window;
         window->begin();
-        constexpr int widgetTopOffset = MENU_BAR_HEIGHT + SEARCH_BAR_HEIGHT;
-        const int widgetHeight = window->h() - MENU_BAR_HEIGHT - STATUS_BAR_HEIGHT - SEARCH_BAR_HEIGHT;
+        constexpr int widgetTopOffset = MENU_BAR_HEIGHT + SEARCH_BAR_HEIGHT + TAB_BAR_HEIGHT;
+        const int widgetHeight =
+            window->h() - MENU_BAR_HEIGHT - STATUS_BAR_HEIGHT - SEARCH_BAR_HEIGHT - TAB_BAR_HEIGHT;
         context.logDisplay = new LogDisplayWidget(0, widgetTopOffset, window->w(), widgetHeight);
         window->resizable(context.logDisplay);
         window->end();
 
-        context.logDisplay->onCursorPositionChanged([this](size_t lineIndex, size_t charIndex) {
-            auto statusBar = context.statusBar;
-            auto line = context.logDisplay->getLines().at(lineIndex);
-            statusBar->setCursorPosition(lineIndex + 1, charIndex, line.first + charIndex);
+        context.logDisplay->onCursorPositionChanged([this](size_t lineIndex, size_t column, size_t dataIndex) {
+            context.statusBar->setCursorPosition(lineIndex + 1, column, dataIndex);
+        });
+
+        context.logDisplay->onViewportChanged([this](size_t begin, size_t end) {
+            if (!file || file->getMemoryBudget() == 0)
+            {
+                return;
+            }
+            file->touch(begin, end);
+
+            // Read ahead in the direction of scrolling
+            if (begin > lastViewportBegin)
+            {
+                file->prefetch(end, end + MappedFile::WINDOW_SIZE);
+            }
+            else if (begin < lastViewportBegin)
+            {
+                file->prefetch(begin - std::min(begin, MappedFile::WINDOW_SIZE), begin);
+            }
+            lastViewportBegin = begin;
+        });
+
+        context.logDisplay->onFileDropped([this](const std::string& path) { openFile(path); });
+
+        context.logDisplay->onClipboardLimitExceeded([this](size_t copiedBytes, size_t) {
+            context.statusBar->setStatusInformation("Clipboard limited to " + std::to_string(copiedBytes >> 20) +
+                                                    " MiB, use File/Export Selection to save everything");
         });
     }
 
+    // The UI thread never waits for background work: a stopped task is kept until it finishes, because it may
+    // still read the lines, and its result is dropped
+    void stopTask(TaskHandle& task)
+    {
+        task.requestStop();
+        std::erase_if(stoppedTasks, [](const TaskHandle& stopped) { return stopped.isFinished(); });
+        if (task.hasJob())
+        {
+            stoppedTasks.push_back(std::move(task)); // moving does not wait, unlike assigning
+        }
+    }
+
+    void stopSearch()
+    {
+        stopTask(searchTask);
+    }
+
+    // The lines of the standard input are extended in place, which waits until no task reads them.
+    // Stopped tasks count as well, they may belong to this document shown again.
+    bool areLinesRead() const
+    {
+        const auto isRunning = [](const TaskHandle& task) { return !task.isFinished(); };
+        return isRunning(searchTask) || isRunning(queryTask) || isRunning(templateTask) || isRunning(gapTask) ||
+               isRunning(sortTask) || std::any_of(stoppedTasks.begin(), stoppedTasks.end(), isRunning);
+    }
+
+    // Search as you type. The match is looked for starting from the current selection,
+    // so that typing more characters refines the match that is already selected.
     void search(const std::string& query)
     {
-        auto& logDisplay = context.logDisplay;
-        const auto& lines = logDisplay->getLines();
-        const auto& data = logDisplay->getData();
+        startSearch(query, context.logDisplay->getSelection().first);
+    }
+
+    void findNext(const std::string& query)
+    {
+        const auto [selectionBegin, selectionEnd] = context.logDisplay->getSelection();
+        const auto pattern = encodeQuery(query);
+        const bool queryIsSelected = pattern && selectionEnd - selectionBegin == pattern->size() &&
+                                     std::string_view(context.logDisplay->getData() + selectionBegin,
+                                                      selectionEnd - selectionBegin) == *pattern;
+        startSearch(query, queryIsSelected ? selectionBegin + 1 : selectionBegin);
+    }
+
+    // Run the search on the scheduler. Starting a new search cancels the previous one without waiting for it.
+    // The query is encoded like the text, so that the original bytes are searched without decoding them.
+    void startSearch(const std::string& query, size_t fromOffset)
+    {
+        lastSearchQuery = query;
+        stopSearch();
+        if (query.empty())
+        {
+            context.statusBar->setStatusInformation(" ");
+            return;
+        }
+
+        if (context.logDisplay->isApproximate())
+        {
+            context.statusBar->setStatusInformation("Search is available once the file is indexed");
+            return;
+        }
 
-        for (size_t lineIndex = 0; lineIndex < lines.size(); lineIndex++)
+        const auto encodedQuery = encodeQuery(query);
+        if (!encodedQuery)
         {
-            auto [lineBegin, lineEnd] = lines[lineIndex];
-            std::string_view line(data + lineBegin, lineEnd - lineBegin);
-            size_t pos = line.find(query);
-            if (pos != std::string_view::npos)
+            context.statusBar->setStatusInformation("No matches found: " + query);
+            return;
+        }
+
+        const size_t dataSize = context.logDisplay->getDataSize();
+        const size_t codeUnitSize = getCodeUnitSize(context.logDisplay->getIndexedLines().getEncoding());
+        context.statusBar->setStatusInformation("Searching: " + query);
+
+        searchTask = scheduler.start(
+            [this, query, pattern = *encodedQuery, codeUnitSize, fromOffset, documentData = shareDocumentData(),
+             dataSize, searchFile = file, cache = searchCache, index = trigramIndex](std::stop_token stopToken) {
+                const auto& summaries = documentData.index->getBlockSummaries();
+                TextSearch textSearch(documentData.data, dataSize, documentData.getLines());
+                textSearch.setScheduler(&scheduler, TaskPriority::Interactive);
+                textSearch.setCodeUnitSize(codeUnitSize);
+                if (searchFile)
+                {
+                    textSearch.onDataAccess([&searchFile](size_t begin, size_t end) { searchFile->touch(begin, end); });
+                }
+
+                const auto cached = cache->lookup(pattern);
+                if (cached.exact)
+                {
+                    showSearchResult(query, textSearch.findNextInLines(pattern, fromOffset, *cached.lines), stopToken);
+                    return;
+                }
+
+                // Narrowing a cached query only checks the lines that it matched,
+                // otherwise the search index or the block summaries may tell which lines can contain the query
+                const auto candidateLines =
+                    cached.lines ? cached.lines : findCandidateLines(index.get(), summaries, pattern);
+                if (candidateLines)
+                {
+                    if (const auto matchingLines =
+                            findMatchingLines(textSearch, pattern, candidateLines.get(), *cache, stopToken))
+                    {
+                        showSearchResult(query, textSearch.findNextInLines(pattern, fromOffset, *matchingLines),
+                                         stopToken);
+                    }
+                    return;
+                }
+
+                auto lastUpdate = std::chrono::steady_clock::now();
+                textSearch.onProgress([this, &lastUpdate, stopToken](size_t bytesScanned, size_t bytesTotal) {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (now - lastUpdate < std::chrono::milliseconds(100) || bytesTotal == 0)
+                    {
+                        return;
+                    }
+                    lastUpdate = now;
+                    const size_t percent = bytesScanned * 100 / bytesTotal;
+                    runOnUiThread([this, percent, stopToken] {
+                        if (!stopToken.stop_requested())
+                        {
+                            context.statusBar->setStatusInformation("Searching... " + std::to_string(percent) + "%");
+                        }
+                    });
+                });
+                showSearchResult(query, textSearch.findNext(pattern, fromOffset, stopToken), stopToken);
+
+                // Remember all matching lines for the refinements of this query
+                textSearch.setScheduler(&scheduler, TaskPriority::Background);
+                findMatchingLines(textSearch, pattern, nullptr, *cache, stopToken);
+            },
+            TaskPriority::Interactive);
+    }
+
+    void showSearchResult(const std::string& query, const std::optional<SearchMatch>& match,
+                          std::stop_token stopToken)
+    {
+        runOnUiThread([this, query, match, stopToken] {
+            // The results of a cancelled search are stale
+            if (stopToken.stop_requested())
             {
-                size_t begin = lineBegin + pos;
-                size_t end = begin + query.size();
-                logDisplay->select(begin, end);
-                logDisplay->scrollToLine(lineIndex);
-                context.statusBar->setStatusInformation("Match found: " + query);
                 return;
             }
+            if (match)
+            {
+                context.logDisplay->select(match->begin, match->end);
+                context.logDisplay->scrollToLine(match->lineIndex);
+                context.statusBar->setStatusInformation("Match found: " + query + getSearchCacheStatistics());
+            }
+            else
+            {
+                context.statusBar->setStatusInformation("No matches found: " + query + getSearchCacheStatistics());
+            }
+        });
+    }
+
+    // Searches answered from the cached lines of the same or a shorter query, and the other ones
+    std::string getSearchCacheStatistics() const
+    {
+        if (!searchCache)
+        {
+            return {};
+        }
+        return " (search cache: " + std::to_string(searchCache->getHits()) + " hits, " +
+               std::to_string(searchCache->getMisses()) + " misses)";
+    }
+
+    // Sorted indices of lines containing the query, only the candidate lines are checked if there are any.
+    // The result is cached. Returns nothing if the search was cancelled.
+    static SearchCache::LineList findMatchingLines(const TextSearch& textSearch, const std::string& query,
+                                                   const std::vector<uint32_t>* candidateLines, SearchCache& cache,
+                                                   std::stop_token stopToken)
+    {
+        auto matchingLines = textSearch.findMatchingLines(query, candidateLines, stopToken);
+        if (!matchingLines)
+        {
+            return nullptr;
+        }
+        auto result = std::make_shared<const std::vector<uint32_t>>(std::move(*matchingLines));
+        cache.insert(query, result);
+        return result;
+    }
+
+    // Lines of the blocks that can contain the query according to the search index or, if it cannot help,
+    // the block summaries. Returns nothing if the query is too common to skip many blocks.
+    static SearchCache::LineList findCandidateLines(const TrigramIndex* index, const BlockSummaries& summaries,
+                                                    const std::string& query)
+    {
+        if (index != nullptr)
+        {
+            const auto blocks = index->findCandidateBlocks(query);
+            if (blocks && blocks->size() <= index->getNumberOfBlocks() / 2)
+            {
+                return std::make_shared<const std::vector<uint32_t>>(index->getLinesOfBlocks(*blocks));
+            }
+        }
+        const auto blocks = summaries.findCandidateBlocks(query);
+        if (!blocks || blocks->size() > summaries.getNumberOfBlocks() / 2)
+        {
+            return nullptr;
+        }
+        return std::make_shared<const std::vector<uint32_t>>(summaries.getLinesOfBlocks(*blocks));
+    }
+
+    void setSearchIndexEnabled(const bool enabled)
+    {
+        searchIndexEnabled = enabled;
+        if (enabled)
+        {
+            buildSearchIndex();
+            return;
+        }
+        indexTask = TaskHandle();
+        trigramIndex.reset();
+        context.statusBar->setStatusInformation("Search index disabled");
+    }
+
+    // Load the search index saved next to the file or build it in the background and save it
+    void buildSearchIndex()
+    {
+        if (!file)
+        {
+            return;
+        }
+        const std::string indexPath = TrigramIndex::getIndexPath(file->getPath());
+        context.statusBar->setStatusInformation("Building search index...");
+
+        indexTask = scheduler.start(
+            [this, documentData = shareDocumentData(), indexPath, indexFile = file](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                const char* data = documentData.data;
+                const auto& lines = documentData.getLines();
+                auto index = std::make_shared<TrigramIndex>();
+                const bool loaded = index->load(indexPath, data, lines);
+                if (!loaded)
+                {
+                    const auto onAccess = [&indexFile](size_t begin, size_t end) { indexFile->touch(begin, end); };
+                    if (!index->build(data, lines, scheduler, stopToken, onAccess))
+                    {
+                        return;
+                    }
+                    index->save(indexPath);
+                }
+
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                const std::string message = std::string(loaded ? "Search index loaded" : "Search index built") +
+                                            " in " + std::to_string(elapsed.count()) + " ms, " +
+                                            std::to_string(index->getMemoryUsage() >> 20) + " MiB";
+                runOnUiThread([this, index, message, stopToken] {
+                    if (!stopToken.stop_requested())
+                    {
+                        trigramIndex = index;
+                        context.statusBar->setStatusInformation(message);
+                    }
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    // Jump to a line number, a byte offset ("@1048576") or a percentage of the file ("50%")
+    void goTo()
+    {
+        const LineIndex& lines = context.logDisplay->getIndexedLines();
+        if (lines.empty())
+        {
+            return;
+        }
+        const char* input = fl_input("Go to line, byte offset (@1048576) or percentage of the file (50%):", "");
+        if (input == nullptr)
+        {
+            return;
+        }
+
+        const std::string_view text(input);
+        if (context.logDisplay->isApproximate())
+        {
+            goToApproximately(text);
+            return;
+        }
+
+        const size_t dataSize = context.logDisplay->getDataSize();
+        size_t offset = 0;
+        if (text.ends_with('%'))
+        {
+            const double percent = std::clamp(std::strtod(input, nullptr), 0.0, 100.0);
+            offset = static_cast<size_t>(static_cast<double>(dataSize) * percent / 100);
+            offset = lines[lines.findLine(offset)].first;
+        }
+        else if (text.starts_with('@'))
+        {
+            offset = std::strtoull(input + 1, nullptr, 0);
+        }
+        else
+        {
+            const size_t lineNumber = std::strtoull(input, nullptr, 10);
+            offset = lines[std::min(std::max<size_t>(lineNumber, 1), lines.size()) - 1].first;
+        }
+        context.logDisplay->goToOffset(std::min(offset, dataSize));
+        context.logDisplay->redraw();
+    }
+
+    // Until the file is indexed only byte offsets and percentages can be reached
+    void goToApproximately(const std::string_view text)
+    {
+        const size_t dataSize = context.logDisplay->getApproximateDataSize();
+        if (text.ends_with('%'))
+        {
+            const double percent = std::clamp(std::strtod(text.data(), nullptr), 0.0, 100.0);
+            const auto offset = static_cast<size_t>(static_cast<double>(dataSize) * percent / 100);
+            context.logDisplay->scrollToApproximateOffset(offset);
+        }
+        else if (text.starts_with('@'))
+        {
+            context.logDisplay->scrollToApproximateOffset(std::strtoull(text.data() + 1, nullptr, 0));
+        }
+        else
+        {
+            context.statusBar->setStatusInformation("Line numbers are available once the file is indexed");
+        }
+    }
+
+    void chooseFieldColumns()
+    {
+        if (!fieldStore)
+        {
+            context.statusBar->setStatusInformation("No fields detected, choose the format in View/Log Format");
+            return;
+        }
+
+        const char* input = fl_input("Fields to show as columns (comma separated):", fieldColumnsText.c_str());
+        if (input == nullptr)
+        {
+            return;
+        }
+        fieldColumnsText = input;
+        showFieldColumns();
+    }
+
+    // Display all lines ordered by the value of a field: numbers by value, then text, then lines without it.
+    // The values come from a column of the field store, so the lines are not parsed again after sorting.
+    void sortByField()
+    {
+        if (!fieldStore)
+        {
+            context.statusBar->setStatusInformation("No fields detected, choose the format in View/Log Format");
+            return;
+        }
+        if (context.logDisplay->isApproximate())
+        {
+            context.statusBar->setStatusInformation("Sorting is available once the file is indexed");
+            return;
+        }
+
+        const char* input = fl_input("Sort lines by field:", sortFieldName.c_str());
+        if (input == nullptr || *input == '\0')
+        {
+            return;
+        }
+        sortFieldName = input;
+        const size_t column = fieldStore->addColumn(sortFieldName);
+
+        context.statusBar->setStatusInformation("Sorting by " + sortFieldName + "...");
+        sortTask = scheduler.start(
+            [this, column, name = sortFieldName, documentData = shareDocumentData(), store = fieldStore,
+             onAccess = getDataAccessCallback()](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                FieldSort sort(documentData.data, documentData.getLines(), *store, scheduler);
+                sort.onDataAccess(onAccess);
+                auto order = sort.sort(column, stopToken);
+                if (!order)
+                {
+                    return;
+                }
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                runOnUiThread([this, order = std::move(*order), name, elapsed, stopToken]() mutable {
+                    if (stopToken.stop_requested())
+                    {
+                        return; // the lines may belong to the document shown before
+                    }
+                    setLineFilter(std::move(order));
+                    context.statusBar->setStatusInformation("Sorted by " + name + " in " +
+                                                            std::to_string(elapsed.count()) + " ms");
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    void showFieldColumns()
+    {
+        std::vector<std::string> fieldNames;
+        std::string_view names(fieldColumnsText);
+        while (!names.empty())
+        {
+            const size_t comma = std::min(names.find(','), names.size());
+            std::string_view name = names.substr(0, comma);
+            while (!name.empty() && name.front() == ' ')
+                name.remove_prefix(1);
+            while (!name.empty() && name.back() == ' ')
+                name.remove_suffix(1);
+            if (!name.empty())
+                fieldNames.emplace_back(name);
+            names.remove_prefix(std::min(comma + 1, names.size()));
+        }
+
+        context.logDisplay->setFieldColumns(fieldNames);
+        context.logDisplay->redraw();
+    }
+
+    // Parse plain-text lines with the format given by the user. An empty format brings back the detection.
+    void chooseLogFormat()
+    {
+        const char* input = fl_input("Log format, e.g. {ts:iso8601} [{level}] {thread} {msg}\n"
+                                     "Leave it empty to detect the format of every file:",
+                                     logFormat.c_str());
+        if (input == nullptr)
+        {
+            return;
+        }
+        std::string errorMessage;
+        if (*input != '\0' && !FormatFieldExtractor::create(input, errorMessage))
+        {
+            fl_alert("Invalid log format: %s", errorMessage.c_str());
+            return;
+        }
+        logFormat = input;
+        if (!canParseLines())
+        {
+            return;
+        }
+
+        // Queries and columns read the old fields
+        queryTask = TaskHandle();
+        lastQuery.reset();
+        context.logDisplay->setFieldStore(nullptr);
+        fieldStore.reset();
+        const char* data = context.logDisplay->getData();
+        const auto& lines = context.logDisplay->getLines();
+        if (auto extractor = createFieldExtractor(data, lines))
+        {
+            context.statusBar->setStatusInformation("Fields of format " + std::string(extractor->getName()));
+            fieldStore = std::make_shared<FieldStore>(data, lines, std::move(extractor));
+        }
+        else
+        {
+            context.statusBar->setStatusInformation("No fields detected in this file");
+        }
+        context.logDisplay->setFieldStore(fieldStore.get());
+        showFieldColumns();
+    }
+
+    // Decode files with the encoding chosen by the user. An empty choice brings back the detection.
+    // The current file is opened again, because its lines are indexed in the encoding.
+    void chooseEncoding()
+    {
+        const std::string currentText = textEncoding ? std::string(getEncodingName(*textEncoding)) : std::string();
+        const char* input = fl_input("Encoding: UTF-8, UTF-16LE, UTF-16BE, Latin-1 or Windows-1250\n"
+                                     "Leave it empty to detect the encoding of every file:",
+                                     currentText.c_str());
+        if (input == nullptr)
+        {
+            return;
+        }
+        const auto encoding = parseEncodingName(input);
+        if (*input != '\0' && !encoding)
+        {
+            fl_alert("Unknown encoding: %s", input);
+            return;
+        }
+        textEncoding = encoding;
+        if (file)
+        {
+            resetDocumentState();
+            loadDocument(std::nullopt);
+        }
+    }
+
+    void chooseMemoryBudget()
+    {
+        const size_t currentBudget = file ? file->getMemoryBudget() : memoryBudget.value_or(0);
+        const std::string currentText = std::to_string(currentBudget >> 20);
+        const char* input = fl_input("Memory budget for mapped files in MiB (0 = no limit):", currentText.c_str());
+        if (input == nullptr)
+        {
+            return;
+        }
+
+        // Budgets above the physical memory do not limit anything, they are clamped so that the bytes do not overflow
+        std::string_view text(input);
+        while (!text.empty() && text.front() == ' ')
+            text.remove_prefix(1);
+        while (!text.empty() && text.back() == ' ')
+            text.remove_suffix(1);
+        size_t mebibytes = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), mebibytes);
+        if (text.empty() || error == std::errc::invalid_argument || end != text.data() + text.size())
+        {
+            context.statusBar->setStatusInformation("Invalid memory budget: " + std::string(text));
+            return;
+        }
+        const size_t physicalMemory = MappedFile::getPhysicalMemorySize();
+        const size_t maxMebibytes = (physicalMemory > 0 ? physicalMemory : SIZE_MAX) >> 20;
+        mebibytes = error == std::errc::result_out_of_range ? maxMebibytes : std::min(mebibytes, maxMebibytes);
+        memoryBudget = mebibytes << 20;
+        if (file)
+        {
+            file->setMemoryBudget(*memoryBudget);
+        }
+        if (*memoryBudget == 0)
+        {
+            context.statusBar->setStatusInformation("Memory budget disabled");
+        }
+        else
+        {
+            context.statusBar->setStatusInformation("Memory budget set to " + std::to_string(*memoryBudget >> 20) +
+                                                    " MiB");
+        }
+    }
+
+    // What background work reads of the current document. Holding it keeps the data and the lines alive after
+    // the document is closed or put aside, so that stopping the work does not have to wait for it.
+    struct DocumentData
+    {
+        std::shared_ptr<const void> owner; // the mapped file or the buffer of the standard input
+        const char* data = nullptr;
+        std::shared_ptr<const LineIndex> index;
+
+        const std::vector<std::pair<size_t, size_t>>& getLines() const
+        {
+            return index->getLines();
+        }
+    };
+
+    DocumentData shareDocumentData() const
+    {
+        std::shared_ptr<const void> owner = file;
+        if (!owner)
+        {
+            owner = stream;
+        }
+        return {std::move(owner), context.logDisplay->getData(), context.logDisplay->getSharedIndexedLines()};
+    }
+
+    // Work reading the lines of the mapped file announces the ranges it reads, so that the memory budget holds.
+    // The standard input is not mapped and needs no callback.
+    LineIndex::AccessCallback getDataAccessCallback() const
+    {
+        if (!file)
+        {
+            return {};
+        }
+        return [mappedFile = file](size_t begin, size_t end) { mappedFile->touch(begin, end); };
+    }
+
+    // Files that do not fit comfortably in RAM get a budget of a quarter of the physical memory
+    static size_t getDefaultMemoryBudget(size_t fileSize)
+    {
+        const size_t physicalMemory = MappedFile::getPhysicalMemorySize();
+        if (physicalMemory == 0 || fileSize < physicalMemory / 2)
+        {
+            return 0;
+        }
+        return physicalMemory / 4;
+    }
+
+    void showQueryWindow()
+    {
+        if (queryWindow == nullptr)
+        {
+            queryWindow = new QueryWindow(560, 400);
+            queryWindow->onRun([this](const std::string& text) { runQuery(text); });
+            queryWindow->onCancel([this] {
+                queryTask.requestStop();
+                queryWindow->setRunning(false);
+                queryWindow->setStatus("Cancelled");
+            });
+            queryWindow->onRowSelected([this](const std::string& key) { filterByQueryRow(key); });
+        }
+        queryWindow->show();
+    }
+
+    void runQuery(const std::string& text)
+    {
+        std::string errorMessage;
+        auto query = AggregationQuery::parse(text, errorMessage);
+        if (!query)
+        {
+            queryWindow->setStatus(errorMessage);
+            return;
+        }
+
+        if (context.logDisplay->isApproximate())
+        {
+            queryWindow->setStatus("Queries are available once the file is indexed");
+            return;
+        }
+
+        lastQuery = std::make_shared<const AggregationQuery>(std::move(*query));
+        queryWindow->setStatus("Running...");
+        queryWindow->setRunning(true);
+
+        // The lines stay in place while the query runs, the standard input is not appended until it finishes
+        queryTask = scheduler.start(
+            [this, query = lastQuery, documentData = shareDocumentData(), store = fieldStore,
+             onAccess = getDataAccessCallback()](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                AggregationEngine engine(documentData.data, documentData.getLines(), store.get(), scheduler);
+                engine.onDataAccess(onAccess);
+                engine.onProgress([this, stopToken](size_t processedLines, size_t totalLines) {
+                    const size_t percent = processedLines * 100 / totalLines;
+                    runOnUiThread([this, percent, stopToken] {
+                        if (!stopToken.stop_requested())
+                        {
+                            queryWindow->setStatus("Running... " + std::to_string(percent) + "%");
+                        }
+                    });
+                });
+
+                auto result = engine.run(*query, stopToken);
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                runOnUiThread([this, result = std::move(result), elapsed, stopToken] {
+                    if (stopToken.stop_requested())
+                    {
+                        return; // replaced by a newer query or cancelled
+                    }
+                    queryWindow->setRunning(false);
+                    queryWindow->setResults(result.rows);
+                    queryWindow->setStatus(std::to_string(result.rows.size()) + " rows from " +
+                                           std::to_string(result.matchedLines) + " lines in " +
+                                           std::to_string(elapsed.count()) + " ms");
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    void filterByQueryRow(const std::string& key)
+    {
+        if (!lastQuery)
+        {
+            return;
+        }
+
+        queryWindow->setStatus("Filtering...");
+        queryWindow->setRunning(true);
+        queryTask = scheduler.start(
+            [this, query = lastQuery, key, documentData = shareDocumentData(), store = fieldStore,
+             onAccess = getDataAccessCallback(),
+             filter = context.logDisplay->getFilteredLines()](std::stop_token stopToken) {
+                // A filter that is already shown is narrowed, only its lines are checked
+                AggregationEngine engine(documentData.data, documentData.getLines(), store.get(), scheduler);
+                engine.onDataAccess(onAccess);
+                auto matchingLines = engine.findContributingLines(*query, key, filter.get(), stopToken);
+                runOnUiThread([this, matchingLines = std::move(matchingLines), stopToken]() mutable {
+                    if (stopToken.stop_requested())
+                    {
+                        return; // the lines may belong to the document shown before
+                    }
+                    queryWindow->setRunning(false);
+                    queryWindow->setStatus("Filtered to " + std::to_string(matchingLines.size()) + " lines");
+                    setLineFilter(std::move(matchingLines));
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    // Compare the open file with another one in the diff window
+    void compareWith(const std::string& path)
+    {
+        if (!file)
+        {
+            context.statusBar->setStatusInformation("Open a file to compare first");
+            return;
+        }
+        diffPaths = {file->getPath(), path};
+        if (diffWindow == nullptr)
+        {
+            diffWindow = new DiffWindow(900, 600);
+            diffWindow->onCompare([this](const DiffMasks& masks) { runDiff(masks); });
+            diffWindow->onCancel([this] {
+                diffTask = TaskHandle();
+                diffWindow->setRunning(false);
+                diffWindow->setStatus("Cancelled");
+            });
+        }
+        diffWindow->show();
+        runDiff(diffWindow->getMasks());
+    }
+
+    // Both files are mapped and indexed again, so the diff does not depend on the file open in the main view
+    void runDiff(const DiffMasks& masks)
+    {
+        diffTask = TaskHandle();
+        diffWindow->clear();
+        diffWindow->setStatus("Comparing...");
+        diffWindow->setRunning(true);
+        diffTask = scheduler.start(
+            [this, paths = diffPaths, masks, budget = memoryBudget](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                auto leftFile = std::make_shared<MappedFile>(paths.first);
+                auto rightFile = std::make_shared<MappedFile>(paths.second);
+                for (const auto& mappedFile : {leftFile, rightFile})
+                {
+                    if (!mappedFile->isOpen())
+                    {
+                        runOnUiThread([this, message = mappedFile->getErrorMessage(), stopToken] {
+                            if (!stopToken.stop_requested())
+                            {
+                                diffWindow->setRunning(false);
+                                diffWindow->setStatus(message);
+                            }
+                        });
+                        return;
+                    }
+                }
+
+                leftFile->setMemoryBudget(budget.value_or(getDefaultMemoryBudget(leftFile->size())));
+                rightFile->setMemoryBudget(budget.value_or(getDefaultMemoryBudget(rightFile->size())));
+
+                auto leftLines = std::make_shared<LineIndex>();
+                auto rightLines = std::make_shared<LineIndex>();
+                const LineIndex::AccessCallback onLeftAccess = [&leftFile](size_t begin, size_t end) {
+                    leftFile->touch(begin, end);
+                };
+                const LineIndex::AccessCallback onRightAccess = [&rightFile](size_t begin, size_t end) {
+                    rightFile->touch(begin, end);
+                };
+                LogDiff diff(scheduler, masks);
+                if (!leftLines->build(leftFile->data(), leftFile->size(), &scheduler, onLeftAccess, stopToken) ||
+                    !rightLines->build(rightFile->data(), rightFile->size(), &scheduler, onRightAccess, stopToken) ||
+                    !diff.compare(*leftLines, *rightLines, stopToken, onLeftAccess, onRightAccess))
+                {
+                    return;
+                }
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                const std::string status = std::to_string(diff.getHunks().size()) + " differences, " +
+                                           std::to_string(diff.getRemovedLines()) + " lines removed and " +
+                                           std::to_string(diff.getAddedLines()) + " added, compared in " +
+                                           std::to_string(elapsed.count()) + " ms";
+                runOnUiThread([this, leftFile, rightFile, leftLines, rightLines, hunks = diff.getHunks(), status,
+                               stopToken]() mutable {
+                    if (stopToken.stop_requested())
+                    {
+                        return;
+                    }
+                    diffWindow->setRunning(false);
+                    diffWindow->setDiff(leftFile, leftLines, rightFile, rightLines, std::move(hunks));
+                    diffWindow->setStatus(status);
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    void showFileSearchWindow()
+    {
+        if (fileSearchWindow == nullptr)
+        {
+            fileSearchWindow = new FileSearchWindow(640, 420);
+            fileSearchWindow->onSearch(
+                [this](const std::string& directory, const std::string& text) { runFileSearch(directory, text); });
+            fileSearchWindow->onCancel([this] { fileSearchTask.requestStop(); });
+            fileSearchWindow->onHitSelected([this](const std::string& path, std::optional<size_t> lineIndex) {
+                if (FileSearch::isCompressed(path))
+                {
+                    fileSearchWindow->setStatus("Compressed files cannot be opened in the viewer");
+                    return;
+                }
+                // Hits in the open file do not reload it
+                const auto& lines = context.logDisplay->getLines();
+                if (file && file->getPath() == path && lineIndex && *lineIndex < lines.size())
+                {
+                    context.logDisplay->goToOffset(lines[*lineIndex].first);
+                    return;
+                }
+                openFile(path, lineIndex);
+            });
+        }
+        fileSearchWindow->show();
+    }
+
+    // Search all files of the directory in the background, results are listed as soon as a file is searched.
+    // The search does not depend on the open file, opening one of the hits does not stop it.
+    void runFileSearch(const std::string& directory, const std::string& text)
+    {
+        fileSearchTask = TaskHandle();
+        fileSearchGeneration++;
+        fileSearchWindow->clearResults();
+        if (text.empty())
+        {
+            fileSearchWindow->setStatus("Enter the text to find");
+            return;
+        }
+        const std::vector<std::string> paths = FileSearch::listFiles(directory);
+        if (paths.empty())
+        {
+            fileSearchWindow->setStatus("No files in " + directory);
+            return;
+        }
+
+        fileSearchWindow->setStatus("Searching " + std::to_string(paths.size()) + " files...");
+        fileSearchWindow->setRunning(true);
+        fileSearchTask = scheduler.start(
+            [this, paths, text, generation = fileSearchGeneration](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                FileSearch fileSearch(scheduler);
+                fileSearch.onResult([this, stopToken](const FileSearchResult& result) {
+                    runOnUiThread([this, result, stopToken] {
+                        if (!stopToken.stop_requested())
+                        {
+                            fileSearchWindow->addResult(result);
+                        }
+                    });
+                });
+
+                const bool completed = fileSearch.search(paths, text, stopToken);
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                // A search replaced by a new one must not show its totals
+                runOnUiThread([this, elapsed, completed, generation] {
+                    if (generation == fileSearchGeneration)
+                    {
+                        fileSearchWindow->finish(elapsed, !completed);
+                    }
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    void setTimeGapsShown(const bool shown)
+    {
+        timeGapsShown = shown;
+        context.logDisplay->setTimeGaps(shown ? timeGaps.get() : nullptr);
+        if (shown && !timeGaps && !gapTask.hasJob())
+        {
+            analyzeTimeGaps();
+        }
+    }
+
+    // Find the time gaps before all lines in the background, they are shown once the whole log is analyzed.
+    // Gaps analyzed before are extended to the lines appended since, only the new lines are parsed.
+    // The gaps are neither shown nor read while they are extended.
+    void analyzeTimeGaps()
+    {
+        if (!canParseLines())
+        {
+            return;
+        }
+        const bool extending = timeGaps != nullptr;
+        auto gaps = extending ? std::move(timeGaps) : std::make_shared<TimeGaps>(scheduler);
+        context.logDisplay->setTimeGaps(nullptr);
+        if (!extending)
+        {
+            context.statusBar->setStatusInformation("Analyzing time gaps...");
+        }
+
+        gapTask = scheduler.start(
+            [this, documentData = shareDocumentData(), gaps, extending, gapsFile = file](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                LineIndex::AccessCallback onAccess;
+                if (gapsFile)
+                {
+                    onAccess = [&gapsFile](size_t begin, size_t end) { gapsFile->touch(begin, end); };
+                }
+                if (!gaps->extend(*documentData.index, onAccess, stopToken))
+                {
+                    return;
+                }
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                runOnUiThread([this, gaps, extending, elapsed, stopToken] {
+                    if (stopToken.stop_requested())
+                    {
+                        return;
+                    }
+                    timeGaps = gaps;
+                    if (timeGapsShown)
+                    {
+                        context.logDisplay->setTimeGaps(timeGaps.get());
+                    }
+                    if (!extending)
+                    {
+                        nextGapRank = 0;
+                        context.statusBar->setStatusInformation("Time gaps analyzed in " +
+                                                                std::to_string(elapsed.count()) + " ms");
+                    }
+                    if (jumpToGapWhenAnalyzed)
+                    {
+                        jumpToGapWhenAnalyzed = false;
+                        nextLargestGap();
+                    }
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    // Go to the line after the largest time gap, then to the next largest one and so on.
+    // The log is analyzed first if needed.
+    void nextLargestGap()
+    {
+        if (!canParseLines())
+        {
+            return;
+        }
+        if (!timeGaps)
+        {
+            jumpToGapWhenAnalyzed = true;
+            if (!gapTask.hasJob())
+            {
+                analyzeTimeGaps();
+            }
+            return;
+        }
+
+        const auto& largestGaps = timeGaps->getLargestGaps();
+        if (largestGaps.empty())
+        {
+            context.statusBar->setStatusInformation("No time gaps found");
+            return;
         }
+        const size_t rank = nextGapRank % largestGaps.size();
+        nextGapRank = rank + 1;
+        const TimeGap& gap = largestGaps[rank];
+        context.logDisplay->goToOffset(context.logDisplay->getIndexedLines()[gap.lineIndex].first);
+        context.logDisplay->redraw();
+        context.statusBar->setStatusInformation("Gap " + std::to_string(rank + 1) + " of " +
+                                                std::to_string(largestGaps.size()) + ": " +
+                                                formatDuration(gap.milliseconds) + " before line " +
+                                                std::to_string(gap.lineIndex + 1));
+    }
 
-        context.statusBar->setStatusInformation("No matches found: " + query);
+    // e.g. "2.500 s" or "1 h 5 min 3.250 s"
+    static std::string formatDuration(const int64_t milliseconds)
+    {
+        std::string text;
+        if (milliseconds >= 3600 * 1000)
+        {
+            text += std::to_string(milliseconds / (3600 * 1000)) + " h ";
+        }
+        if (milliseconds >= 60 * 1000)
+        {
+            text += std::to_string(milliseconds / (60 * 1000) % 60) + " min ";
+        }
+        const std::string millis = std::to_string(1000 + milliseconds % 1000);
+        return text + std::to_string(milliseconds / 1000 % 60) + "." + millis.substr(1) + " s";
+    }
+
+    void showTemplatesWindow()
+    {
+        if (templatesWindow == nullptr)
+        {
+            templatesWindow = new TemplatesWindow(640, 420);
+            templatesWindow->onShowOnly([this](const std::vector<uint32_t>& ids) { filterByTemplates(ids, true); });
+            templatesWindow->onHide([this](const std::vector<uint32_t>& ids) { filterByTemplates(ids, false); });
+            templatesWindow->onCollapseRepeats([this] { collapseRepeatedTemplates(); });
+            templatesWindow->onShowAll([this] {
+                context.logDisplay->clearLineFilter();
+                context.statusBar->setNumberOfLines(context.logDisplay->getLines().size());
+            });
+        }
+        templatesWindow->show();
+
+        if (canParseLines() && !templateMiner && !templateTask.hasJob())
+        {
+            mineTemplates();
+        }
+    }
+
+    // Discover templates in the background, the results are shown when the whole log is processed
+    void mineTemplates()
+    {
+        templatesWindow->setStatus("Discovering templates...");
+        templateTask = scheduler.start(
+            [this, documentData = shareDocumentData(), onAccess = getDataAccessCallback()](std::stop_token stopToken) {
+                const auto startTime = std::chrono::steady_clock::now();
+                auto miner = std::make_shared<TemplateMiner>();
+                miner->onDataAccess(onAccess);
+                miner->onProgress([this, stopToken](size_t processedLines, size_t totalLines) {
+                    const size_t percent = processedLines * 100 / totalLines;
+                    runOnUiThread([this, percent, stopToken] {
+                        if (!stopToken.stop_requested())
+                        {
+                            templatesWindow->setStatus("Discovering templates... " + std::to_string(percent) + "%");
+                        }
+                    });
+                });
+
+                if (!miner->mine(documentData.data, documentData.getLines(), stopToken))
+                {
+                    return;
+                }
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+                runOnUiThread([this, miner, elapsed, stopToken] {
+                    if (stopToken.stop_requested())
+                    {
+                        return; // the templates may belong to the document shown before
+                    }
+                    templateMiner = miner;
+                    templatesWindow->setTemplates(miner->getTemplates());
+                    templatesWindow->setStatus(std::to_string(miner->getTemplates().size()) + " templates found in " +
+                                               std::to_string(elapsed.count()) + " ms");
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    // Show only lines of the given templates or hide them
+    void filterByTemplates(const std::vector<uint32_t>& templateIds, const bool showOnly)
+    {
+        if (!templateMiner)
+        {
+            return;
+        }
+
+        std::vector<bool> isSelected(templateMiner->getTemplates().size(), false);
+        for (const uint32_t templateId : templateIds)
+        {
+            isSelected[templateId] = true;
+        }
+        auto isVisible = [miner = templateMiner, isSelected = std::move(isSelected), showOnly](
+                             size_t lineIndex, std::optional<size_t>) {
+            return isSelected[miner->getLineTemplates()[lineIndex]] == showOnly;
+        };
+        filterLinesInBackground(std::move(isVisible));
+    }
+
+    // Show only the first line of every run of lines with the same template
+    void collapseRepeatedTemplates()
+    {
+        if (!templateMiner)
+        {
+            return;
+        }
+
+        filterLinesInBackground([miner = templateMiner](size_t lineIndex, std::optional<size_t> previousLine) {
+            const auto& lineTemplates = miner->getLineTemplates();
+            return !previousLine || lineTemplates[lineIndex] != lineTemplates[*previousLine];
+        });
+    }
+
+    // Collect the lines accepted by the function in parallel in the background and show only them.
+    // The function receives every line and the line displayed before it. A filter that is already shown
+    // is narrowed, only its lines are checked and they keep their order.
+    void filterLinesInBackground(std::function<bool(size_t, std::optional<size_t>)> isVisible)
+    {
+        templatesWindow->setStatus("Filtering...");
+        templateTask = scheduler.start(
+            [this, numberOfLines = templateMiner->getLineTemplates().size(),
+             filter = context.logDisplay->getFilteredLines(),
+             isVisible = std::move(isVisible)](std::stop_token stopToken) {
+                constexpr size_t chunkSize = 64 * 1024;
+                const auto getLine = [&](size_t row) { return filter ? (*filter)[row] : row; };
+                const size_t numberOfRows = filter ? filter->size() : numberOfLines;
+                std::vector<std::vector<size_t>> chunkLines((numberOfRows + chunkSize - 1) / chunkSize);
+                scheduler.parallelFor(numberOfRows, chunkSize, TaskPriority::Background, stopToken,
+                                      [&](size_t firstRow, size_t lastRow, size_t) {
+                                          auto& visibleLines = chunkLines[firstRow / chunkSize];
+                                          for (size_t row = firstRow; row < lastRow; row++)
+                                          {
+                                              const auto previousLine =
+                                                  row > 0 ? std::optional(getLine(row - 1)) : std::nullopt;
+                                              if (isVisible(getLine(row), previousLine))
+                                              {
+                                                  visibleLines.push_back(getLine(row));
+                                              }
+                                          }
+                                      });
+                if (stopToken.stop_requested())
+                {
+                    return;
+                }
+
+                size_t numberOfVisibleLines = 0;
+                for (const auto& lines : chunkLines)
+                    numberOfVisibleLines += lines.size();
+                std::vector<size_t> visibleLines;
+                visibleLines.reserve(numberOfVisibleLines);
+                for (auto& lines : chunkLines)
+                {
+                    visibleLines.insert(visibleLines.end(), lines.begin(), lines.end());
+                    lines = {};
+                }
+                runOnUiThread([this, visibleLines = std::move(visibleLines), stopToken]() mutable {
+                    if (stopToken.stop_requested())
+                    {
+                        return; // the lines may belong to the document shown before
+                    }
+                    templatesWindow->setStatus("Filtered to " + std::to_string(visibleLines.size()) + " lines");
+                    setLineFilter(std::move(visibleLines));
+                });
+            },
+            TaskPriority::Background);
+    }
+
+    void setLineFilter(std::vector<size_t> visibleLines)
+    {
+        const size_t numberOfLines = visibleLines.size();
+        context.logDisplay->setLineFilter(std::move(visibleLines));
+        context.statusBar->setNumberOfLines(numberOfLines);
+        context.statusBar->setStatusInformation("Filtered to " + std::to_string(numberOfLines) + " lines");
+    }
+
+    void exportSelection(const std::string& path)
+    {
+        if (!file)
+        {
+            return;
+        }
+
+        const auto [begin, end] = context.logDisplay->getSelection();
+        startExport(path, [begin, end](FileExporter& exporter, std::stop_token stopToken) {
+            return exporter.exportRange(begin, end, stopToken);
+        });
+    }
+
+    void exportMatchingLines(const std::string& path)
+    {
+        if (!file)
+        {
+            return;
+        }
+
+        // Lines are exported in the encoding of the file, the query is encoded like for the search
+        const auto encodedQuery = encodeQuery(lastSearchQuery);
+        if (!encodedQuery)
+        {
+            context.statusBar->setStatusInformation("No matches found: " + lastSearchQuery);
+            return;
+        }
+        const std::string query = *encodedQuery;
+        const size_t codeUnitSize = getCodeUnitSize(context.logDisplay->getIndexedLines().getEncoding());
+
+        // The export keeps its own copy of the index, the widget releases its lines when another document is shown
+        const auto exportIndex = std::make_shared<const LineIndex>(context.logDisplay->getIndexedLines());
+        startExport(path, [this, query, codeUnitSize, exportIndex, exportFile = file, cache = searchCache,
+                           index = trigramIndex](FileExporter& exporter, std::stop_token stopToken) {
+            const auto& lines = exportIndex->getLines();
+            const auto& summaries = exportIndex->getBlockSummaries();
+            if (query.empty())
+            {
+                return exporter.exportLines(lines, stopToken);
+            }
+
+            TextSearch textSearch(exportFile->data(), exportFile->size(), lines);
+            textSearch.setScheduler(&scheduler, TaskPriority::Background);
+            textSearch.setCodeUnitSize(codeUnitSize);
+            textSearch.onDataAccess([&exportFile](size_t begin, size_t end) { exportFile->touch(begin, end); });
+            const auto cached = cache->lookup(query);
+            auto lineIndices = cached.lines;
+            if (!cached.exact)
+            {
+                const auto candidateLines =
+                    cached.lines ? cached.lines : findCandidateLines(index.get(), summaries, query);
+                lineIndices = findMatchingLines(textSearch, query, candidateLines.get(), *cache, stopToken);
+            }
+            if (!lineIndices)
+            {
+                return false;
+            }
+
+            std::vector<std::pair<size_t, size_t>> matchingLines;
+            matchingLines.reserve(lineIndices->size());
+            for (const uint32_t lineIndex : *lineIndices)
+            {
+                matchingLines.push_back(lines[lineIndex]);
+            }
+            return exporter.exportLines(matchingLines, stopToken);
+        });
+    }
+
+    // Run the export on the scheduler. Only one export can run at a time,
+    // starting a new one cancels the previous one.
+    template <typename ExportFunction> void startExport(const std::string& path, ExportFunction exportFunction)
+    {
+        context.statusBar->setStatusInformation("Exporting to " + path);
+
+        exportTask = scheduler.start(
+            [this, path, exportFile = file, encoding = context.logDisplay->getIndexedLines().getEncoding(),
+             exportFunction](std::stop_token stopToken) {
+                FileExporter exporter(*exportFile, path);
+                exporter.setEncoding(encoding);
+
+                auto lastUpdate = std::chrono::steady_clock::now();
+                exporter.onProgress([this, &lastUpdate](size_t bytesWritten, size_t bytesTotal) {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (now - lastUpdate < std::chrono::milliseconds(100) || bytesTotal == 0)
+                    {
+                        return;
+                    }
+                    lastUpdate = now;
+                    const size_t percent = bytesWritten * 100 / bytesTotal;
+                    runOnUiThread([this, percent] {
+                        context.statusBar->setStatusInformation("Exporting... " + std::to_string(percent) + "%");
+                    });
+                });
+
+                const bool success = exportFunction(exporter, stopToken);
+                const std::string message = success ? "Exported to " + path : exporter.getErrorMessage();
+                if (!stopToken.stop_requested())
+                {
+                    runOnUiThread([this, message] { context.statusBar->setStatusInformation(message); });
+                }
+            },
+            TaskPriority::Background);
     }
 
     AppContext context{};
+    std::shared_ptr<MappedFile> file;
+    std::shared_ptr<StreamBuffer> stream;    // the standard input, when it is displayed instead of a file
+    std::atomic<size_t> streamShownSize{0}; // bytes of the stream that are indexed and displayed
+    std::string lastSearchQuery;
+    std::shared_ptr<SearchCache> searchCache = std::make_shared<SearchCache>(); // replaced with every file
+    std::shared_ptr<const TrigramIndex> trigramIndex; // set once it is built
+    bool searchIndexEnabled = false;
+    std::optional<size_t> memoryBudget; // chosen by the user, otherwise depends on the file size
+    size_t lastViewportBegin = 0;
+    std::shared_ptr<FieldStore> fieldStore;
+    std::string fieldColumnsText;
+    std::string sortFieldName;
+    std::string logFormat; // chosen by the user, otherwise detected in every file
+    std::optional<TextEncoding> textEncoding; // chosen by the user, otherwise detected in every file
+    QueryWindow* queryWindow = nullptr;
+    std::shared_ptr<const AggregationQuery> lastQuery;
+    TemplatesWindow* templatesWindow = nullptr;
+    std::shared_ptr<const TemplateMiner> templateMiner;
+    FileSearchWindow* fileSearchWindow = nullptr;
+    DiffWindow* diffWindow = nullptr;
+    std::pair<std::string, std::string> diffPaths; // the open file and the file it is compared with
+    size_t fileSearchGeneration = 0; // incremented with every search in files
+    std::shared_ptr<TimeGaps> timeGaps; // set once the whole log is analyzed
+    bool timeGapsShown = false;
+    size_t nextGapRank = 0;             // rank of the gap shown by the next "Next Largest Gap"
+    bool jumpToGapWhenAnalyzed = false; // "Next Largest Gap" was chosen before the analysis finished
+
+    // Shared by all background work. Declared after the state used by the tasks,
+    // the handles below are declared last so the tasks finish before anything else is destroyed.
+    TaskScheduler scheduler;
+    TaskHandle exportTask;
+    TaskHandle queryTask;
+    TaskHandle templateTask;
+    TaskHandle fileSearchTask;
+    TaskHandle diffTask;
+    TaskHandle gapTask;
+    TaskHandle sortTask;
+    TaskHandle searchTask;
+    std::vector<TaskHandle> stoppedTasks; // still running after they were replaced or cancelled
+    TaskHandle indexTask;
+    TaskHandle openTask;
+    std::vector<Document> documents; // in the order of their tabs, their handles save evicted indexes
+    size_t currentDocument = 0;
+    uint64_t documentUseCounter = 0;
+    std::jthread streamReader; // stopped first, before the state that its updates use
 };
\ No newline at end of file
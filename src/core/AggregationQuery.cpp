@@ -0,0 +1,723 @@
+#include "AggregationQuery.hpp"
+#include "LogLevel.hpp"
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+constexpr size_t LINES_PER_CHUNK = 64 * 1024;
+constexpr size_t MAX_ANNOUNCED_GAP = 1024 * 1024; // data skipped between candidate lines announced together
+constexpr size_t WHOLE_LINE = std::numeric_limits<size_t>::max();
+constexpr std::string_view KEY_SEPARATOR = " | ";
+constexpr std::string_view MISSING_VALUE = "-";
+
+// Fields that are tried, in this order, to get the timestamp of a structured line
+constexpr std::string_view TIMESTAMP_FIELDS[] = {"ts", "time", "timestamp", "@timestamp"};
+
+struct Token
+{
+    enum class Type
+    {
+        Word,
+        String,
+        Symbol
+    };
+    Type type;
+    std::string text;
+};
+
+bool isWordCharacter(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' ||
+           c == '@' || c == '-' || c == ':' || c == '/';
+}
+
+char toLower(const char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return toLower(x) == toLower(y); });
+}
+
+std::optional<double> parseNumber(std::string_view text)
+{
+    double number = 0;
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, number);
+    if (result.ec != std::errc{} || result.ptr != end || text.empty())
+    {
+        return std::nullopt;
+    }
+    return number;
+}
+
+bool tokenize(std::string_view text, std::vector<Token>& tokens, std::string& errorMessage)
+{
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        const char c = text[pos];
+        if (c == ' ' || c == '\t')
+        {
+            pos++;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            const size_t end = text.find(c, pos + 1);
+            if (end == std::string_view::npos)
+            {
+                errorMessage = "Unterminated string";
+                return false;
+            }
+            tokens.push_back({Token::Type::String, std::string(text.substr(pos + 1, end - pos - 1))});
+            pos = end + 1;
+        }
+        else if (isWordCharacter(c))
+        {
+            const size_t begin = pos;
+            while (pos < text.size() && isWordCharacter(text[pos]))
+            {
+                pos++;
+            }
+            tokens.push_back({Token::Type::Word, std::string(text.substr(begin, pos - begin))});
+        }
+        else if ((c == '!' || c == '<' || c == '>') && pos + 1 < text.size() && text[pos + 1] == '=')
+        {
+            tokens.push_back({Token::Type::Symbol, std::string(text.substr(pos, 2))});
+            pos += 2;
+        }
+        else if (c == '(' || c == ')' || c == ',' || c == '=' || c == '<' || c == '>')
+        {
+            tokens.push_back({Token::Type::Symbol, std::string(1, c)});
+            pos++;
+        }
+        else
+        {
+            errorMessage = std::string("Unexpected character: ") + c;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<TimestampPrecision> getTimestampKey(std::string_view field)
+{
+    if (field == "second")
+        return TimestampPrecision::Second;
+    if (field == "minute")
+        return TimestampPrecision::Minute;
+    if (field == "hour")
+        return TimestampPrecision::Hour;
+    if (field == "day")
+        return TimestampPrecision::Day;
+    return std::nullopt;
+}
+
+struct Accumulator
+{
+    size_t count = 0;
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    std::vector<double> values; // only for percentiles
+
+    void add(const double value, const bool keepValues)
+    {
+        count++;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        if (keepValues)
+        {
+            values.push_back(value);
+        }
+    }
+
+    void merge(Accumulator& other)
+    {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        values.insert(values.end(), other.values.begin(), other.values.end());
+    }
+};
+
+using AggregationTable = std::unordered_map<std::string, Accumulator>;
+} // namespace
+
+std::optional<AggregationQuery> AggregationQuery::parse(std::string_view text, std::string& errorMessage)
+{
+    using Operator = Condition::Operator;
+
+    std::vector<Token> tokens;
+    if (!tokenize(text, tokens, errorMessage))
+    {
+        return std::nullopt;
+    }
+
+    size_t pos = 0;
+    auto peek = [&]() -> std::string_view { return pos < tokens.size() ? tokens[pos].text : std::string_view{}; };
+    auto isKeyword = [&](std::string_view keyword) {
+        return pos < tokens.size() && tokens[pos].type == Token::Type::Word &&
+               equalsIgnoreCase(tokens[pos].text, keyword);
+    };
+    auto expectWord = [&](std::string& word) {
+        if (pos >= tokens.size() || tokens[pos].type == Token::Type::Symbol)
+        {
+            errorMessage = "Expected a name after: " + std::string(pos > 0 ? tokens[pos - 1].text : "");
+            return false;
+        }
+        word = tokens[pos++].text;
+        return true;
+    };
+
+    AggregationQuery query;
+
+    // Aggregate function
+    std::string function;
+    if (!expectWord(function))
+    {
+        errorMessage = "Expected count, sum(field), avg(field), min(field), max(field) or pNN(field)";
+        return std::nullopt;
+    }
+    if (equalsIgnoreCase(function, "count"))
+    {
+        query.function = Function::Count;
+    }
+    else
+    {
+        if (equalsIgnoreCase(function, "sum"))
+            query.function = Function::Sum;
+        else if (equalsIgnoreCase(function, "avg"))
+            query.function = Function::Average;
+        else if (equalsIgnoreCase(function, "min"))
+            query.function = Function::Min;
+        else if (equalsIgnoreCase(function, "max"))
+            query.function = Function::Max;
+        else if ((function[0] == 'p' || function[0] == 'P') && parseNumber(std::string_view(function).substr(1)))
+        {
+            query.function = Function::Percentile;
+            query.percentile = *parseNumber(std::string_view(function).substr(1));
+            if (query.percentile < 0 || query.percentile > 100)
+            {
+                errorMessage = "Percentile must be between 0 and 100";
+                return std::nullopt;
+            }
+        }
+        else
+        {
+            errorMessage = "Unknown function: " + function;
+            return std::nullopt;
+        }
+
+        if (peek() != "(")
+        {
+            errorMessage = "Expected ( after " + function;
+            return std::nullopt;
+        }
+        pos++;
+        if (!expectWord(query.valueField))
+        {
+            return std::nullopt;
+        }
+        if (peek() != ")")
+        {
+            errorMessage = "Expected ) after " + query.valueField;
+            return std::nullopt;
+        }
+        pos++;
+    }
+
+    // Group by
+    if (isKeyword("by"))
+    {
+        pos++;
+        do
+        {
+            std::string field;
+            if (!expectWord(field))
+            {
+                return std::nullopt;
+            }
+            query.groupBy.push_back(field);
+        } while (peek() == "," && ++pos);
+    }
+
+    // Conditions
+    if (isKeyword("where"))
+    {
+        pos++;
+        do
+        {
+            Condition condition;
+            if (!isKeyword("contains") && !expectWord(condition.field))
+            {
+                return std::nullopt;
+            }
+
+            const std::string_view op = peek();
+            if (isKeyword("contains"))
+                condition.op = Operator::Contains;
+            else if (op == "=")
+                condition.op = Operator::Equal;
+            else if (op == "!=")
+                condition.op = Operator::NotEqual;
+            else if (op == "<")
+                condition.op = Operator::Less;
+            else if (op == "<=")
+                condition.op = Operator::LessOrEqual;
+            else if (op == ">")
+                condition.op = Operator::Greater;
+            else if (op == ">=")
+                condition.op = Operator::GreaterOrEqual;
+            else
+            {
+                errorMessage = "Expected an operator after " + condition.field;
+                return std::nullopt;
+            }
+            pos++;
+
+            if (!expectWord(condition.value))
+            {
+                return std::nullopt;
+            }
+
+            const bool isComparison = condition.op != Operator::Equal && condition.op != Operator::NotEqual &&
+                                      condition.op != Operator::Contains;
+            if (isComparison)
+            {
+                const auto number = parseNumber(condition.value);
+                if (!number)
+                {
+                    errorMessage = "Expected a number: " + condition.value;
+                    return std::nullopt;
+                }
+                condition.number = *number;
+            }
+            query.conditions.push_back(condition);
+        } while (isKeyword("and") && ++pos);
+    }
+
+    if (pos < tokens.size())
+    {
+        errorMessage = "Unexpected: " + tokens[pos].text;
+        return std::nullopt;
+    }
+    return query;
+}
+
+struct AggregationEngine::CompiledQuery
+{
+    enum class FieldKind
+    {
+        Column,
+        Timestamp,
+        Level
+    };
+
+    struct FieldReference
+    {
+        FieldKind kind = FieldKind::Column;
+        size_t column = 0;
+        TimestampPrecision precision = TimestampPrecision::Second;
+    };
+
+    const AggregationQuery& query;
+    std::vector<FieldReference> fields;
+    std::vector<size_t> groupFields;
+    std::vector<size_t> conditionFields;
+    size_t valueField = WHOLE_LINE;
+    std::vector<size_t> timestampColumns;
+    std::optional<size_t> levelColumn;
+};
+
+AggregationEngine::AggregationEngine(const char* data, const std::vector<std::pair<size_t, size_t>>& lines,
+                                     FieldStore* fieldStore, TaskScheduler& scheduler)
+    : data(data), lines(lines), fieldStore(fieldStore), scheduler(scheduler)
+{
+}
+
+void AggregationEngine::onProgress(ProgressCallback callback)
+{
+    progressCallback = std::move(callback);
+}
+
+void AggregationEngine::onDataAccess(AccessCallback callback)
+{
+    accessCallback = std::move(callback);
+}
+
+AggregationEngine::CompiledQuery AggregationEngine::compile(const AggregationQuery& query) const
+{
+    using FieldKind = CompiledQuery::FieldKind;
+    CompiledQuery compiled{query, {}, {}, {}, WHOLE_LINE, {}, std::nullopt};
+
+    auto addField = [&](const std::string& name) -> size_t {
+        CompiledQuery::FieldReference field;
+        if (auto precision = getTimestampKey(name))
+        {
+            field.kind = FieldKind::Timestamp;
+            field.precision = *precision;
+        }
+        else if (name == "level")
+        {
+            field.kind = FieldKind::Level;
+        }
+        else if (fieldStore != nullptr)
+        {
+            field.column = fieldStore->addColumn(name);
+        }
+        else
+        {
+            // There are no structured fields, the value will always be missing
+            field.kind = FieldKind::Column;
+            field.column = WHOLE_LINE;
+        }
+        compiled.fields.push_back(field);
+        return compiled.fields.size() - 1;
+    };
+
+    if (fieldStore != nullptr)
+    {
+        for (const std::string_view name : TIMESTAMP_FIELDS)
+        {
+            compiled.timestampColumns.push_back(fieldStore->addColumn(name));
+        }
+        compiled.levelColumn = fieldStore->addColumn("level");
+    }
+
+    for (const std::string& field : query.groupBy)
+    {
+        compiled.groupFields.push_back(addField(field));
+    }
+    for (const auto& condition : query.conditions)
+    {
+        compiled.conditionFields.push_back(condition.field.empty() ? WHOLE_LINE : addField(condition.field));
+    }
+    if (query.function != AggregationQuery::Function::Count)
+    {
+        compiled.valueField = addField(query.valueField);
+    }
+    return compiled;
+}
+
+std::string_view AggregationEngine::getFieldText(const CompiledQuery& query, const size_t fieldIndex,
+                                                 const size_t lineIndex, std::string& buffer) const
+{
+    using FieldKind = CompiledQuery::FieldKind;
+    const auto& field = query.fields[fieldIndex];
+    const auto [lineBegin, lineEnd] = lines[lineIndex];
+    const std::string_view line(data + lineBegin, lineEnd - lineBegin);
+
+    switch (field.kind)
+    {
+    case FieldKind::Column:
+        if (field.column == WHOLE_LINE)
+        {
+            return {};
+        }
+        return fieldStore->getText(lineIndex, field.column);
+
+    case FieldKind::Timestamp: {
+        std::optional<int64_t> timestamp;
+        for (const size_t column : query.timestampColumns)
+        {
+            const std::string_view text = fieldStore->getText(lineIndex, column);
+            if (!text.empty() && (timestamp = parseTimestamp(text)))
+            {
+                break;
+            }
+        }
+        if (!timestamp)
+        {
+            timestamp = findTimestamp(line);
+        }
+        if (!timestamp)
+        {
+            return {};
+        }
+        buffer = formatTimestamp(truncateTimestamp(*timestamp, field.precision), field.precision);
+        return buffer;
+    }
+
+    case FieldKind::Level: {
+        std::optional<LogLevel> level;
+        if (query.levelColumn)
+        {
+            level = parseLogLevel(fieldStore->getText(lineIndex, *query.levelColumn));
+        }
+        if (!level)
+        {
+            level = findLogLevel(line);
+        }
+        return level ? toString(*level) : std::string_view{};
+    }
+    }
+    return {};
+}
+
+// Check the conditions and build the group key of the line.
+// Returns false if the line does not take part in the aggregation.
+bool AggregationEngine::evaluateLine(const CompiledQuery& query, const size_t lineIndex, std::string& key,
+                                     double& value) const
+{
+    using Operator = AggregationQuery::Condition::Operator;
+    thread_local std::string buffer;
+
+    const auto& conditions = query.query.conditions;
+    for (size_t i = 0; i < conditions.size(); i++)
+    {
+        const auto& condition = conditions[i];
+        std::string_view text;
+        if (query.conditionFields[i] == WHOLE_LINE)
+        {
+            const auto [lineBegin, lineEnd] = lines[lineIndex];
+            text = std::string_view(data + lineBegin, lineEnd - lineBegin);
+        }
+        else
+        {
+            text = getFieldText(query, query.conditionFields[i], lineIndex, buffer);
+        }
+
+        bool matches = false;
+        switch (condition.op)
+        {
+        case Operator::Equal:
+            matches = equalsIgnoreCase(text, condition.value);
+            break;
+        case Operator::NotEqual:
+            matches = !equalsIgnoreCase(text, condition.value);
+            break;
+        case Operator::Contains:
+            matches = text.find(condition.value) != std::string_view::npos;
+            break;
+        default: {
+            const auto number = parseNumber(text);
+            if (!number)
+                return false;
+            matches = (condition.op == Operator::Less && *number < condition.number) ||
+                      (condition.op == Operator::LessOrEqual && *number <= condition.number) ||
+                      (condition.op == Operator::Greater && *number > condition.number) ||
+                      (condition.op == Operator::GreaterOrEqual && *number >= condition.number);
+            break;
+        }
+        }
+        if (!matches)
+        {
+            return false;
+        }
+    }
+
+    if (query.valueField != WHOLE_LINE)
+    {
+        const auto number = parseNumber(getFieldText(query, query.valueField, lineIndex, buffer));
+        if (!number)
+        {
+            return false;
+        }
+        value = *number;
+    }
+
+    key.clear();
+    for (size_t i = 0; i < query.groupFields.size(); i++)
+    {
+        if (i > 0)
+        {
+            key += KEY_SEPARATOR;
+        }
+        const std::string_view text = getFieldText(query, query.groupFields[i], lineIndex, buffer);
+        key += text.empty() ? MISSING_VALUE : text;
+    }
+    return true;
+}
+
+AggregationResult AggregationEngine::run(const AggregationQuery& query, std::stop_token stopToken) const
+{
+    using Function = AggregationQuery::Function;
+    const CompiledQuery compiled = compile(query);
+    const bool keepValues = query.function == Function::Percentile;
+
+    // Map: every runner aggregates into its own table
+    std::vector<AggregationTable> tables(scheduler.getMaxConcurrency());
+    parallelForChunks(
+        nullptr,
+        [&](size_t firstLine, size_t lastLine, size_t runnerIndex) {
+            AggregationTable& table = tables[runnerIndex];
+            std::string key;
+            double value = 1;
+            for (size_t lineIndex = firstLine; lineIndex < lastLine; lineIndex++)
+            {
+                if (!evaluateLine(compiled, lineIndex, key, value))
+                {
+                    continue;
+                }
+                auto it = table.find(key);
+                if (it == table.end())
+                {
+                    it = table.emplace(key, Accumulator{}).first;
+                }
+                it->second.add(value, keepValues);
+            }
+        },
+        stopToken);
+
+    AggregationResult result;
+    if (stopToken.stop_requested())
+    {
+        result.cancelled = true;
+        return result;
+    }
+
+    // Reduce: merge all tables into the first one
+    AggregationTable& merged = tables.front();
+    for (size_t i = 1; i < tables.size(); i++)
+    {
+        for (auto& [key, accumulator] : tables[i])
+        {
+            merged[key].merge(accumulator);
+        }
+        tables[i].clear();
+    }
+
+    for (auto& [key, accumulator] : merged)
+    {
+        AggregationRow row{key, 0, accumulator.count};
+        result.matchedLines += accumulator.count;
+        switch (query.function)
+        {
+        case Function::Count:
+            row.value = static_cast<double>(accumulator.count);
+            break;
+        case Function::Sum:
+            row.value = accumulator.sum;
+            break;
+        case Function::Average:
+            row.value = accumulator.sum / static_cast<double>(accumulator.count);
+            break;
+        case Function::Min:
+            row.value = accumulator.min;
+            break;
+        case Function::Max:
+            row.value = accumulator.max;
+            break;
+        case Function::Percentile: {
+            auto& values = accumulator.values;
+            const auto rank = static_cast<size_t>(std::ceil(query.percentile / 100.0 * values.size()));
+            const size_t index = std::min(values.size() - 1, rank > 0 ? rank - 1 : 0);
+            std::nth_element(values.begin(), values.begin() + index, values.end());
+            row.value = values[index];
+            break;
+        }
+        }
+        result.rows.push_back(std::move(row));
+    }
+
+    // Time buckets are shown in chronological order, everything else from the biggest value
+    const bool groupedByTime = std::any_of(query.groupBy.begin(), query.groupBy.end(),
+                                           [](const std::string& field) { return getTimestampKey(field).has_value(); });
+    std::sort(result.rows.begin(), result.rows.end(), [groupedByTime](const auto& a, const auto& b) {
+        return groupedByTime ? a.key < b.key : (a.value != b.value ? a.value > b.value : a.key < b.key);
+    });
+    return result;
+}
+
+std::vector<size_t> AggregationEngine::findContributingLines(const AggregationQuery& query, const std::string& key,
+                                                             const std::vector<size_t>* candidateLines,
+                                                             std::stop_token stopToken) const
+{
+    const CompiledQuery compiled = compile(query);
+
+    // Every chunk collects its own lines, so the result keeps the order of the lines after concatenation
+    const size_t size = candidateLines ? candidateLines->size() : lines.size();
+    std::vector<std::vector<size_t>> chunkLines((size + LINES_PER_CHUNK - 1) / LINES_PER_CHUNK);
+    parallelForChunks(
+        candidateLines,
+        [&](size_t first, size_t last, size_t) {
+            auto& matching = chunkLines[first / LINES_PER_CHUNK];
+            std::string lineKey;
+            double value = 0;
+            for (size_t i = first; i < last; i++)
+            {
+                const size_t lineIndex = candidateLines ? (*candidateLines)[i] : i;
+                if (evaluateLine(compiled, lineIndex, lineKey, value) && lineKey == key)
+                {
+                    matching.push_back(lineIndex);
+                }
+            }
+        },
+        stopToken);
+
+    std::vector<size_t> result;
+    for (auto& matching : chunkLines)
+    {
+        result.insert(result.end(), matching.begin(), matching.end());
+    }
+    return result;
+}
+
+void AggregationEngine::parallelForChunks(const std::vector<size_t>* candidateLines,
+                                          const TaskScheduler::ChunkFunction& chunkFunction,
+                                          std::stop_token stopToken) const
+{
+    const size_t totalLines = candidateLines ? candidateLines->size() : lines.size();
+    std::atomic<size_t> processedLines{0};
+    std::atomic<size_t> reportedPercent{0};
+
+    scheduler.parallelFor(
+        totalLines, LINES_PER_CHUNK, TaskPriority::Background, stopToken,
+        [&](size_t firstLine, size_t lastLine, size_t runnerIndex) {
+            announceData(candidateLines, firstLine, lastLine);
+            chunkFunction(firstLine, lastLine, runnerIndex);
+
+            // Report progress only when it changes by at least one percent
+            const size_t processed = processedLines.fetch_add(lastLine - firstLine) + (lastLine - firstLine);
+            size_t percent = processed * 100 / totalLines;
+            size_t previousPercent = reportedPercent.load();
+            if (progressCallback && percent > previousPercent &&
+                reportedPercent.compare_exchange_strong(previousPercent, percent))
+            {
+                progressCallback(processed, totalLines);
+            }
+        });
+}
+
+// Candidate lines close to each other are announced together, lines far apart or out of order one by one
+void AggregationEngine::announceData(const std::vector<size_t>* candidateLines, const size_t first,
+                                     const size_t last) const
+{
+    if (!accessCallback)
+    {
+        return;
+    }
+    if (candidateLines == nullptr)
+    {
+        accessCallback(lines[first].first, lines[last - 1].second);
+        return;
+    }
+
+    auto [begin, end] = lines[(*candidateLines)[first]];
+    for (size_t i = first + 1; i < last; i++)
+    {
+        const auto [lineBegin, lineEnd] = lines[(*candidateLines)[i]];
+        if (lineBegin >= end && lineBegin - end <= MAX_ANNOUNCED_GAP)
+        {
+            end = lineEnd;
+            continue;
+        }
+        accessCallback(begin, end);
+        begin = lineBegin;
+        end = lineEnd;
+    }
+    accessCallback(begin, end);
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "FieldStore.hpp"
+#include "TaskScheduler.hpp"
+
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A small group-by query over the whole log, e.g.
+//   count by service, minute where level = error
+//   p99(latency_ms) by service
+//   avg(latency_ms) where status >= 500 and contains "db-7"
+// Besides the structured fields the keys "second", "minute", "hour", "day" (timestamp of the line)
+// and "level" (severity of the line) can be used.
+struct AggregationQuery
+{
+    enum class Function
+    {
+        Count,
+        Sum,
+        Average,
+        Min,
+        Max,
+        Percentile
+    };
+
+    struct Condition
+    {
+        enum class Operator
+        {
+            Equal,
+            NotEqual,
+            Less,
+            LessOrEqual,
+            Greater,
+            GreaterOrEqual,
+            Contains
+        };
+
+        std::string field; // Empty field means the whole line (only with Contains)
+        Operator op = Operator::Equal;
+        std::string value;
+        double number = 0; // Value as a number, used by the comparison operators
+    };
+
+    Function function = Function::Count;
+    double percentile = 0;
+    std::string valueField;
+    std::vector<std::string> groupBy;
+    std::vector<Condition> conditions;
+
+    // Returns std::nullopt and sets the error message if the text is not a valid query.
+    static std::optional<AggregationQuery> parse(std::string_view text, std::string& errorMessage);
+};
+
+struct AggregationRow
+{
+    std::string key;
+    double value = 0;
+    size_t count = 0;
+};
+
+struct AggregationResult
+{
+    std::vector<AggregationRow> rows;
+    size_t matchedLines = 0;
+    bool cancelled = false;
+};
+
+// Runs aggregation queries with map-reduce on the task scheduler.
+// Every runner takes chunks of lines and aggregates them into its own hash table,
+// the tables are merged once all lines are processed.
+// Structured fields are read through the FieldStore, so they are parsed only once.
+class AggregationEngine
+{
+public:
+    // Receives the number of lines processed so far and the total number of lines.
+    // Called from worker threads.
+    using ProgressCallback = std::function<void(size_t, size_t)>;
+
+    // Receives a range of data before its lines are read. Called from worker threads.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    // The field store is optional, without it only the timestamp and level keys are available.
+    AggregationEngine(const char* data, const std::vector<std::pair<size_t, size_t>>& lines, FieldStore* fieldStore,
+                      TaskScheduler& scheduler);
+
+    void onProgress(ProgressCallback callback);
+    void onDataAccess(AccessCallback callback);
+
+    AggregationResult run(const AggregationQuery& query, std::stop_token stopToken) const;
+
+    // Returns indices of lines that were aggregated into the row with the given key. If candidate lines are given,
+    // e.g. the lines of the current filter, only they are checked and the result keeps their order.
+    std::vector<size_t> findContributingLines(const AggregationQuery& query, const std::string& key,
+                                              const std::vector<size_t>* candidateLines,
+                                              std::stop_token stopToken) const;
+
+private:
+    struct CompiledQuery;
+
+    CompiledQuery compile(const AggregationQuery& query) const;
+    bool evaluateLine(const CompiledQuery& query, size_t lineIndex, std::string& key, double& value) const;
+    std::string_view getFieldText(const CompiledQuery& query, size_t fieldIndex, size_t lineIndex,
+                                  std::string& buffer) const;
+
+    // Call chunkFunction(first, last, runnerIndex) for all lines or positions of candidate lines, in parallel.
+    void parallelForChunks(const std::vector<size_t>* candidateLines, const TaskScheduler::ChunkFunction& chunkFunction,
+                           std::stop_token stopToken) const;
+    void announceData(const std::vector<size_t>* candidateLines, size_t first, size_t last) const;
+
+    const char* data;
+    const std::vector<std::pair<size_t, size_t>>& lines;
+    FieldStore* fieldStore;
+    TaskScheduler& scheduler;
+    ProgressCallback progressCallback;
+    AccessCallback accessCallback;
+};
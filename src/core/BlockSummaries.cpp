@@ -0,0 +1,159 @@
+#include "BlockSummaries.hpp"
+
+#include <algorithm>
+#include <array>
+#include <istream>
+#include <ostream>
+
+namespace
+{
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+constexpr std::array<bool, 256> makeTokenCharacters()
+{
+    std::array<bool, 256> table{};
+    for (int c = 0; c < 256; c++)
+    {
+        table[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+    }
+    return table;
+}
+
+constexpr std::array<bool, 256> TOKEN_CHARACTERS = makeTokenCharacters();
+
+bool isTokenCharacter(const char c)
+{
+    return TOKEN_CHARACTERS[static_cast<unsigned char>(c)];
+}
+
+// Call function(hash, begin, end) for every token of the text
+template <typename Function> void forEachToken(const std::string_view text, Function function)
+{
+    size_t tokenBegin = 0;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t pos = 0; pos <= text.size(); pos++)
+    {
+        if (pos < text.size() && isTokenCharacter(text[pos]))
+        {
+            hash = (hash ^ static_cast<unsigned char>(text[pos])) * FNV_PRIME;
+            continue;
+        }
+        if (pos > tokenBegin)
+        {
+            function(hash, tokenBegin, pos);
+        }
+        tokenBegin = pos + 1;
+        hash = FNV_OFFSET_BASIS;
+    }
+}
+} // namespace
+
+void BlockSummaries::reset(const size_t numberOfLines)
+{
+    this->numberOfLines = numberOfLines;
+    const size_t numberOfBlocks = (numberOfLines + LINES_PER_BLOCK - 1) / LINES_PER_BLOCK;
+    bits.assign(numberOfBlocks * WORDS_PER_BLOCK, 0);
+}
+
+void BlockSummaries::resize(const size_t numberOfLines)
+{
+    this->numberOfLines = numberOfLines;
+    const size_t numberOfBlocks = (numberOfLines + LINES_PER_BLOCK - 1) / LINES_PER_BLOCK;
+    bits.resize(numberOfBlocks * WORDS_PER_BLOCK, 0);
+}
+
+void BlockSummaries::addLine(const size_t lineIndex, const std::string_view text)
+{
+    const size_t block = lineIndex / LINES_PER_BLOCK;
+    forEachToken(text, [this, block](uint64_t hash, size_t, size_t) { addToken(block, hash); });
+}
+
+std::optional<std::vector<uint32_t>> BlockSummaries::findCandidateBlocks(const std::string_view text) const
+{
+    // Tokens touching the ends of the text may be parts of longer tokens in the line
+    std::vector<uint64_t> hashes;
+    forEachToken(text, [&](uint64_t hash, size_t begin, size_t end) {
+        if (begin > 0 && end < text.size())
+        {
+            hashes.push_back(hash);
+        }
+    });
+    if (hashes.empty())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<uint32_t> blocks;
+    for (size_t block = 0; block < getNumberOfBlocks(); block++)
+    {
+        const bool candidate =
+            std::all_of(hashes.begin(), hashes.end(), [&](uint64_t hash) { return mayContain(block, hash); });
+        if (candidate)
+        {
+            blocks.push_back(static_cast<uint32_t>(block));
+        }
+    }
+    return blocks;
+}
+
+std::vector<uint32_t> BlockSummaries::getLinesOfBlocks(const std::vector<uint32_t>& blocks) const
+{
+    std::vector<uint32_t> lineIndices;
+    for (const uint32_t block : blocks)
+    {
+        const size_t firstLine = block * LINES_PER_BLOCK;
+        const size_t lastLine = std::min(numberOfLines, firstLine + LINES_PER_BLOCK);
+        for (size_t lineIndex = firstLine; lineIndex < lastLine; lineIndex++)
+        {
+            lineIndices.push_back(static_cast<uint32_t>(lineIndex));
+        }
+    }
+    return lineIndices;
+}
+
+size_t BlockSummaries::getNumberOfBlocks() const
+{
+    return bits.size() / WORDS_PER_BLOCK;
+}
+
+size_t BlockSummaries::getMemoryUsage() const
+{
+    return bits.size() * sizeof(uint64_t);
+}
+
+void BlockSummaries::write(std::ostream& output) const
+{
+    output.write(reinterpret_cast<const char*>(bits.data()),
+                 static_cast<std::streamsize>(bits.size() * sizeof(uint64_t)));
+}
+
+bool BlockSummaries::read(std::istream& input, const size_t numberOfLines)
+{
+    reset(numberOfLines);
+    if (!input.read(reinterpret_cast<char*>(bits.data()),
+                    static_cast<std::streamsize>(bits.size() * sizeof(uint64_t))))
+    {
+        reset(0);
+        return false;
+    }
+    return true;
+}
+
+// Two bits per token, taken from both halves of the hash
+void BlockSummaries::addToken(const size_t block, const uint64_t hash)
+{
+    uint64_t* words = bits.data() + block * WORDS_PER_BLOCK;
+    const auto bit1 = static_cast<size_t>(hash % BITS_PER_BLOCK);
+    const auto bit2 = static_cast<size_t>((hash >> 32) % BITS_PER_BLOCK);
+    words[bit1 / 64] |= uint64_t{1} << (bit1 % 64);
+    words[bit2 / 64] |= uint64_t{1} << (bit2 % 64);
+}
+
+bool BlockSummaries::mayContain(const size_t block, const uint64_t hash) const
+{
+    const uint64_t* words = bits.data() + block * WORDS_PER_BLOCK;
+    const auto bit1 = static_cast<size_t>(hash % BITS_PER_BLOCK);
+    const auto bit2 = static_cast<size_t>((hash >> 32) % BITS_PER_BLOCK);
+    return (words[bit1 / 64] >> (bit1 % 64) & 1) != 0 && (words[bit2 / 64] >> (bit2 % 64) & 1) != 0;
+}
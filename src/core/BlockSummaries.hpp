@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Small summaries of fixed blocks of lines that tell which blocks cannot contain a text.
+// Every block has a Bloom filter of its tokens (runs of letters, digits, underscores and non-ASCII bytes).
+// Only the tokens of a query that are delimited on both sides within the query itself are certainly
+// whole tokens of a matching line, so a query like "id=7f3a9c21 " skips every block without 7f3a9c21,
+// while a query without delimiters cannot skip anything.
+// A summary takes BITS_PER_BLOCK / 8 bytes, which is about 2% of a log with 100-byte lines.
+class BlockSummaries
+{
+public:
+    static constexpr size_t LINES_PER_BLOCK = 1024;
+    static constexpr size_t BITS_PER_BLOCK = 16 * 1024;
+
+    void reset(size_t numberOfLines);
+
+    // Change the number of lines, the summaries of the blocks that remain are kept
+    void resize(size_t numberOfLines);
+
+    // Add the tokens of the line to the summary of its block.
+    // Lines of different blocks can be added from different threads at the same time.
+    void addLine(size_t lineIndex, std::string_view text);
+
+    // Sorted blocks that may contain the text.
+    // Returns nothing if the text has no delimited tokens that could rule out any block.
+    std::optional<std::vector<uint32_t>> findCandidateBlocks(std::string_view text) const;
+
+    // Sorted indices of all lines in the given blocks.
+    std::vector<uint32_t> getLinesOfBlocks(const std::vector<uint32_t>& blocks) const;
+
+    size_t getNumberOfBlocks() const;
+    size_t getMemoryUsage() const;
+
+    // Write the summaries into a file of another index. read() expects the same number of lines
+    // and returns false if the summaries are incomplete.
+    void write(std::ostream& output) const;
+    bool read(std::istream& input, size_t numberOfLines);
+
+private:
+    static constexpr size_t WORDS_PER_BLOCK = BITS_PER_BLOCK / 64;
+
+    void addToken(size_t block, uint64_t hash);
+    bool mayContain(size_t block, uint64_t hash) const;
+
+    size_t numberOfLines = 0;
+    std::vector<uint64_t> bits;
+};
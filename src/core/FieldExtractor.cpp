@@ -0,0 +1,291 @@
+#include "FieldExtractor.hpp"
+#include "LogFormat.hpp"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LOGVIEWER_SSE2 1
+#endif
+
+namespace
+{
+constexpr size_t DETECTION_SAMPLE_SIZE = 100;
+
+// Find the first occurrence of any of the given characters in [begin, end).
+// Returns end if none of them was found. With SSE2 16 bytes are compared at once,
+// which lets long string values and nested objects be skipped quickly.
+template <char... Chars> const char* findAnyOf(const char* begin, const char* end)
+{
+    const char* p = begin;
+#ifdef LOGVIEWER_SSE2
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i matches = _mm_setzero_si128();
+        ((matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Chars)))), ...);
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+        if (mask != 0)
+        {
+            return p + std::countr_zero(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && ((*p != Chars) && ...))
+    {
+        ++p;
+    }
+    return p;
+}
+
+bool isWhitespace(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* skipWhitespace(const char* p, const char* end)
+{
+    while (p < end && isWhitespace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// p points right after the opening quote.
+// Returns a pointer to the closing quote or end if the string is not terminated.
+const char* skipString(const char* p, const char* end)
+{
+    while (true)
+    {
+        p = findAnyOf<'"', '\\'>(p, end);
+        if (p >= end || *p == '"')
+        {
+            return p;
+        }
+        p += 2; // skip the escaped character
+        if (p >= end)
+        {
+            return end;
+        }
+    }
+}
+
+// p points at the opening bracket of an object or an array.
+// Returns a pointer right after the matching closing bracket.
+const char* skipNested(const char* p, const char* end)
+{
+    int depth = 0;
+    while (p < end)
+    {
+        p = findAnyOf<'"', '{', '}', '[', ']'>(p, end);
+        if (p >= end)
+        {
+            break;
+        }
+
+        switch (*p)
+        {
+        case '"':
+            p = skipString(p + 1, end);
+            break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        default:
+            depth--;
+            break;
+        }
+        if (p < end)
+        {
+            ++p;
+        }
+        if (depth == 0)
+        {
+            break;
+        }
+    }
+    return p;
+}
+} // namespace
+
+std::string_view JsonFieldExtractor::getName() const
+{
+    return "JSON";
+}
+
+bool JsonFieldExtractor::extract(std::string_view line, std::vector<Field>& fields) const
+{
+    const char* end = line.data() + line.size();
+    const char* p = skipWhitespace(line.data(), end);
+    if (p >= end || *p != '{')
+    {
+        return false;
+    }
+    ++p;
+
+    while (true)
+    {
+        p = skipWhitespace(p, end);
+        if (p >= end || *p == '}' || *p != '"')
+        {
+            break;
+        }
+
+        const char* keyBegin = p + 1;
+        const char* keyEnd = skipString(keyBegin, end);
+        p = skipWhitespace(keyEnd + 1, end);
+        if (keyEnd >= end || p >= end || *p != ':')
+        {
+            break;
+        }
+        p = skipWhitespace(p + 1, end);
+        if (p >= end)
+        {
+            break;
+        }
+
+        const char* valueBegin = p;
+        const char* valueEnd;
+        if (*p == '"')
+        {
+            valueBegin = p + 1;
+            valueEnd = skipString(valueBegin, end);
+            p = valueEnd < end ? valueEnd + 1 : end;
+        }
+        else if (*p == '{' || *p == '[')
+        {
+            valueEnd = skipNested(p, end);
+            p = valueEnd;
+        }
+        else
+        {
+            valueEnd = findAnyOf<',', '}', ' ', '\t', '\r'>(p, end);
+            p = valueEnd;
+        }
+
+        fields.push_back({{keyBegin, static_cast<size_t>(keyEnd - keyBegin)},
+                          {valueBegin, static_cast<size_t>(valueEnd - valueBegin)}});
+
+        p = skipWhitespace(p, end);
+        if (p >= end || *p != ',')
+        {
+            break;
+        }
+        ++p;
+    }
+
+    return true;
+}
+
+std::string_view LogfmtFieldExtractor::getName() const
+{
+    return "logfmt";
+}
+
+bool LogfmtFieldExtractor::extract(std::string_view line, std::vector<Field>& fields) const
+{
+    const size_t fieldsBefore = fields.size();
+    const char* end = line.data() + line.size();
+    const char* p = line.data();
+
+    while (p < end)
+    {
+        p = skipWhitespace(p, end);
+        const char* keyBegin = p;
+        const char* keyEnd = findAnyOf<'=', ' ', '\t', '"'>(p, end);
+        if (keyEnd >= end || *keyEnd != '=' || keyEnd == keyBegin)
+        {
+            // Not a key=value pair, skip the whole token
+            p = findAnyOf<' ', '\t'>(keyEnd, end);
+            continue;
+        }
+
+        const char* valueBegin = keyEnd + 1;
+        const char* valueEnd;
+        if (valueBegin < end && *valueBegin == '"')
+        {
+            valueBegin++;
+            valueEnd = skipString(valueBegin, end);
+            p = valueEnd < end ? valueEnd + 1 : end;
+        }
+        else
+        {
+            valueEnd = findAnyOf<' ', '\t', '\r'>(valueBegin, end);
+            p = valueEnd;
+        }
+
+        fields.push_back({{keyBegin, static_cast<size_t>(keyEnd - keyBegin)},
+                          {valueBegin, static_cast<size_t>(valueEnd - valueBegin)}});
+    }
+
+    return fields.size() > fieldsBefore;
+}
+
+std::unique_ptr<FieldExtractor> detectFieldExtractor(const char* data,
+                                                     const std::vector<std::pair<size_t, size_t>>& lines)
+{
+    const JsonFieldExtractor json;
+    const LogfmtFieldExtractor logfmt;
+    auto formats = createBuiltInFormatExtractors();
+    std::vector<Field> fields;
+
+    size_t sampledLines = 0;
+    size_t jsonLines = 0;
+    size_t logfmtLines = 0;
+    std::vector<size_t> formatLines(formats.size(), 0);
+    for (const auto& [lineBegin, lineEnd] : lines)
+    {
+        if (sampledLines >= DETECTION_SAMPLE_SIZE)
+        {
+            break;
+        }
+        if (lineBegin == lineEnd)
+        {
+            continue;
+        }
+
+        const std::string_view line(data + lineBegin, lineEnd - lineBegin);
+        sampledLines++;
+
+        fields.clear();
+        if (json.extract(line, fields) && !fields.empty())
+        {
+            jsonLines++;
+            continue;
+        }
+        fields.clear();
+        if (logfmt.extract(line, fields) && fields.size() >= 2)
+        {
+            logfmtLines++;
+        }
+        for (size_t i = 0; i < formats.size(); i++)
+        {
+            fields.clear();
+            formatLines[i] += formats[i]->extract(line, fields) ? 1 : 0;
+        }
+    }
+
+    if (sampledLines == 0)
+    {
+        return nullptr;
+    }
+    if (jsonLines * 2 > sampledLines)
+    {
+        return std::make_unique<JsonFieldExtractor>();
+    }
+    // Plain-text lines with key=value pairs in the message are parsed by their format, which finds the timestamp
+    // and the level as well. The first of the formats matching the most lines is the most specific one.
+    const auto bestFormat = std::max_element(formatLines.begin(), formatLines.end());
+    if (*bestFormat * 2 > sampledLines && *bestFormat >= logfmtLines)
+    {
+        return std::move(formats[bestFormat - formatLines.begin()]);
+    }
+    if (logfmtLines * 2 > sampledLines)
+    {
+        return std::make_unique<LogfmtFieldExtractor>();
+    }
+    return nullptr;
+}
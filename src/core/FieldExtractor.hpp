@@ -0,0 +1,51 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A single key/value pair found in a structured log line.
+// The value points into the line that was passed to the extractor.
+struct Field
+{
+    std::string_view key;
+    std::string_view value;
+};
+
+// Parses structured fields out of a single log line.
+// Extractors are stateless, so one instance can be shared between threads.
+class FieldExtractor
+{
+public:
+    virtual ~FieldExtractor() = default;
+
+    virtual std::string_view getName() const = 0;
+
+    // Append all top-level fields of the line to the output vector.
+    // Returns false if the line is not in the format understood by the extractor.
+    virtual bool extract(std::string_view line, std::vector<Field>& fields) const = 0;
+};
+
+// JSON lines: {"ts":"...","level":"info","latency_ms":12}
+// Only top-level members are extracted, nested objects and arrays are returned as raw text.
+// String values are returned without quotes and escape sequences are left as they are.
+class JsonFieldExtractor : public FieldExtractor
+{
+public:
+    std::string_view getName() const override;
+    bool extract(std::string_view line, std::vector<Field>& fields) const override;
+};
+
+// logfmt: ts=2024-01-01T10:00:00Z level=info msg="request done" latency_ms=12
+// Text that is not a key=value pair is skipped.
+class LogfmtFieldExtractor : public FieldExtractor
+{
+public:
+    std::string_view getName() const override;
+    bool extract(std::string_view line, std::vector<Field>& fields) const override;
+};
+
+// Pick an extractor by looking at a sample of lines.
+// Returns nullptr if the lines do not look like JSON, logfmt or one of the common plain-text formats.
+std::unique_ptr<FieldExtractor> detectFieldExtractor(const char* data,
+                                                     const std::vector<std::pair<size_t, size_t>>& lines);
@@ -0,0 +1,144 @@
+#include "FieldSort.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+
+namespace
+{
+// Number of lines sorted by one task, and the size of the pieces of every merge
+constexpr size_t SORT_CHUNK_LINES = 64 * 1024;
+
+// Values without the field go last, text goes after numbers
+int getRank(const FieldValue& value)
+{
+    if (!value.isPresent())
+    {
+        return 2;
+    }
+    return value.isNumber() ? 0 : 1;
+}
+
+// Number of elements taken from the sorted range a by the first k elements of the merge of a and b.
+// Elements of a go first among equal elements, like in std::merge.
+template <typename Less>
+size_t findMergeSplit(const uint32_t* a, const size_t aSize, const uint32_t* b, const size_t bSize, const size_t k,
+                      const Less& less)
+{
+    size_t low = k > bSize ? k - bSize : 0;
+    size_t high = std::min(k, aSize);
+    while (low < high)
+    {
+        const size_t i = low + (high - low) / 2;
+        if (!less(b[k - i - 1], a[i]))
+        {
+            low = i + 1;
+        }
+        else
+        {
+            high = i;
+        }
+    }
+    return low;
+}
+} // namespace
+
+FieldSort::FieldSort(const char* data, const std::vector<std::pair<size_t, size_t>>& lines, FieldStore& fieldStore,
+                     TaskScheduler& scheduler)
+    : data(data), lines(lines), fieldStore(fieldStore), scheduler(scheduler)
+{
+}
+
+void FieldSort::onDataAccess(AccessCallback callback)
+{
+    accessCallback = std::move(callback);
+}
+
+std::optional<std::vector<size_t>> FieldSort::sort(const size_t column, std::stop_token stopToken) const
+{
+    // Line indices fit in 32 bits like in the search results, so the two buffers of the merges take 8 bytes per line
+    const size_t numberOfLines = lines.size();
+    std::vector<FieldValue> values(numberOfLines);
+    std::vector<uint32_t> order(numberOfLines);
+    const auto less = [&](uint32_t left, uint32_t right) { return isBefore(values, left, right); };
+
+    scheduler.parallelFor(numberOfLines, SORT_CHUNK_LINES, TaskPriority::Background, stopToken,
+                          [&](size_t firstLine, size_t lastLine, size_t) {
+                              if (accessCallback)
+                              {
+                                  accessCallback(lines[firstLine].first, lines[lastLine - 1].second);
+                              }
+                              fieldStore.prefetch(firstLine, lastLine);
+                              for (size_t lineIndex = firstLine; lineIndex < lastLine; lineIndex++)
+                              {
+                                  values[lineIndex] = fieldStore.getValue(lineIndex, column);
+                              }
+                              std::iota(order.begin() + firstLine, order.begin() + lastLine,
+                                        static_cast<uint32_t>(firstLine));
+                              std::sort(order.begin() + firstLine, order.begin() + lastLine, less);
+                          });
+    if (stopToken.stop_requested())
+    {
+        return std::nullopt;
+    }
+
+    // Pieces are aligned to the chunks, so every piece belongs to a single pair of sorted ranges
+    std::vector<uint32_t> merged(numberOfLines);
+    for (size_t width = SORT_CHUNK_LINES; width < numberOfLines; width *= 2)
+    {
+        scheduler.parallelFor(numberOfLines, SORT_CHUNK_LINES, TaskPriority::Background, stopToken,
+                              [&](size_t pieceBegin, size_t pieceEnd, size_t) {
+                                  const size_t pairBegin = pieceBegin / (2 * width) * (2 * width);
+                                  const size_t middle = std::min(pairBegin + width, numberOfLines);
+                                  const size_t pairEnd = std::min(pairBegin + 2 * width, numberOfLines);
+                                  const uint32_t* a = order.data() + pairBegin;
+                                  const uint32_t* b = order.data() + middle;
+                                  const size_t aSize = middle - pairBegin;
+                                  const size_t bSize = pairEnd - middle;
+
+                                  const size_t kBegin = pieceBegin - pairBegin;
+                                  const size_t kEnd = pieceEnd - pairBegin;
+                                  const size_t aBegin = findMergeSplit(a, aSize, b, bSize, kBegin, less);
+                                  const size_t aEnd = findMergeSplit(a, aSize, b, bSize, kEnd, less);
+                                  std::merge(a + aBegin, a + aEnd, b + (kBegin - aBegin), b + (kEnd - aEnd),
+                                             merged.data() + pieceBegin, less);
+                              });
+        if (stopToken.stop_requested())
+        {
+            return std::nullopt;
+        }
+        order.swap(merged);
+    }
+
+    merged = {};
+    values = {};
+    return std::vector<size_t>(order.begin(), order.end());
+}
+
+// Lines with equal values are ordered by their index, so the order does not depend on how the lines were chunked
+bool FieldSort::isBefore(const std::vector<FieldValue>& values, const uint32_t left, const uint32_t right) const
+{
+    const FieldValue& a = values[left];
+    const FieldValue& b = values[right];
+    const int aRank = getRank(a);
+    const int bRank = getRank(b);
+    if (aRank != bRank)
+    {
+        return aRank < bRank;
+    }
+    if (aRank == 0 && a.number != b.number)
+    {
+        return a.number < b.number;
+    }
+    if (aRank == 1)
+    {
+        const std::string_view aText(data + lines[left].first + a.offset, a.length);
+        const std::string_view bText(data + lines[right].first + b.offset, b.length);
+        const int comparison = aText.compare(bText);
+        if (comparison != 0)
+        {
+            return comparison < 0;
+        }
+    }
+    return left < right;
+}
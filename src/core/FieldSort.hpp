@@ -0,0 +1,40 @@
+#pragma once
+#include "FieldStore.hpp"
+#include "TaskScheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+// Orders the lines of a log by the value of one field: numbers by value, then text, then lines without the field.
+// Lines with equal values keep their order in the log. The values are read from a column of the field store,
+// so every line is parsed at most once. Chunks of lines are sorted in parallel and then merged in pairs.
+// Every merge is split into pieces of the same size with a binary search, so all runners take part in it
+// and the sort stops between pieces when it is cancelled.
+class FieldSort
+{
+public:
+    // Receives a range of data before its lines are read. Called from worker threads.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    FieldSort(const char* data, const std::vector<std::pair<size_t, size_t>>& lines, FieldStore& fieldStore,
+              TaskScheduler& scheduler);
+
+    void onDataAccess(AccessCallback callback);
+
+    // Indices of all lines in the order of their values in the column. Returns nothing if the sort was cancelled.
+    std::optional<std::vector<size_t>> sort(size_t column, std::stop_token stopToken) const;
+
+private:
+    bool isBefore(const std::vector<FieldValue>& values, uint32_t left, uint32_t right) const;
+
+    const char* data;
+    const std::vector<std::pair<size_t, size_t>>& lines;
+    FieldStore& fieldStore;
+    TaskScheduler& scheduler;
+    AccessCallback accessCallback;
+};
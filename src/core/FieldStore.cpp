@@ -0,0 +1,190 @@
+#include "FieldStore.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+double parseNumber(std::string_view text)
+{
+    double number = std::numeric_limits<double>::quiet_NaN();
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, number);
+    if (result.ec != std::errc{} || result.ptr != end)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return number;
+}
+} // namespace
+
+FieldStore::FieldStore(const char* data, const std::vector<std::pair<size_t, size_t>>& lines,
+                       std::unique_ptr<FieldExtractor> extractor)
+    : data(data), lines(lines), numberOfLines(lines.size()), extractor(std::move(extractor))
+{
+    const size_t numberOfBlocks = (lines.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blocks.reserve(numberOfBlocks);
+    for (size_t i = 0; i < numberOfBlocks; i++)
+    {
+        blocks.push_back(std::make_unique<Block>());
+    }
+}
+
+void FieldStore::extend()
+{
+    if (numberOfLines > 0)
+    {
+        const size_t lastLine = numberOfLines - 1;
+        for (ColumnBlock& column : blocks[lastLine / BLOCK_SIZE]->columns)
+        {
+            column.parsed.reset(lastLine % BLOCK_SIZE);
+        }
+    }
+    numberOfLines = lines.size();
+
+    const size_t numberOfBlocks = (numberOfLines + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    while (blocks.size() < numberOfBlocks)
+    {
+        blocks.push_back(std::make_unique<Block>());
+    }
+}
+
+const FieldExtractor& FieldStore::getExtractor() const
+{
+    return *extractor;
+}
+
+size_t FieldStore::addColumn(std::string_view fieldName)
+{
+    std::unique_lock lock(columnNamesMutex);
+    const auto it = std::find(columnNames.begin(), columnNames.end(), fieldName);
+    if (it != columnNames.end())
+    {
+        return it - columnNames.begin();
+    }
+    columnNames.emplace_back(fieldName);
+    return columnNames.size() - 1;
+}
+
+std::optional<size_t> FieldStore::findColumn(std::string_view fieldName) const
+{
+    std::shared_lock lock(columnNamesMutex);
+    const auto it = std::find(columnNames.begin(), columnNames.end(), fieldName);
+    if (it == columnNames.end())
+    {
+        return std::nullopt;
+    }
+    return it - columnNames.begin();
+}
+
+std::string FieldStore::getColumnName(size_t column) const
+{
+    std::shared_lock lock(columnNamesMutex);
+    return columnNames.at(column);
+}
+
+size_t FieldStore::getNumberOfColumns() const
+{
+    std::shared_lock lock(columnNamesMutex);
+    return columnNames.size();
+}
+
+FieldValue FieldStore::getValue(size_t lineIndex, size_t column)
+{
+    if (lineIndex >= lines.size() || column >= getNumberOfColumns())
+    {
+        return {};
+    }
+
+    Block& block = *blocks[lineIndex / BLOCK_SIZE];
+    std::lock_guard lock(block.mutex);
+    const size_t indexInBlock = lineIndex % BLOCK_SIZE;
+    if (!getColumnBlock(block, column).parsed.test(indexInBlock))
+    {
+        parseLine(block, lineIndex);
+    }
+    return getColumnBlock(block, column).values[indexInBlock];
+}
+
+std::string_view FieldStore::getText(size_t lineIndex, size_t column)
+{
+    const FieldValue value = getValue(lineIndex, column);
+    if (!value.isPresent())
+    {
+        return {};
+    }
+    return {data + lines[lineIndex].first + value.offset, value.length};
+}
+
+void FieldStore::prefetch(size_t firstLine, size_t lastLine)
+{
+    lastLine = std::min(lastLine, lines.size());
+    const size_t numberOfColumns = getNumberOfColumns();
+
+    for (size_t lineIndex = firstLine; lineIndex < lastLine;)
+    {
+        Block& block = *blocks[lineIndex / BLOCK_SIZE];
+        const size_t blockEnd = std::min(lastLine, (lineIndex / BLOCK_SIZE + 1) * BLOCK_SIZE);
+
+        std::lock_guard lock(block.mutex);
+        for (; lineIndex < blockEnd; lineIndex++)
+        {
+            const size_t indexInBlock = lineIndex % BLOCK_SIZE;
+            for (size_t column = 0; column < numberOfColumns; column++)
+            {
+                if (!getColumnBlock(block, column).parsed.test(indexInBlock))
+                {
+                    parseLine(block, lineIndex);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+FieldStore::ColumnBlock& FieldStore::getColumnBlock(Block& block, size_t column) const
+{
+    if (block.columns.size() <= column)
+    {
+        block.columns.resize(column + 1);
+    }
+
+    ColumnBlock& columnBlock = block.columns[column];
+    if (columnBlock.values.empty())
+    {
+        columnBlock.values.resize(BLOCK_SIZE);
+    }
+    return columnBlock;
+}
+
+// Extract fields of the line and store the values of all registered columns.
+// The block must be locked by the caller.
+void FieldStore::parseLine(Block& block, size_t lineIndex)
+{
+    thread_local std::vector<Field> fields;
+    fields.clear();
+
+    const auto [lineBegin, lineEnd] = lines[lineIndex];
+    const std::string_view line(data + lineBegin, lineEnd - lineBegin);
+    extractor->extract(line, fields);
+
+    const size_t indexInBlock = lineIndex % BLOCK_SIZE;
+    std::shared_lock lock(columnNamesMutex);
+    for (size_t column = 0; column < columnNames.size(); column++)
+    {
+        ColumnBlock& columnBlock = getColumnBlock(block, column);
+        FieldValue value;
+        for (const Field& field : fields)
+        {
+            if (field.key == columnNames[column])
+            {
+                value.offset = static_cast<uint32_t>(field.value.data() - line.data());
+                value.length = static_cast<uint32_t>(field.value.size());
+                value.number = parseNumber(field.value);
+                break;
+            }
+        }
+        columnBlock.values[indexInBlock] = value;
+        columnBlock.parsed.set(indexInBlock);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "FieldExtractor.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Cached value of one field in one line.
+// The text is stored as a position relative to the beginning of the line,
+// so the store never copies the log text.
+struct FieldValue
+{
+    static constexpr uint32_t MISSING = std::numeric_limits<uint32_t>::max();
+
+    uint32_t offset = 0;
+    uint32_t length = MISSING;
+    double number = std::numeric_limits<double>::quiet_NaN();
+
+    bool isPresent() const
+    {
+        return length != MISSING;
+    }
+    bool isNumber() const
+    {
+        return number == number; // false for NaN
+    }
+};
+
+// Columnar cache of structured fields extracted from log lines.
+// Lines are parsed lazily, only when a value from them is requested, and the values of each
+// requested field are kept in a separate column. Sorting, filtering or drawing by a field
+// reads the column and never parses the same line twice.
+// Columns are split into blocks of lines that are allocated on first use and locked separately,
+// so many threads can fill different parts of the store at the same time.
+class FieldStore
+{
+public:
+    FieldStore(const char* data, const std::vector<std::pair<size_t, size_t>>& lines,
+               std::unique_ptr<FieldExtractor> extractor);
+
+    const FieldExtractor& getExtractor() const;
+
+    // Register a field to be cached. Returns the index of its column.
+    // Adding a field that is already registered returns the existing column.
+    size_t addColumn(std::string_view fieldName);
+    std::optional<size_t> findColumn(std::string_view fieldName) const;
+    std::string getColumnName(size_t column) const;
+    size_t getNumberOfColumns() const;
+
+    // Returns the value of the field in the given line, parsing the line if necessary.
+    FieldValue getValue(size_t lineIndex, size_t column);
+    std::string_view getText(size_t lineIndex, size_t column);
+
+    // Parse lines [firstLine, lastLine) ahead of time, e.g. the lines on screen or the lines of a query.
+    void prefetch(size_t firstLine, size_t lastLine);
+
+    // Make room for the lines appended to the log, e.g. to the standard input. The last line known before
+    // may have continued, so it is parsed again. Must not be called while the store is read.
+    void extend();
+
+private:
+    static constexpr size_t BLOCK_SIZE = 4096; // lines per block
+
+    struct ColumnBlock
+    {
+        std::vector<FieldValue> values;
+        std::bitset<BLOCK_SIZE> parsed;
+    };
+
+    struct Block
+    {
+        std::mutex mutex;
+        std::vector<ColumnBlock> columns;
+    };
+
+    ColumnBlock& getColumnBlock(Block& block, size_t column) const;
+    void parseLine(Block& block, size_t lineIndex);
+
+    const char* data;
+    const std::vector<std::pair<size_t, size_t>>& lines;
+    size_t numberOfLines; // lines known when the store was created or last extended
+    std::unique_ptr<FieldExtractor> extractor;
+
+    mutable std::shared_mutex columnNamesMutex;
+    std::vector<std::string> columnNames;
+
+    std::vector<std::unique_ptr<Block>> blocks;
+};
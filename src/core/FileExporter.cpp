@@ -0,0 +1,391 @@
+#include "FileExporter.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace
+{
+// Amount of data copied between checks for cancellation and progress updates
+constexpr size_t EXPORT_CHUNK_SIZE = 64 * 1024 * 1024;
+
+#ifdef IOV_MAX
+constexpr size_t MAX_BUFFERS_PER_WRITE = IOV_MAX;
+#else
+constexpr size_t MAX_BUFFERS_PER_WRITE = 1024;
+#endif
+
+struct Buffer
+{
+    const char* data;
+    size_t size;
+};
+} // namespace
+
+FileExporter::FileExporter(const MappedFile& source, std::string destinationPath)
+    : source(source), destinationPath(std::move(destinationPath))
+{
+}
+
+void FileExporter::onProgress(ProgressCallback callback)
+{
+    progressCallback = std::move(callback);
+}
+
+void FileExporter::setEncoding(const TextEncoding encoding)
+{
+    newline = encodeFromUtf8("\n", encoding).value_or("\n");
+}
+
+const std::string& FileExporter::getErrorMessage() const
+{
+    return errorMessage;
+}
+
+bool FileExporter::exportRange(size_t begin, size_t end, std::stop_token stopToken)
+{
+    end = std::min(end, source.size());
+    begin = std::min(begin, end);
+
+    if (!openDestination())
+    {
+        return false;
+    }
+
+    const size_t bytesTotal = end - begin;
+    size_t position = begin;
+    reportProgress(0, bytesTotal);
+    while (position < end)
+    {
+        if (stopToken.stop_requested())
+        {
+            setError("Export cancelled");
+            break;
+        }
+
+        const size_t chunkEnd = std::min(end, position + EXPORT_CHUNK_SIZE);
+        if (!copyRange(position, chunkEnd))
+        {
+            break;
+        }
+        position = chunkEnd;
+        reportProgress(position - begin, bytesTotal);
+    }
+
+    closeDestination();
+    return errorMessage.empty();
+}
+
+bool FileExporter::exportLines(std::span<const std::pair<size_t, size_t>> lines, std::stop_token stopToken)
+{
+    if (!openDestination())
+    {
+        return false;
+    }
+
+    const char* data = source.data();
+    const size_t dataSize = source.size();
+
+    size_t bytesTotal = 0;
+    for (const auto& [lineBegin, lineEnd] : lines)
+    {
+        bytesTotal += lineEnd - lineBegin + newline.size();
+    }
+
+    // Lines are written directly from the mapping. Adjacent lines are merged into a single
+    // buffer together with the newline between them, so a contiguous block of lines
+    // costs only one buffer no matter how many lines it has.
+    std::vector<Buffer> buffers;
+    buffers.reserve(MAX_BUFFERS_PER_WRITE);
+    size_t batchBytes = 0;
+    size_t bytesWritten = 0;
+
+    auto flush = [&] {
+        bool success = true;
+        for (const Buffer& buffer : buffers)
+        {
+            if (buffer.data != newline.data())
+            {
+                source.touch(buffer.data - data, buffer.data - data + buffer.size);
+            }
+        }
+#ifdef _WIN32
+        for (const Buffer& buffer : buffers)
+        {
+            if (!success)
+                break;
+            const char* chunk = buffer.data;
+            size_t remaining = buffer.size;
+            while (success && remaining > 0)
+            {
+                DWORD written = 0;
+                const DWORD toWrite = static_cast<DWORD>(std::min<size_t>(remaining, EXPORT_CHUNK_SIZE));
+                success = WriteFile(destinationHandle, chunk, toWrite, &written, nullptr) && written > 0;
+                chunk += written;
+                remaining -= written;
+            }
+        }
+        if (!success)
+            setError("Cannot write to file: " + destinationPath);
+#else
+        std::vector<iovec> vectors(buffers.size());
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            vectors[i].iov_base = const_cast<char*>(buffers[i].data);
+            vectors[i].iov_len = buffers[i].size;
+        }
+
+        iovec* pending = vectors.data();
+        int pendingCount = static_cast<int>(vectors.size());
+        while (pendingCount > 0)
+        {
+            const ssize_t written = writev(destinationDescriptor, pending, pendingCount);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                setError("Cannot write to file: " + destinationPath + " (" + std::strerror(errno) + ")");
+                success = false;
+                break;
+            }
+
+            // Skip buffers that were written completely and adjust the partially written one
+            size_t remaining = static_cast<size_t>(written);
+            while (pendingCount > 0 && remaining >= pending->iov_len)
+            {
+                remaining -= pending->iov_len;
+                pending++;
+                pendingCount--;
+            }
+            if (pendingCount > 0)
+            {
+                pending->iov_base = static_cast<char*>(pending->iov_base) + remaining;
+                pending->iov_len -= remaining;
+            }
+        }
+#endif
+        bytesWritten += batchBytes;
+        buffers.clear();
+        batchBytes = 0;
+        reportProgress(bytesWritten, bytesTotal);
+        return success;
+    };
+
+    reportProgress(0, bytesTotal);
+    for (const auto& [lineBegin, lineEnd] : lines)
+    {
+        if (stopToken.stop_requested())
+        {
+            setError("Export cancelled");
+            break;
+        }
+
+        const bool hasNewline = lineEnd < dataSize;
+        const size_t bufferEnd = hasNewline ? std::min(lineEnd + newline.size(), dataSize) : lineEnd;
+        if (!buffers.empty() && buffers.back().data + buffers.back().size == data + lineBegin)
+        {
+            buffers.back().size += bufferEnd - lineBegin;
+        }
+        else if (bufferEnd > lineBegin)
+        {
+            buffers.push_back({data + lineBegin, bufferEnd - lineBegin});
+        }
+        if (!hasNewline)
+        {
+            buffers.push_back({newline.data(), newline.size()});
+        }
+        batchBytes += lineEnd - lineBegin + newline.size();
+
+        // Keep one slot free for the newline of the last line in the file
+        if (buffers.size() + 1 >= MAX_BUFFERS_PER_WRITE || batchBytes >= EXPORT_CHUNK_SIZE)
+        {
+            if (!flush())
+                break;
+        }
+    }
+
+    if (errorMessage.empty() && !buffers.empty())
+    {
+        flush();
+    }
+
+    closeDestination();
+    return errorMessage.empty();
+}
+
+// Writing the file that is being exported would truncate it under its mapping, so it is refused
+bool FileExporter::openDestination()
+{
+    errorMessage.clear();
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION sourceInfo{};
+    BY_HANDLE_FILE_INFORMATION destinationInfo{};
+    const DWORD shareMode = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+    HANDLE existingFile =
+        CreateFileA(destinationPath.c_str(), 0, shareMode, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (existingFile != INVALID_HANDLE_VALUE)
+    {
+        const bool sameFile =
+            GetFileInformationByHandle(reinterpret_cast<HANDLE>(source.nativeHandle()), &sourceInfo) &&
+            GetFileInformationByHandle(existingFile, &destinationInfo) &&
+            sourceInfo.dwVolumeSerialNumber == destinationInfo.dwVolumeSerialNumber &&
+            sourceInfo.nFileIndexHigh == destinationInfo.nFileIndexHigh &&
+            sourceInfo.nFileIndexLow == destinationInfo.nFileIndexLow;
+        CloseHandle(existingFile);
+        if (sameFile)
+        {
+            setError("Cannot export to the file that is exported: " + destinationPath);
+            return false;
+        }
+    }
+
+    destinationHandle = CreateFileA(destinationPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (destinationHandle == INVALID_HANDLE_VALUE)
+    {
+        destinationHandle = nullptr;
+        setError("Cannot create file: " + destinationPath);
+        return false;
+    }
+#else
+    // The file is truncated only once it is known to be another file than the source
+    destinationDescriptor = open(destinationPath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (destinationDescriptor < 0)
+    {
+        setError("Cannot create file: " + destinationPath + " (" + std::strerror(errno) + ")");
+        return false;
+    }
+    struct stat sourceStat{};
+    struct stat destinationStat{};
+    if (fstat(static_cast<int>(source.nativeHandle()), &sourceStat) == 0 &&
+        fstat(destinationDescriptor, &destinationStat) == 0 && sourceStat.st_dev == destinationStat.st_dev &&
+        sourceStat.st_ino == destinationStat.st_ino)
+    {
+        setError("Cannot export to the file that is exported: " + destinationPath);
+        closeDestination();
+        return false;
+    }
+    if (ftruncate(destinationDescriptor, 0) != 0)
+    {
+        setError("Cannot create file: " + destinationPath + " (" + std::strerror(errno) + ")");
+        closeDestination();
+        return false;
+    }
+#endif
+    return true;
+}
+
+void FileExporter::closeDestination()
+{
+#ifdef _WIN32
+    if (destinationHandle != nullptr)
+        CloseHandle(destinationHandle);
+    destinationHandle = nullptr;
+#else
+    if (destinationDescriptor >= 0 && ::close(destinationDescriptor) != 0 && errorMessage.empty())
+        setError("Cannot write to file: " + destinationPath + " (" + std::strerror(errno) + ")");
+    destinationDescriptor = -1;
+#endif
+}
+
+// Copy a range of the source file to the current position in the destination file.
+// On Linux the data is copied inside the kernel, otherwise it is written from the mapping.
+bool FileExporter::copyRange(size_t begin, const size_t end)
+{
+#ifdef __linux__
+    const int sourceDescriptor = static_cast<int>(source.nativeHandle());
+    while (begin < end)
+    {
+        auto offset = static_cast<off_t>(begin);
+        ssize_t copied = copy_file_range(sourceDescriptor, &offset, destinationDescriptor, nullptr, end - begin, 0);
+        if (copied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+        {
+            // copy_file_range does not support this pair of files (e.g. different file systems)
+            offset = static_cast<off_t>(begin);
+            copied = sendfile(destinationDescriptor, sourceDescriptor, &offset, end - begin);
+            if (copied < 0 && (errno == EINVAL || errno == ENOSYS))
+            {
+                return writeFromMapping(begin, end);
+            }
+        }
+        if (copied < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (copied <= 0)
+        {
+            setError("Cannot write to file: " + destinationPath + " (" + std::strerror(errno) + ")");
+            return false;
+        }
+        begin += static_cast<size_t>(copied);
+    }
+    return true;
+#else
+    return writeFromMapping(begin, end);
+#endif
+}
+
+bool FileExporter::writeFromMapping(size_t begin, const size_t end)
+{
+    const char* data = source.data();
+    source.touch(begin, end);
+    while (begin < end)
+    {
+#ifdef _WIN32
+        DWORD written = 0;
+        const DWORD toWrite = static_cast<DWORD>(end - begin);
+        if (!WriteFile(destinationHandle, data + begin, toWrite, &written, nullptr) || written == 0)
+        {
+            setError("Cannot write to file: " + destinationPath);
+            return false;
+        }
+#else
+        const ssize_t written = write(destinationDescriptor, data + begin, end - begin);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            setError("Cannot write to file: " + destinationPath + " (" + std::strerror(errno) + ")");
+            return false;
+        }
+#endif
+        begin += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void FileExporter::reportProgress(const size_t bytesWritten, const size_t bytesTotal) const
+{
+    if (progressCallback)
+    {
+        progressCallback(bytesWritten, bytesTotal);
+    }
+}
+
+void FileExporter::setError(const std::string& message)
+{
+    if (errorMessage.empty())
+    {
+        errorMessage = message;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "MappedFile.hpp"
+#include "TextEncoding.hpp"
+
+#include <functional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <utility>
+
+// Writes parts of a mapped file to another file without building a copy in memory.
+// Contiguous ranges are copied by the kernel (copy_file_range / sendfile) and sets of
+// lines are written straight from the mapping with batched scatter-gather writes.
+// Both functions are blocking and meant to be run on a background thread.
+class FileExporter
+{
+public:
+    // Receives the number of bytes written so far and the total number of bytes to write.
+    using ProgressCallback = std::function<void(size_t, size_t)>;
+
+    FileExporter(const MappedFile& source, std::string destinationPath);
+
+    void onProgress(ProgressCallback callback);
+
+    // Encoding of the source, lines are terminated with a newline in it. UTF-8 by default.
+    void setEncoding(TextEncoding encoding);
+
+    // Export bytes [begin, end) of the source file.
+    bool exportRange(size_t begin, size_t end, std::stop_token stopToken);
+
+    // Export the given lines, each terminated with a newline character.
+    // Lines are pairs of begin and end offsets, without the newline character.
+    bool exportLines(std::span<const std::pair<size_t, size_t>> lines, std::stop_token stopToken);
+
+    const std::string& getErrorMessage() const;
+
+private:
+    bool openDestination();
+    void closeDestination();
+    bool copyRange(size_t begin, size_t end);
+    bool writeFromMapping(size_t begin, size_t end);
+    void reportProgress(size_t bytesWritten, size_t bytesTotal) const;
+    void setError(const std::string& message);
+
+    const MappedFile& source;
+    std::string destinationPath;
+    std::string errorMessage;
+    ProgressCallback progressCallback;
+    std::string newline = "\n";
+
+#ifdef _WIN32
+    void* destinationHandle = nullptr;
+#else
+    int destinationDescriptor = -1;
+#endif
+};
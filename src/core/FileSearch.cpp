@@ -0,0 +1,329 @@
+#include "FileSearch.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+#ifdef LOGVIEWER_ZLIB
+#include <cstring>
+#include <zlib.h>
+#endif
+
+namespace
+{
+// Mapped files are scanned in chunks of one memory window
+constexpr size_t SEARCH_CHUNK_SIZE = MappedFile::WINDOW_SIZE;
+
+// Amount of decompressed data scanned at once in compressed files
+constexpr size_t DECOMPRESSED_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// Matching lines found in a part of a file. Lines are counted from the beginning of the part.
+struct ChunkHits
+{
+    size_t newlines = 0;
+    size_t matchingLines = 0;
+    size_t firstLine = 0;
+    size_t lastLine = 0;
+    std::vector<size_t> lines; // at most MAX_HITS_PER_FILE
+
+    void add(const size_t line)
+    {
+        if (matchingLines == 0)
+        {
+            firstLine = line;
+        }
+        lastLine = line;
+        matchingLines++;
+        if (lines.size() < FileSearch::MAX_HITS_PER_FILE)
+        {
+            lines.push_back(line);
+        }
+    }
+};
+
+// Find lines with a match of the text beginning in [begin, end). The data is searched until scanEnd,
+// so that matches crossing the end of the range are found. Newlines are counted from countFrom,
+// a match beginning before it belongs to the first line. The text must not contain newlines.
+void scanChunk(const char* data, const size_t begin, const size_t end, const size_t scanEnd, const size_t countFrom,
+               const std::string_view text, ChunkHits& hits)
+{
+    const std::string_view range(data, scanEnd);
+    size_t countedUntil = countFrom;
+    size_t line = 0;
+    size_t pos = range.find(text, begin);
+    while (pos != std::string_view::npos && pos < end)
+    {
+        if (pos > countedUntil)
+        {
+            line += std::count(data + countedUntil, data + pos, '\n');
+            countedUntil = pos;
+        }
+        hits.add(line);
+
+        // Other matches in the same line do not add anything
+        const size_t newline = range.find('\n', pos + text.size());
+        if (newline == std::string_view::npos || newline >= end)
+        {
+            break;
+        }
+        line++;
+        countedUntil = newline + 1;
+        pos = range.find(text, countedUntil);
+    }
+    if (countedUntil < end)
+    {
+        line += std::count(data + countedUntil, data + end, '\n');
+    }
+    hits.newlines = line;
+}
+
+// Joins the hits of consecutive parts of a file. A line crossing the border of two parts
+// can match in both of them, it is counted once.
+class ResultBuilder
+{
+public:
+    explicit ResultBuilder(FileSearchResult& result) : result(result)
+    {
+    }
+
+    void add(const ChunkHits& hits)
+    {
+        if (hits.matchingLines > 0)
+        {
+            const bool continuesLastHit = hasLastHit && lastHit == lineOffset + hits.firstLine;
+            result.matchingLines += hits.matchingLines - (continuesLastHit ? 1 : 0);
+            for (const size_t line : hits.lines)
+            {
+                if (result.lineIndices.size() < FileSearch::MAX_HITS_PER_FILE &&
+                    (result.lineIndices.empty() || result.lineIndices.back() != lineOffset + line))
+                {
+                    result.lineIndices.push_back(lineOffset + line);
+                }
+            }
+            lastHit = lineOffset + hits.lastLine;
+            hasLastHit = true;
+        }
+        lineOffset += hits.newlines;
+    }
+
+private:
+    FileSearchResult& result;
+    size_t lineOffset = 0;
+    size_t lastHit = 0;
+    bool hasLastHit = false;
+};
+
+// A file whose chunks are being scanned. It is mapped when its first chunk is scanned,
+// so that only the files being searched hold a descriptor.
+struct FileState
+{
+    std::string path;
+    bool compressed = false;
+    size_t size = 0; // when the search started
+    std::once_flag opened;
+    std::unique_ptr<MappedFile> file;
+    std::vector<ChunkHits> chunks;
+    std::atomic<size_t> remainingChunks{0};
+};
+
+// A chunk of a mapped file or a whole compressed file
+struct WorkItem
+{
+    size_t fileIndex;
+    size_t chunkIndex;
+};
+} // namespace
+
+FileSearch::FileSearch(TaskScheduler& scheduler) : scheduler(scheduler)
+{
+}
+
+void FileSearch::onResult(ResultCallback callback)
+{
+    resultCallback = std::move(callback);
+}
+
+bool FileSearch::search(const std::vector<std::string>& paths, const std::string_view text,
+                        std::stop_token stopToken) const
+{
+    auto report = [this](const FileSearchResult& result) {
+        if (resultCallback)
+        {
+            resultCallback(result);
+        }
+    };
+
+    // Compressed files go first, they are the longest tasks
+    std::vector<FileState> files(paths.size());
+    std::vector<WorkItem> items;
+    for (size_t fileIndex = 0; fileIndex < paths.size(); fileIndex++)
+    {
+        if (isCompressed(paths[fileIndex]))
+        {
+            files[fileIndex].path = paths[fileIndex];
+            files[fileIndex].compressed = true;
+            items.push_back({fileIndex, 0});
+        }
+    }
+    for (size_t fileIndex = 0; fileIndex < paths.size(); fileIndex++)
+    {
+        FileState& state = files[fileIndex];
+        if (isCompressed(paths[fileIndex]))
+        {
+            continue;
+        }
+        state.path = paths[fileIndex];
+
+        // A file that cannot be read gets one chunk, which reports the error of opening it
+        std::error_code error;
+        state.size = std::filesystem::file_size(state.path, error);
+        if (error)
+        {
+            state.size = 0;
+        }
+        if ((state.size == 0 && !error) || text.empty() || text.find('\n') != std::string_view::npos)
+        {
+            FileSearchResult result;
+            result.path = state.path;
+            report(result);
+            continue;
+        }
+        const size_t numberOfChunks = error ? 1 : (state.size + SEARCH_CHUNK_SIZE - 1) / SEARCH_CHUNK_SIZE;
+        state.chunks.resize(numberOfChunks);
+        state.remainingChunks = numberOfChunks;
+        for (size_t chunkIndex = 0; chunkIndex < numberOfChunks; chunkIndex++)
+        {
+            items.push_back({fileIndex, chunkIndex});
+        }
+    }
+
+    scheduler.parallelFor(items.size(), 1, TaskPriority::Background, stopToken, [&](size_t begin, size_t, size_t) {
+        const auto [fileIndex, chunkIndex] = items[begin];
+        FileState& state = files[fileIndex];
+        if (state.compressed)
+        {
+            const FileSearchResult result = searchCompressedFile(state.path, text, stopToken);
+            if (!stopToken.stop_requested())
+            {
+                report(result);
+            }
+            return;
+        }
+
+        std::call_once(state.opened, [&] {
+            state.file = std::make_unique<MappedFile>(state.path);
+
+            // Every runner reads one window at a time, and the overlap of a chunk may reach into the next window
+            state.file->setMemoryBudget(2 * scheduler.getMaxConcurrency() * MappedFile::WINDOW_SIZE);
+        });
+
+        // Data appended after the search started is not searched, the chunks cover the size known then
+        const char* data = state.file->data();
+        const size_t size = std::min(state.size, state.file->size());
+        if (state.file->isOpen())
+        {
+            const size_t chunkBegin = std::min(size, chunkIndex * SEARCH_CHUNK_SIZE);
+            const size_t chunkEnd = std::min(size, chunkBegin + SEARCH_CHUNK_SIZE);
+            const size_t scanEnd = std::min(size, chunkEnd + text.size() - 1);
+            state.file->touch(chunkBegin, scanEnd);
+            scanChunk(data, chunkBegin, chunkEnd, scanEnd, chunkBegin, text, state.chunks[chunkIndex]);
+        }
+
+        // The last chunk of the file completes its result
+        if (state.remainingChunks.fetch_sub(1) != 1)
+        {
+            return;
+        }
+        FileSearchResult result;
+        result.path = state.path;
+        result.bytesSearched = size;
+        result.errorMessage = state.file->getErrorMessage();
+        ResultBuilder builder(result);
+        for (const ChunkHits& hits : state.chunks)
+        {
+            builder.add(hits);
+        }
+        state.chunks = {};
+        state.file.reset();
+        if (!stopToken.stop_requested())
+        {
+            report(result);
+        }
+    });
+    return !stopToken.stop_requested();
+}
+
+FileSearchResult FileSearch::searchCompressedFile(const std::string& path, const std::string_view text,
+                                                  std::stop_token stopToken) const
+{
+    FileSearchResult result;
+    result.path = path;
+#ifdef LOGVIEWER_ZLIB
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        result.errorMessage = "Cannot open file: " + path;
+        return result;
+    }
+    gzbuffer(file, 256 * 1024);
+
+    // The end of the previous block is kept in front of the next one, so that matches crossing them are found
+    const size_t overlap = text.empty() ? 0 : text.size() - 1;
+    std::vector<char> buffer(overlap + DECOMPRESSED_BLOCK_SIZE);
+    size_t kept = 0;
+    ResultBuilder builder(result);
+    while (!stopToken.stop_requested() && !text.empty() && text.find('\n') == std::string_view::npos)
+    {
+        const int bytesRead = gzread(file, buffer.data() + kept, static_cast<unsigned>(DECOMPRESSED_BLOCK_SIZE));
+        if (bytesRead < 0)
+        {
+            int errorNumber = 0;
+            result.errorMessage = "Cannot decompress file: " + path + " (" + gzerror(file, &errorNumber) + ")";
+            break;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+
+        const size_t size = kept + static_cast<size_t>(bytesRead);
+        ChunkHits hits;
+        scanChunk(buffer.data(), 0, size, size, kept, text, hits);
+        builder.add(hits);
+        result.bytesSearched += static_cast<size_t>(bytesRead);
+
+        const size_t newKept = std::min(size, overlap);
+        std::memmove(buffer.data(), buffer.data() + size - newKept, newKept);
+        kept = newKept;
+    }
+    gzclose(file);
+#else
+    (void)text;
+    (void)stopToken;
+    result.errorMessage = "Compressed files are not supported in this build";
+#endif
+    return result;
+}
+
+std::vector<std::string> FileSearch::listFiles(const std::string& directory)
+{
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.is_regular_file(error))
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool FileSearch::isCompressed(const std::string& path)
+{
+    return path.ends_with(".gz");
+}
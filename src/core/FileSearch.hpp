@@ -0,0 +1,53 @@
+#pragma once
+#include "TaskScheduler.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FileSearchResult
+{
+    std::string path;
+    size_t matchingLines = 0;        // Number of lines containing the text
+    std::vector<size_t> lineIndices; // The first MAX_HITS_PER_FILE of them
+    size_t bytesSearched = 0;
+    std::string errorMessage;
+};
+
+// Searches many files for plain text at once, e.g. a directory of rotated logs.
+// All files are split into chunks that are scanned in parallel on the task scheduler, one chunk per task.
+// A file is mapped when its first chunk is scanned and unmapped as soon as all its chunks are scanned,
+// and every file keeps a memory budget, so the open files and the memory in flight stay bounded no matter
+// how many files are searched.
+// Compressed files (.gz) are decompressed as a stream through a fixed buffer by a single task each.
+// They are supported only in builds with zlib (LOGVIEWER_ZLIB).
+class FileSearch
+{
+public:
+    static constexpr size_t MAX_HITS_PER_FILE = 1000;
+
+    // Receives the result of every file as soon as the file is searched. Called from worker threads.
+    using ResultCallback = std::function<void(const FileSearchResult&)>;
+
+    explicit FileSearch(TaskScheduler& scheduler);
+
+    void onResult(ResultCallback callback);
+
+    // Returns false if the search was cancelled. Matches never span more than one line.
+    bool search(const std::vector<std::string>& paths, std::string_view text, std::stop_token stopToken) const;
+
+    // Paths of the regular files in the directory, sorted by name.
+    static std::vector<std::string> listFiles(const std::string& directory);
+
+    static bool isCompressed(const std::string& path);
+
+private:
+    FileSearchResult searchCompressedFile(const std::string& path, std::string_view text,
+                                          std::stop_token stopToken) const;
+
+    TaskScheduler& scheduler;
+    ResultCallback resultCallback;
+};
@@ -0,0 +1,501 @@
+#include "LineIndex.hpp"
+#include "TaskScheduler.hpp"
+#include "Utf8.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LOGVIEWER_SSE2 1
+#endif
+
+namespace
+{
+// Amount of data scanned for newlines by one task
+constexpr size_t SCAN_CHUNK_SIZE = 8 * 1024 * 1024;
+
+// Number of lines validated as UTF-8 and summarized by one task
+constexpr size_t VALIDATION_CHUNK_LINES = 64 * 1024;
+static_assert(VALIDATION_CHUNK_LINES % BlockSummaries::LINES_PER_BLOCK == 0, "Blocks are summarized by one task");
+
+// Bytes hashed at both ends of the data to recognize it when the index is loaded
+constexpr size_t FINGERPRINT_SAMPLE_SIZE = 64 * 1024;
+
+constexpr char FILE_MAGIC[8] = {'L', 'V', 'L', 'I', 'N', 'E', 'S', '\0'};
+constexpr uint32_t FILE_VERSION = 1;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    uint64_t dataSize;
+    uint64_t fingerprint;
+    uint64_t numberOfLines;
+    uint64_t numberOfInvalidChunks;
+};
+
+uint64_t hashBytes(uint64_t hash, const void* bytes, const size_t size)
+{
+    const auto* p = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t computeFingerprint(const char* data, const size_t size)
+{
+    const size_t sampleSize = std::min(size, FINGERPRINT_SAMPLE_SIZE);
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, &size, sizeof(size));
+    hash = hashBytes(hash, data, sampleSize);
+    hash = hashBytes(hash, data + size - sampleSize, sampleSize);
+    return hash;
+}
+
+// Amount of data announced to the access callback at once
+constexpr size_t ACCESS_BLOCK_SIZE = 16 * 1024 * 1024;
+
+// Result of scanning a part of the text.
+// A segment is a part of a line within the scanned range, there is one more segment than newlines.
+struct ScannedRange
+{
+    std::vector<size_t> newlines;
+    std::vector<uint8_t> segmentHasNonAscii;
+};
+
+// Scan [begin, end) continuing the segment of the previous block
+void scanBlock(const char* data, const size_t begin, const size_t end, ScannedRange& result, bool& segmentNonAscii)
+{
+    size_t pos = begin;
+
+#ifdef LOGVIEWER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - pos >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        auto newlineMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        auto nonAsciiMask = static_cast<unsigned>(_mm_movemask_epi8(chunk));
+
+        while (newlineMask != 0)
+        {
+            const int bit = std::countr_zero(newlineMask);
+            const unsigned bytesBeforeNewline = (1u << bit) - 1;
+            segmentNonAscii |= (nonAsciiMask & bytesBeforeNewline) != 0;
+            nonAsciiMask &= ~bytesBeforeNewline;
+
+            result.newlines.push_back(pos + bit);
+            result.segmentHasNonAscii.push_back(segmentNonAscii);
+            segmentNonAscii = false;
+            newlineMask &= newlineMask - 1;
+        }
+        segmentNonAscii |= nonAsciiMask != 0;
+        pos += 16;
+    }
+#endif
+
+    for (; pos < end; pos++)
+    {
+        const char c = data[pos];
+        if (c == '\n')
+        {
+            result.newlines.push_back(pos);
+            result.segmentHasNonAscii.push_back(segmentNonAscii);
+            segmentNonAscii = false;
+        }
+        else if (static_cast<unsigned char>(c) >= 0x80)
+        {
+            segmentNonAscii = true;
+        }
+    }
+}
+
+void scanRange(const char* data, const size_t begin, const size_t end, ScannedRange& result,
+               const LineIndex::AccessCallback& onAccess)
+{
+    bool segmentNonAscii = false;
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += ACCESS_BLOCK_SIZE)
+    {
+        const size_t blockEnd = std::min(end, blockBegin + ACCESS_BLOCK_SIZE);
+        if (onAccess)
+        {
+            onAccess(blockBegin, blockEnd);
+        }
+        scanBlock(data, blockBegin, blockEnd, result, segmentNonAscii);
+    }
+    result.segmentHasNonAscii.push_back(segmentNonAscii);
+}
+
+// Call function(begin, end) for chunks of [0, size), on the scheduler if there is one
+template <typename Function>
+void forEachChunk(TaskScheduler* scheduler, const size_t size, const size_t chunkSize, std::stop_token stopToken,
+                  Function function)
+{
+    if (scheduler == nullptr)
+    {
+        for (size_t begin = 0; begin < size && !stopToken.stop_requested(); begin += chunkSize)
+        {
+            function(begin, std::min(size, begin + chunkSize));
+        }
+        return;
+    }
+    scheduler->parallelFor(size, chunkSize, TaskPriority::Background, stopToken,
+                           [&function](size_t begin, size_t end, size_t) { function(begin, end); });
+}
+} // namespace
+
+bool LineIndex::build(const char* data, const size_t size, TaskScheduler* scheduler, const AccessCallback& onAccess,
+                      std::stop_token stopToken, const TextEncoding encoding)
+{
+    clear();
+    this->data = data;
+    this->encoding = encoding;
+    const size_t begin = encoding == TextEncoding::Utf8 ? 0 : getByteOrderMarkSize({data, size}, encoding);
+    if (!indexLines(begin, size, scheduler, onAccess, stopToken))
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool LineIndex::extend(const char* data, const size_t size, TaskScheduler* scheduler, const AccessCallback& onAccess,
+                       std::stop_token stopToken)
+{
+    if (lines.empty() || data != this->data || size < dataSize)
+    {
+        return build(data, size, scheduler, onAccess, stopToken, encoding);
+    }
+
+    // The last line may continue in the appended data, so it is indexed again
+    const size_t oldSize = dataSize;
+    const auto lastLine = lines.back();
+    const uint8_t lastLineFlags = lineFlags.back();
+    lines.pop_back();
+    lineFlags.pop_back();
+    if (!indexLines(lastLine.first, size, scheduler, onAccess, stopToken))
+    {
+        lines.push_back(lastLine);
+        lineFlags.push_back(lastLineFlags);
+        dataSize = oldSize;
+        blockSummaries.resize(lines.size());
+        return false;
+    }
+    return true;
+}
+
+bool LineIndex::indexLines(const size_t begin, const size_t size, TaskScheduler* scheduler,
+                           const AccessCallback& onAccess, std::stop_token stopToken)
+{
+    const size_t firstLine = lines.size();
+
+    // Find newlines and non-ASCII bytes in parallel
+    std::vector<ScannedRange> ranges((size - begin + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE);
+    forEachChunk(scheduler, size - begin, SCAN_CHUNK_SIZE, stopToken, [&](size_t rangeBegin, size_t rangeEnd) {
+        scanRange(data, begin + rangeBegin, begin + rangeEnd, ranges[rangeBegin / SCAN_CHUNK_SIZE], onAccess);
+    });
+    if (stopToken.stop_requested())
+    {
+        return false;
+    }
+
+    // Merge the ranges. A line may consist of segments from many ranges.
+    size_t numberOfLines = firstLine + 1;
+    for (const auto& range : ranges)
+    {
+        numberOfLines += range.newlines.size();
+    }
+    lines.reserve(numberOfLines);
+    lineFlags.reserve(numberOfLines);
+
+    // A UTF-16 newline is a whole code unit, other bytes 0x0A are parts of other characters.
+    // Lines of UTF-16 are never ASCII.
+    const bool utf16 = getCodeUnitSize(encoding) == 2;
+    const bool bigEndian = encoding == TextEncoding::Utf16Be;
+    const auto isNewline = [&](size_t pos) {
+        if (!utf16)
+        {
+            return true;
+        }
+        if (bigEndian)
+        {
+            return pos % 2 == 1 && data[pos - 1] == '\0';
+        }
+        return pos % 2 == 0 && pos + 1 < size && data[pos + 1] == '\0';
+    };
+
+    size_t lineBegin = begin;
+    bool lineNonAscii = utf16;
+    for (auto& range : ranges)
+    {
+        for (size_t i = 0; i < range.newlines.size(); i++)
+        {
+            const size_t newline = range.newlines[i];
+            lineNonAscii |= range.segmentHasNonAscii[i] != 0;
+            if (!isNewline(newline))
+            {
+                continue;
+            }
+            const size_t lineEnd = bigEndian ? newline - 1 : newline;
+            lines.emplace_back(lineBegin, lineEnd);
+            lineFlags.push_back(lineNonAscii ? NON_ASCII : 0);
+            lineBegin = utf16 && !bigEndian ? newline + 2 : newline + 1;
+            lineNonAscii = utf16;
+        }
+        lineNonAscii |= range.segmentHasNonAscii.back() != 0;
+        range = {}; // free memory early
+    }
+
+    // The last line ends at the end of data. It is empty if data ends with a newline.
+    lines.emplace_back(lineBegin, size);
+    lineFlags.push_back(lineNonAscii ? NON_ASCII : 0);
+    dataSize = size;
+
+    // Summarize blocks of lines and validate UTF-8 only in lines that are not pure ASCII.
+    // The chunks start at the block of the first new line, so that no two tasks add lines to the same block.
+    const size_t firstChunkLine = firstLine - firstLine % BlockSummaries::LINES_PER_BLOCK;
+    const size_t numberOfChunkLines = lines.size() - firstChunkLine;
+    std::vector<std::vector<size_t>> invalidChunks((numberOfChunkLines + VALIDATION_CHUNK_LINES - 1) /
+                                                   VALIDATION_CHUNK_LINES);
+    blockSummaries.resize(lines.size());
+    forEachChunk(scheduler, numberOfChunkLines, VALIDATION_CHUNK_LINES, stopToken, [&](size_t first, size_t last) {
+        auto& invalidInChunk = invalidChunks[first / VALIDATION_CHUNK_LINES];
+        size_t accessedEnd = 0;
+        for (size_t lineIndex = std::max(firstLine, firstChunkLine + first); lineIndex < firstChunkLine + last;
+             lineIndex++)
+        {
+            const auto [lineBegin, lineEnd] = lines[lineIndex];
+            if (onAccess && lineEnd > accessedEnd)
+            {
+                accessedEnd = std::max(lineEnd, lineBegin + ACCESS_BLOCK_SIZE);
+                onAccess(lineBegin, accessedEnd);
+            }
+            const std::string_view lineText = getLineText(lineIndex);
+            blockSummaries.addLine(lineIndex, lineText);
+            if ((lineFlags[lineIndex] & NON_ASCII) == 0 || encoding != TextEncoding::Utf8)
+            {
+                continue;
+            }
+            const size_t invalidOffset = findInvalidUtf8(lineText);
+            if (invalidOffset != std::string_view::npos)
+            {
+                lineFlags[lineIndex] |= INVALID_UTF8;
+                invalidInChunk.push_back((lines[lineIndex].first + invalidOffset) / CHUNK_SIZE);
+            }
+        }
+    });
+    if (stopToken.stop_requested())
+    {
+        lines.resize(firstLine);
+        lineFlags.resize(firstLine);
+        return false;
+    }
+
+    // A line indexed again reports the same chunks as before
+    for (const auto& chunks : invalidChunks)
+    {
+        invalidUtf8Chunks.insert(invalidUtf8Chunks.end(), chunks.begin(), chunks.end());
+    }
+    invalidUtf8Chunks.erase(std::unique(invalidUtf8Chunks.begin(), invalidUtf8Chunks.end()), invalidUtf8Chunks.end());
+    return true;
+}
+
+void LineIndex::clear()
+{
+    data = nullptr;
+    dataSize = 0;
+    encoding = TextEncoding::Utf8;
+    lines.clear();
+    lineFlags.clear();
+    invalidUtf8Chunks.clear();
+    blockSummaries.reset(0);
+}
+
+bool LineIndex::save(const std::string& path) const
+{
+    // Write to a temporary file first, so that a half-written index is never loaded
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        FileHeader header{};
+        std::copy(std::begin(FILE_MAGIC), std::end(FILE_MAGIC), header.magic);
+        header.version = FILE_VERSION;
+        header.encoding = static_cast<uint32_t>(encoding);
+        header.dataSize = dataSize;
+        header.fingerprint = computeFingerprint(data, dataSize);
+        header.numberOfLines = lines.size();
+        header.numberOfInvalidChunks = invalidUtf8Chunks.size();
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(lines.data()),
+                     static_cast<std::streamsize>(lines.size() * sizeof(lines[0])));
+        output.write(reinterpret_cast<const char*>(lineFlags.data()), static_cast<std::streamsize>(lineFlags.size()));
+        output.write(reinterpret_cast<const char*>(invalidUtf8Chunks.data()),
+                     static_cast<std::streamsize>(invalidUtf8Chunks.size() * sizeof(size_t)));
+        blockSummaries.write(output);
+        if (!output)
+        {
+            output.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str()); // rename does not replace files on Windows
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool LineIndex::load(const std::string& path, const char* data, const size_t size)
+{
+    std::ifstream input(path, std::ios::binary);
+    FileHeader header{};
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !std::equal(std::begin(FILE_MAGIC), std::end(FILE_MAGIC), header.magic) || header.version != FILE_VERSION ||
+        header.encoding > static_cast<uint32_t>(TextEncoding::Windows1250) || header.dataSize != size ||
+        header.numberOfLines == 0 || header.numberOfLines > size + 1 ||
+        header.numberOfInvalidChunks > size / CHUNK_SIZE + 1 || header.fingerprint != computeFingerprint(data, size))
+    {
+        return false;
+    }
+
+    std::vector<std::pair<size_t, size_t>> loadedLines(header.numberOfLines);
+    std::vector<uint8_t> loadedFlags(header.numberOfLines);
+    std::vector<size_t> loadedChunks(header.numberOfInvalidChunks);
+    BlockSummaries loadedSummaries;
+    input.read(reinterpret_cast<char*>(loadedLines.data()),
+               static_cast<std::streamsize>(loadedLines.size() * sizeof(loadedLines[0])));
+    input.read(reinterpret_cast<char*>(loadedFlags.data()), static_cast<std::streamsize>(loadedFlags.size()));
+    input.read(reinterpret_cast<char*>(loadedChunks.data()),
+               static_cast<std::streamsize>(loadedChunks.size() * sizeof(size_t)));
+    if (!input || !loadedSummaries.read(input, loadedLines.size()) || loadedLines.back().second != size)
+    {
+        return false;
+    }
+
+    this->data = data;
+    dataSize = size;
+    encoding = static_cast<TextEncoding>(header.encoding);
+    lines = std::move(loadedLines);
+    lineFlags = std::move(loadedFlags);
+    invalidUtf8Chunks = std::move(loadedChunks);
+    blockSummaries = std::move(loadedSummaries);
+    return true;
+}
+
+std::string LineIndex::getIndexPath(const std::string& logPath)
+{
+    return logPath + ".lines";
+}
+
+size_t LineIndex::getMemoryUsage() const
+{
+    return lines.capacity() * sizeof(lines[0]) + lineFlags.capacity() + invalidUtf8Chunks.capacity() * sizeof(size_t) +
+           blockSummaries.getMemoryUsage();
+}
+
+const std::vector<std::pair<size_t, size_t>>& LineIndex::getLines() const
+{
+    return lines;
+}
+
+size_t LineIndex::size() const
+{
+    return lines.size();
+}
+
+bool LineIndex::empty() const
+{
+    return lines.empty();
+}
+
+const std::pair<size_t, size_t>& LineIndex::operator[](const size_t lineIndex) const
+{
+    return lines[lineIndex];
+}
+
+std::string_view LineIndex::getLineText(const size_t lineIndex) const
+{
+    const auto [lineBegin, lineEnd] = lines[lineIndex];
+    return {data + lineBegin, lineEnd - lineBegin};
+}
+
+TextEncoding LineIndex::getEncoding() const
+{
+    return encoding;
+}
+
+bool LineIndex::isAsciiLine(const size_t lineIndex) const
+{
+    return (lineFlags[lineIndex] & NON_ASCII) == 0;
+}
+
+bool LineIndex::hasInvalidUtf8(const size_t lineIndex) const
+{
+    return (lineFlags[lineIndex] & INVALID_UTF8) != 0;
+}
+
+const std::vector<size_t>& LineIndex::getInvalidUtf8Chunks() const
+{
+    return invalidUtf8Chunks;
+}
+
+size_t LineIndex::findLine(const size_t offset) const
+{
+    return findLine(lines, offset);
+}
+
+size_t LineIndex::findLine(const std::vector<std::pair<size_t, size_t>>& lines, const size_t offset)
+{
+    const auto it = std::upper_bound(lines.begin(), lines.end(), offset,
+                                     [](size_t value, const auto& line) { return value < line.first; });
+    return it == lines.begin() ? 0 : static_cast<size_t>(it - lines.begin() - 1);
+}
+
+const BlockSummaries& LineIndex::getBlockSummaries() const
+{
+    return blockSummaries;
+}
+
+size_t LineIndex::getColumn(const size_t lineIndex, const size_t offsetInLine) const
+{
+    if (isAsciiLine(lineIndex) || (encoding != TextEncoding::Utf8 && getCodeUnitSize(encoding) == 1))
+    {
+        return offsetInLine;
+    }
+    const std::string_view line = getLineText(lineIndex);
+    if (encoding == TextEncoding::Utf8)
+    {
+        return countCodePoints(line.substr(0, std::min(offsetInLine, line.size())));
+    }
+    size_t column = 0;
+    for (size_t offset = 0; offset < offsetInLine && offset < line.size(); column++)
+    {
+        decodeCharacter(line, offset, encoding);
+    }
+    return column;
+}
+
+size_t LineIndex::getOffsetInLine(const size_t lineIndex, const size_t column) const
+{
+    if (isAsciiLine(lineIndex) || (encoding != TextEncoding::Utf8 && getCodeUnitSize(encoding) == 1))
+    {
+        return column;
+    }
+    const std::string_view line = getLineText(lineIndex);
+    if (encoding == TextEncoding::Utf8)
+    {
+        return offsetOfCodePoint(line, column);
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < column && offset < line.size(); i++)
+    {
+        decodeCharacter(line, offset, encoding);
+    }
+    return offset;
+}
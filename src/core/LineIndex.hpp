@@ -0,0 +1,102 @@
+#pragma once
+#include "BlockSummaries.hpp"
+#include "TextEncoding.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class TaskScheduler;
+
+// Positions of all lines in the text together with a few bits of information about each line.
+// The index is built on the task scheduler: the text is split into chunks that are scanned for newlines
+// and non-ASCII bytes 16 bytes at a time. Only lines with non-ASCII bytes are validated as UTF-8
+// afterwards, pure ASCII lines (the vast majority of logs) keep the byte-based fast path.
+// The same pass summarizes the tokens of every block of lines, so that searches can skip blocks.
+// Text in other encodings is indexed in its original bytes: a UTF-16 newline must be a whole code unit,
+// the byte order mark is not a part of the first line and the lines are not validated as UTF-8.
+class LineIndex
+{
+public:
+    // Size of a chunk of text for which invalid UTF-8 is reported
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    // Called with a range of data before it is read. It may be called from many threads at once.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    // Without a scheduler the index is built on the calling thread.
+    // Returns false and leaves the index empty if the build was cancelled.
+    bool build(const char* data, size_t size, TaskScheduler* scheduler, const AccessCallback& onAccess = {},
+               std::stop_token stopToken = {}, TextEncoding encoding = TextEncoding::Utf8);
+
+    // Index the data appended after the indexed data, e.g. text that keeps arriving from a pipe.
+    // The data must not have moved and keeps its encoding. Only the last line (which may continue) and the new lines
+    // are scanned.
+    // Returns false and keeps the previous index if cancelled.
+    bool extend(const char* data, size_t size, TaskScheduler* scheduler, const AccessCallback& onAccess = {},
+                std::stop_token stopToken = {});
+    void clear();
+
+    // Save the index next to the log, e.g. when the log is put aside and its memory is needed elsewhere.
+    // load() rejects the file if the data has changed since. The data must stay where it was loaded.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path, const char* data, size_t size);
+
+    // Path of the file with the line index of the given log.
+    static std::string getIndexPath(const std::string& logPath);
+
+    size_t getMemoryUsage() const;
+
+    // Pairs of line begin and end offsets, without the newline character.
+    const std::vector<std::pair<size_t, size_t>>& getLines() const;
+
+    size_t size() const;
+    bool empty() const;
+    const std::pair<size_t, size_t>& operator[](size_t lineIndex) const;
+
+    // Text of the line in the encoding of the data
+    std::string_view getLineText(size_t lineIndex) const;
+    TextEncoding getEncoding() const;
+
+    // Index of the line containing the byte offset, found with a binary search. A newline character belongs
+    // to the line it ends and offsets past the end of data belong to the last line.
+    size_t findLine(size_t offset) const;
+    static size_t findLine(const std::vector<std::pair<size_t, size_t>>& lines, size_t offset);
+
+    bool isAsciiLine(size_t lineIndex) const;
+    bool hasInvalidUtf8(size_t lineIndex) const;
+
+    // Indices of chunks (of CHUNK_SIZE bytes) containing invalid UTF-8, in ascending order.
+    const std::vector<size_t>& getInvalidUtf8Chunks() const;
+
+    const BlockSummaries& getBlockSummaries() const;
+
+    // Convert between a byte offset within a line and a character (code point) column.
+    size_t getColumn(size_t lineIndex, size_t offsetInLine) const;
+    size_t getOffsetInLine(size_t lineIndex, size_t column) const;
+
+private:
+    // Add the lines of data [begin, size) after the indexed ones, begin is the beginning of a line.
+    // Returns false and adds no lines if cancelled.
+    bool indexLines(size_t begin, size_t size, TaskScheduler* scheduler, const AccessCallback& onAccess,
+                    std::stop_token stopToken);
+
+    enum LineFlags : uint8_t
+    {
+        NON_ASCII = 1 << 0,
+        INVALID_UTF8 = 1 << 1,
+    };
+
+    const char* data = nullptr;
+    size_t dataSize = 0;
+    TextEncoding encoding = TextEncoding::Utf8;
+    std::vector<std::pair<size_t, size_t>> lines;
+    std::vector<uint8_t> lineFlags;
+    std::vector<size_t> invalidUtf8Chunks;
+    BlockSummaries blockSummaries;
+};
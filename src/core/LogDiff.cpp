@@ -0,0 +1,565 @@
+#include "LogDiff.hpp"
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <optional>
+
+namespace
+{
+// Number of lines normalized and hashed by one task
+constexpr size_t HASH_CHUNK_LINES = 64 * 1024;
+
+// The search for the middle snake gives up after this many differences. A limit growing with the size
+// of the logs makes very different logs take minutes instead of seconds, for a slightly smaller diff.
+constexpr int64_t COST_LIMIT = 256;
+
+// Upper limit of the size of the bitmap of hashes of the other log, 128 MiB
+constexpr size_t MAX_FILTER_BITS = size_t{1} << 30;
+
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+uint64_t rotateLeft(const uint64_t value, const int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t read64(const char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t read32(const char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t xxHashRound(uint64_t accumulator, const uint64_t input)
+{
+    accumulator += input * PRIME64_2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * PRIME64_1;
+}
+
+uint64_t xxHashMergeRound(uint64_t accumulator, const uint64_t value)
+{
+    accumulator ^= xxHashRound(0, value);
+    return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+// XXH64 with seed 0, reading the input in the native byte order
+uint64_t xxHash64(const std::string_view text)
+{
+    const char* p = text.data();
+    const char* const end = p + text.size();
+    uint64_t hash;
+    if (text.size() >= 32)
+    {
+        uint64_t v1 = PRIME64_1 + PRIME64_2;
+        uint64_t v2 = PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - PRIME64_1;
+        do
+        {
+            v1 = xxHashRound(v1, read64(p));
+            v2 = xxHashRound(v2, read64(p + 8));
+            v3 = xxHashRound(v3, read64(p + 16));
+            v4 = xxHashRound(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = xxHashMergeRound(hash, v1);
+        hash = xxHashMergeRound(hash, v2);
+        hash = xxHashMergeRound(hash, v3);
+        hash = xxHashMergeRound(hash, v4);
+    }
+    else
+    {
+        hash = PRIME64_5;
+    }
+    hash += text.size();
+
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= xxHashRound(0, read64(p));
+        hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        hash ^= static_cast<unsigned char>(*p) * PRIME64_5;
+        hash = rotateLeft(hash, 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+bool isDigit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool isHexLetter(const char c)
+{
+    return (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool isTokenCharacter(const char c)
+{
+    return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+// "0x7ffd5e3c", "deadbeef01" or "3f2a9c" but neither "123456" (a number) nor "facade" (a word)
+bool isHexId(const std::string_view token)
+{
+    auto isHexDigit = [](char c) { return isDigit(c) || isHexLetter(c); };
+    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+    {
+        return std::all_of(token.begin() + 2, token.end(), isHexDigit);
+    }
+    return token.size() >= 6 && std::all_of(token.begin(), token.end(), isHexDigit) &&
+           std::any_of(token.begin(), token.end(), isDigit) && std::any_of(token.begin(), token.end(), isHexLetter);
+}
+
+void appendNormalized(const std::string_view line, const DiffMasks& masks, std::string& output)
+{
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        if (!isTokenCharacter(line[pos]))
+        {
+            output += line[pos++];
+            continue;
+        }
+
+        size_t timestampLength = 0;
+        if (masks.timestamps && isDigit(line[pos]) && parseTimestamp(line.substr(pos), &timestampLength) &&
+            timestampLength > 0)
+        {
+            output += "<time>";
+            pos += timestampLength;
+            continue;
+        }
+
+        size_t tokenEnd = pos;
+        while (tokenEnd < line.size() && isTokenCharacter(line[tokenEnd]))
+        {
+            tokenEnd++;
+        }
+        const std::string_view token = line.substr(pos, tokenEnd - pos);
+        pos = tokenEnd;
+        if (masks.hexIds && isHexId(token))
+        {
+            output += "<hex>";
+            continue;
+        }
+        if (!masks.numbers)
+        {
+            output += token;
+            continue;
+        }
+
+        // Every run of digits is masked, also in tokens like "12ms" or "worker7"
+        for (size_t i = 0; i < token.size();)
+        {
+            if (!isDigit(token[i]))
+            {
+                output += token[i++];
+                continue;
+            }
+            while (i < token.size() && isDigit(token[i]))
+            {
+                i++;
+            }
+            output += "<num>";
+        }
+    }
+}
+
+// Point of the edit graph of left[0, n) and right[0, m) where an optimal path crosses the middle diagonal,
+// found by running Myers' algorithm from both ends until the paths overlap. After costLimit differences
+// the point furthest from its end is taken instead. Returns nothing if no point splits the problem.
+std::optional<std::pair<int64_t, int64_t>> findMiddleSnake(const uint64_t* left, const int64_t n, const uint64_t* right,
+                                                           const int64_t m, const int64_t costLimit,
+                                                           std::vector<int64_t>& forward,
+                                                           std::vector<int64_t>& backward,
+                                                           const std::stop_token& stopToken)
+{
+    // Furthest x on every diagonal k = x - y, from the beginning (forward) and from the end (backward)
+    const int64_t maxCost = std::min(costLimit, (n + m + 1) / 2);
+    const int64_t offset = maxCost + 1;
+    forward.assign(2 * maxCost + 3, -1);
+    backward.assign(2 * maxCost + 3, -1);
+    forward[offset + 1] = 0;
+    backward[offset + 1] = 0;
+
+    const int64_t delta = n - m;
+    const bool forwardChecksOverlap = delta % 2 != 0;
+    int64_t forwardStart = 0, forwardEnd = 0, backwardStart = 0, backwardEnd = 0;
+    for (int64_t d = 0; d < maxCost; d++)
+    {
+        if (d % 256 == 0 && stopToken.stop_requested())
+        {
+            return std::nullopt;
+        }
+
+        for (int64_t k = -d + forwardStart; k <= d - forwardEnd; k += 2)
+        {
+            const int64_t index = offset + k;
+            int64_t x = k == -d || (k != d && forward[index - 1] < forward[index + 1]) ? forward[index + 1]
+                                                                                        : forward[index - 1] + 1;
+            int64_t y = x - k;
+            while (x < n && y < m && left[x] == right[y])
+            {
+                x++;
+                y++;
+            }
+            forward[index] = x;
+            if (x > n)
+            {
+                forwardEnd += 2; // ran off the right of the graph
+            }
+            else if (y > m)
+            {
+                forwardStart += 2; // ran off the bottom of the graph
+            }
+            else if (forwardChecksOverlap)
+            {
+                const int64_t backwardIndex = offset + delta - k;
+                if (backwardIndex >= 0 && backwardIndex < static_cast<int64_t>(backward.size()) &&
+                    backward[backwardIndex] != -1 && x >= n - backward[backwardIndex])
+                {
+                    return std::make_pair(x, y);
+                }
+            }
+        }
+
+        for (int64_t k = -d + backwardStart; k <= d - backwardEnd; k += 2)
+        {
+            const int64_t index = offset + k;
+            int64_t x = k == -d || (k != d && backward[index - 1] < backward[index + 1]) ? backward[index + 1]
+                                                                                          : backward[index - 1] + 1;
+            int64_t y = x - k;
+            while (x < n && y < m && left[n - x - 1] == right[m - y - 1])
+            {
+                x++;
+                y++;
+            }
+            backward[index] = x;
+            if (x > n)
+            {
+                backwardEnd += 2;
+            }
+            else if (y > m)
+            {
+                backwardStart += 2;
+            }
+            else if (!forwardChecksOverlap)
+            {
+                const int64_t forwardIndex = offset + delta - k;
+                if (forwardIndex >= 0 && forwardIndex < static_cast<int64_t>(forward.size()) &&
+                    forward[forwardIndex] != -1 && forward[forwardIndex] >= n - x)
+                {
+                    const int64_t forwardX = forward[forwardIndex];
+                    return std::make_pair(forwardX, forwardX - (forwardIndex - offset));
+                }
+            }
+        }
+    }
+
+    // Too expensive: split at the point that got furthest from its end
+    std::optional<std::pair<int64_t, int64_t>> best;
+    int64_t bestProgress = 0;
+    for (int64_t k = -maxCost; k <= maxCost; k++)
+    {
+        const int64_t x = forward[offset + k];
+        const int64_t y = x - k;
+        if (x >= 0 && x <= n && y >= 0 && y <= m && x + y > bestProgress && x + y < n + m)
+        {
+            bestProgress = x + y;
+            best = std::make_pair(x, y);
+        }
+        const int64_t backwardX = backward[offset + k];
+        const int64_t backwardY = backwardX - k;
+        if (backwardX >= 0 && backwardX <= n && backwardY >= 0 && backwardY <= m &&
+            backwardX + backwardY > bestProgress && backwardX + backwardY < n + m)
+        {
+            bestProgress = backwardX + backwardY;
+            best = std::make_pair(n - backwardX, m - backwardY);
+        }
+    }
+    return best;
+}
+
+// Indices of the lines whose hash may occur among the other hashes according to a bitmap of them.
+// The bitmap has false positives, they only make the diff search a little longer.
+std::vector<uint32_t> findLinesWithPossibleMatch(const std::vector<uint64_t>& hashes,
+                                                 const std::vector<uint64_t>& otherHashes)
+{
+    size_t bits = 64;
+    while (bits < otherHashes.size() * 8 && bits < MAX_FILTER_BITS)
+    {
+        bits <<= 1;
+    }
+    std::vector<uint64_t> bitmap(bits / 64);
+    for (const uint64_t hash : otherHashes)
+    {
+        const size_t bit = hash & (bits - 1);
+        bitmap[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    std::vector<uint32_t> lineIndices;
+    for (size_t i = 0; i < hashes.size(); i++)
+    {
+        const size_t bit = hashes[i] & (bits - 1);
+        if ((bitmap[bit / 64] >> (bit % 64) & 1) != 0)
+        {
+            lineIndices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return lineIndices;
+}
+
+std::vector<uint64_t> selectHashes(const std::vector<uint64_t>& hashes, const std::vector<uint32_t>& lineIndices)
+{
+    std::vector<uint64_t> selected;
+    selected.reserve(lineIndices.size());
+    for (const uint32_t lineIndex : lineIndices)
+    {
+        selected.push_back(hashes[lineIndex]);
+    }
+    return selected;
+}
+
+// Line of the other log next to the given line. The members select the sides of the hunks to map from and to.
+size_t mapLine(const std::vector<DiffHunk>& hunks, const size_t line, size_t DiffHunk::*fromBegin,
+               size_t DiffHunk::*fromEnd, size_t DiffHunk::*toBegin, size_t DiffHunk::*toEnd)
+{
+    const auto next = std::upper_bound(hunks.begin(), hunks.end(), line,
+                                       [&](size_t value, const DiffHunk& hunk) { return value < hunk.*fromBegin; });
+    if (next == hunks.begin())
+    {
+        return line;
+    }
+    const DiffHunk& hunk = *std::prev(next);
+    if (line < hunk.*fromEnd)
+    {
+        const size_t otherSize = hunk.*toEnd - hunk.*toBegin;
+        return hunk.*toBegin + std::min(line - hunk.*fromBegin, otherSize > 0 ? otherSize - 1 : 0);
+    }
+    return line - hunk.*fromEnd + hunk.*toEnd;
+}
+} // namespace
+
+LogDiff::LogDiff(TaskScheduler& scheduler, const DiffMasks masks) : scheduler(scheduler), masks(masks)
+{
+}
+
+bool LogDiff::compare(const LineIndex& leftLines, const LineIndex& rightLines, std::stop_token stopToken,
+                      const LineIndex::AccessCallback& onLeftAccess, const LineIndex::AccessCallback& onRightAccess)
+{
+    hunks.clear();
+    const std::vector<uint64_t> left = hashLines(leftLines, onLeftAccess, stopToken);
+    const std::vector<uint64_t> right = hashLines(rightLines, onRightAccess, stopToken);
+    if (stopToken.stop_requested())
+    {
+        return false;
+    }
+
+    // Lines without an equal line in the other log are differences anyway, the search skips them.
+    // Logs of different runs have many such lines, e.g. messages with unique IDs.
+    const std::vector<uint32_t> leftCandidates = findLinesWithPossibleMatch(left, right);
+    const std::vector<uint32_t> rightCandidates = findLinesWithPossibleMatch(right, left);
+    diff(selectHashes(left, leftCandidates), selectHashes(right, rightCandidates), stopToken);
+    if (stopToken.stop_requested())
+    {
+        hunks.clear();
+        return false;
+    }
+    restoreLineIndices(leftCandidates, rightCandidates, left.size(), right.size());
+    return true;
+}
+
+const std::vector<DiffHunk>& LogDiff::getHunks() const
+{
+    return hunks;
+}
+
+size_t LogDiff::getRemovedLines() const
+{
+    size_t removedLines = 0;
+    for (const DiffHunk& hunk : hunks)
+    {
+        removedLines += hunk.leftEnd - hunk.leftBegin;
+    }
+    return removedLines;
+}
+
+size_t LogDiff::getAddedLines() const
+{
+    size_t addedLines = 0;
+    for (const DiffHunk& hunk : hunks)
+    {
+        addedLines += hunk.rightEnd - hunk.rightBegin;
+    }
+    return addedLines;
+}
+
+size_t LogDiff::mapLeftToRight(const std::vector<DiffHunk>& hunks, const size_t leftLine)
+{
+    return mapLine(hunks, leftLine, &DiffHunk::leftBegin, &DiffHunk::leftEnd, &DiffHunk::rightBegin,
+                   &DiffHunk::rightEnd);
+}
+
+size_t LogDiff::mapRightToLeft(const std::vector<DiffHunk>& hunks, const size_t rightLine)
+{
+    return mapLine(hunks, rightLine, &DiffHunk::rightBegin, &DiffHunk::rightEnd, &DiffHunk::leftBegin,
+                   &DiffHunk::leftEnd);
+}
+
+std::string LogDiff::normalize(const std::string_view line, const DiffMasks& masks)
+{
+    std::string output;
+    appendNormalized(line, masks, output);
+    return output;
+}
+
+std::vector<uint64_t> LogDiff::hashLines(const LineIndex& lines, const LineIndex::AccessCallback& onAccess,
+                                         std::stop_token stopToken) const
+{
+    std::vector<uint64_t> hashes(lines.size());
+    std::vector<std::string> buffers(scheduler.getMaxConcurrency());
+    scheduler.parallelFor(lines.size(), HASH_CHUNK_LINES, TaskPriority::Background, stopToken,
+                          [&](size_t begin, size_t end, size_t runner) {
+                              std::string& buffer = buffers[runner];
+                              if (onAccess)
+                              {
+                                  onAccess(lines[begin].first, lines[end - 1].second);
+                              }
+                              for (size_t i = begin; i < end; i++)
+                              {
+                                  buffer.clear();
+                                  appendNormalized(lines.getLineText(i), masks, buffer);
+                                  hashes[i] = xxHash64(buffer);
+                              }
+                          });
+    return hashes;
+}
+
+// Divide and conquer on the middle snakes with an explicit stack. The parts are processed from the beginning
+// of the logs, so the hunks come out in order.
+void LogDiff::diff(const std::vector<uint64_t>& left, const std::vector<uint64_t>& right, std::stop_token stopToken)
+{
+    struct Part
+    {
+        size_t leftBegin, leftEnd, rightBegin, rightEnd;
+    };
+
+    std::vector<int64_t> forward;
+    std::vector<int64_t> backward;
+    std::vector<Part> parts{{0, left.size(), 0, right.size()}};
+    while (!parts.empty() && !stopToken.stop_requested())
+    {
+        Part part = parts.back();
+        parts.pop_back();
+
+        // Common lines at both ends are not a part of any difference
+        while (part.leftBegin < part.leftEnd && part.rightBegin < part.rightEnd &&
+               left[part.leftBegin] == right[part.rightBegin])
+        {
+            part.leftBegin++;
+            part.rightBegin++;
+        }
+        while (part.leftBegin < part.leftEnd && part.rightBegin < part.rightEnd &&
+               left[part.leftEnd - 1] == right[part.rightEnd - 1])
+        {
+            part.leftEnd--;
+            part.rightEnd--;
+        }
+        if (part.leftBegin == part.leftEnd || part.rightBegin == part.rightEnd)
+        {
+            addHunk(part.leftBegin, part.leftEnd, part.rightBegin, part.rightEnd);
+            continue;
+        }
+
+        const auto split = findMiddleSnake(left.data() + part.leftBegin, part.leftEnd - part.leftBegin,
+                                           right.data() + part.rightBegin, part.rightEnd - part.rightBegin, COST_LIMIT,
+                                           forward, backward, stopToken);
+        if (!split)
+        {
+            addHunk(part.leftBegin, part.leftEnd, part.rightBegin, part.rightEnd);
+            continue;
+        }
+        const size_t leftSplit = part.leftBegin + static_cast<size_t>(split->first);
+        const size_t rightSplit = part.rightBegin + static_cast<size_t>(split->second);
+        parts.push_back({leftSplit, part.leftEnd, rightSplit, part.rightEnd});
+        parts.push_back({part.leftBegin, leftSplit, part.rightBegin, rightSplit});
+    }
+}
+
+// Turn the hunks of the candidate lines into hunks of all lines. Every pair of candidate lines outside
+// of the hunks is a pair of equal lines, the rest of the lines is different.
+void LogDiff::restoreLineIndices(const std::vector<uint32_t>& leftCandidates,
+                                 const std::vector<uint32_t>& rightCandidates, const size_t leftSize,
+                                 const size_t rightSize)
+{
+    const std::vector<DiffHunk> candidateHunks = std::move(hunks);
+    hunks.clear();
+    size_t leftLine = 0;
+    size_t rightLine = 0;
+    size_t leftCandidate = 0;
+    size_t rightCandidate = 0;
+    auto addEqualLines = [&](const size_t leftEnd) {
+        for (; leftCandidate < leftEnd; leftCandidate++, rightCandidate++)
+        {
+            const size_t leftEqual = leftCandidates[leftCandidate];
+            const size_t rightEqual = rightCandidates[rightCandidate];
+            addHunk(leftLine, leftEqual, rightLine, rightEqual);
+            leftLine = leftEqual + 1;
+            rightLine = rightEqual + 1;
+        }
+    };
+    for (const DiffHunk& hunk : candidateHunks)
+    {
+        addEqualLines(hunk.leftBegin);
+        leftCandidate = hunk.leftEnd;
+        rightCandidate = hunk.rightEnd;
+    }
+    addEqualLines(leftCandidates.size());
+    addHunk(leftLine, leftSize, rightLine, rightSize);
+}
+
+// Adjacent hunks are joined into one
+void LogDiff::addHunk(const size_t leftBegin, const size_t leftEnd, const size_t rightBegin, const size_t rightEnd)
+{
+    if (leftBegin == leftEnd && rightBegin == rightEnd)
+    {
+        return;
+    }
+    if (!hunks.empty() && hunks.back().leftEnd == leftBegin && hunks.back().rightEnd == rightBegin)
+    {
+        hunks.back().leftEnd = leftEnd;
+        hunks.back().rightEnd = rightEnd;
+        return;
+    }
+    hunks.push_back({leftBegin, leftEnd, rightBegin, rightEnd});
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "LineIndex.hpp"
+#include "TaskScheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parts of lines that differ between runs of the same program and are ignored by the diff
+struct DiffMasks
+{
+    bool timestamps = true; // e.g. 2024-01-15T10:20:30.123Z
+    bool numbers = true;    // runs of digits, e.g. PIDs, thread IDs, counters and durations
+    bool hexIds = true;     // tokens of at least 6 hex digits with a digit among them or with 0x, e.g. addresses
+};
+
+// Lines [leftBegin, leftEnd) of the left log were replaced with lines [rightBegin, rightEnd) of the right log.
+// One of the ranges is empty for pure removals and additions.
+struct DiffHunk
+{
+    size_t leftBegin, leftEnd;
+    size_t rightBegin, rightEnd;
+};
+
+// Compares two logs line by line, ignoring the masked parts of the lines.
+// Every line is normalized and hashed (xxHash64) in parallel, the diff runs on the hashes only.
+// Lines without an equal line in the other log are left out of the search, like in GNU diff.
+// The diff is Myers' linear space algorithm, so the memory used is proportional to the number of lines.
+// Very different logs would make it quadratic, so the search for the middle snake gives up after
+// a fixed number of differences and splits the logs at the furthest point reached, like GNU diff does.
+class LogDiff
+{
+public:
+    LogDiff(TaskScheduler& scheduler, DiffMasks masks);
+
+    // Returns false if the comparison was cancelled. The callbacks receive ranges of the logs before they are read.
+    bool compare(const LineIndex& leftLines, const LineIndex& rightLines, std::stop_token stopToken,
+                 const LineIndex::AccessCallback& onLeftAccess = {},
+                 const LineIndex::AccessCallback& onRightAccess = {});
+
+    const std::vector<DiffHunk>& getHunks() const;
+    size_t getRemovedLines() const;
+    size_t getAddedLines() const;
+
+    // Line of one log displayed next to the given line of the other one
+    static size_t mapLeftToRight(const std::vector<DiffHunk>& hunks, size_t leftLine);
+    static size_t mapRightToLeft(const std::vector<DiffHunk>& hunks, size_t rightLine);
+
+    // The line with masked parts replaced with placeholders, e.g. "<time> pid=<num> ptr=<hex>"
+    static std::string normalize(std::string_view line, const DiffMasks& masks);
+
+private:
+    std::vector<uint64_t> hashLines(const LineIndex& lines, const LineIndex::AccessCallback& onAccess,
+                                    std::stop_token stopToken) const;
+    void diff(const std::vector<uint64_t>& left, const std::vector<uint64_t>& right, std::stop_token stopToken);
+    void restoreLineIndices(const std::vector<uint32_t>& leftCandidates, const std::vector<uint32_t>& rightCandidates,
+                            size_t leftSize, size_t rightSize);
+    void addHunk(size_t leftBegin, size_t leftEnd, size_t rightBegin, size_t rightEnd);
+
+    TaskScheduler& scheduler;
+    DiffMasks masks;
+    std::vector<DiffHunk> hunks;
+};
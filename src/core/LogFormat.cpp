@@ -0,0 +1,89 @@
+#include "LogFormat.hpp"
+
+namespace
+{
+// log4j and logback: 2024-01-15 10:20:30,123 [main] INFO  com.example.App - Started
+using Log4jExtractor = CompiledFormatExtractor<"{ts:iso8601} [{thread}] {level} {logger} - {msg}">;
+
+// Python logging: 2024-01-15 10:20:30,123 - app.db - WARNING - Slow query
+using PythonExtractor = CompiledFormatExtractor<"{ts:iso8601} - {logger} - {level} - {msg}">;
+
+// 2024-01-15T10:20:30.123Z [ERROR] [worker-3] Connection lost
+using BracketedThreadExtractor = CompiledFormatExtractor<"{ts:iso8601} [{level}] [{thread}] {msg}">;
+
+// 2024-01-15T10:20:30.123Z [ERROR] Connection lost
+using BracketedLevelExtractor = CompiledFormatExtractor<"{ts:iso8601} [{level}] {msg}">;
+
+// 2024-01-15T10:20:30.123Z ERROR Connection lost
+using PlainLevelExtractor = CompiledFormatExtractor<"{ts:iso8601} {level} {msg}">;
+} // namespace
+
+std::unique_ptr<FormatFieldExtractor> FormatFieldExtractor::create(std::string format, std::string& errorMessage)
+{
+    std::string_view error;
+    if (format.empty() || !parseFormat(format, [](const FormatPiece&) {}, &error))
+    {
+        errorMessage = format.empty() ? "The format is empty" : std::string(error);
+        return nullptr;
+    }
+    return std::unique_ptr<FormatFieldExtractor>(new FormatFieldExtractor(std::move(format)));
+}
+
+FormatFieldExtractor::FormatFieldExtractor(std::string format) : format(std::move(format))
+{
+    parseFormat(this->format, [this](const FormatPiece& piece) { pieces.push_back(piece); });
+}
+
+std::string_view FormatFieldExtractor::getName() const
+{
+    return format;
+}
+
+bool FormatFieldExtractor::extract(std::string_view line, std::vector<Field>& fields) const
+{
+    const size_t fieldsBefore = fields.size();
+    const char* p = line.data();
+    const char* end = line.data() + line.size();
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        const FormatPiece& piece = pieces[i];
+        const bool last = i + 1 == pieces.size();
+        const std::string_view nextLiteral = last ? std::string_view() : pieces[i + 1].literal;
+        bool matched = false;
+        if (piece.name.empty())
+        {
+            matched = matchLiteral(piece.literal, p, end);
+        }
+        else if (piece.type == FormatFieldType::Timestamp)
+        {
+            matched = matchFormatPiece<FormatFieldType::Timestamp>(piece, nextLiteral, last, p, end, fields);
+        }
+        else if (piece.type == FormatFieldType::Level)
+        {
+            matched = matchFormatPiece<FormatFieldType::Level>(piece, nextLiteral, last, p, end, fields);
+        }
+        else
+        {
+            matched = matchFormatPiece<FormatFieldType::Text>(piece, nextLiteral, last, p, end, fields);
+        }
+
+        if (!matched)
+        {
+            fields.resize(fieldsBefore);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::unique_ptr<FieldExtractor>> createBuiltInFormatExtractors()
+{
+    // The more specific formats go first
+    std::vector<std::unique_ptr<FieldExtractor>> extractors;
+    extractors.push_back(std::make_unique<Log4jExtractor>());
+    extractors.push_back(std::make_unique<PythonExtractor>());
+    extractors.push_back(std::make_unique<BracketedThreadExtractor>());
+    extractors.push_back(std::make_unique<BracketedLevelExtractor>());
+    extractors.push_back(std::make_unique<PlainLevelExtractor>());
+    return extractors;
+}
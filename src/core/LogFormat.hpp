@@ -0,0 +1,291 @@
+#pragma once
+#include "FieldExtractor.hpp"
+#include "LogLevel.hpp"
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Format descriptors describe plain-text logs, e.g. "{ts:iso8601} [{level}] {thread} {msg}".
+// Every {name} or {name:type} placeholder becomes a field, the text between placeholders must be in the line.
+// A space matches any run of spaces and tabs, so padded columns match as well.
+// Types of placeholders:
+//   {name:iso8601}  a timestamp, e.g. 2024-01-15T10:20:30.123Z or 2024-01-15 10:20:30,123
+//   {name:level}    a level word, e.g. INFO or warn. A placeholder named "level" has this type by default.
+//   {name}          text up to the text after the placeholder, or the rest of the line if it is the last one.
+//                   It must not be followed directly by another placeholder.
+enum class FormatFieldType
+{
+    Text,
+    Timestamp,
+    Level
+};
+
+// Literal text of a format followed by a placeholder. The last piece of a format may have no placeholder.
+struct FormatPiece
+{
+    std::string_view literal;
+    std::string_view name;
+    FormatFieldType type = FormatFieldType::Text;
+};
+
+// Split the format into pieces, calling onPiece for each of them.
+// Returns false with a description of the problem if the format is not valid.
+template <typename PieceCallback>
+constexpr bool parseFormat(std::string_view format, PieceCallback onPiece, std::string_view* errorMessage = nullptr)
+{
+    const auto fail = [errorMessage](std::string_view message) {
+        if (errorMessage != nullptr)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    bool afterText = false;
+    while (!format.empty())
+    {
+        FormatPiece piece;
+        const size_t open = std::min(format.find('{'), format.size());
+        piece.literal = format.substr(0, open);
+        format.remove_prefix(open);
+        if (format.empty())
+        {
+            onPiece(piece);
+            break;
+        }
+        if (afterText && piece.literal.empty())
+        {
+            return fail("A placeholder without a type must be followed by text");
+        }
+
+        const size_t close = format.find('}');
+        if (close == std::string_view::npos)
+        {
+            return fail("Missing }");
+        }
+        std::string_view placeholder = format.substr(1, close - 1);
+        format.remove_prefix(close + 1);
+
+        const size_t colon = std::min(placeholder.find(':'), placeholder.size());
+        piece.name = placeholder.substr(0, colon);
+        const std::string_view type = placeholder.substr(std::min(colon + 1, placeholder.size()));
+        if (piece.name.empty() || piece.name.find('{') != std::string_view::npos)
+        {
+            return fail("A placeholder has no name");
+        }
+        if (type == "iso8601")
+        {
+            piece.type = FormatFieldType::Timestamp;
+        }
+        else if (type == "level" || (type.empty() && piece.name == "level"))
+        {
+            piece.type = FormatFieldType::Level;
+        }
+        else if (!type.empty() && type != "text")
+        {
+            return fail("Unknown placeholder type, expected iso8601, level or text");
+        }
+        afterText = piece.type == FormatFieldType::Text;
+        onPiece(piece);
+    }
+    return true;
+}
+
+constexpr size_t countFormatPieces(const std::string_view format)
+{
+    size_t count = 0;
+    parseFormat(format, [&count](const FormatPiece&) { count++; });
+    return count;
+}
+
+inline bool isFormatSpace(const char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Match the literal text at p and move p past it
+inline bool matchLiteral(const std::string_view literal, const char*& p, const char* end)
+{
+    const char* q = p;
+    for (const char c : literal)
+    {
+        if (q >= end || (c == ' ' ? !isFormatSpace(*q) : *q != c))
+        {
+            return false;
+        }
+        ++q;
+        while (c == ' ' && q < end && isFormatSpace(*q))
+        {
+            ++q;
+        }
+    }
+    p = q;
+    return true;
+}
+
+// Returns the first position at or after p where the literal text matches, or end if there is none
+inline const char* findLiteral(const std::string_view literal, const char* p, const char* end)
+{
+    for (; p < end; ++p)
+    {
+        const char* q = p;
+        if ((literal.front() == ' ' ? isFormatSpace(*p) : *p == literal.front()) && matchLiteral(literal, q, end))
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Match the literal text of the piece and its placeholder at p, add the value of the placeholder to the fields
+// and move p past it. A text placeholder ends where the literal text of the next piece begins, the last one
+// takes the rest of the line.
+template <FormatFieldType Type>
+bool matchFormatPiece(const FormatPiece& piece, const std::string_view nextLiteral, const bool last, const char*& p,
+                      const char* end, std::vector<Field>& fields)
+{
+    if (!matchLiteral(piece.literal, p, end))
+    {
+        return false;
+    }
+
+    const char* valueEnd = end;
+    if constexpr (Type == FormatFieldType::Timestamp)
+    {
+        size_t length = 0;
+        if (!parseTimestamp(std::string_view(p, static_cast<size_t>(end - p)), &length))
+        {
+            return false;
+        }
+        valueEnd = p + length;
+    }
+    else if constexpr (Type == FormatFieldType::Level)
+    {
+        valueEnd = std::find_if_not(p, end, [](char c) { return (c | 0x20) >= 'a' && (c | 0x20) <= 'z'; });
+        if (!parseLogLevel(std::string_view(p, static_cast<size_t>(valueEnd - p))))
+        {
+            return false;
+        }
+    }
+    else if (!last)
+    {
+        valueEnd = findLiteral(nextLiteral, p, end);
+        if (valueEnd == end)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        while (valueEnd > p && valueEnd[-1] == '\r')
+        {
+            --valueEnd;
+        }
+    }
+
+    fields.push_back({piece.name, {p, static_cast<size_t>(valueEnd - p)}});
+    p = valueEnd;
+    return true;
+}
+
+// The format is given as a template argument, e.g. CompiledFormatExtractor<"{ts:iso8601} {level} {msg}">
+template <size_t N> struct FormatString
+{
+    constexpr FormatString(const char (&text)[N])
+    {
+        std::copy_n(text, N, chars);
+    }
+
+    constexpr std::string_view view() const
+    {
+        return {chars, N - 1};
+    }
+
+    char chars[N]{};
+};
+
+// Parser of a format known at compile time. The format is parsed by the compiler,
+// the matching of its pieces is unrolled and specialized for the type of every placeholder.
+template <FormatString Format> class CompiledFormatExtractor : public FieldExtractor
+{
+    static_assert(parseFormat(Format.view(), [](const FormatPiece&) {}), "Invalid format");
+
+public:
+    std::string_view getName() const override
+    {
+        return Format.view();
+    }
+
+    bool extract(std::string_view line, std::vector<Field>& fields) const override
+    {
+        const size_t fieldsBefore = fields.size();
+        const char* p = line.data();
+        if (matchPieces(p, line.data() + line.size(), fields, std::make_index_sequence<PIECES.size()>()))
+        {
+            return true;
+        }
+        fields.resize(fieldsBefore);
+        return false;
+    }
+
+private:
+    static constexpr std::array<FormatPiece, countFormatPieces(Format.view())> PIECES = [] {
+        std::array<FormatPiece, countFormatPieces(Format.view())> pieces{};
+        size_t i = 0;
+        parseFormat(Format.view(), [&](const FormatPiece& piece) { pieces[i++] = piece; });
+        return pieces;
+    }();
+
+    template <size_t I> static bool matchPiece(const char*& p, const char* end, std::vector<Field>& fields)
+    {
+        constexpr FormatPiece piece = PIECES[I];
+        if constexpr (piece.name.empty())
+        {
+            return matchLiteral(piece.literal, p, end);
+        }
+        else if constexpr (I + 1 < PIECES.size())
+        {
+            return matchFormatPiece<piece.type>(piece, PIECES[I + 1].literal, false, p, end, fields);
+        }
+        else
+        {
+            return matchFormatPiece<piece.type>(piece, {}, true, p, end, fields);
+        }
+    }
+
+    template <size_t... I>
+    static bool matchPieces(const char*& p, const char* end, std::vector<Field>& fields, std::index_sequence<I...>)
+    {
+        return (matchPiece<I>(p, end, fields) && ...);
+    }
+};
+
+// Parser of a format given at run time, e.g. by the user. The pieces are interpreted for every line.
+class FormatFieldExtractor : public FieldExtractor
+{
+public:
+    // Returns nullptr and sets the error message if the format is not valid.
+    static std::unique_ptr<FormatFieldExtractor> create(std::string format, std::string& errorMessage);
+
+    FormatFieldExtractor(const FormatFieldExtractor&) = delete;
+    FormatFieldExtractor& operator=(const FormatFieldExtractor&) = delete;
+
+    std::string_view getName() const override;
+    bool extract(std::string_view line, std::vector<Field>& fields) const override;
+
+private:
+    explicit FormatFieldExtractor(std::string format);
+
+    const std::string format; // the pieces point into it
+    std::vector<FormatPiece> pieces;
+};
+
+// Parsers of the common plain-text formats, tried by detectFieldExtractor()
+std::vector<std::unique_ptr<FieldExtractor>> createBuiltInFormatExtractors();
@@ -0,0 +1,108 @@
+#include "LogLevel.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+// A level is looked for only in this many first characters of a line
+constexpr size_t LEVEL_SEARCH_LIMIT = 128;
+
+struct LevelName
+{
+    std::string_view name;
+    LogLevel level;
+};
+
+constexpr std::array LEVEL_NAMES = {
+    LevelName{"trace", LogLevel::Trace},     LevelName{"debug", LogLevel::Debug},
+    LevelName{"info", LogLevel::Info},       LevelName{"warn", LogLevel::Warning},
+    LevelName{"warning", LogLevel::Warning}, LevelName{"error", LogLevel::Error},
+    LevelName{"err", LogLevel::Error},       LevelName{"fatal", LogLevel::Fatal},
+    LevelName{"critical", LogLevel::Fatal},  LevelName{"crit", LogLevel::Fatal},
+};
+
+char toLower(const char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool isLetter(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool equalsIgnoreCase(std::string_view text, std::string_view lowercase)
+{
+    return text.size() == lowercase.size() &&
+           std::equal(text.begin(), text.end(), lowercase.begin(), [](char a, char b) { return toLower(a) == b; });
+}
+} // namespace
+
+std::string_view toString(const LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Trace:
+        return "TRACE";
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warning:
+        return "WARN";
+    case LogLevel::Error:
+        return "ERROR";
+    case LogLevel::Fatal:
+        return "FATAL";
+    }
+    return "";
+}
+
+std::optional<LogLevel> parseLogLevel(std::string_view text)
+{
+    for (const auto& [name, level] : LEVEL_NAMES)
+    {
+        if (equalsIgnoreCase(text, name))
+        {
+            return level;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<LogLevel> findLogLevel(std::string_view line)
+{
+    const size_t searchEnd = std::min(line.size(), LEVEL_SEARCH_LIMIT);
+    size_t pos = 0;
+    while (pos < searchEnd)
+    {
+        // Check every word made of letters only
+        while (pos < searchEnd && !isLetter(line[pos]))
+        {
+            pos++;
+        }
+        const size_t wordBegin = pos;
+        while (pos < searchEnd && isLetter(line[pos]))
+        {
+            pos++;
+        }
+
+        const std::string_view word = line.substr(wordBegin, pos - wordBegin);
+        if (word.size() >= 3 && word.size() <= 8)
+        {
+            // Lowercase words are levels only if they look like one: [info] or level=info
+            const bool isUppercase = word[0] >= 'A' && word[0] <= 'Z';
+            const char before = wordBegin > 0 ? line[wordBegin - 1] : ' ';
+            const bool isMarked = before == '[' || before == '=' || before == '<';
+            if (isUppercase || isMarked)
+            {
+                if (auto level = parseLogLevel(word))
+                {
+                    return level;
+                }
+            }
+        }
+    }
+    return std::nullopt;
+}
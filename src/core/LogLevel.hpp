@@ -0,0 +1,22 @@
+#pragma once
+#include <optional>
+#include <string_view>
+
+enum class LogLevel
+{
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Fatal
+};
+
+std::string_view toString(LogLevel level);
+
+// Parse a level name such as "warn", "WARNING" or "E". Case insensitive.
+std::optional<LogLevel> parseLogLevel(std::string_view text);
+
+// Find the severity of a plain-text log line by looking for a level word
+// ("ERROR", "[warn]", "level=info", ...) near the beginning of the line.
+std::optional<LogLevel> findLogLevel(std::string_view line);
@@ -0,0 +1,313 @@
+#include "MappedFile.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Windows used at the same time by the workers of the scheduler and the view should not evict each other.
+// A worker reading a chunk may also touch the beginning of the next window.
+size_t getMinResidentWindows()
+{
+    static const size_t minResidentWindows = 2 * std::max<size_t>(2, TaskScheduler::getAvailableCpus()) + 1;
+    return minResidentWindows;
+}
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) : path(path)
+{
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = nullptr;
+        errorMessage = "Cannot open file: " + path;
+        return;
+    }
+
+    LARGE_INTEGER fileSize{};
+    GetFileSizeEx(fileHandle, &fileSize);
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+
+    // Empty files cannot be mapped, but they are still valid documents
+    if (mappedSize == 0)
+    {
+        return;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+    {
+        mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mappedData == nullptr)
+    {
+        errorMessage = "Cannot map file: " + path;
+        close();
+    }
+#else
+    fileDescriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        errorMessage = "Cannot open file: " + path + " (" + std::strerror(errno) + ")";
+        return;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        errorMessage = "Not a regular file: " + path;
+        close();
+        return;
+    }
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    opened = true;
+
+    // Empty files cannot be mapped, but they are still valid documents
+    if (mappedSize == 0)
+    {
+        return;
+    }
+
+    void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED)
+    {
+        errorMessage = "Cannot map file: " + path + " (" + std::strerror(errno) + ")";
+        close();
+        return;
+    }
+    mappedData = static_cast<const char*>(mapping);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (mappedData != nullptr)
+        UnmapViewOfFile(mappedData);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mappedData != nullptr)
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+}
+
+bool MappedFile::isOpen() const
+{
+    return opened;
+}
+
+const std::string& MappedFile::getPath() const
+{
+    return path;
+}
+
+const std::string& MappedFile::getErrorMessage() const
+{
+    return errorMessage;
+}
+
+const char* MappedFile::data() const
+{
+    return mappedData;
+}
+
+size_t MappedFile::size() const
+{
+    return mappedSize;
+}
+
+intptr_t MappedFile::nativeHandle() const
+{
+#ifdef _WIN32
+    return reinterpret_cast<intptr_t>(fileHandle);
+#else
+    return fileDescriptor;
+#endif
+}
+
+void MappedFile::setMemoryBudget(const size_t bytes)
+{
+    std::vector<size_t> windows;
+    {
+        std::lock_guard lock(windowsMutex);
+        if (bytes == 0)
+        {
+            maxResidentWindows = 0;
+            residentWindows.clear();
+            residentWindowPositions.clear();
+            return;
+        }
+
+        // Pages read before, e.g. while there was no budget, are not tracked, so everything else is released
+        maxResidentWindows = std::max(getMinResidentWindows(), bytes / WINDOW_SIZE);
+        while (residentWindows.size() > maxResidentWindows)
+        {
+            residentWindowPositions.erase(residentWindows.back());
+            residentWindows.pop_back();
+        }
+        windows.assign(residentWindows.begin(), residentWindows.end());
+    }
+    releaseUntrackedMemory(std::move(windows));
+}
+
+size_t MappedFile::getMemoryBudget() const
+{
+    std::lock_guard lock(windowsMutex);
+    return maxResidentWindows * WINDOW_SIZE;
+}
+
+void MappedFile::touch(const size_t begin, size_t end) const
+{
+    end = std::min(end, mappedSize);
+    if (mappedData == nullptr || begin >= end)
+    {
+        return;
+    }
+
+    // The memory of evicted windows is released after the lock, so other readers do not wait for the system
+    std::vector<size_t> evictedWindows;
+    {
+        std::lock_guard lock(windowsMutex);
+        if (maxResidentWindows == 0)
+        {
+            return;
+        }
+        for (size_t window = begin / WINDOW_SIZE; window <= (end - 1) / WINDOW_SIZE; window++)
+        {
+            markWindowUsed(window, evictedWindows);
+        }
+    }
+    for (const size_t window : evictedWindows)
+    {
+        releaseWindow(window);
+    }
+}
+
+void MappedFile::prefetch(const size_t begin, size_t end) const
+{
+    end = std::min(end, mappedSize);
+    if (mappedData == nullptr || begin >= end)
+    {
+        return;
+    }
+
+    touch(begin, end);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602 // Windows 8
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<char*>(mappedData + begin), end - begin};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+    // madvise requires an address aligned to a page
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t alignedBegin = begin / pageSize * pageSize;
+    madvise(const_cast<char*>(mappedData + alignedBegin), end - alignedBegin, MADV_WILLNEED);
+#endif
+}
+
+size_t MappedFile::getPhysicalMemorySize()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status{};
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? static_cast<size_t>(status.ullTotalPhys) : 0;
+#else
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<size_t>(pages) * static_cast<size_t>(pageSize) : 0;
+#endif
+}
+
+// Move the window to the front of the LRU list. The window evicted to make room for it is added to the list.
+void MappedFile::markWindowUsed(const size_t window, std::vector<size_t>& evictedWindows) const
+{
+    const auto it = residentWindowPositions.find(window);
+    if (it != residentWindowPositions.end())
+    {
+        residentWindows.splice(residentWindows.begin(), residentWindows, it->second);
+        return;
+    }
+
+    residentWindows.push_front(window);
+    residentWindowPositions.emplace(window, residentWindows.begin());
+    if (residentWindows.size() <= maxResidentWindows)
+    {
+        return;
+    }
+
+    evictedWindows.push_back(residentWindows.back());
+    residentWindowPositions.erase(residentWindows.back());
+    residentWindows.pop_back();
+}
+
+void MappedFile::releaseWindow(const size_t window) const
+{
+    releaseRange(window * WINDOW_SIZE, (window + 1) * WINDOW_SIZE);
+#ifdef POSIX_FADV_DONTNEED
+    // Do not let the evicted data fill the page cache either
+    posix_fadvise(fileDescriptor, static_cast<off_t>(window * WINDOW_SIZE), WINDOW_SIZE, POSIX_FADV_DONTNEED);
+#endif
+}
+
+// Release the memory of all windows that are not resident. This also covers pages read by code that
+// does not call touch(), so the budget holds no matter who has read the data.
+void MappedFile::releaseUntrackedMemory(std::vector<size_t> windows) const
+{
+    std::sort(windows.begin(), windows.end());
+
+    size_t gapBegin = 0;
+    for (const size_t window : windows)
+    {
+        releaseRange(gapBegin, window * WINDOW_SIZE);
+        gapBegin = (window + 1) * WINDOW_SIZE;
+    }
+    releaseRange(gapBegin, mappedSize);
+}
+
+void MappedFile::releaseRange(const size_t begin, size_t end) const
+{
+    end = std::min(end, mappedSize);
+    if (begin >= end)
+    {
+        return;
+    }
+#ifdef _WIN32
+    // Unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(const_cast<char*>(mappedData + begin), end - begin);
+#else
+    madvise(const_cast<char*>(mappedData + begin), end - begin, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Read-only memory mapping of a whole file.
+// The mapping stays valid for the lifetime of the object, so the text can be
+// addressed with plain pointers without reading the file into memory first.
+//
+// Files bigger than RAM can be kept under a memory budget. The whole file stays mapped (it only takes
+// address space), but the memory is managed in windows of WINDOW_SIZE bytes. Readers announce the ranges
+// they read with touch(). When more windows have been touched than the budget allows, the least recently
+// used window is evicted and its memory is given back to the system. Setting a budget also gives back
+// everything outside of the resident windows. The data is read from the file again when it is accessed later.
+class MappedFile
+{
+public:
+    static constexpr size_t WINDOW_SIZE = 16 * 1024 * 1024;
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const;
+    const std::string& getPath() const;
+    const std::string& getErrorMessage() const;
+
+    const char* data() const;
+    size_t size() const;
+
+    // Native file descriptor (POSIX) or file HANDLE (Windows) of the mapped file.
+    // It allows the kernel to copy ranges of the file without touching the mapping.
+    intptr_t nativeHandle() const;
+
+    // Limit the resident memory of the mapping to the given number of bytes. 0 disables the limit.
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+
+    // Mark bytes [begin, end) as being read. Can be called from many threads.
+    void touch(size_t begin, size_t end) const;
+
+    // Ask the system to read bytes [begin, end) ahead of time. The range counts as touched.
+    void prefetch(size_t begin, size_t end) const;
+
+    // Total size of physical memory or 0 if it is unknown.
+    static size_t getPhysicalMemorySize();
+
+private:
+    void close();
+    void markWindowUsed(size_t window, std::vector<size_t>& evictedWindows) const;
+    void releaseWindow(size_t window) const;
+    void releaseUntrackedMemory(std::vector<size_t> windows) const;
+    void releaseRange(size_t begin, size_t end) const;
+
+    std::string path;
+    std::string errorMessage;
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    bool opened = false;
+
+    // Windows that may be resident, the most recently used first
+    mutable std::mutex windowsMutex;
+    mutable std::list<size_t> residentWindows;
+    mutable std::unordered_map<size_t, std::list<size_t>::iterator> residentWindowPositions;
+    size_t maxResidentWindows = 0; // 0 = no budget
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
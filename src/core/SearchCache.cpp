@@ -0,0 +1,80 @@
+#include "SearchCache.hpp"
+
+SearchCache::SearchCache(const size_t maxLines) : maxLines(maxLines)
+{
+}
+
+SearchCache::Lookup SearchCache::lookup(const std::string_view text)
+{
+    std::lock_guard lock(mutex);
+    auto best = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->text == text)
+        {
+            best = it;
+            break;
+        }
+        // Prefer the longest contained text, it usually matches the fewest lines
+        if (text.find(it->text) != std::string_view::npos &&
+            (best == entries.end() || it->lines->size() < best->lines->size()))
+        {
+            best = it;
+        }
+    }
+
+    if (best == entries.end())
+    {
+        misses++;
+        return {};
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, best);
+    return {best->lines, best->text == text};
+}
+
+void SearchCache::insert(std::string text, LineList lines)
+{
+    if (!lines || lines->size() > maxLines)
+    {
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->text == text)
+        {
+            cachedLines -= it->lines->size();
+            entries.erase(it);
+            break;
+        }
+    }
+
+    cachedLines += lines->size();
+    entries.push_front({std::move(text), std::move(lines)});
+    while (cachedLines > maxLines)
+    {
+        cachedLines -= entries.back().lines->size();
+        entries.pop_back();
+    }
+}
+
+void SearchCache::clear()
+{
+    std::lock_guard lock(mutex);
+    entries.clear();
+    cachedLines = 0;
+}
+
+size_t SearchCache::getHits() const
+{
+    std::lock_guard lock(mutex);
+    return hits;
+}
+
+size_t SearchCache::getMisses() const
+{
+    std::lock_guard lock(mutex);
+    return misses;
+}
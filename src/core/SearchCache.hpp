@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Remembers which lines contain recently searched texts.
+// A line containing a text also contains every part of it, so a query that contains a cached query
+// only has to be looked for in the lines of the cached one. Narrowing a search (timeout -> timeout db-7)
+// checks a fraction of the file instead of scanning all of it again.
+// Line indices are stored as 32-bit numbers, the display limits the number of lines to INT_MAX anyway.
+// Results are evicted, least recently used first, when the cache holds more than maxLines line indices.
+class SearchCache
+{
+public:
+    using LineList = std::shared_ptr<const std::vector<uint32_t>>;
+
+    static constexpr size_t DEFAULT_MAX_LINES = 32 * 1024 * 1024;
+
+    struct Lookup
+    {
+        LineList lines;     // empty on a miss
+        bool exact = false; // lines of the text itself, otherwise of a text it contains
+    };
+
+    explicit SearchCache(size_t maxLines = DEFAULT_MAX_LINES);
+
+    // Find the lines of the text or of the longest cached text that it contains. Counts a hit or a miss.
+    Lookup lookup(std::string_view text);
+
+    // Remember the sorted indices of lines containing the text.
+    // Results bigger than the whole cache are not remembered.
+    void insert(std::string text, LineList lines);
+
+    void clear();
+
+    size_t getHits() const;
+    size_t getMisses() const;
+
+private:
+    struct Entry
+    {
+        std::string text;
+        LineList lines;
+    };
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // the most recently used first
+    const size_t maxLines;
+    size_t cachedLines = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+};
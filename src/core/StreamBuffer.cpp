@@ -0,0 +1,188 @@
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Bytes read at once, so that readers see the text soon even when the input is fast
+constexpr size_t MAX_READ_SIZE = 1024 * 1024;
+} // namespace
+
+StreamBuffer::StreamBuffer(const size_t capacity) : capacity(capacity)
+{
+#ifdef _WIN32
+    reservedData = static_cast<char*>(VirtualAlloc(nullptr, capacity, MEM_RESERVE, PAGE_NOACCESS));
+    if (reservedData == nullptr)
+    {
+        errorMessage = "Cannot reserve memory for the input";
+    }
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void* reservation = mmap(nullptr, capacity, PROT_NONE, flags, -1, 0);
+    if (reservation == MAP_FAILED)
+    {
+        errorMessage = std::string("Cannot reserve memory for the input (") + std::strerror(errno) + ")";
+        return;
+    }
+    reservedData = static_cast<char*>(reservation);
+#endif
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    if (reservedData == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(reservedData, 0, MEM_RELEASE);
+#else
+    munmap(reservedData, capacity);
+#endif
+}
+
+bool StreamBuffer::isOpen() const
+{
+    return reservedData != nullptr;
+}
+
+const std::string& StreamBuffer::getErrorMessage() const
+{
+    return errorMessage;
+}
+
+const char* StreamBuffer::data() const
+{
+    return reservedData;
+}
+
+size_t StreamBuffer::size() const
+{
+    return dataSize.load(std::memory_order_acquire);
+}
+
+bool StreamBuffer::hasEnded() const
+{
+    return ended.load(std::memory_order_acquire);
+}
+
+bool StreamBuffer::readStandardInput(const std::chrono::milliseconds timeout)
+{
+    if (reservedData == nullptr || hasEnded())
+    {
+        return false;
+    }
+    const size_t size = dataSize.load(std::memory_order_relaxed);
+    if (size == capacity)
+    {
+        finish("The input is bigger than " + std::to_string(capacity >> 20) + " MiB, the rest is not shown");
+        return false;
+    }
+    if (size == committedSize && !commit(size + 1))
+    {
+        finish("Not enough memory for the input, the rest is not shown");
+        return false;
+    }
+    const size_t bytesToRead = std::min(committedSize - size, MAX_READ_SIZE);
+
+#ifdef _WIN32
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    const DWORD inputType = GetFileType(input);
+    if (inputType == FILE_TYPE_PIPE)
+    {
+        // Pipes cannot be waited for, a closed pipe fails to peek and ReadFile reports the end of input
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        DWORD available = 0;
+        while (PeekNamedPipe(input, nullptr, 0, nullptr, &available, nullptr) && available == 0)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return true;
+            }
+            Sleep(10);
+        }
+    }
+    else if (inputType == FILE_TYPE_CHAR &&
+             WaitForSingleObject(input, static_cast<DWORD>(timeout.count())) == WAIT_TIMEOUT)
+    {
+        return true;
+    }
+
+    DWORD bytesRead = 0;
+    const BOOL success = ReadFile(input, reservedData + size, static_cast<DWORD>(bytesToRead), &bytesRead, nullptr);
+    if (!success || bytesRead == 0)
+    {
+        const DWORD error = success ? ERROR_SUCCESS : GetLastError();
+        finish(error == ERROR_SUCCESS || error == ERROR_BROKEN_PIPE || error == ERROR_HANDLE_EOF
+                   ? std::string()
+                   : "Cannot read the standard input (error " + std::to_string(error) + ")");
+        return false;
+    }
+#else
+    pollfd input{STDIN_FILENO, POLLIN, 0};
+    const int ready = poll(&input, 1, static_cast<int>(timeout.count()));
+    if (ready == 0 || (ready < 0 && errno == EINTR))
+    {
+        return true;
+    }
+    const ssize_t bytesRead = ready < 0 ? -1 : read(STDIN_FILENO, reservedData + size, bytesToRead);
+    if (bytesRead < 0 && (errno == EINTR || errno == EAGAIN))
+    {
+        return true;
+    }
+    if (bytesRead <= 0)
+    {
+        finish(bytesRead == 0 ? std::string()
+                              : std::string("Cannot read the standard input (") + std::strerror(errno) + ")");
+        return false;
+    }
+#endif
+
+    dataSize.store(size + static_cast<size_t>(bytesRead), std::memory_order_release);
+    return true;
+}
+
+// Make the memory up to the given number of bytes writable, a whole block at a time
+bool StreamBuffer::commit(const size_t bytes)
+{
+    const size_t target = std::min(capacity, (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE);
+    if (target <= committedSize)
+    {
+        return true;
+    }
+#ifdef _WIN32
+    if (VirtualAlloc(reservedData + committedSize, target - committedSize, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+    {
+        return false;
+    }
+#else
+    if (mprotect(reservedData + committedSize, target - committedSize, PROT_READ | PROT_WRITE) != 0)
+    {
+        return false;
+    }
+#endif
+    committedSize = target;
+    return true;
+}
+
+void StreamBuffer::finish(std::string message)
+{
+    errorMessage = std::move(message);
+    ended.store(true, std::memory_order_release);
+}
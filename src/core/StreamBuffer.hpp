@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Append-only storage for text of unknown length, e.g. a log piped to the standard input.
+// The address space for the whole capacity is reserved up front and memory is committed in blocks of
+// BLOCK_SIZE as the text arrives. The text never moves, so it is addressed with plain pointers like a mapped
+// file, and growing never copies it or needs twice its size in memory, as a reallocated vector would.
+// One thread appends, any thread can read the bytes below size().
+class StreamBuffer
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024 * 1024;
+    static constexpr size_t DEFAULT_CAPACITY = sizeof(void*) >= 8 ? size_t{1} << 40 : size_t{1} << 30;
+
+    explicit StreamBuffer(size_t capacity = DEFAULT_CAPACITY);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    bool isOpen() const;
+    const std::string& getErrorMessage() const;
+
+    const char* data() const;
+
+    // Number of bytes appended so far, the bytes below it do not change any more
+    size_t size() const;
+
+    // Append what is available on the standard input, waiting for it at most for the timeout.
+    // Returns false once the input has ended, has failed or the buffer is full, see hasEnded().
+    bool readStandardInput(std::chrono::milliseconds timeout);
+    bool hasEnded() const;
+
+private:
+    bool commit(size_t bytes);
+    void finish(std::string message);
+
+    char* reservedData = nullptr;
+    size_t capacity = 0;
+    size_t committedSize = 0;
+    std::atomic<size_t> dataSize{0};
+    std::atomic<bool> ended{false};
+    std::string errorMessage; // written before ended is set
+};
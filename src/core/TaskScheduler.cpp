@@ -0,0 +1,371 @@
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <sched.h>
+#include <string>
+#endif
+
+namespace
+{
+// Scheduler and index of the worker running on the current thread
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local size_t currentWorker = 0;
+
+size_t getPriorityIndex(const TaskPriority priority)
+{
+    return priority == TaskPriority::Interactive ? 0 : 1;
+}
+
+// Chunks of a parallelFor() are claimed one by one by the calling thread and the helper tasks.
+// Helpers that start after all chunks are claimed return without touching the function.
+struct ParallelLoop
+{
+    const TaskScheduler::ChunkFunction* function;
+    std::stop_token stopToken;
+    size_t size;
+    size_t chunkSize;
+    size_t numberOfChunks;
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<size_t> nextRunner{1}; // the calling thread is runner 0
+    std::atomic<size_t> unfinishedChunks;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    void run(const size_t runnerIndex)
+    {
+        while (true)
+        {
+            const size_t chunk = nextChunk.fetch_add(1);
+            if (chunk >= numberOfChunks)
+            {
+                return;
+            }
+            if (!stopToken.stop_requested())
+            {
+                const size_t begin = chunk * chunkSize;
+                (*function)(begin, std::min(size, begin + chunkSize), runnerIndex);
+            }
+            if (unfinishedChunks.fetch_sub(1) == 1)
+            {
+                std::lock_guard lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [this] { return unfinishedChunks.load() == 0; });
+    }
+};
+
+#ifdef __linux__
+// CPU limit of the container rounded up to whole CPUs, if there is any
+std::optional<size_t> readCgroupCpuLimit()
+{
+    // cgroup v2: "<quota> <period>" or "max <period>"
+    std::ifstream cpuMax("/sys/fs/cgroup/cpu.max");
+    std::string quota;
+    long long period = 0;
+    if (cpuMax >> quota >> period)
+    {
+        const long long quotaValue = std::strtoll(quota.c_str(), nullptr, 10);
+        if (quota == "max" || quotaValue <= 0 || period <= 0)
+        {
+            return std::nullopt;
+        }
+        return static_cast<size_t>((quotaValue + period - 1) / period);
+    }
+
+    // cgroup v1: a quota of -1 means no limit
+    std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+    std::ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    long long quotaUs = 0;
+    long long periodUs = 0;
+    if (quotaFile >> quotaUs && periodFile >> periodUs && quotaUs > 0 && periodUs > 0)
+    {
+        return static_cast<size_t>((quotaUs + periodUs - 1) / periodUs);
+    }
+    return std::nullopt;
+}
+#endif
+} // namespace
+
+struct TaskHandle::State
+{
+    enum class Phase
+    {
+        Pending,
+        Running,
+        Finished,
+    };
+
+    std::stop_source stopSource;
+    std::mutex mutex;
+    std::condition_variable finished;
+    Phase phase = Phase::Pending;
+};
+
+TaskHandle::TaskHandle(std::shared_ptr<State> state) : state(std::move(state))
+{
+}
+
+TaskHandle& TaskHandle::operator=(TaskHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        requestStop();
+        wait();
+        state = std::move(other.state);
+    }
+    return *this;
+}
+
+TaskHandle::~TaskHandle()
+{
+    requestStop();
+    wait();
+}
+
+void TaskHandle::requestStop()
+{
+    if (!state)
+    {
+        return;
+    }
+    state->stopSource.request_stop();
+
+    std::lock_guard lock(state->mutex);
+    if (state->phase == State::Phase::Pending)
+    {
+        state->phase = State::Phase::Finished;
+        state->finished.notify_all();
+    }
+}
+
+void TaskHandle::wait()
+{
+    if (!state)
+    {
+        return;
+    }
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock, [this] { return state->phase == State::Phase::Finished; });
+}
+
+bool TaskHandle::hasJob() const
+{
+    return state != nullptr;
+}
+
+bool TaskHandle::isFinished() const
+{
+    if (!state)
+    {
+        return true;
+    }
+    std::lock_guard lock(state->mutex);
+    return state->phase == State::Phase::Finished;
+}
+
+TaskScheduler::TaskScheduler(size_t numberOfWorkers)
+{
+    numberOfWorkers = std::max<size_t>(2, numberOfWorkers);
+    maxBackgroundTasks = numberOfWorkers - 1;
+    for (size_t i = 0; i < numberOfWorkers; i++)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < numberOfWorkers; i++)
+    {
+        workers.emplace_back(&TaskScheduler::runWorker, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard lock(stateMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+size_t TaskScheduler::getNumberOfWorkers() const
+{
+    return workers.size();
+}
+
+size_t TaskScheduler::getMaxConcurrency() const
+{
+    return workers.size();
+}
+
+void TaskScheduler::submit(Task task, const TaskPriority priority)
+{
+    // Tasks submitted by a worker go to its own queue, the others are spread over all queues
+    const size_t queueIndex = currentScheduler == this ? currentWorker : nextQueue.fetch_add(1) % queues.size();
+    const size_t priorityIndex = getPriorityIndex(priority);
+    {
+        std::lock_guard lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks[priorityIndex].push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(stateMutex);
+        queuedTasks[priorityIndex]++;
+    }
+    wakeUp.notify_one();
+}
+
+TaskHandle TaskScheduler::start(Job job, const TaskPriority priority)
+{
+    auto state = std::make_shared<TaskHandle::State>();
+    submit(
+        [state, job = std::move(job)] {
+            {
+                std::lock_guard lock(state->mutex);
+                if (state->phase != TaskHandle::State::Phase::Pending)
+                {
+                    return; // cancelled before it started
+                }
+                state->phase = TaskHandle::State::Phase::Running;
+            }
+
+            job(state->stopSource.get_token());
+
+            std::lock_guard lock(state->mutex);
+            state->phase = TaskHandle::State::Phase::Finished;
+            state->finished.notify_all();
+        },
+        priority);
+    return TaskHandle(std::move(state));
+}
+
+void TaskScheduler::parallelFor(const size_t size, size_t chunkSize, const TaskPriority priority,
+                                std::stop_token stopToken, const ChunkFunction& function)
+{
+    chunkSize = std::max<size_t>(1, chunkSize);
+    const size_t numberOfChunks = (size + chunkSize - 1) / chunkSize;
+    if (numberOfChunks == 0)
+    {
+        return;
+    }
+
+    auto loop = std::make_shared<ParallelLoop>();
+    loop->function = &function;
+    loop->stopToken = std::move(stopToken);
+    loop->size = size;
+    loop->chunkSize = chunkSize;
+    loop->numberOfChunks = numberOfChunks;
+    loop->unfinishedChunks = numberOfChunks;
+
+    const size_t numberOfHelpers = std::min(numberOfChunks, getMaxConcurrency()) - 1;
+    for (size_t i = 0; i < numberOfHelpers; i++)
+    {
+        submit([loop] { loop->run(loop->nextRunner.fetch_add(1)); }, priority);
+    }
+    loop->run(0);
+    loop->wait();
+}
+
+size_t TaskScheduler::getAvailableCpus()
+{
+    size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0 && CPU_COUNT(&cpuSet) > 0)
+    {
+        cpus = static_cast<size_t>(CPU_COUNT(&cpuSet));
+    }
+    if (const auto limit = readCgroupCpuLimit())
+    {
+        cpus = std::clamp<size_t>(*limit, 1, cpus);
+    }
+#endif
+    return cpus;
+}
+
+void TaskScheduler::runWorker(const size_t workerIndex)
+{
+    currentScheduler = this;
+    currentWorker = workerIndex;
+
+    constexpr size_t interactive = 0;
+    constexpr size_t background = 1;
+    std::unique_lock lock(stateMutex);
+    while (true)
+    {
+        wakeUp.wait(lock, [this] {
+            return stopping || queuedTasks[interactive] > 0 ||
+                   (queuedTasks[background] > 0 && runningBackgroundTasks < maxBackgroundTasks);
+        });
+        if (stopping)
+        {
+            return;
+        }
+
+        // Reserve a task, it is guaranteed to be in one of the queues
+        const bool isInteractive = queuedTasks[interactive] > 0;
+        queuedTasks[isInteractive ? interactive : background]--;
+        if (!isInteractive)
+        {
+            runningBackgroundTasks++;
+        }
+        lock.unlock();
+
+        Task task = takeTask(workerIndex, isInteractive ? TaskPriority::Interactive : TaskPriority::Background);
+        task();
+        task = nullptr; // release the captured state before the task is counted as finished
+
+        lock.lock();
+        if (!isInteractive)
+        {
+            runningBackgroundTasks--;
+            wakeUp.notify_one(); // another background task may run now
+        }
+    }
+}
+
+// Take the newest task of the own queue or steal the oldest task of another worker
+TaskScheduler::Task TaskScheduler::takeTask(const size_t workerIndex, const TaskPriority priority)
+{
+    const size_t priorityIndex = getPriorityIndex(priority);
+    while (true)
+    {
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            const bool ownQueue = i == 0;
+            WorkerQueue& queue = *queues[(workerIndex + i) % queues.size()];
+            std::lock_guard lock(queue.mutex);
+            auto& tasks = queue.tasks[priorityIndex];
+            if (tasks.empty())
+            {
+                continue;
+            }
+
+            Task task;
+            if (ownQueue)
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            return task;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+enum class TaskPriority
+{
+    Interactive, // the user is waiting for the result, e.g. a search
+    Background,  // bulk work: indexing, queries, template mining, exports
+};
+
+// Handle of a job started with TaskScheduler::start(). Like std::jthread, destroying or reassigning
+// the handle requests the job to stop and waits for it. A job that has not started yet is dropped.
+class TaskHandle
+{
+public:
+    TaskHandle() = default;
+    TaskHandle(TaskHandle&& other) noexcept = default;
+    TaskHandle& operator=(TaskHandle&& other) noexcept;
+    ~TaskHandle();
+
+    TaskHandle(const TaskHandle&) = delete;
+    TaskHandle& operator=(const TaskHandle&) = delete;
+
+    void requestStop();
+    void wait();
+
+    // True if a job has been started with this handle, even if it is finished already.
+    bool hasJob() const;
+
+    // True if there is no job or it has finished (or was cancelled before it started).
+    bool isFinished() const;
+
+private:
+    friend class TaskScheduler;
+    struct State;
+
+    explicit TaskHandle(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state;
+};
+
+// Thread pool shared by all background work of the application.
+// Every worker has its own queue per priority. Workers take their own newest tasks first and steal
+// the oldest tasks of other workers when they run out of work. Interactive tasks are always taken
+// before background ones, and background tasks never occupy all workers, so interactive work starts
+// as soon as it is submitted. Bulk work should be split with parallelFor() to give way between chunks.
+class TaskScheduler
+{
+public:
+    using Task = std::function<void()>;
+    using Job = std::function<void(std::stop_token)>;
+
+    // Receives the begin and end index of a chunk and the index of the runner processing it.
+    // Runner indices are lower than getMaxConcurrency(), so they can select per-runner state.
+    using ChunkFunction = std::function<void(size_t, size_t, size_t)>;
+
+    // There are at least two workers, so that one of them is always free for interactive tasks.
+    explicit TaskScheduler(size_t numberOfWorkers = getAvailableCpus());
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    size_t getNumberOfWorkers() const;
+
+    // Maximum number of threads, including the calling one, running the chunks of one parallelFor().
+    size_t getMaxConcurrency() const;
+
+    void submit(Task task, TaskPriority priority);
+
+    // Run a cancellable job on a worker.
+    [[nodiscard]] TaskHandle start(Job job, TaskPriority priority);
+
+    // Call function for chunks of [0, size) in parallel. The calling thread processes chunks as well,
+    // so nested loops and loops started from busy workers do not deadlock. Chunks that did not start
+    // before the stop was requested are skipped. Returns when all started chunks are finished.
+    void parallelFor(size_t size, size_t chunkSize, TaskPriority priority, std::stop_token stopToken,
+                     const ChunkFunction& function);
+
+    // Number of CPUs the process may use, limited by the affinity mask and the cgroup CPU quota.
+    static size_t getAvailableCpus();
+
+private:
+    static constexpr size_t NUMBER_OF_PRIORITIES = 2;
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks[NUMBER_OF_PRIORITIES];
+    };
+
+    void runWorker(size_t workerIndex);
+    Task takeTask(size_t workerIndex, TaskPriority priority);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+
+    // Tasks are counted when they are queued and reserved by a worker before it takes one
+    std::mutex stateMutex;
+    std::condition_variable wakeUp;
+    size_t queuedTasks[NUMBER_OF_PRIORITIES]{};
+    size_t runningBackgroundTasks = 0;
+    size_t maxBackgroundTasks = 1;
+    bool stopping = false;
+};
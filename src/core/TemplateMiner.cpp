@@ -0,0 +1,244 @@
+#include "TemplateMiner.hpp"
+
+#include <algorithm>
+
+namespace
+{
+constexpr uint64_t WILDCARD = 0;
+constexpr std::string_view WILDCARD_TEXT = "<*>";
+constexpr size_t PROGRESS_INTERVAL = 256 * 1024; // lines
+
+bool isSeparator(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool hasDigits(std::string_view token)
+{
+    return std::any_of(token.begin(), token.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// FNV-1a, never returns WILDCARD
+uint64_t hashToken(std::string_view token)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : token)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash == WILDCARD ? 1 : hash;
+}
+
+void tokenize(std::string_view line, std::vector<std::string_view>& tokens, std::vector<uint64_t>& hashes)
+{
+    tokens.clear();
+    hashes.clear();
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        while (pos < line.size() && isSeparator(line[pos]))
+        {
+            pos++;
+        }
+        const size_t tokenBegin = pos;
+        while (pos < line.size() && !isSeparator(line[pos]))
+        {
+            pos++;
+        }
+        if (pos > tokenBegin)
+        {
+            const std::string_view token = line.substr(tokenBegin, pos - tokenBegin);
+            tokens.push_back(token);
+            // Tokens with numbers are almost always parameters (IDs, durations, addresses...)
+            hashes.push_back(hasDigits(token) ? WILDCARD : hashToken(token));
+        }
+    }
+}
+} // namespace
+
+TemplateMiner::TemplateMiner(const double similarityThreshold, const size_t treeDepth, const size_t maxChildren)
+    : similarityThreshold(similarityThreshold), treeDepth(treeDepth), maxChildren(maxChildren)
+{
+}
+
+void TemplateMiner::onProgress(ProgressCallback callback)
+{
+    progressCallback = std::move(callback);
+}
+
+void TemplateMiner::onDataAccess(AccessCallback callback)
+{
+    accessCallback = std::move(callback);
+}
+
+bool TemplateMiner::mine(const char* data, const std::vector<std::pair<size_t, size_t>>& lines,
+                         std::stop_token stopToken)
+{
+    nodes.assign(1, Node{}); // root
+    clusters.clear();
+    templates.clear();
+    lineTemplates.assign(lines.size(), 0);
+
+    std::vector<std::string_view> tokens;
+    std::vector<uint64_t> hashes;
+    for (size_t lineIndex = 0; lineIndex < lines.size(); lineIndex++)
+    {
+        if (lineIndex % PROGRESS_INTERVAL == 0)
+        {
+            if (stopToken.stop_requested())
+            {
+                return false;
+            }
+            if (progressCallback)
+            {
+                progressCallback(lineIndex, lines.size());
+            }
+            if (accessCallback)
+            {
+                const size_t lastLine = std::min(lineIndex + PROGRESS_INTERVAL, lines.size()) - 1;
+                accessCallback(lines[lineIndex].first, lines[lastLine].second);
+            }
+        }
+
+        const auto [lineBegin, lineEnd] = lines[lineIndex];
+        tokenize(std::string_view(data + lineBegin, lineEnd - lineBegin), tokens, hashes);
+        lineTemplates[lineIndex] = addLine(tokens, hashes);
+    }
+
+    templates.reserve(clusters.size());
+    for (const Cluster& cluster : clusters)
+    {
+        LogTemplate logTemplate;
+        for (size_t i = 0; i < cluster.tokens.size(); i++)
+        {
+            if (i > 0)
+            {
+                logTemplate.text += ' ';
+            }
+            const bool isWildcard = cluster.tokenHashes[i] == WILDCARD;
+            logTemplate.text += isWildcard ? WILDCARD_TEXT : std::string_view(cluster.tokens[i]);
+        }
+        logTemplate.count = cluster.count;
+        templates.push_back(std::move(logTemplate));
+    }
+
+    // The token texts are not needed anymore
+    clusters.clear();
+    nodes.clear();
+    return true;
+}
+
+const std::vector<LogTemplate>& TemplateMiner::getTemplates() const
+{
+    return templates;
+}
+
+const std::vector<uint32_t>& TemplateMiner::getLineTemplates() const
+{
+    return lineTemplates;
+}
+
+uint32_t TemplateMiner::addLine(const std::vector<std::string_view>& tokens, const std::vector<uint64_t>& hashes)
+{
+    const uint32_t leaf = findLeaf(hashes);
+
+    // Find the most similar template with the same number of tokens
+    uint32_t bestCluster = 0;
+    double bestSimilarity = -1;
+    size_t bestWildcards = 0;
+    for (const uint32_t clusterIndex : nodes[leaf].clusters)
+    {
+        const Cluster& cluster = clusters[clusterIndex];
+        size_t equalTokens = 0;
+        size_t wildcards = 0;
+        for (size_t i = 0; i < hashes.size(); i++)
+        {
+            // Parameters of the line that are also parameters in the template count as equal
+            if (cluster.tokenHashes[i] == hashes[i])
+                equalTokens++;
+            if (cluster.tokenHashes[i] == WILDCARD)
+                wildcards++;
+        }
+
+        const double similarity = hashes.empty() ? 1.0 : static_cast<double>(equalTokens) / hashes.size();
+        if (similarity > bestSimilarity || (similarity == bestSimilarity && wildcards > bestWildcards))
+        {
+            bestCluster = clusterIndex;
+            bestSimilarity = similarity;
+            bestWildcards = wildcards;
+        }
+    }
+
+    if (bestSimilarity >= similarityThreshold)
+    {
+        // Generalize the template: tokens that differ become wildcards
+        Cluster& cluster = clusters[bestCluster];
+        for (size_t i = 0; i < hashes.size(); i++)
+        {
+            if (cluster.tokenHashes[i] != hashes[i])
+            {
+                cluster.tokenHashes[i] = WILDCARD;
+                cluster.tokens[i].clear();
+            }
+        }
+        cluster.count++;
+        return bestCluster;
+    }
+
+    Cluster cluster;
+    cluster.tokenHashes = hashes;
+    cluster.tokens.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        cluster.tokens.emplace_back(hashes[i] == WILDCARD ? std::string_view{} : tokens[i]);
+    }
+    cluster.count = 1;
+    clusters.push_back(std::move(cluster));
+
+    const auto clusterIndex = static_cast<uint32_t>(clusters.size() - 1);
+    nodes[leaf].clusters.push_back(clusterIndex);
+    return clusterIndex;
+}
+
+// Walk the prefix tree: first level is the number of tokens, then the first `treeDepth` tokens
+uint32_t TemplateMiner::findLeaf(const std::vector<uint64_t>& hashes)
+{
+    uint32_t node = getOrAddChild(0, hashes.size() + 1, false);
+    const size_t depth = std::min(treeDepth, hashes.size());
+    for (size_t i = 0; i < depth; i++)
+    {
+        node = getOrAddChild(node, hashes[i], true);
+    }
+    return node;
+}
+
+uint32_t TemplateMiner::getOrAddChild(const uint32_t node, const uint64_t key, const bool limitChildren)
+{
+    for (const auto& [childKey, child] : nodes[node].children)
+    {
+        if (childKey == key)
+        {
+            return child;
+        }
+    }
+
+    // Too many different tokens at this position, it is probably a parameter
+    uint64_t childKey = key;
+    if (limitChildren && nodes[node].children.size() >= maxChildren)
+    {
+        childKey = WILDCARD;
+        for (const auto& [existingKey, child] : nodes[node].children)
+        {
+            if (existingKey == WILDCARD)
+            {
+                return child;
+            }
+        }
+    }
+
+    const auto child = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    nodes[node].children.emplace_back(childKey, child);
+    return child;
+}
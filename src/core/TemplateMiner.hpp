@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct LogTemplate
+{
+    std::string text; // Tokens of the template, variable parts are replaced with <*>
+    size_t count = 0; // Number of lines matching the template
+};
+
+// Discovers message templates in a single pass over the log (Drain algorithm).
+// Lines are split into tokens that are compared by their hashes. Candidate templates are found
+// in a prefix tree keyed by the number of tokens and the first tokens of the line, then the most
+// similar one is either generalized to cover the line or a new template is created.
+// Only the templates themselves are kept as text, every line gets just a template ID.
+class TemplateMiner
+{
+public:
+    // Receives the number of lines processed so far and the total number of lines.
+    using ProgressCallback = std::function<void(size_t, size_t)>;
+
+    // Receives a range of data before its lines are read.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    // similarityThreshold - fraction of tokens that must be equal for a line to join a template
+    // treeDepth - number of leading tokens used to navigate the prefix tree
+    // maxChildren - maximum number of children of a tree node, other tokens go to a wildcard child
+    explicit TemplateMiner(double similarityThreshold = 0.5, size_t treeDepth = 2, size_t maxChildren = 100);
+
+    void onProgress(ProgressCallback callback);
+    void onDataAccess(AccessCallback callback);
+
+    // Returns false if the mining was cancelled.
+    bool mine(const char* data, const std::vector<std::pair<size_t, size_t>>& lines, std::stop_token stopToken);
+
+    const std::vector<LogTemplate>& getTemplates() const;
+
+    // Template ID of every line, indices into getTemplates().
+    const std::vector<uint32_t>& getLineTemplates() const;
+
+private:
+    struct Cluster
+    {
+        std::vector<uint64_t> tokenHashes; // WILDCARD for variable tokens
+        std::vector<std::string> tokens;
+        size_t count = 0;
+    };
+
+    struct Node
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> children; // token hash -> node index
+        std::vector<uint32_t> clusters;
+    };
+
+    uint32_t addLine(const std::vector<std::string_view>& tokens, const std::vector<uint64_t>& hashes);
+    uint32_t findLeaf(const std::vector<uint64_t>& hashes);
+    uint32_t getOrAddChild(uint32_t node, uint64_t key, bool limitChildren);
+
+    const double similarityThreshold;
+    const size_t treeDepth;
+    const size_t maxChildren;
+    ProgressCallback progressCallback;
+    AccessCallback accessCallback;
+
+    std::vector<Node> nodes;
+    std::vector<Cluster> clusters;
+    std::vector<LogTemplate> templates;
+    std::vector<uint32_t> lineTemplates;
+};
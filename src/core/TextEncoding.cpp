@@ -0,0 +1,331 @@
+#include "TextEncoding.hpp"
+#include "Utf8.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace
+{
+constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Characters of the bytes 0x80-0xFF of Windows-1250. The five unused bytes map to the C1 controls, like Windows does.
+constexpr std::array<char16_t, 128> WINDOWS_1250 = {
+    0x20AC, 0x0081, 0x201A, 0x0083, 0x201E, 0x2026, 0x2020, 0x2021, 0x0088, 0x2030, 0x0160, 0x2039, 0x015A,
+    0x0164, 0x017D, 0x0179, 0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0098, 0x2122,
+    0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A, 0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6,
+    0x00A7, 0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B, 0x00B0, 0x00B1, 0x02DB, 0x0142,
+    0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C, 0x0154,
+    0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD,
+    0x00CE, 0x010E, 0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7, 0x0158, 0x016E, 0x00DA,
+    0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF, 0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+    0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F, 0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4,
+    0x0151, 0x00F6, 0x00F7, 0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+};
+
+// Bytes that are letters of Central European languages in Windows-1250 (e.g. ł, ą, ś, ž)
+// but C1 controls or rarely used symbols in Latin-1
+constexpr std::array<unsigned char, 15> WINDOWS_1250_LETTERS = {0x8A, 0x8C, 0x8D, 0x8E, 0x8F, 0x9A, 0x9C, 0x9D,
+                                                                0x9E, 0x9F, 0xA5, 0xB3, 0xB9, 0xBC, 0xBE};
+
+bool hasPrefix(const std::string_view text, const std::string_view prefix)
+{
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+uint16_t readCodeUnit(const std::string_view bytes, const size_t offset, const bool bigEndian)
+{
+    const auto first = static_cast<unsigned char>(bytes[offset]);
+    const auto second = static_cast<unsigned char>(bytes[offset + 1]);
+    return static_cast<uint16_t>(bigEndian ? first << 8 | second : second << 8 | first);
+}
+
+char32_t decodeUtf16(const std::string_view bytes, size_t& offset, const bool bigEndian)
+{
+    if (offset + 2 > bytes.size())
+    {
+        offset = bytes.size();
+        return REPLACEMENT_CHARACTER;
+    }
+    const uint16_t unit = readCodeUnit(bytes, offset, bigEndian);
+    offset += 2;
+    if (unit < 0xD800 || unit > 0xDFFF)
+    {
+        return unit;
+    }
+    if (unit > 0xDBFF || offset + 2 > bytes.size())
+    {
+        return REPLACEMENT_CHARACTER;
+    }
+    const uint16_t low = readCodeUnit(bytes, offset, bigEndian);
+    if (low < 0xDC00 || low > 0xDFFF)
+    {
+        return REPLACEMENT_CHARACTER; // the next unit is decoded on its own
+    }
+    offset += 2;
+    return 0x10000 + ((static_cast<char32_t>(unit) - 0xD800) << 10) + (low - 0xDC00);
+}
+
+char32_t decodeUtf8(const std::string_view bytes, size_t& offset)
+{
+    const size_t begin = offset;
+    offset = nextCodePoint(bytes, begin);
+    const auto first = static_cast<unsigned char>(bytes[begin]);
+    const size_t length = offset - begin;
+    if (length == 1)
+    {
+        return first < 0x80 ? first : REPLACEMENT_CHARACTER;
+    }
+    char32_t codePoint = first & (0x7F >> length);
+    for (size_t i = begin + 1; i < offset; i++)
+    {
+        codePoint = codePoint << 6 | (static_cast<unsigned char>(bytes[i]) & 0x3F);
+    }
+    return codePoint;
+}
+
+size_t getUtf8Length(const char32_t codePoint)
+{
+    return codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+}
+
+void appendUtf8(const char32_t codePoint, std::string& utf8)
+{
+    if (codePoint < 0x80)
+    {
+        utf8 += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        utf8 += static_cast<char>(0xC0 | codePoint >> 6);
+        utf8 += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        utf8 += static_cast<char>(0xE0 | codePoint >> 12);
+        utf8 += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        utf8 += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        utf8 += static_cast<char>(0xF0 | codePoint >> 18);
+        utf8 += static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+        utf8 += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        utf8 += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+void appendUtf16(const char32_t codePoint, const bool bigEndian, std::string& bytes)
+{
+    const auto appendUnit = [&bytes, bigEndian](const char32_t unit) {
+        const auto high = static_cast<char>(unit >> 8);
+        const auto low = static_cast<char>(unit & 0xFF);
+        bytes += bigEndian ? high : low;
+        bytes += bigEndian ? low : high;
+    };
+    if (codePoint < 0x10000)
+    {
+        appendUnit(codePoint);
+        return;
+    }
+    appendUnit(0xD800 + ((codePoint - 0x10000) >> 10));
+    appendUnit(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+}
+} // namespace
+
+TextEncoding detectTextEncoding(const std::string_view sample)
+{
+    if (hasPrefix(sample, "\xEF\xBB\xBF"))
+    {
+        return TextEncoding::Utf8;
+    }
+    if (hasPrefix(sample, "\xFF\xFE"))
+    {
+        return TextEncoding::Utf16Le;
+    }
+    if (hasPrefix(sample, "\xFE\xFF"))
+    {
+        return TextEncoding::Utf16Be;
+    }
+
+    // ASCII characters in UTF-16 have a NUL byte, which plain text never has
+    size_t evenZeros = 0;
+    size_t oddZeros = 0;
+    for (size_t i = 0; i + 1 < sample.size(); i += 2)
+    {
+        evenZeros += sample[i] == '\0';
+        oddZeros += sample[i + 1] == '\0';
+    }
+    const size_t pairs = sample.size() / 2;
+    // Compared by multiplying, so that short samples are not rounded down to no zeros allowed at all
+    if (oddZeros * 4 > pairs && evenZeros * 16 < pairs)
+    {
+        return TextEncoding::Utf16Le;
+    }
+    if (evenZeros * 4 > pairs && oddZeros * 16 < pairs)
+    {
+        return TextEncoding::Utf16Be;
+    }
+
+    // The sample may end in the middle of a character
+    const size_t invalidOffset = findInvalidUtf8(sample);
+    if (invalidOffset == std::string_view::npos || invalidOffset + 4 > sample.size())
+    {
+        return TextEncoding::Utf8;
+    }
+    const bool windows1250 = std::any_of(sample.begin(), sample.end(), [](char c) {
+        return std::find(WINDOWS_1250_LETTERS.begin(), WINDOWS_1250_LETTERS.end(), static_cast<unsigned char>(c)) !=
+               WINDOWS_1250_LETTERS.end();
+    });
+    return windows1250 ? TextEncoding::Windows1250 : TextEncoding::Latin1;
+}
+
+size_t getByteOrderMarkSize(const std::string_view text, const TextEncoding encoding)
+{
+    switch (encoding)
+    {
+    case TextEncoding::Utf8:
+        return hasPrefix(text, "\xEF\xBB\xBF") ? 3 : 0;
+    case TextEncoding::Utf16Le:
+        return hasPrefix(text, "\xFF\xFE") ? 2 : 0;
+    case TextEncoding::Utf16Be:
+        return hasPrefix(text, "\xFE\xFF") ? 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+size_t getCodeUnitSize(const TextEncoding encoding)
+{
+    return encoding == TextEncoding::Utf16Le || encoding == TextEncoding::Utf16Be ? 2 : 1;
+}
+
+bool isAsciiCompatible(const TextEncoding encoding)
+{
+    return getCodeUnitSize(encoding) == 1;
+}
+
+std::string_view getEncodingName(const TextEncoding encoding)
+{
+    switch (encoding)
+    {
+    case TextEncoding::Utf8:
+        return "UTF-8";
+    case TextEncoding::Utf16Le:
+        return "UTF-16LE";
+    case TextEncoding::Utf16Be:
+        return "UTF-16BE";
+    case TextEncoding::Latin1:
+        return "Latin-1";
+    case TextEncoding::Windows1250:
+        return "Windows-1250";
+    }
+    return {};
+}
+
+std::optional<TextEncoding> parseEncodingName(const std::string_view name)
+{
+    for (const TextEncoding encoding : {TextEncoding::Utf8, TextEncoding::Utf16Le, TextEncoding::Utf16Be,
+                                        TextEncoding::Latin1, TextEncoding::Windows1250})
+    {
+        const std::string_view encodingName = getEncodingName(encoding);
+        const bool equal = std::equal(name.begin(), name.end(), encodingName.begin(), encodingName.end(),
+                                      [](char a, char b) { return (a | 0x20) == (b | 0x20); });
+        if (equal)
+        {
+            return encoding;
+        }
+    }
+    return std::nullopt;
+}
+
+char32_t decodeCharacter(const std::string_view bytes, size_t& offset, const TextEncoding encoding)
+{
+    switch (encoding)
+    {
+    case TextEncoding::Utf16Le:
+    case TextEncoding::Utf16Be:
+        return decodeUtf16(bytes, offset, encoding == TextEncoding::Utf16Be);
+    case TextEncoding::Latin1:
+        return static_cast<unsigned char>(bytes[offset++]);
+    case TextEncoding::Windows1250: {
+        const auto byte = static_cast<unsigned char>(bytes[offset++]);
+        return byte < 0x80 ? byte : WINDOWS_1250[byte - 0x80];
+    }
+    default:
+        return decodeUtf8(bytes, offset);
+    }
+}
+
+void decodeToUtf8(const std::string_view bytes, const TextEncoding encoding, std::string& utf8)
+{
+    if (encoding == TextEncoding::Utf8)
+    {
+        utf8 += bytes;
+        return;
+    }
+    utf8.reserve(utf8.size() + bytes.size());
+    for (size_t offset = 0; offset < bytes.size();)
+    {
+        appendUtf8(decodeCharacter(bytes, offset, encoding), utf8);
+    }
+}
+
+std::optional<std::string> encodeFromUtf8(const std::string_view utf8, const TextEncoding encoding)
+{
+    if (encoding == TextEncoding::Utf8)
+    {
+        return std::string(utf8);
+    }
+    std::string bytes;
+    for (size_t offset = 0; offset < utf8.size();)
+    {
+        const char32_t codePoint = decodeUtf8(utf8, offset);
+        if (encoding == TextEncoding::Utf16Le || encoding == TextEncoding::Utf16Be)
+        {
+            appendUtf16(codePoint, encoding == TextEncoding::Utf16Be, bytes);
+        }
+        else if (codePoint < 0x80 || (encoding == TextEncoding::Latin1 && codePoint < 0x100))
+        {
+            bytes += static_cast<char>(codePoint);
+        }
+        else
+        {
+            const auto it = std::find(WINDOWS_1250.begin(), WINDOWS_1250.end(), codePoint);
+            if (encoding != TextEncoding::Windows1250 || it == WINDOWS_1250.end())
+            {
+                return std::nullopt;
+            }
+            bytes += static_cast<char>(0x80 + (it - WINDOWS_1250.begin()));
+        }
+    }
+    return bytes;
+}
+
+size_t toUtf8Offset(const std::string_view bytes, const TextEncoding encoding, const size_t offset)
+{
+    if (encoding == TextEncoding::Utf8)
+    {
+        return std::min(offset, bytes.size());
+    }
+    size_t utf8Offset = 0;
+    for (size_t position = 0; position < offset && position < bytes.size();)
+    {
+        utf8Offset += getUtf8Length(decodeCharacter(bytes, position, encoding));
+    }
+    return utf8Offset;
+}
+
+size_t fromUtf8Offset(const std::string_view bytes, const TextEncoding encoding, const size_t utf8Offset)
+{
+    if (encoding == TextEncoding::Utf8)
+    {
+        return std::min(utf8Offset, bytes.size());
+    }
+    size_t offset = 0;
+    for (size_t position = 0; position < utf8Offset && offset < bytes.size();)
+    {
+        position += getUtf8Length(decodeCharacter(bytes, offset, encoding));
+    }
+    return offset;
+}
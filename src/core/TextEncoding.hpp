@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Encodings of logs besides UTF-8. Text in them is never converted as a whole: lines are indexed in the
+// original bytes and only the lines that are displayed are decoded to UTF-8. Searched text is encoded instead,
+// so searches scan the original bytes.
+enum class TextEncoding
+{
+    Utf8,
+    Utf16Le,
+    Utf16Be,
+    Latin1,      // ISO-8859-1
+    Windows1250, // Central European
+};
+
+// Detect the encoding from the byte order mark or, without one, from a sample of the beginning of the text.
+// NUL bytes at every other position mean UTF-16, bytes that are not valid UTF-8 mean a legacy single-byte
+// encoding, which is Windows-1250 if the sample has letters that only it has at those bytes.
+TextEncoding detectTextEncoding(std::string_view sample);
+
+// Size of the byte order mark at the beginning of the text, 0 if there is none
+size_t getByteOrderMarkSize(std::string_view text, TextEncoding encoding);
+
+// Size of a code unit: 2 for UTF-16, 1 for the rest
+size_t getCodeUnitSize(TextEncoding encoding);
+
+// True if ASCII characters are encoded as single ASCII bytes, so the parsers of timestamps,
+// levels and fields work on the original bytes
+bool isAsciiCompatible(TextEncoding encoding);
+
+// e.g. "UTF-16LE". Names are case-insensitive when parsed.
+std::string_view getEncodingName(TextEncoding encoding);
+std::optional<TextEncoding> parseEncodingName(std::string_view name);
+
+// Decode the character beginning at the offset and move the offset past it. Invalid characters decode as U+FFFD.
+char32_t decodeCharacter(std::string_view bytes, size_t& offset, TextEncoding encoding);
+
+// Append the text decoded to UTF-8
+void decodeToUtf8(std::string_view bytes, TextEncoding encoding, std::string& utf8);
+
+// The UTF-8 text in the given encoding. Returns nothing if it has characters that the encoding cannot represent.
+std::optional<std::string> encodeFromUtf8(std::string_view utf8, TextEncoding encoding);
+
+// Convert between an offset in the bytes and the offset in their UTF-8 text. Offsets inside a character
+// are moved to its end.
+size_t toUtf8Offset(std::string_view bytes, TextEncoding encoding, size_t offset);
+size_t fromUtf8Offset(std::string_view bytes, TextEncoding encoding, size_t utf8Offset);
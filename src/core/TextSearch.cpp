@@ -0,0 +1,244 @@
+#include "TextSearch.hpp"
+#include "LineIndex.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Amount of data scanned between checks for cancellation and progress updates
+constexpr size_t SEARCH_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Number of candidate lines checked by one task
+constexpr size_t CANDIDATE_CHUNK_LINES = 64 * 1024;
+} // namespace
+
+TextSearch::TextSearch(const char* data, const size_t dataSize, const std::vector<std::pair<size_t, size_t>>& lines)
+    : data(data), dataSize(dataSize), lines(lines)
+{
+}
+
+void TextSearch::onProgress(ProgressCallback callback)
+{
+    progressCallback = std::move(callback);
+}
+
+void TextSearch::onDataAccess(AccessCallback callback)
+{
+    accessCallback = std::move(callback);
+}
+
+void TextSearch::setScheduler(TaskScheduler* taskScheduler, const TaskPriority taskPriority)
+{
+    scheduler = taskScheduler;
+    priority = taskPriority;
+}
+
+void TextSearch::setCodeUnitSize(const size_t size)
+{
+    codeUnitSize = size;
+}
+
+std::optional<SearchMatch> TextSearch::findNext(std::string_view text, size_t fromOffset,
+                                                std::stop_token stopToken) const
+{
+    if (text.empty() || lines.empty())
+    {
+        return std::nullopt;
+    }
+
+    fromOffset = std::min(fromOffset, dataSize);
+    if (auto match = findInRange(text, fromOffset, dataSize, 0, stopToken))
+    {
+        return match;
+    }
+    return findInRange(text, 0, fromOffset, dataSize - fromOffset, stopToken);
+}
+
+std::optional<SearchMatch> TextSearch::findNextInLines(std::string_view text, const size_t fromOffset,
+                                                       const std::vector<uint32_t>& lineIndices) const
+{
+    if (text.empty() || lineIndices.empty())
+    {
+        return std::nullopt;
+    }
+
+    // Lines ending before the offset cannot contain the next match
+    auto it = std::lower_bound(lineIndices.begin(), lineIndices.end(), fromOffset,
+                               [this](uint32_t lineIndex, size_t offset) { return lines[lineIndex].second < offset; });
+    for (; it != lineIndices.end(); ++it)
+    {
+        const auto [lineBegin, lineEnd] = lines[*it];
+        const size_t searchFrom = std::max(lineBegin, fromOffset) - lineBegin;
+        const size_t pos = find({data + lineBegin, lineEnd - lineBegin}, lineBegin, text, searchFrom);
+        if (pos != std::string_view::npos)
+        {
+            return SearchMatch{*it, lineBegin + pos, lineBegin + pos + text.size()};
+        }
+    }
+
+    // Wrap around, the first line contains a match by definition
+    const auto [lineBegin, lineEnd] = lines[lineIndices.front()];
+    const size_t pos = find({data + lineBegin, lineEnd - lineBegin}, lineBegin, text, 0);
+    if (pos == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    return SearchMatch{lineIndices.front(), lineBegin + pos, lineBegin + pos + text.size()};
+}
+
+std::optional<std::vector<uint32_t>> TextSearch::findMatchingLines(std::string_view text,
+                                                                   const std::vector<uint32_t>* candidateLines,
+                                                                   std::stop_token stopToken) const
+{
+    std::vector<uint32_t> result;
+    if (text.empty() || lines.empty())
+    {
+        return result;
+    }
+
+    // Every chunk collects its own lines, so the result is sorted after concatenation
+    std::vector<std::vector<uint32_t>> chunkLines;
+    if (candidateLines != nullptr)
+    {
+        chunkLines.resize((candidateLines->size() + CANDIDATE_CHUNK_LINES - 1) / CANDIDATE_CHUNK_LINES);
+        forEachChunk(candidateLines->size(), CANDIDATE_CHUNK_LINES, stopToken, [&](size_t first, size_t last, size_t) {
+            auto& matching = chunkLines[first / CANDIDATE_CHUNK_LINES];
+            for (size_t i = first; i < last; i++)
+            {
+                const auto [lineBegin, lineEnd] = lines[(*candidateLines)[i]];
+                if (accessCallback)
+                {
+                    accessCallback(lineBegin, lineEnd);
+                }
+                if (find({data + lineBegin, lineEnd - lineBegin}, lineBegin, text, 0) != std::string_view::npos)
+                {
+                    matching.push_back((*candidateLines)[i]);
+                }
+            }
+        });
+    }
+    else
+    {
+        chunkLines.resize((dataSize + SEARCH_CHUNK_SIZE - 1) / SEARCH_CHUNK_SIZE);
+        forEachChunk(dataSize, SEARCH_CHUNK_SIZE, stopToken, [&](size_t begin, size_t end, size_t) {
+            scanForLines(text, begin, end, chunkLines[begin / SEARCH_CHUNK_SIZE]);
+        });
+    }
+
+    if (stopToken.stop_requested())
+    {
+        return std::nullopt;
+    }
+    for (const auto& matching : chunkLines)
+    {
+        // A line crossing a chunk boundary may have matches in both chunks
+        const bool continuesLine = !result.empty() && !matching.empty() && matching.front() == result.back();
+        result.insert(result.end(), matching.begin() + (continuesLine ? 1 : 0), matching.end());
+    }
+    return result;
+}
+
+// Find a match beginning in [begin, end). The match itself may extend past the end of the range.
+std::optional<SearchMatch> TextSearch::findInRange(std::string_view text, const size_t begin, const size_t end,
+                                                   const size_t bytesScanned, std::stop_token stopToken) const
+{
+    for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += SEARCH_CHUNK_SIZE)
+    {
+        if (stopToken.stop_requested())
+        {
+            return std::nullopt;
+        }
+
+        // The chunk overlaps the next one, so that matches crossing the chunk boundary are found
+        const size_t chunkEnd = std::min(end, chunkBegin + SEARCH_CHUNK_SIZE);
+        const size_t scanEnd = std::min(dataSize, chunkEnd + text.size() - 1);
+        const std::string_view chunk(data + chunkBegin, scanEnd - chunkBegin);
+        if (accessCallback)
+        {
+            accessCallback(chunkBegin, scanEnd);
+        }
+
+        size_t pos = find(chunk, chunkBegin, text, 0);
+        while (pos != std::string_view::npos && chunkBegin + pos < chunkEnd)
+        {
+            const size_t matchBegin = chunkBegin + pos;
+            const size_t matchEnd = matchBegin + text.size();
+            const size_t lineIndex = findLineOfOffset(matchBegin);
+            if (matchEnd <= lines[lineIndex].second)
+            {
+                return SearchMatch{lineIndex, matchBegin, matchEnd};
+            }
+            pos = find(chunk, chunkBegin, text, pos + 1);
+        }
+
+        if (progressCallback)
+        {
+            progressCallback(bytesScanned + chunkEnd - begin, dataSize);
+        }
+    }
+    return std::nullopt;
+}
+
+size_t TextSearch::findLineOfOffset(const size_t offset) const
+{
+    return LineIndex::findLine(lines, offset);
+}
+
+// Find the text in a chunk of data beginning at the given offset of data, at an aligned offset
+size_t TextSearch::find(std::string_view chunk, const size_t chunkBegin, std::string_view text, const size_t from) const
+{
+    size_t pos = chunk.find(text, from);
+    while (codeUnitSize > 1 && pos != std::string_view::npos && (chunkBegin + pos) % codeUnitSize != 0)
+    {
+        pos = chunk.find(text, pos + 1);
+    }
+    return pos;
+}
+
+// Append indices of lines with a match beginning in [begin, end), every line once
+void TextSearch::scanForLines(std::string_view text, const size_t begin, const size_t end,
+                              std::vector<uint32_t>& result) const
+{
+    const size_t scanEnd = std::min(dataSize, end + text.size() - 1);
+    const std::string_view chunk(data + begin, scanEnd - begin);
+    if (accessCallback)
+    {
+        accessCallback(begin, scanEnd);
+    }
+
+    size_t pos = find(chunk, begin, text, 0);
+    while (pos != std::string_view::npos && begin + pos < end)
+    {
+        const size_t matchBegin = begin + pos;
+        const size_t lineIndex = findLineOfOffset(matchBegin);
+        const size_t lineEnd = lines[lineIndex].second;
+        if (matchBegin + text.size() <= lineEnd)
+        {
+            result.push_back(static_cast<uint32_t>(lineIndex));
+            if (lineEnd >= scanEnd)
+            {
+                break;
+            }
+            // The rest of the line does not matter anymore
+            pos = find(chunk, begin, text, lineEnd + 1 - begin);
+        }
+        else
+        {
+            pos = find(chunk, begin, text, pos + 1);
+        }
+    }
+}
+
+void TextSearch::forEachChunk(const size_t size, const size_t chunkSize, std::stop_token stopToken,
+                              const TaskScheduler::ChunkFunction& function) const
+{
+    if (scheduler != nullptr)
+    {
+        scheduler->parallelFor(size, chunkSize, priority, stopToken, function);
+        return;
+    }
+    for (size_t begin = 0; begin < size && !stopToken.stop_requested(); begin += chunkSize)
+    {
+        function(begin, std::min(size, begin + chunkSize), 0);
+    }
+}
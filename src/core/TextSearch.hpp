@@ -0,0 +1,76 @@
+#pragma once
+#include "TaskScheduler.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct SearchMatch
+{
+    size_t lineIndex;
+    size_t begin;
+    size_t end;
+};
+
+// Finds plain text in the data. The data is scanned in chunks so that the search can be
+// cancelled quickly and report its progress. Matches never span more than one line.
+// The search is blocking and meant to be run on a background thread.
+class TextSearch
+{
+public:
+    // Receives the number of bytes scanned so far and the total number of bytes to scan.
+    using ProgressCallback = std::function<void(size_t, size_t)>;
+
+    // Receives a range of data before it is scanned.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    // Lines are pairs of begin and end offsets, without the newline character.
+    TextSearch(const char* data, size_t dataSize, const std::vector<std::pair<size_t, size_t>>& lines);
+
+    void onProgress(ProgressCallback callback);
+    void onDataAccess(AccessCallback callback);
+
+    // Run findMatchingLines() in parallel on the scheduler, with the given priority.
+    void setScheduler(TaskScheduler* taskScheduler, TaskPriority taskPriority);
+
+    // Matches begin only at multiples of the size, e.g. 2 for text encoded as UTF-16,
+    // so that a match never begins in the middle of a character.
+    void setCodeUnitSize(size_t size);
+
+    // Find the first match beginning at or after the given offset.
+    // The search wraps around to the beginning of the data if nothing is found until its end.
+    // Returns nothing if there is no match or the search was cancelled.
+    std::optional<SearchMatch> findNext(std::string_view text, size_t fromOffset, std::stop_token stopToken) const;
+
+    // Same as findNext(), but only the given lines (sorted indices of lines containing the text) are searched.
+    std::optional<SearchMatch> findNextInLines(std::string_view text, size_t fromOffset,
+                                               const std::vector<uint32_t>& lineIndices) const;
+
+    // Sorted indices of all lines containing the text. If candidate lines are given, only they are checked.
+    // Returns nothing if the search was cancelled.
+    std::optional<std::vector<uint32_t>> findMatchingLines(std::string_view text,
+                                                           const std::vector<uint32_t>* candidateLines,
+                                                           std::stop_token stopToken) const;
+
+private:
+    std::optional<SearchMatch> findInRange(std::string_view text, size_t begin, size_t end, size_t bytesScanned,
+                                           std::stop_token stopToken) const;
+    size_t findLineOfOffset(size_t offset) const;
+    size_t find(std::string_view chunk, size_t chunkBegin, std::string_view text, size_t from) const;
+    void scanForLines(std::string_view text, size_t begin, size_t end, std::vector<uint32_t>& result) const;
+    void forEachChunk(size_t size, size_t chunkSize, std::stop_token stopToken,
+                      const TaskScheduler::ChunkFunction& function) const;
+
+    const char* data;
+    size_t dataSize;
+    const std::vector<std::pair<size_t, size_t>>& lines;
+    ProgressCallback progressCallback;
+    AccessCallback accessCallback;
+    TaskScheduler* scheduler = nullptr;
+    TaskPriority priority = TaskPriority::Interactive;
+    size_t codeUnitSize = 1;
+};
@@ -0,0 +1,158 @@
+#include "TimeGaps.hpp"
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+// Number of lines parsed by one task
+constexpr size_t GAP_CHUNK_LINES = 64 * 1024;
+
+// Amount of data announced to the access callback at once
+constexpr size_t ACCESS_BLOCK_SIZE = 16 * 1024 * 1024;
+
+// Gaps below 2048 ms are stored as they are, bigger ones with a 6-bit exponent and a 10-bit mantissa.
+// The encoding keeps the order of the gaps.
+constexpr int MANTISSA_BITS = 10;
+
+uint16_t encodeGap(const int64_t milliseconds)
+{
+    const auto value = static_cast<uint64_t>(milliseconds);
+    if (value < (uint64_t{2} << MANTISSA_BITS))
+    {
+        return static_cast<uint16_t>(value);
+    }
+    const int exponent = std::bit_width(value) - MANTISSA_BITS - 1;
+    const uint64_t mantissa = (value >> exponent) & ((uint64_t{1} << MANTISSA_BITS) - 1);
+    return static_cast<uint16_t>(static_cast<uint64_t>(exponent + 1) << MANTISSA_BITS | mantissa);
+}
+
+int64_t decodeGap(const uint16_t code)
+{
+    if (code < (2 << MANTISSA_BITS))
+    {
+        return code;
+    }
+    const int exponent = (code >> MANTISSA_BITS) - 1;
+    const uint64_t mantissa = (uint64_t{1} << MANTISSA_BITS) | (code & ((1 << MANTISSA_BITS) - 1));
+    return static_cast<int64_t>(mantissa << exponent);
+}
+
+bool isLarger(const TimeGap& a, const TimeGap& b)
+{
+    return a.milliseconds != b.milliseconds ? a.milliseconds > b.milliseconds : a.lineIndex < b.lineIndex;
+}
+
+// Sort the gaps from the largest and drop all but the largest ones
+void keepLargest(std::vector<TimeGap>& gaps)
+{
+    if (gaps.size() > TimeGaps::MAX_LARGEST_GAPS)
+    {
+        std::nth_element(gaps.begin(), gaps.begin() + TimeGaps::MAX_LARGEST_GAPS, gaps.end(), isLarger);
+        gaps.resize(TimeGaps::MAX_LARGEST_GAPS);
+    }
+    std::sort(gaps.begin(), gaps.end(), isLarger);
+}
+
+// Result of parsing a chunk of lines. The gap before the first timestamp depends on the previous chunks.
+struct ChunkGaps
+{
+    std::optional<int64_t> firstTimestamp;
+    size_t firstLine = 0;
+    std::optional<int64_t> lastTimestamp;
+    std::vector<TimeGap> largest;
+};
+} // namespace
+
+TimeGaps::TimeGaps(TaskScheduler& scheduler) : scheduler(scheduler)
+{
+}
+
+bool TimeGaps::extend(const LineIndex& lines, const LineIndex::AccessCallback& onAccess, std::stop_token stopToken)
+{
+    const size_t firstLine = gaps.size();
+    if (firstLine >= lines.size())
+    {
+        return true;
+    }
+    const size_t numberOfLines = lines.size() - firstLine;
+    gaps.resize(lines.size(), 0);
+
+    std::vector<ChunkGaps> chunks((numberOfLines + GAP_CHUNK_LINES - 1) / GAP_CHUNK_LINES);
+    scheduler.parallelFor(numberOfLines, GAP_CHUNK_LINES, TaskPriority::Background, stopToken,
+                          [&](size_t begin, size_t end, size_t) {
+                              ChunkGaps& chunk = chunks[begin / GAP_CHUNK_LINES];
+                              size_t accessedEnd = 0;
+                              for (size_t lineIndex = firstLine + begin; lineIndex < firstLine + end; lineIndex++)
+                              {
+                                  const auto [lineBegin, lineEnd] = lines[lineIndex];
+                                  if (onAccess && lineEnd > accessedEnd)
+                                  {
+                                      accessedEnd = std::max(lineEnd, lineBegin + ACCESS_BLOCK_SIZE);
+                                      onAccess(lineBegin, accessedEnd);
+                                  }
+                                  const auto timestamp = findTimestamp(lines.getLineText(lineIndex));
+                                  if (!timestamp)
+                                  {
+                                      continue;
+                                  }
+                                  if (!chunk.lastTimestamp)
+                                  {
+                                      chunk.firstTimestamp = timestamp;
+                                      chunk.firstLine = lineIndex;
+                                  }
+                                  else if (*timestamp > *chunk.lastTimestamp)
+                                  {
+                                      const int64_t gap = *timestamp - *chunk.lastTimestamp;
+                                      gaps[lineIndex] = encodeGap(gap);
+                                      chunk.largest.push_back({lineIndex, gap});
+                                      if (chunk.largest.size() >= 2 * MAX_LARGEST_GAPS)
+                                      {
+                                          keepLargest(chunk.largest);
+                                      }
+                                  }
+                                  chunk.lastTimestamp = timestamp;
+                              }
+                          });
+    if (stopToken.stop_requested())
+    {
+        gaps.resize(firstLine);
+        return false;
+    }
+
+    // Join the chunks in order and merge their largest gaps
+    std::vector<TimeGap> candidates = std::move(largestGaps);
+    for (ChunkGaps& chunk : chunks)
+    {
+        if (chunk.firstTimestamp && lastTimestamp && *chunk.firstTimestamp > *lastTimestamp)
+        {
+            const int64_t gap = *chunk.firstTimestamp - *lastTimestamp;
+            gaps[chunk.firstLine] = encodeGap(gap);
+            candidates.push_back({chunk.firstLine, gap});
+        }
+        if (chunk.lastTimestamp)
+        {
+            lastTimestamp = chunk.lastTimestamp;
+        }
+        candidates.insert(candidates.end(), chunk.largest.begin(), chunk.largest.end());
+        keepLargest(candidates);
+    }
+    largestGaps = std::move(candidates);
+    return true;
+}
+
+size_t TimeGaps::size() const
+{
+    return gaps.size();
+}
+
+int64_t TimeGaps::getGap(const size_t lineIndex) const
+{
+    return lineIndex < gaps.size() ? decodeGap(gaps[lineIndex]) : 0;
+}
+
+const std::vector<TimeGap>& TimeGaps::getLargestGaps() const
+{
+    return largestGaps;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "LineIndex.hpp"
+#include "TaskScheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stop_token>
+#include <vector>
+
+struct TimeGap
+{
+    size_t lineIndex;
+    int64_t milliseconds; // since the previous line with a timestamp
+};
+
+// Time between every line and the previous line with a timestamp, for finding latency incidents.
+// The lines are parsed in chunks in parallel, the first timestamp of a chunk is joined with the last
+// timestamp of the chunk before it afterwards. Every gap is kept in 16 bits as a small floating point
+// number (precise to 0.1%), lines without a timestamp and lines going back in time have no gap.
+// Every chunk collects its largest gaps, which are merged into the largest gaps of the whole log.
+// The analysis is incremental: extending it to new lines at the end of the log parses only those lines.
+// It is not thread-safe, the gaps must not be read while they are extended.
+class TimeGaps
+{
+public:
+    static constexpr size_t MAX_LARGEST_GAPS = 100;
+
+    explicit TimeGaps(TaskScheduler& scheduler);
+
+    // Analyze the lines after the ones analyzed so far. Returns false if cancelled,
+    // the lines analyzed before stay.
+    bool extend(const LineIndex& lines, const LineIndex::AccessCallback& onAccess, std::stop_token stopToken);
+
+    // Number of analyzed lines
+    size_t size() const;
+
+    // Gap before the line, 0 if the line has none
+    int64_t getGap(size_t lineIndex) const;
+
+    // The largest gaps sorted from the largest one, at most MAX_LARGEST_GAPS
+    const std::vector<TimeGap>& getLargestGaps() const;
+
+private:
+    TaskScheduler& scheduler;
+    std::vector<uint16_t> gaps;
+    std::optional<int64_t> lastTimestamp;
+    std::vector<TimeGap> largestGaps;
+};
@@ -0,0 +1,208 @@
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+// A timestamp is looked for only in this many first characters of a line
+constexpr size_t TIMESTAMP_SEARCH_LIMIT = 64;
+
+constexpr int64_t MILLIS_PER_SECOND = 1000;
+constexpr int64_t MILLIS_PER_MINUTE = 60 * MILLIS_PER_SECOND;
+constexpr int64_t MILLIS_PER_HOUR = 60 * MILLIS_PER_MINUTE;
+constexpr int64_t MILLIS_PER_DAY = 24 * MILLIS_PER_HOUR;
+
+bool isDigit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Parse exactly `count` digits starting at `pos`
+bool parseDigits(std::string_view text, size_t pos, size_t count, int& value)
+{
+    if (pos + count > text.size())
+    {
+        return false;
+    }
+    value = 0;
+    for (size_t i = pos; i < pos + count; i++)
+    {
+        if (!isDigit(text[i]))
+        {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+int64_t floorDiv(int64_t value, int64_t divisor)
+{
+    const int64_t quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+} // namespace
+
+std::optional<int64_t> parseTimestamp(std::string_view text, size_t* parsedLength)
+{
+    using namespace std::chrono;
+
+    // YYYY-MM-DD
+    int yearValue, monthValue, dayValue;
+    if (!parseDigits(text, 0, 4, yearValue) || text.size() < 10 || text[4] != '-' ||
+        !parseDigits(text, 5, 2, monthValue) || text[7] != '-' || !parseDigits(text, 8, 2, dayValue))
+    {
+        return std::nullopt;
+    }
+    const year_month_day date{year{yearValue}, month{static_cast<unsigned>(monthValue)},
+                              day{static_cast<unsigned>(dayValue)}};
+    if (!date.ok())
+    {
+        return std::nullopt;
+    }
+    int64_t millis = duration_cast<milliseconds>(sys_days{date}.time_since_epoch()).count();
+    size_t pos = 10;
+
+    // [T ]HH:MM:SS
+    int hours, minutes, seconds;
+    if (pos + 9 <= text.size() && (text[pos] == 'T' || text[pos] == ' ') && parseDigits(text, pos + 1, 2, hours) &&
+        text[pos + 3] == ':' && parseDigits(text, pos + 4, 2, minutes) && text[pos + 6] == ':' &&
+        parseDigits(text, pos + 7, 2, seconds))
+    {
+        if (hours > 23 || minutes > 59 || seconds > 60)
+        {
+            return std::nullopt;
+        }
+        millis += hours * MILLIS_PER_HOUR + minutes * MILLIS_PER_MINUTE + seconds * MILLIS_PER_SECOND;
+        pos += 9;
+
+        // Fraction of a second: .123 or ,123456
+        if (pos < text.size() && (text[pos] == '.' || text[pos] == ',') && pos + 1 < text.size() &&
+            isDigit(text[pos + 1]))
+        {
+            pos++;
+            int64_t fraction = 0;
+            int digits = 0;
+            for (; pos < text.size() && isDigit(text[pos]); pos++, digits++)
+            {
+                if (digits < 3)
+                {
+                    fraction = fraction * 10 + (text[pos] - '0');
+                }
+            }
+            for (; digits < 3; digits++)
+            {
+                fraction *= 10;
+            }
+            millis += fraction;
+        }
+
+        // Time zone: Z, +hh:mm, -hhmm
+        if (pos < text.size() && text[pos] == 'Z')
+        {
+            pos++;
+        }
+        else if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+        {
+            int offsetHours, offsetMinutes = 0;
+            const int sign = text[pos] == '+' ? 1 : -1;
+            if (parseDigits(text, pos + 1, 2, offsetHours))
+            {
+                size_t offsetEnd = pos + 3;
+                if (offsetEnd < text.size() && text[offsetEnd] == ':')
+                {
+                    offsetEnd++;
+                }
+                if (parseDigits(text, offsetEnd, 2, offsetMinutes))
+                {
+                    offsetEnd += 2;
+                }
+                millis -= sign * (offsetHours * MILLIS_PER_HOUR + offsetMinutes * MILLIS_PER_MINUTE);
+                pos = offsetEnd;
+            }
+        }
+    }
+
+    if (parsedLength != nullptr)
+    {
+        *parsedLength = pos;
+    }
+    return millis;
+}
+
+std::optional<int64_t> findTimestamp(std::string_view line)
+{
+    const size_t searchEnd = std::min(line.size(), TIMESTAMP_SEARCH_LIMIT);
+    for (size_t pos = 0; pos < searchEnd; pos++)
+    {
+        // Timestamps start at the beginning of a number
+        if (!isDigit(line[pos]) || (pos > 0 && isDigit(line[pos - 1])))
+        {
+            continue;
+        }
+        if (auto timestamp = parseTimestamp(line.substr(pos)))
+        {
+            return timestamp;
+        }
+    }
+    return std::nullopt;
+}
+
+int64_t truncateTimestamp(const int64_t millis, const TimestampPrecision precision)
+{
+    int64_t unit = MILLIS_PER_SECOND;
+    switch (precision)
+    {
+    case TimestampPrecision::Second:
+        unit = MILLIS_PER_SECOND;
+        break;
+    case TimestampPrecision::Minute:
+        unit = MILLIS_PER_MINUTE;
+        break;
+    case TimestampPrecision::Hour:
+        unit = MILLIS_PER_HOUR;
+        break;
+    case TimestampPrecision::Day:
+        unit = MILLIS_PER_DAY;
+        break;
+    }
+    return floorDiv(millis, unit) * unit;
+}
+
+std::string formatTimestamp(const int64_t millis, const TimestampPrecision precision)
+{
+    using namespace std::chrono;
+
+    const int64_t days = floorDiv(millis, MILLIS_PER_DAY);
+    const int64_t millisOfDay = millis - days * MILLIS_PER_DAY;
+    const year_month_day date{sys_days{std::chrono::days{days}}};
+
+    const int hours = static_cast<int>(millisOfDay / MILLIS_PER_HOUR);
+    const int minutes = static_cast<int>(millisOfDay % MILLIS_PER_HOUR / MILLIS_PER_MINUTE);
+    const int seconds = static_cast<int>(millisOfDay % MILLIS_PER_MINUTE / MILLIS_PER_SECOND);
+
+    char buffer[64];
+    const int length = std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u %02d:%02d:%02d",
+                                     static_cast<int>(date.year()), static_cast<unsigned>(date.month()),
+                                     static_cast<unsigned>(date.day()), hours, minutes, seconds);
+
+    std::string text(buffer, std::max(length, 0));
+    switch (precision)
+    {
+    case TimestampPrecision::Second:
+        break;
+    case TimestampPrecision::Minute:
+        text.resize(16);
+        break;
+    case TimestampPrecision::Hour:
+        text.resize(13);
+        text += ":00";
+        break;
+    case TimestampPrecision::Day:
+        text.resize(10);
+        break;
+    }
+    return text;
+}
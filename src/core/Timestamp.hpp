@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Timestamps are kept as milliseconds since the Unix epoch (UTC).
+// Timestamps without a time zone are treated as UTC.
+
+enum class TimestampPrecision
+{
+    Second,
+    Minute,
+    Hour,
+    Day
+};
+
+// Parse an ISO 8601-like timestamp at the beginning of the text, e.g.
+// "2024-01-15T10:20:30.123Z", "2024-01-15 10:20:30,123" or "2024-01-15T10:20:30+02:00".
+// On success parsedLength (if given) receives the number of consumed characters.
+std::optional<int64_t> parseTimestamp(std::string_view text, size_t* parsedLength = nullptr);
+
+// Find the first timestamp near the beginning of a log line.
+std::optional<int64_t> findTimestamp(std::string_view line);
+
+// Truncate the timestamp to the given precision.
+int64_t truncateTimestamp(int64_t millis, TimestampPrecision precision);
+
+// Format as "YYYY-MM-DD HH:MM:SS" cut to the given precision.
+std::string formatTimestamp(int64_t millis, TimestampPrecision precision);
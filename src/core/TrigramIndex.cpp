@@ -0,0 +1,385 @@
+#include "TrigramIndex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace
+{
+// Blocks whose trigrams are collected before they are added to the posting lists
+constexpr size_t BLOCKS_PER_GROUP = 256;
+
+// Posting lists are built in shards selected by the low bits of the trigram, so that the shards can
+// be filled in parallel. Collected trigrams are tagged with their shard and sorted, which puts the
+// trigrams of every shard next to each other.
+constexpr uint32_t SHARD_BITS = 6;
+constexpr uint32_t NUMBER_OF_SHARDS = 1u << SHARD_BITS;
+constexpr uint32_t TRIGRAM_MASK = 0xFFFFFF;
+
+// Bytes hashed at both ends of the data to recognize it when the index is loaded
+constexpr size_t FINGERPRINT_SAMPLE_SIZE = 64 * 1024;
+
+constexpr char FILE_MAGIC[8] = {'L', 'V', 'T', 'R', 'I', 'G', 'R', 'M'};
+constexpr uint32_t FILE_VERSION = 1;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t linesPerBlock;
+    uint64_t numberOfLines;
+    uint64_t numberOfBlocks;
+    uint64_t fingerprint;
+    uint64_t numberOfTrigrams;
+    uint64_t numberOfPostingBytes;
+};
+
+struct PostingList
+{
+    std::vector<uint8_t> bytes;
+    uint32_t previousBlock = 0; // block + 1, so that every difference is at least 1
+};
+
+uint32_t tagWithShard(const uint32_t trigram)
+{
+    return ((trigram & (NUMBER_OF_SHARDS - 1)) << 24) | trigram;
+}
+
+void appendVarint(std::vector<uint8_t>& bytes, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+void collectTrigrams(const char* data, const std::pair<size_t, size_t>* lines, const size_t numberOfLines,
+                     std::vector<uint32_t>& result)
+{
+    // One bit for every possible trigram removes duplicates without sorting all of them
+    thread_local std::vector<uint64_t> seen(size_t{1} << (24 - 6));
+
+    result.clear();
+    for (size_t i = 0; i < numberOfLines; i++)
+    {
+        const auto* line = reinterpret_cast<const unsigned char*>(data + lines[i].first);
+        const size_t length = lines[i].second - lines[i].first;
+        if (length < 3)
+        {
+            continue;
+        }
+        uint32_t trigram = (line[0] << 8) | line[1];
+        for (size_t pos = 2; pos < length; pos++)
+        {
+            trigram = ((trigram << 8) | line[pos]) & TRIGRAM_MASK;
+            uint64_t& word = seen[trigram >> 6];
+            const uint64_t bit = uint64_t{1} << (trigram & 63);
+            if ((word & bit) == 0)
+            {
+                word |= bit;
+                result.push_back(tagWithShard(trigram));
+            }
+        }
+    }
+
+    for (const uint32_t tagged : result)
+    {
+        seen[(tagged & TRIGRAM_MASK) >> 6] = 0;
+    }
+    std::sort(result.begin(), result.end());
+}
+
+// Append blocks [firstBlock, firstBlock + numberOfBlocks) to the posting lists of one shard.
+// The blocks are appended in order, so the posting lists stay sorted.
+void addToShard(std::unordered_map<uint32_t, PostingList>& shard, const uint32_t shardIndex,
+                const std::vector<std::vector<uint32_t>>& blockTrigrams, const size_t numberOfBlocks,
+                const size_t firstBlock)
+{
+    for (size_t i = 0; i < numberOfBlocks; i++)
+    {
+        const auto& tagged = blockTrigrams[i];
+        auto it = std::lower_bound(tagged.begin(), tagged.end(), shardIndex << 24);
+        const auto end = std::lower_bound(it, tagged.end(), (shardIndex + 1) << 24);
+        const auto block = static_cast<uint32_t>(firstBlock + i + 1);
+        for (; it != end; ++it)
+        {
+            PostingList& list = shard[*it & TRIGRAM_MASK];
+            appendVarint(list.bytes, block - list.previousBlock);
+            list.previousBlock = block;
+        }
+    }
+}
+
+uint64_t hashBytes(uint64_t hash, const void* bytes, const size_t size)
+{
+    // FNV-1a
+    const auto* data = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+} // namespace
+
+TrigramIndex::TrigramIndex(const size_t linesPerBlock) : linesPerBlock(std::max<size_t>(1, linesPerBlock))
+{
+}
+
+bool TrigramIndex::build(const char* data, const std::vector<std::pair<size_t, size_t>>& lines,
+                         TaskScheduler& scheduler, std::stop_token stopToken, const AccessCallback& onAccess)
+{
+    numberOfLines = lines.size();
+    numberOfBlocks = (numberOfLines + linesPerBlock - 1) / linesPerBlock;
+    fingerprint = computeFingerprint(data, lines);
+    trigrams.clear();
+    postingOffsets.clear();
+    postings.clear();
+
+    std::vector<std::unordered_map<uint32_t, PostingList>> shards(NUMBER_OF_SHARDS);
+    std::vector<std::vector<uint32_t>> blockTrigrams(BLOCKS_PER_GROUP);
+    for (size_t groupBegin = 0; groupBegin < numberOfBlocks; groupBegin += BLOCKS_PER_GROUP)
+    {
+        const size_t groupSize = std::min(BLOCKS_PER_GROUP, numberOfBlocks - groupBegin);
+        auto collectGroup = [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++)
+            {
+                const size_t firstLine = (groupBegin + i) * linesPerBlock;
+                const size_t blockLines = std::min(linesPerBlock, numberOfLines - firstLine);
+                if (onAccess)
+                {
+                    onAccess(lines[firstLine].first, lines[firstLine + blockLines - 1].second);
+                }
+                collectTrigrams(data, lines.data() + firstLine, blockLines, blockTrigrams[i]);
+            }
+        };
+        auto addGroup = [&](size_t firstShard, size_t lastShard, size_t) {
+            for (size_t shard = firstShard; shard < lastShard; shard++)
+            {
+                addToShard(shards[shard], static_cast<uint32_t>(shard), blockTrigrams, groupSize, groupBegin);
+            }
+        };
+        scheduler.parallelFor(groupSize, 1, TaskPriority::Background, stopToken, collectGroup);
+        scheduler.parallelFor(NUMBER_OF_SHARDS, 1, TaskPriority::Background, stopToken, addGroup);
+
+        if (stopToken.stop_requested())
+        {
+            return false;
+        }
+    }
+
+    // Concatenate the posting lists in the order of trigrams
+    std::vector<std::pair<uint32_t, PostingList*>> lists;
+    for (auto& shard : shards)
+    {
+        for (auto& [trigram, list] : shard)
+        {
+            lists.emplace_back(trigram, &list);
+        }
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    trigrams.reserve(lists.size());
+    postingOffsets.reserve(lists.size() + 1);
+    for (auto& [trigram, list] : lists)
+    {
+        trigrams.push_back(trigram);
+        postingOffsets.push_back(postings.size());
+        postings.insert(postings.end(), list->bytes.begin(), list->bytes.end());
+        list->bytes = {}; // free memory early
+    }
+    postingOffsets.push_back(postings.size());
+    return true;
+}
+
+bool TrigramIndex::save(const std::string& path) const
+{
+    // Write to a temporary file first, so that a half-written index is never loaded
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        FileHeader header{};
+        std::copy(std::begin(FILE_MAGIC), std::end(FILE_MAGIC), header.magic);
+        header.version = FILE_VERSION;
+        header.linesPerBlock = linesPerBlock;
+        header.numberOfLines = numberOfLines;
+        header.numberOfBlocks = numberOfBlocks;
+        header.fingerprint = fingerprint;
+        header.numberOfTrigrams = trigrams.size();
+        header.numberOfPostingBytes = postings.size();
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(trigrams.data()),
+                     static_cast<std::streamsize>(trigrams.size() * sizeof(uint32_t)));
+        output.write(reinterpret_cast<const char*>(postingOffsets.data()),
+                     static_cast<std::streamsize>(postingOffsets.size() * sizeof(uint64_t)));
+        output.write(reinterpret_cast<const char*>(postings.data()), static_cast<std::streamsize>(postings.size()));
+        if (!output)
+        {
+            output.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str()); // rename does not replace files on Windows
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool TrigramIndex::load(const std::string& path, const char* data,
+                        const std::vector<std::pair<size_t, size_t>>& lines)
+{
+    std::ifstream input(path, std::ios::binary);
+    FileHeader header{};
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !std::equal(std::begin(FILE_MAGIC), std::end(FILE_MAGIC), header.magic) || header.version != FILE_VERSION ||
+        header.linesPerBlock == 0 || header.numberOfLines != lines.size() ||
+        header.numberOfBlocks != (lines.size() + header.linesPerBlock - 1) / header.linesPerBlock ||
+        header.fingerprint != computeFingerprint(data, lines))
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> loadedTrigrams(header.numberOfTrigrams);
+    std::vector<uint64_t> loadedOffsets(header.numberOfTrigrams + 1);
+    std::vector<uint8_t> loadedPostings(header.numberOfPostingBytes);
+    input.read(reinterpret_cast<char*>(loadedTrigrams.data()),
+               static_cast<std::streamsize>(loadedTrigrams.size() * sizeof(uint32_t)));
+    input.read(reinterpret_cast<char*>(loadedOffsets.data()),
+               static_cast<std::streamsize>(loadedOffsets.size() * sizeof(uint64_t)));
+    input.read(reinterpret_cast<char*>(loadedPostings.data()), static_cast<std::streamsize>(loadedPostings.size()));
+    if (!input || loadedOffsets.back() != loadedPostings.size())
+    {
+        return false;
+    }
+
+    linesPerBlock = header.linesPerBlock;
+    numberOfLines = header.numberOfLines;
+    numberOfBlocks = header.numberOfBlocks;
+    fingerprint = header.fingerprint;
+    trigrams = std::move(loadedTrigrams);
+    postingOffsets = std::move(loadedOffsets);
+    postings = std::move(loadedPostings);
+    return true;
+}
+
+std::string TrigramIndex::getIndexPath(const std::string& logPath)
+{
+    return logPath + ".trigrams";
+}
+
+std::optional<std::vector<uint32_t>> TrigramIndex::findCandidateBlocks(const std::string_view text) const
+{
+    if (text.size() < 3 || postingOffsets.empty())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<uint32_t> textTrigrams;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    for (size_t pos = 0; pos + 3 <= text.size(); pos++)
+    {
+        textTrigrams.push_back((bytes[pos] << 16) | (bytes[pos + 1] << 8) | bytes[pos + 2]);
+    }
+    std::sort(textTrigrams.begin(), textTrigrams.end());
+    textTrigrams.erase(std::unique(textTrigrams.begin(), textTrigrams.end()), textTrigrams.end());
+
+    // Intersect the posting lists starting from the shortest one
+    std::vector<size_t> listIndices;
+    for (const uint32_t trigram : textTrigrams)
+    {
+        const auto it = std::lower_bound(trigrams.begin(), trigrams.end(), trigram);
+        if (it == trigrams.end() || *it != trigram)
+        {
+            return std::vector<uint32_t>{}; // no block has this trigram
+        }
+        listIndices.push_back(static_cast<size_t>(it - trigrams.begin()));
+    }
+    std::sort(listIndices.begin(), listIndices.end(), [this](size_t a, size_t b) {
+        return postingOffsets[a + 1] - postingOffsets[a] < postingOffsets[b + 1] - postingOffsets[b];
+    });
+
+    std::vector<uint32_t> blocks = decodePostings(listIndices.front());
+    std::vector<uint32_t> intersection;
+    for (size_t i = 1; i < listIndices.size() && !blocks.empty(); i++)
+    {
+        const std::vector<uint32_t> other = decodePostings(listIndices[i]);
+        intersection.clear();
+        std::set_intersection(blocks.begin(), blocks.end(), other.begin(), other.end(),
+                              std::back_inserter(intersection));
+        blocks.swap(intersection);
+    }
+    return blocks;
+}
+
+std::vector<uint32_t> TrigramIndex::getLinesOfBlocks(const std::vector<uint32_t>& blocks) const
+{
+    std::vector<uint32_t> lineIndices;
+    for (const uint32_t block : blocks)
+    {
+        const size_t firstLine = block * linesPerBlock;
+        const size_t lastLine = std::min(numberOfLines, firstLine + linesPerBlock);
+        for (size_t lineIndex = firstLine; lineIndex < lastLine; lineIndex++)
+        {
+            lineIndices.push_back(static_cast<uint32_t>(lineIndex));
+        }
+    }
+    return lineIndices;
+}
+
+size_t TrigramIndex::getLinesPerBlock() const
+{
+    return linesPerBlock;
+}
+
+size_t TrigramIndex::getNumberOfBlocks() const
+{
+    return numberOfBlocks;
+}
+
+size_t TrigramIndex::getMemoryUsage() const
+{
+    return trigrams.size() * sizeof(uint32_t) + postingOffsets.size() * sizeof(uint64_t) + postings.size();
+}
+
+std::vector<uint32_t> TrigramIndex::decodePostings(const size_t trigramIndex) const
+{
+    std::vector<uint32_t> blocks;
+    uint32_t block = 0;
+    uint32_t value = 0;
+    int shift = 0;
+    for (uint64_t pos = postingOffsets[trigramIndex]; pos < postingOffsets[trigramIndex + 1]; pos++)
+    {
+        value |= static_cast<uint32_t>(postings[pos] & 0x7F) << shift;
+        shift += 7;
+        if ((postings[pos] & 0x80) == 0)
+        {
+            block += value;
+            blocks.push_back(block - 1);
+            value = 0;
+            shift = 0;
+        }
+    }
+    return blocks;
+}
+
+uint64_t TrigramIndex::computeFingerprint(const char* data, const std::vector<std::pair<size_t, size_t>>& lines)
+{
+    // The last line ends at the end of data
+    const size_t dataSize = lines.empty() ? 0 : lines.back().second;
+    const size_t sampleSize = std::min(dataSize, FINGERPRINT_SAMPLE_SIZE);
+    const size_t numberOfLines = lines.size();
+
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, &dataSize, sizeof(dataSize));
+    hash = hashBytes(hash, &numberOfLines, sizeof(numberOfLines));
+    hash = hashBytes(hash, data, sampleSize);
+    hash = hashBytes(hash, data + dataSize - sampleSize, sampleSize);
+    return hash;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "TaskScheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Index of 3-byte sequences (trigrams) occurring in blocks of lines.
+// A line can contain a text only if it contains all trigrams of the text, so a search for a text of at
+// least 3 bytes needs to scan only the blocks that have all of them. Every trigram has a posting list
+// of block numbers, stored as differences between consecutive blocks encoded as variable-length integers.
+// Bigger blocks make the index smaller but the candidate blocks coarser.
+class TrigramIndex
+{
+public:
+    static constexpr size_t DEFAULT_LINES_PER_BLOCK = 64;
+
+    // Receives a range of data before it is read. Called from many threads at once.
+    using AccessCallback = std::function<void(size_t, size_t)>;
+
+    explicit TrigramIndex(size_t linesPerBlock = DEFAULT_LINES_PER_BLOCK);
+
+    // Returns false if the build was cancelled. Trigrams never span two lines.
+    bool build(const char* data, const std::vector<std::pair<size_t, size_t>>& lines, TaskScheduler& scheduler,
+               std::stop_token stopToken, const AccessCallback& onAccess = {});
+
+    // Save the index next to the log. The file is tied to the data it was built from
+    // and load() rejects it if the data has changed since.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path, const char* data, const std::vector<std::pair<size_t, size_t>>& lines);
+
+    // Path of the file with the index of the given log.
+    static std::string getIndexPath(const std::string& logPath);
+
+    // Sorted blocks that may contain the text.
+    // Returns nothing if the index cannot narrow the search, e.g. for texts shorter than 3 bytes.
+    std::optional<std::vector<uint32_t>> findCandidateBlocks(std::string_view text) const;
+
+    // Sorted indices of all lines in the given blocks.
+    std::vector<uint32_t> getLinesOfBlocks(const std::vector<uint32_t>& blocks) const;
+
+    size_t getLinesPerBlock() const;
+    size_t getNumberOfBlocks() const;
+    size_t getMemoryUsage() const;
+
+private:
+    std::vector<uint32_t> decodePostings(size_t trigramIndex) const;
+    static uint64_t computeFingerprint(const char* data, const std::vector<std::pair<size_t, size_t>>& lines);
+
+    size_t linesPerBlock;
+    size_t numberOfLines = 0;
+    size_t numberOfBlocks = 0;
+    uint64_t fingerprint = 0;
+
+    // Posting list of trigrams[i] is postings[postingOffsets[i], postingOffsets[i + 1])
+    std::vector<uint32_t> trigrams;
+    std::vector<uint64_t> postingOffsets;
+    std::vector<uint8_t> postings;
+};
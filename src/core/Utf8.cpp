@@ -0,0 +1,186 @@
+#include "Utf8.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LOGVIEWER_SSE2 1
+#endif
+
+namespace
+{
+bool isContinuationByte(const unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+// Returns the number of bytes of the ASCII prefix of [p, end)
+size_t asciiPrefixLength(const unsigned char* begin, const unsigned char* end)
+{
+    const unsigned char* p = begin;
+#ifdef LOGVIEWER_SSE2
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = _mm_movemask_epi8(chunk); // one bit per byte with the highest bit set
+        if (mask != 0)
+        {
+            break;
+        }
+        p += 16;
+    }
+#else
+    while (end - p >= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        if ((word & 0x8080808080808080ull) != 0)
+        {
+            break;
+        }
+        p += 8;
+    }
+#endif
+    while (p < end && *p < 0x80)
+    {
+        p++;
+    }
+    return p - begin;
+}
+
+// Validate one multi-byte sequence starting at p. Returns its length or 0 if it is invalid.
+size_t validateSequence(const unsigned char* p, const unsigned char* end)
+{
+    const unsigned char lead = *p;
+    size_t length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF)
+        length = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        if (lead == 0xE0)
+            min = 0xA0; // overlong
+        if (lead == 0xED)
+            max = 0x9F; // surrogates
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        if (lead == 0xF0)
+            min = 0x90; // overlong
+        if (lead == 0xF4)
+            max = 0x8F; // above U+10FFFF
+    }
+    else
+        return 0;
+
+    if (static_cast<size_t>(end - p) < length || p[1] < min || p[1] > max)
+    {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++)
+    {
+        if (!isContinuationByte(p[i]))
+        {
+            return 0;
+        }
+    }
+    return length;
+}
+} // namespace
+
+bool isValidUtf8(std::string_view text)
+{
+    return findInvalidUtf8(text) == std::string_view::npos;
+}
+
+size_t findInvalidUtf8(std::string_view text)
+{
+    const auto* begin = reinterpret_cast<const unsigned char*>(text.data());
+    const auto* end = begin + text.size();
+    const auto* p = begin;
+    while (p < end)
+    {
+        p += asciiPrefixLength(p, end);
+        if (p >= end)
+        {
+            break;
+        }
+        const size_t length = validateSequence(p, end);
+        if (length == 0)
+        {
+            return p - begin;
+        }
+        p += length;
+    }
+    return std::string_view::npos;
+}
+
+bool isAscii(std::string_view text)
+{
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+    return asciiPrefixLength(p, p + text.size()) == text.size();
+}
+
+size_t countCodePoints(std::string_view text)
+{
+    const auto* begin = reinterpret_cast<const unsigned char*>(text.data());
+    size_t count = 0;
+    size_t offset = 0;
+    while (offset < text.size())
+    {
+        const size_t asciiLength = asciiPrefixLength(begin + offset, begin + text.size());
+        count += asciiLength;
+        offset += asciiLength;
+        if (offset < text.size())
+        {
+            offset = nextCodePoint(text, offset);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t offsetOfCodePoint(std::string_view text, size_t codePointIndex)
+{
+    size_t offset = 0;
+    while (offset < text.size() && codePointIndex > 0)
+    {
+        offset = nextCodePoint(text, offset);
+        codePointIndex--;
+    }
+    return offset;
+}
+
+size_t alignToCodePoint(std::string_view text, size_t offset)
+{
+    if (offset >= text.size())
+    {
+        return text.size();
+    }
+    // A code point has at most 3 continuation bytes
+    for (size_t i = 0; i < 3 && offset > 0 && isContinuationByte(static_cast<unsigned char>(text[offset])); i++)
+    {
+        offset--;
+    }
+    return offset;
+}
+
+size_t nextCodePoint(std::string_view text, size_t offset)
+{
+    if (offset >= text.size())
+    {
+        return text.size();
+    }
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data()) + offset;
+    if (*p < 0x80)
+    {
+        return offset + 1;
+    }
+    const size_t length = validateSequence(p, reinterpret_cast<const unsigned char*>(text.data()) + text.size());
+    return offset + (length == 0 ? 1 : length);
+}
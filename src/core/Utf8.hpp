@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// Helpers for UTF-8 text. Invalid bytes are treated as single characters.
+
+// Returns true if the text is valid UTF-8. Blocks of ASCII are checked 16 bytes at once.
+bool isValidUtf8(std::string_view text);
+
+// Returns the offset of the first byte that is not a part of a valid UTF-8 sequence
+// or std::string_view::npos if the whole text is valid.
+size_t findInvalidUtf8(std::string_view text);
+
+// Returns true if the text contains only ASCII characters.
+bool isAscii(std::string_view text);
+
+// Number of code points in the text.
+size_t countCodePoints(std::string_view text);
+
+// Byte offset of the code point with the given index (or text.size() if there are fewer code points).
+size_t offsetOfCodePoint(std::string_view text, size_t codePointIndex);
+
+// Offset of the beginning of the code point containing the byte at the given offset.
+size_t alignToCodePoint(std::string_view text, size_t offset);
+
+// Offset of the code point following the one that begins at the given offset.
+size_t nextCodePoint(std::string_view text, size_t offset);
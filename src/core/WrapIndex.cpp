@@ -0,0 +1,131 @@
+#include "WrapIndex.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+void WrapIndex::reset(const size_t numberOfLines)
+{
+    this->numberOfLines = numberOfLines;
+    measuredLines = 0;
+    measuredRows = 0;
+    blocks.clear();
+    blocks.resize((numberOfLines + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+size_t WrapIndex::getNumberOfLines() const
+{
+    return numberOfLines;
+}
+
+bool WrapIndex::isMeasured(const size_t line) const
+{
+    assert(line < numberOfLines);
+    const Block& block = blocks[line / BLOCK_SIZE];
+    return !block.rows.empty() && block.rows[line % BLOCK_SIZE] != 0;
+}
+
+void WrapIndex::setNumberOfRows(const size_t line, uint32_t rows)
+{
+    assert(line < numberOfLines);
+    rows = std::max<uint32_t>(rows, 1);
+
+    Block& block = blocks[line / BLOCK_SIZE];
+    if (block.rows.empty())
+    {
+        block.rows.resize(getLinesInBlock(line / BLOCK_SIZE), 0);
+    }
+
+    uint32_t& oldRows = block.rows[line % BLOCK_SIZE];
+    if (oldRows == 0)
+    {
+        block.measuredLines++;
+        measuredLines++;
+    }
+    block.measuredRows = block.measuredRows - oldRows + rows;
+    measuredRows = measuredRows - oldRows + rows;
+    oldRows = rows;
+}
+
+uint32_t WrapIndex::getNumberOfRows(const size_t line) const
+{
+    assert(line < numberOfLines);
+    const Block& block = blocks[line / BLOCK_SIZE];
+    if (!block.rows.empty() && block.rows[line % BLOCK_SIZE] != 0)
+    {
+        return block.rows[line % BLOCK_SIZE];
+    }
+    return getEstimatedRowsPerLine();
+}
+
+size_t WrapIndex::getTotalRows() const
+{
+    return measuredRows + (numberOfLines - measuredLines) * getEstimatedRowsPerLine();
+}
+
+size_t WrapIndex::getFirstRowOfLine(const size_t line) const
+{
+    const size_t lastBlock = std::min(line, numberOfLines) / BLOCK_SIZE;
+    size_t row = 0;
+    for (size_t blockIndex = 0; blockIndex < lastBlock; blockIndex++)
+    {
+        row += getRowsInBlock(blocks[blockIndex], getLinesInBlock(blockIndex));
+    }
+    for (size_t i = lastBlock * BLOCK_SIZE; i < line && i < numberOfLines; i++)
+    {
+        row += getNumberOfRows(i);
+    }
+    return row;
+}
+
+std::pair<size_t, size_t> WrapIndex::findLineOfRow(size_t row) const
+{
+    if (numberOfLines == 0)
+    {
+        return {0, 0};
+    }
+
+    for (size_t blockIndex = 0; blockIndex < blocks.size(); blockIndex++)
+    {
+        const size_t linesInBlock = getLinesInBlock(blockIndex);
+        const size_t rowsInBlock = getRowsInBlock(blocks[blockIndex], linesInBlock);
+        if (row >= rowsInBlock)
+        {
+            row -= rowsInBlock;
+            continue;
+        }
+
+        for (size_t line = blockIndex * BLOCK_SIZE; line < blockIndex * BLOCK_SIZE + linesInBlock; line++)
+        {
+            const size_t rowsInLine = getNumberOfRows(line);
+            if (row < rowsInLine)
+            {
+                return {line, row};
+            }
+            row -= rowsInLine;
+        }
+    }
+
+    // Past the end, return the last row
+    const size_t lastLine = numberOfLines - 1;
+    return {lastLine, getNumberOfRows(lastLine) - 1};
+}
+
+size_t WrapIndex::getLinesInBlock(const size_t blockIndex) const
+{
+    return std::min(BLOCK_SIZE, numberOfLines - blockIndex * BLOCK_SIZE);
+}
+
+size_t WrapIndex::getRowsInBlock(const Block& block, const size_t linesInBlock) const
+{
+    return block.measuredRows + (linesInBlock - block.measuredLines) * getEstimatedRowsPerLine();
+}
+
+uint32_t WrapIndex::getEstimatedRowsPerLine() const
+{
+    if (measuredLines == 0)
+    {
+        return 1;
+    }
+    // Rounded to the nearest integer, so that the estimates of blocks and lines add up
+    return static_cast<uint32_t>(std::max<size_t>(1, (measuredRows + measuredLines / 2) / measuredLines));
+}
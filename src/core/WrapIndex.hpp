@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Number of visual rows that each line takes when long lines are wrapped.
+// Measuring every line of a huge file would be too slow, so only lines that have been displayed
+// are measured. The rest is estimated from the average of the measured ones. The estimate is refined
+// as more lines get measured, the totals are kept per block of lines, so lookups only walk the blocks.
+class WrapIndex
+{
+public:
+    void reset(size_t numberOfLines);
+
+    size_t getNumberOfLines() const;
+    bool isMeasured(size_t line) const;
+    void setNumberOfRows(size_t line, uint32_t rows);
+
+    // Exact for measured lines, estimated for the rest.
+    uint32_t getNumberOfRows(size_t line) const;
+    size_t getTotalRows() const;
+    size_t getFirstRowOfLine(size_t line) const;
+
+    // Returns the line that contains the given row and the index of the row within that line.
+    std::pair<size_t, size_t> findLineOfRow(size_t row) const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 1024;
+
+    struct Block
+    {
+        std::vector<uint32_t> rows; // allocated when the first line of the block is measured, 0 = not measured
+        size_t measuredLines = 0;
+        size_t measuredRows = 0;
+    };
+
+    size_t getLinesInBlock(size_t blockIndex) const;
+    size_t getRowsInBlock(const Block& block, size_t linesInBlock) const;
+    uint32_t getEstimatedRowsPerLine() const;
+
+    std::vector<Block> blocks;
+    size_t numberOfLines = 0;
+    size_t measuredLines = 0;
+    size_t measuredRows = 0;
+};
@@ -0,0 +1,45 @@
+#include "DecodedLineCache.hpp"
+
+#include <algorithm>
+
+DecodedLineCache::DecodedLineCache()
+{
+    // Views of the texts are returned, so they must not be moved
+    decodedLines.reserve(MAX_LINES);
+}
+
+void DecodedLineCache::clear()
+{
+    decodedLines.clear();
+}
+
+std::string_view DecodedLineCache::getText(const size_t lineIndex, std::string_view bytes, const TextEncoding encoding)
+{
+    useCounter++;
+    for (Line& line : decodedLines)
+    {
+        if (line.lineIndex == lineIndex)
+        {
+            line.lastUse = useCounter;
+            return line.text;
+        }
+    }
+
+    // Replace the least recently used line
+    Line* line = nullptr;
+    if (decodedLines.size() < MAX_LINES)
+    {
+        line = &decodedLines.emplace_back();
+    }
+    else
+    {
+        line = &*std::min_element(decodedLines.begin(), decodedLines.end(),
+                                  [](const Line& a, const Line& b) { return a.lastUse < b.lastUse; });
+    }
+
+    line->lineIndex = lineIndex;
+    line->lastUse = useCounter;
+    line->text.clear();
+    decodeToUtf8(bytes, encoding, line->text);
+    return line->text;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "core/TextEncoding.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Lines of text in other encodings than UTF-8, decoded to UTF-8 for drawing and measuring.
+// Only the lines displayed most recently are kept, the text is never decoded as a whole.
+class DecodedLineCache
+{
+public:
+    DecodedLineCache();
+
+    // Must be called when the text changes.
+    void clear();
+
+    // The returned text is valid until the line is evicted by MAX_LINES other lines.
+    std::string_view getText(size_t lineIndex, std::string_view bytes, TextEncoding encoding);
+
+private:
+    static constexpr size_t MAX_LINES = 256;
+
+    struct Line
+    {
+        size_t lineIndex = 0;
+        uint64_t lastUse = 0;
+        std::string text;
+    };
+
+    std::vector<Line> decodedLines;
+    uint64_t useCounter = 0;
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include "core/LogDiff.hpp"
+#include "core/MappedFile.hpp"
+#include "widgets/LogDisplayWidget.hpp"
+
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Check_Button.H>
+#include <FL/Fl_Flex.H>
+#include <FL/Fl_Window.H>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Window showing two logs side by side with their differences highlighted.
+// Scrolling one view scrolls the other one to the matching line. The masks choose which parts of the lines
+// are ignored, changing them needs a new comparison.
+class DiffWindow : public Fl_Window
+{
+public:
+    DiffWindow(const int w, const int h) : Fl_Window(w, h, "Compare")
+    {
+        constexpr int margin = 4;
+        constexpr int rowHeight = 25;
+
+        auto* toolbar = new Fl_Flex(margin, margin, w - 2 * margin, rowHeight, Fl_Flex::HORIZONTAL);
+        toolbar->gap(margin);
+        timestampsButton = addCheckButton("Timestamps", "Ignore timestamps");
+        numbersButton = addCheckButton("Numbers", "Ignore numbers, e.g. PIDs, thread IDs and durations");
+        hexIdsButton = addCheckButton("Hex IDs", "Ignore hexadecimal IDs and addresses");
+        addButton("Compare", [this] {
+            if (compareCallback)
+                compareCallback(getMasks());
+        });
+        cancelButton = addButton("Cancel", [this] {
+            if (cancelCallback)
+                cancelCallback();
+        });
+        cancelButton->deactivate();
+        differencesOnlyButton = addCheckButton("Differences Only", "Show only the lines that differ");
+        differencesOnlyButton->value(0);
+        differencesOnlyButton->callback(
+            [](Fl_Widget*, void* pThis) { static_cast<DiffWindow*>(pThis)->updateFilters(); }, this);
+        addButton("@<", [this] { goToDifference(false); })->tooltip("Previous difference");
+        addButton("@>", [this] { goToDifference(true); })->tooltip("Next difference");
+        toolbar->end();
+
+        const int viewsTop = 2 * margin + rowHeight;
+        auto* views = new Fl_Flex(0, viewsTop, w, h - viewsTop - rowHeight, Fl_Flex::HORIZONTAL);
+        views->gap(margin);
+        displays[0] = new LogDisplayWidget(0, 0, 0, 0);
+        displays[1] = new LogDisplayWidget(0, 0, 0, 0);
+        views->end();
+        displays[0]->onViewportChanged([this](size_t begin, size_t) { alignViews(0, begin); });
+        displays[1]->onViewportChanged([this](size_t begin, size_t) { alignViews(1, begin); });
+
+        status = new Fl_Box(margin, h - rowHeight, w - 2 * margin, rowHeight);
+        status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+
+        resizable(views);
+        end();
+    }
+
+    // Set callback for the Compare button. The callback receives the masks chosen by the user.
+    void onCompare(std::function<void(const DiffMasks&)> callback)
+    {
+        compareCallback = std::move(callback);
+    }
+
+    void onCancel(std::function<void()> callback)
+    {
+        cancelCallback = std::move(callback);
+    }
+
+    DiffMasks getMasks() const
+    {
+        DiffMasks masks;
+        masks.timestamps = timestampsButton->value() != 0;
+        masks.numbers = numbersButton->value() != 0;
+        masks.hexIds = hexIdsButton->value() != 0;
+        return masks;
+    }
+
+    void setRunning(const bool running)
+    {
+        running ? cancelButton->activate() : cancelButton->deactivate();
+    }
+
+    void setStatus(const std::string& text)
+    {
+        status->copy_label(text.c_str());
+        status->redraw();
+    }
+
+    // Display both logs with the differences found in them. The window keeps the files mapped until
+    // it displays other ones.
+    void setDiff(std::shared_ptr<MappedFile> leftFile, std::shared_ptr<LineIndex> leftLines,
+                 std::shared_ptr<MappedFile> rightFile, std::shared_ptr<LineIndex> rightLines,
+                 std::vector<DiffHunk> diffHunks)
+    {
+        hunks = std::move(diffHunks);
+        files = {std::move(leftFile), std::move(rightFile)};
+        displays[0]->setData(files[0]->data(), files[0]->size(), std::move(leftLines));
+        displays[1]->setData(files[1]->data(), files[1]->size(), std::move(rightLines));
+        topLines = {0, 0};
+        copy_label(("Compare " + files[0]->getPath() + " with " + files[1]->getPath()).c_str());
+
+        // Removed lines are red on the left, added lines are green on the right
+        std::vector<std::pair<size_t, size_t>> leftRanges;
+        std::vector<std::pair<size_t, size_t>> rightRanges;
+        for (const DiffHunk& hunk : hunks)
+        {
+            if (hunk.leftBegin < hunk.leftEnd)
+                leftRanges.emplace_back(hunk.leftBegin, hunk.leftEnd);
+            if (hunk.rightBegin < hunk.rightEnd)
+                rightRanges.emplace_back(hunk.rightBegin, hunk.rightEnd);
+        }
+        displays[0]->setMarkedLines(std::move(leftRanges), removedLinesColor);
+        displays[1]->setMarkedLines(std::move(rightRanges), addedLinesColor);
+        updateFilters();
+    }
+
+    // Release both files, e.g. before comparing other ones
+    void clear()
+    {
+        displays[0]->setData(nullptr, 0, std::make_shared<LineIndex>());
+        displays[1]->setData(nullptr, 0, std::make_shared<LineIndex>());
+        files = {};
+        hunks.clear();
+        topLines = {0, 0};
+    }
+
+private:
+    Fl_Check_Button* addCheckButton(const char* label, const char* tooltip)
+    {
+        auto* button = new Fl_Check_Button(0, 0, 0, 0, label);
+        button->tooltip(tooltip);
+        button->value(1);
+        return button;
+    }
+
+    Fl_Button* addButton(const char* label, std::function<void()> action)
+    {
+        auto* button = new Fl_Button(0, 0, 0, 0, label);
+        buttonActions.push_back(std::make_unique<std::function<void()>>(std::move(action)));
+        button->callback(
+            [](Fl_Widget*, void* action) { (*static_cast<std::function<void()>*>(action))(); },
+            buttonActions.back().get());
+        return button;
+    }
+
+    // Scroll the other view to the line next to the top line of the view that moved. The top lines
+    // set here are remembered, so that the other view does not move this one back when it reports them.
+    void alignViews(const size_t side, const size_t begin)
+    {
+        if (files[0] == nullptr)
+        {
+            return;
+        }
+        const size_t topLine = displays[side]->getIndexedLines().findLine(begin);
+        if (topLine == topLines[side] || differencesOnlyButton->value() != 0)
+        {
+            topLines[side] = topLine;
+            return;
+        }
+        const size_t otherSide = 1 - side;
+        const size_t otherLine =
+            side == 0 ? LogDiff::mapLeftToRight(hunks, topLine) : LogDiff::mapRightToLeft(hunks, topLine);
+        topLines[side] = topLine;
+        topLines[otherSide] = otherLine;
+        displays[otherSide]->scrollToLine(otherLine);
+    }
+
+    // Show both sides of the next (or the previous) difference after the top line of the left view
+    void goToDifference(const bool next)
+    {
+        if (hunks.empty())
+        {
+            return;
+        }
+        auto hunk = hunks.end();
+        if (next)
+        {
+            hunk = std::upper_bound(hunks.begin(), hunks.end(), topLines[0],
+                                    [](size_t line, const DiffHunk& h) { return line < h.leftBegin; });
+        }
+        else
+        {
+            const auto atTop = std::lower_bound(hunks.begin(), hunks.end(), topLines[0],
+                                                [](const DiffHunk& h, size_t line) { return h.leftBegin < line; });
+            if (atTop != hunks.begin())
+            {
+                hunk = std::prev(atTop);
+            }
+        }
+        if (hunk == hunks.end())
+        {
+            setStatus("No more differences");
+            return;
+        }
+
+        topLines = {hunk->leftBegin, hunk->rightBegin};
+        displays[0]->scrollToLine(hunk->leftBegin);
+        displays[1]->scrollToLine(hunk->rightBegin);
+        setStatus("Difference " + std::to_string(hunk - hunks.begin() + 1) + " of " + std::to_string(hunks.size()));
+    }
+
+    void updateFilters()
+    {
+        if (differencesOnlyButton->value() == 0)
+        {
+            displays[0]->clearLineFilter();
+            displays[1]->clearLineFilter();
+            return;
+        }
+        std::vector<size_t> leftLines;
+        std::vector<size_t> rightLines;
+        for (const DiffHunk& hunk : hunks)
+        {
+            for (size_t line = hunk.leftBegin; line < hunk.leftEnd; line++)
+                leftLines.push_back(line);
+            for (size_t line = hunk.rightBegin; line < hunk.rightEnd; line++)
+                rightLines.push_back(line);
+        }
+        displays[0]->setLineFilter(std::move(leftLines));
+        displays[1]->setLineFilter(std::move(rightLines));
+    }
+
+    Fl_Check_Button* timestampsButton = nullptr;
+    Fl_Check_Button* numbersButton = nullptr;
+    Fl_Check_Button* hexIdsButton = nullptr;
+    Fl_Check_Button* differencesOnlyButton = nullptr;
+    Fl_Button* cancelButton = nullptr;
+    std::array<LogDisplayWidget*, 2> displays{};
+    Fl_Box* status = nullptr;
+    std::vector<std::unique_ptr<std::function<void()>>> buttonActions;
+
+    std::array<std::shared_ptr<MappedFile>, 2> files;
+    std::vector<DiffHunk> hunks;
+    std::array<size_t, 2> topLines{0, 0};
+    Fl_Color removedLinesColor = fl_rgb_color(255, 220, 220);
+    Fl_Color addedLinesColor = fl_rgb_color(220, 245, 220);
+
+    std::function<void(const DiffMasks&)> compareCallback;
+    std::function<void()> cancelCallback;
+};
@@ -0,0 +1,212 @@
+#pragma once
+#include "core/FileSearch.hpp"
+
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Flex.H>
+#include <FL/Fl_Hold_Browser.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Native_File_Chooser.H>
+#include <FL/Fl_Window.H>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Window for searching all files of a directory for plain text.
+// Every file with matches has a row with the number of matching lines followed by a row for every hit.
+// Selecting a row reports the file and, for hit rows, the index of the line.
+class FileSearchWindow : public Fl_Window
+{
+public:
+    FileSearchWindow(const int w, const int h) : Fl_Window(w, h, "Search in Files")
+    {
+        constexpr int margin = 4;
+        constexpr int rowHeight = 25;
+
+        auto* directoryRow = new Fl_Flex(margin, margin, w - 2 * margin, rowHeight, Fl_Flex::HORIZONTAL);
+        directoryRow->gap(margin);
+        directoryInput = new Fl_Input(0, 0, 0, 0);
+        directoryInput->tooltip("Directory with the files to search, e.g. a directory of rotated logs");
+        auto* browseButton = new Fl_Button(0, 0, 0, 0, "Browse...");
+        browseButton->callback(reinterpret_cast<Fl_Callback*>(browseCallback), this);
+        directoryRow->fixed(browseButton, 80);
+        directoryRow->end();
+
+        auto* textRow = new Fl_Flex(margin, 2 * margin + rowHeight, w - 2 * margin, rowHeight, Fl_Flex::HORIZONTAL);
+        textRow->gap(margin);
+        textInput = new Fl_Input(0, 0, 0, 0);
+        textInput->tooltip("Text to find, compressed files (.gz) are searched too");
+        textInput->callback(reinterpret_cast<Fl_Callback*>(searchCallback), this);
+        textInput->when(FL_WHEN_ENTER_KEY_ALWAYS);
+
+        auto* searchButton = new Fl_Button(0, 0, 0, 0, "Search");
+        searchButton->callback(reinterpret_cast<Fl_Callback*>(searchCallback), this);
+        textRow->fixed(searchButton, 60);
+
+        cancelButton = new Fl_Button(0, 0, 0, 0, "Cancel");
+        cancelButton->callback(reinterpret_cast<Fl_Callback*>(cancelCallback), this);
+        cancelButton->deactivate();
+        textRow->fixed(cancelButton, 60);
+        textRow->end();
+
+        const int resultsTop = 3 * margin + 2 * rowHeight;
+        results = new Fl_Hold_Browser(margin, resultsTop, w - 2 * margin, h - resultsTop - rowHeight - margin);
+        results->format_char(0); // paths are displayed as they are
+        results->column_char('\t');
+        results->column_widths(COLUMN_WIDTHS);
+        results->textfont(FL_COURIER);
+        results->callback(reinterpret_cast<Fl_Callback*>(rowSelectedCallback), this);
+
+        status = new Fl_Box(margin, h - rowHeight, w - 2 * margin, rowHeight);
+        status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+
+        resizable(results);
+        end();
+    }
+
+    // Set callback for starting a search. The callback receives the directory and the text to find.
+    void onSearch(std::function<void(const std::string&, const std::string&)> callback)
+    {
+        searchFilesCallback = std::move(callback);
+    }
+
+    void onCancel(std::function<void()> callback)
+    {
+        cancelSearchCallback = std::move(callback);
+    }
+
+    // Set callback for selecting a result row. The callback receives the path of the file
+    // and the index of the matching line, or nothing for the row of the file itself.
+    void onHitSelected(std::function<void(const std::string&, std::optional<size_t>)> callback)
+    {
+        hitSelectedCallback = std::move(callback);
+    }
+
+    void clearResults()
+    {
+        results->clear();
+        rows.clear();
+        matchingFiles = 0;
+        matchingLines = 0;
+        bytesSearched = 0;
+    }
+
+    // Files without matches are not listed, files that could not be searched are listed with the error
+    void addResult(const FileSearchResult& result)
+    {
+        bytesSearched += result.bytesSearched;
+        if (result.errorMessage.empty() && result.matchingLines == 0)
+        {
+            return;
+        }
+
+        std::string fileRow = result.path + "\t";
+        if (!result.errorMessage.empty())
+        {
+            fileRow += result.errorMessage;
+        }
+        else
+        {
+            fileRow += std::to_string(result.matchingLines) + " lines";
+            if (result.lineIndices.size() < result.matchingLines)
+            {
+                fileRow += " (first " + std::to_string(result.lineIndices.size()) + " listed)";
+            }
+            matchingFiles++;
+            matchingLines += result.matchingLines;
+        }
+        results->add(fileRow.c_str());
+        rows.emplace_back(result.path, std::nullopt);
+
+        for (const size_t lineIndex : result.lineIndices)
+        {
+            const std::string hitRow = "  line " + std::to_string(lineIndex + 1);
+            results->add(hitRow.c_str());
+            rows.emplace_back(result.path, lineIndex);
+        }
+    }
+
+    void setRunning(const bool running)
+    {
+        running ? cancelButton->activate() : cancelButton->deactivate();
+    }
+
+    void setStatus(const std::string& text)
+    {
+        status->copy_label(text.c_str());
+        status->redraw();
+    }
+
+    // Show the totals of the search
+    void finish(const std::chrono::milliseconds elapsed, const bool cancelled)
+    {
+        setRunning(false);
+        const double megabytes = static_cast<double>(bytesSearched) / (1024 * 1024);
+        const double seconds = std::max(static_cast<double>(elapsed.count()) / 1000, 0.001);
+        char buffer[160];
+        std::snprintf(buffer, sizeof(buffer), "%s%zu lines in %zu files, %.1f MiB in %lld ms (%.0f MiB/s)",
+                      cancelled ? "Cancelled, " : "", matchingLines, matchingFiles, megabytes,
+                      static_cast<long long>(elapsed.count()), megabytes / seconds);
+        setStatus(buffer);
+    }
+
+private:
+    static constexpr int COLUMN_WIDTHS[] = {420, 0};
+
+    static void browseCallback(Fl_Widget*, FileSearchWindow* pThis)
+    {
+        Fl_Native_File_Chooser chooser;
+        chooser.title("Search in Directory");
+        chooser.type(Fl_Native_File_Chooser::BROWSE_DIRECTORY);
+        if (chooser.show() == 0)
+        {
+            pThis->directoryInput->value(chooser.filename());
+        }
+    }
+
+    static void searchCallback(Fl_Widget*, FileSearchWindow* pThis)
+    {
+        if (pThis->searchFilesCallback)
+        {
+            pThis->searchFilesCallback(pThis->directoryInput->value(), pThis->textInput->value());
+        }
+    }
+
+    static void cancelCallback(Fl_Widget*, FileSearchWindow* pThis)
+    {
+        if (pThis->cancelSearchCallback)
+        {
+            pThis->cancelSearchCallback();
+        }
+    }
+
+    static void rowSelectedCallback(Fl_Hold_Browser* browser, FileSearchWindow* pThis)
+    {
+        const int row = browser->value();
+        if (row > 0 && static_cast<size_t>(row) <= pThis->rows.size() && pThis->hitSelectedCallback)
+        {
+            const auto& [path, lineIndex] = pThis->rows[row - 1];
+            pThis->hitSelectedCallback(path, lineIndex);
+        }
+    }
+
+    Fl_Input* directoryInput = nullptr;
+    Fl_Input* textInput = nullptr;
+    Fl_Button* cancelButton = nullptr;
+    Fl_Hold_Browser* results = nullptr;
+    Fl_Box* status = nullptr;
+    std::vector<std::pair<std::string, std::optional<size_t>>> rows;
+    size_t matchingFiles = 0;
+    size_t matchingLines = 0;
+    size_t bytesSearched = 0;
+
+    std::function<void(const std::string&, const std::string&)> searchFilesCallback;
+    std::function<void()> cancelSearchCallback;
+    std::function<void(const std::string&, std::optional<size_t>)> hitSelectedCallback;
+};
@@ -0,0 +1,135 @@
+#include "LineLayoutCache.hpp"
+
+#include <algorithm>
+
+LineLayoutCache::LineLayoutCache(TextMetrics& metrics) : metrics(metrics)
+{
+    // References to layouts are returned, so they must not be moved
+    layouts.reserve(MAX_LINES);
+}
+
+void LineLayoutCache::clear()
+{
+    layouts.clear();
+}
+
+double LineLayoutCache::getWidth(const size_t lineIndex, std::string_view text, const bool asciiText)
+{
+    return getLayout(lineIndex, text, asciiText).width;
+}
+
+double LineLayoutCache::getPrefixWidth(const size_t lineIndex, std::string_view text, const bool asciiText,
+                                       const size_t offset)
+{
+    const Layout& layout = getLayout(lineIndex, text, asciiText);
+    auto [position, width] = findCheckpoint(layout, offset);
+    const size_t end = std::min(offset, text.size());
+    while (position < end)
+    {
+        width += metrics.getCharWidth(text, position, asciiText);
+    }
+    return width;
+}
+
+size_t LineLayoutCache::findOffset(const size_t lineIndex, std::string_view text, const bool asciiText, const double x,
+                                   double* charX)
+{
+    const Layout& layout = getLayout(lineIndex, text, asciiText);
+
+    // The last checkpoint that begins before x
+    const auto it = std::upper_bound(layout.checkpoints.begin(), layout.checkpoints.end(), x,
+                                     [](double value, const auto& checkpoint) { return value < checkpoint.second; });
+    auto [position, width] = it == layout.checkpoints.begin() ? layout.checkpoints.front() : *(it - 1);
+
+    while (position < text.size())
+    {
+        size_t next = position;
+        const double charWidth = metrics.getCharWidth(text, next, asciiText);
+        if (width + charWidth > x)
+        {
+            break;
+        }
+        width += charWidth;
+        position = next;
+    }
+
+    if (charX != nullptr)
+    {
+        *charX = width;
+    }
+    return position;
+}
+
+const std::vector<size_t>& LineLayoutCache::getWrapRows(const size_t lineIndex, std::string_view text,
+                                                        const bool asciiText, const int width)
+{
+    Layout& layout = getLayout(lineIndex, text, asciiText);
+    if (layout.wrapWidth != width)
+    {
+        layout.wrapWidth = width;
+        layout.wrapRows.clear();
+        size_t rowBegin = 0;
+        do
+        {
+            layout.wrapRows.push_back(rowBegin);
+            rowBegin = metrics.findWrapEnd(text, rowBegin, width, asciiText);
+        } while (rowBegin < text.size());
+    }
+    return layout.wrapRows;
+}
+
+LineLayoutCache::Layout& LineLayoutCache::getLayout(const size_t lineIndex, std::string_view text,
+                                                    const bool asciiText)
+{
+    useCounter++;
+    for (Layout& layout : layouts)
+    {
+        if (layout.lineIndex == lineIndex)
+        {
+            layout.lastUse = useCounter;
+            return layout;
+        }
+    }
+
+    // Replace the least recently used layout
+    Layout* layout = nullptr;
+    if (layouts.size() < MAX_LINES)
+    {
+        layout = &layouts.emplace_back();
+    }
+    else
+    {
+        layout = &*std::min_element(layouts.begin(), layouts.end(),
+                                    [](const Layout& a, const Layout& b) { return a.lastUse < b.lastUse; });
+    }
+
+    layout->lineIndex = lineIndex;
+    layout->lastUse = useCounter;
+    layout->wrapWidth = -1;
+    layout->wrapRows.clear();
+    layout->checkpoints.clear();
+    layout->checkpoints.emplace_back(0, 0.0);
+
+    // Measure the whole line once
+    double width = 0;
+    size_t position = 0;
+    size_t nextCheckpoint = CHECKPOINT_INTERVAL;
+    while (position < text.size())
+    {
+        width += metrics.getCharWidth(text, position, asciiText);
+        if (position >= nextCheckpoint)
+        {
+            layout->checkpoints.emplace_back(position, width);
+            nextCheckpoint = position + CHECKPOINT_INTERVAL;
+        }
+    }
+    layout->width = width;
+    return *layout;
+}
+
+const std::pair<size_t, double>& LineLayoutCache::findCheckpoint(const Layout& layout, const size_t offset) const
+{
+    const auto it = std::upper_bound(layout.checkpoints.begin(), layout.checkpoints.end(), offset,
+                                     [](size_t value, const auto& checkpoint) { return value < checkpoint.first; });
+    return *(it - 1);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "TextMetrics.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Layout of long lines, kept for the lines displayed most recently.
+// Widths of prefixes of a line are sampled every CHECKPOINT_INTERVAL bytes. A position within the line
+// is found with a binary search over these checkpoints and measuring at most one interval, instead of
+// measuring the line from its beginning. Each line is measured only once, when it gets into the cache.
+class LineLayoutCache
+{
+public:
+    static constexpr size_t CHECKPOINT_INTERVAL = 4096;
+
+    explicit LineLayoutCache(TextMetrics& metrics);
+
+    // Must be called when the text or the font changes.
+    void clear();
+
+    double getWidth(size_t lineIndex, std::string_view text, bool asciiText);
+
+    // Width of the first `offset` bytes of the line.
+    double getPrefixWidth(size_t lineIndex, std::string_view text, bool asciiText, size_t offset);
+
+    // Offset of the character at the horizontal position x (relative to the beginning of the line).
+    // If charX is given, it receives the position where that character begins.
+    size_t findOffset(size_t lineIndex, std::string_view text, bool asciiText, double x, double* charX = nullptr);
+
+    // Offsets where the rows of the line begin when it is wrapped to the given width.
+    const std::vector<size_t>& getWrapRows(size_t lineIndex, std::string_view text, bool asciiText, int width);
+
+private:
+    static constexpr size_t MAX_LINES = 64;
+
+    struct Layout
+    {
+        size_t lineIndex = 0;
+        uint64_t lastUse = 0;
+        double width = 0;
+        std::vector<std::pair<size_t, double>> checkpoints; // pairs of offset and width of the prefix
+        int wrapWidth = -1;
+        std::vector<size_t> wrapRows;
+    };
+
+    Layout& getLayout(size_t lineIndex, std::string_view text, bool asciiText);
+    const std::pair<size_t, double>& findCheckpoint(const Layout& layout, size_t offset) const;
+
+    TextMetrics& metrics;
+    std::vector<Layout> layouts;
+    uint64_t useCounter = 0;
+};
@@ -1,12 +1,16 @@
 #include "LogDisplayWidget.hpp"
+#include "core/Utf8.hpp"
 
 #include "FL/Fl_Window.H"
 #include "FL/fl_draw.H"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cctype>
 #include <cmath>
-#include <iostream>
+#include <iterator>
+#include <limits>
 #include <span>
 #include <string>
 
@@ -16,6 +20,24 @@ constexpr int TOP_MARGIN = 1;
 constexpr int BOTTOM_MARGIN = 1;
 constexpr int LEFT_MARGIN = 3;
 constexpr int RIGHT_MARGIN = 3;
+constexpr int FIELD_COLUMN_MIN_CHARS = 12;
+constexpr int TIME_GAPS_WIDTH = 6;
+
+// Scrolling is applied and the view is redrawn at most this often, in seconds
+constexpr double FRAME_INTERVAL = 1.0 / 60;
+
+// Amount of data indexed from the top of the view before the whole data is indexed, enough for a screen
+constexpr size_t APPROXIMATE_WINDOW_SIZE = 256 * 1024;
+
+// Resolution of the vertical scroll bar when it positions the view by byte offset
+constexpr int APPROXIMATE_SCROLL_STEPS = 1 << 20;
+
+// Fl::copy takes the length as int and the whole text goes through the system clipboard.
+// Bigger selections should be exported to a file instead.
+constexpr size_t MAX_CLIPBOARD_SIZE = 64 * 1024 * 1024;
+
+// Lines filtered out have no row
+constexpr uint32_t NO_ROW = std::numeric_limits<uint32_t>::max();
 
 bool isWordSeparator(const char c)
 {
@@ -57,38 +79,96 @@ LogDisplayWidget::LogDisplayWidget(int X, int Y, int W, int H) : Fl_Group(X, Y,
     end();
 }
 
-LogDisplayWidget::~LogDisplayWidget() = default;
-
-void LogDisplayWidget::setData(const char* data, const size_t size)
+LogDisplayWidget::~LogDisplayWidget()
 {
-    this->data = data;
-    this->dataSize = size;
+    Fl::remove_timeout(frameCallback, this);
+}
 
-    size_t lineStart = 0;
-    size_t lineEnd = 0;
-    while (lineEnd < dataSize)
+void LogDisplayWidget::setData(const char* data, const size_t size, std::shared_ptr<LineIndex> index)
+{
+    // A bigger index of the same data replaces a partial one, the view stays where it was.
+    // The index of approximately displayed data keeps the top line at the same offset.
+    const bool indexedApproximateData = approximate.active && data == approximate.data;
+    const size_t approximateTopOffset = approximate.windowBegin;
+    if (approximate.active)
     {
-        while (lineEnd < dataSize && data[lineEnd] != '\n')
-        {
-            ++lineEnd;
-        }
-        lines.emplace_back(lineStart, lineEnd);
-        ++lineEnd;
-        lineStart = lineEnd;
+        wrapEnabled = approximate.wrapEnabled;
+        approximate = {};
+    }
+    const bool sameData = data != nullptr && data == this->data;
+    size_t topLine = sameData && getNumberOfRows() > 0 ? getLineOfRow(getIndexOfTopDisplayedRow()) : 0;
+    if (indexedApproximateData)
+    {
+        topLine = index->findLine(approximateTopOffset);
     }
+    this->data = data;
+    this->dataSize = size;
 
-    // Add an empty line if the last character is a newline
-    if (data[dataSize - 1] == '\n')
+    lines = std::move(index);
+    lastViewport = {0, 0};
+    targetTopRow.reset();
+    targetLeft.reset();
+    lineLayouts.clear();
+    decodedLines.clear();
+    if (!sameData)
     {
-        lines.emplace_back(dataSize, dataSize);
+        selection = {0, 0};
+        cursorPos = {0, 0};
+        maxLineWidth = 0;
+        markedLines.clear();
     }
 
     // In some places the line number is cast to int (for example when drawing the line number)
     // So for now I will allow for a file to have too many lines.
-    assert(lines.size() < std::numeric_limits<int>::max() && "Too many lines!");
+    assert(lines->size() < std::numeric_limits<int>::max() && "Too many lines!");
 
-    const int numberOfLines = static_cast<int>(lines.size());
+    filteredLines.reset();
+    filterActive = false;
+    rowsOfLines = {};
+    resetWrapIndex();
+
+    const int numberOfLines = static_cast<int>(lines->size());
     vScrollBar->value(1, howManyLinesCanFit(), 1, numberOfLines);
+    updateVerticalScrollBar();
+    if (topLine > 0 && topLine < lines->size())
+    {
+        scrollToLine(topLine);
+    }
+    damage(FL_DAMAGE_ALL);
+}
+
+std::shared_ptr<LineIndex> LogDisplayWidget::takeData()
+{
+    auto index = std::move(lines);
+    setData(nullptr, 0, std::make_shared<LineIndex>());
+    return index;
+}
+
+void LogDisplayWidget::appendData(const size_t size, TaskScheduler* scheduler)
+{
+    if (data == nullptr || approximate.active || size == dataSize)
+    {
+        return;
+    }
+    const size_t rows = getNumberOfRows();
+    const size_t topRow = getIndexOfTopDisplayedRow();
+    const bool showsEnd = !filterActive && (rows == 0 || topRow + howManyLinesCanFit() >= rows);
+    const size_t topLine = rows > 0 ? getLineOfRow(std::min(topRow, rows - 1)) : 0;
+
+    lines->extend(data, size, scheduler);
+    dataSize = size;
+    assert(lines->size() < std::numeric_limits<int>::max() && "Too many lines!");
+
+    // The last line may have grown, so its layout and wrapped rows are out of date
+    lineLayouts.clear();
+    decodedLines.clear();
+    targetTopRow.reset();
+    resetWrapIndex();
+    vScrollBar->value(1, howManyLinesCanFit(), 1, static_cast<int>(getNumberOfRows()));
+    updateVerticalScrollBar();
+    const size_t linesOnScreen = std::min(lines->size(), static_cast<size_t>(std::max(howManyLinesCanFit(), 1)));
+    scrollToLine(showsEnd ? lines->size() - linesOnScreen : topLine);
+    damage(FL_DAMAGE_ALL);
 }
 
 const char* LogDisplayWidget::getData() const
@@ -102,10 +182,160 @@ size_t LogDisplayWidget::getDataSize() const
 }
 
 const std::vector<std::pair<size_t, size_t>>& LogDisplayWidget::getLines() const
+{
+    return lines->getLines();
+}
+
+const LineIndex& LogDisplayWidget::getIndexedLines() const
+{
+    return *lines;
+}
+
+std::shared_ptr<const LineIndex> LogDisplayWidget::getSharedIndexedLines() const
 {
     return lines;
 }
 
+void LogDisplayWidget::setApproximateData(const char* data, const size_t size)
+{
+    setData(nullptr, 0, std::make_shared<LineIndex>());
+    approximate.active = true;
+    approximate.data = data;
+    approximate.size = size;
+    approximate.wrapEnabled = wrapEnabled;
+    approximate.bytesPerLine = 1;
+    wrapEnabled = false;
+    resetWrapIndex();
+
+    setApproximateWindow(0);
+    if (lines->size() > 1)
+    {
+        // The last line of the window may be cut
+        const size_t completeLines = lines->size() - 1;
+        const auto completeSize = static_cast<double>((*lines)[completeLines - 1].second + 1);
+        approximate.bytesPerLine = std::max(completeSize / static_cast<double>(completeLines), 1.0);
+    }
+    updateVerticalScrollBar();
+}
+
+bool LogDisplayWidget::isApproximate() const
+{
+    return approximate.active;
+}
+
+size_t LogDisplayWidget::getApproximateDataSize() const
+{
+    return approximate.size;
+}
+
+void LogDisplayWidget::scrollToApproximateOffset(const size_t offset)
+{
+    if (approximate.active)
+    {
+        setApproximateWindow(findApproximateLineStart(std::min(offset, approximate.size)));
+    }
+}
+
+// Index the window of lines beginning at the offset. The end of the data is shown at the bottom of the view.
+void LogDisplayWidget::setApproximateWindow(size_t begin)
+{
+    const auto linesOnScreen = static_cast<size_t>(std::max(howManyLinesCanFit(), 1));
+    begin = std::min(begin, findApproximateLineBegin(approximate.size, linesOnScreen));
+    approximate.windowBegin = begin;
+    data = approximate.data + begin;
+    dataSize = std::min(approximate.size - begin, APPROXIMATE_WINDOW_SIZE);
+    lines = std::make_shared<LineIndex>();
+    lines->build(data, dataSize, nullptr);
+    lineLayouts.clear();
+    decodedLines.clear();
+
+    // Offsets in the window change, the selection is dropped and no line has the cursor
+    selection = {0, 0};
+    cursorPos = {0, std::numeric_limits<size_t>::max()};
+    updateVerticalScrollBar();
+    damage(FL_DAMAGE_SCROLL);
+}
+
+void LogDisplayWidget::scrollApproximateWindowBy(const long long rows)
+{
+    if (rows < 0)
+    {
+        setApproximateWindow(findApproximateLineBegin(approximate.windowBegin, static_cast<size_t>(-rows)));
+    }
+    else if (rows > 0 && !lines->empty())
+    {
+        const size_t row = std::min(static_cast<size_t>(rows), lines->size() - 1);
+        setApproximateWindow(approximate.windowBegin + (*lines)[row].first);
+    }
+}
+
+// Beginning of the line the given number of lines above the line beginning at the offset (or above the end
+// of the data). Lines longer than the window are cut, the search goes back at most the size of the window.
+size_t LogDisplayWidget::findApproximateLineBegin(const size_t offset, const size_t linesAbove) const
+{
+    const size_t limit = offset - std::min(offset, APPROXIMATE_WINDOW_SIZE);
+    const std::string_view text(approximate.data + limit, offset - limit);
+    size_t begin = text.size();
+    for (size_t i = 0; i < linesAbove && begin > 0; i++)
+    {
+        // Skip the newline ending the line above
+        const size_t newline = begin >= 2 ? text.rfind('\n', begin - 2) : std::string_view::npos;
+        begin = newline == std::string_view::npos ? 0 : newline + 1;
+    }
+    return limit + begin;
+}
+
+// Seeking to an offset in the middle of a line shows the next line, like in "less"
+size_t LogDisplayWidget::findApproximateLineStart(const size_t offset) const
+{
+    if (offset == 0 || offset >= approximate.size || approximate.data[offset - 1] == '\n')
+    {
+        return offset;
+    }
+    const size_t searchSize = std::min(approximate.size - offset, APPROXIMATE_WINDOW_SIZE);
+    const size_t newline = std::string_view(approximate.data + offset, searchSize).find('\n');
+    return newline == std::string_view::npos ? offset : offset + newline + 1;
+}
+
+size_t LogDisplayWidget::getApproximateFirstLine() const
+{
+    return static_cast<size_t>(static_cast<double>(approximate.windowBegin) / approximate.bytesPerLine);
+}
+
+void LogDisplayWidget::setFieldStore(FieldStore* store)
+{
+    fieldStore = store;
+    fieldColumns.clear();
+    fieldColumnWidths.clear();
+    damage(FL_DAMAGE_ALL);
+}
+
+void LogDisplayWidget::setFieldColumns(const std::vector<std::string>& fieldNames)
+{
+    fieldColumns.clear();
+    fieldColumnWidths.clear();
+    if (fieldStore == nullptr)
+    {
+        return;
+    }
+
+    fl_font(textFont, textSize);
+    const int minWidth = static_cast<int>(fl_width("0") * FIELD_COLUMN_MIN_CHARS);
+    for (const std::string& fieldName : fieldNames)
+    {
+        fieldColumns.push_back(fieldStore->addColumn(fieldName));
+        const int nameWidth = static_cast<int>(fl_width(fieldName.c_str()));
+        fieldColumnWidths.push_back(std::max(minWidth, nameWidth) + LEFT_MARGIN + RIGHT_MARGIN);
+    }
+    damage(FL_DAMAGE_ALL);
+}
+
+void LogDisplayWidget::setTimeGaps(const TimeGaps* gaps)
+{
+    timeGaps = gaps;
+    damage(FL_DAMAGE_ALL);
+}
+
 // TODO: In the future I should add highlight and select as a separate methods.
 // The first one should be used to highlight a word in a given color without
 // changing the cursor position and selection. The second would overwrite the
@@ -119,17 +349,160 @@ void LogDisplayWidget::select(size_t startPos, size_t endPos)
     take_focus();
 }
 
+void LogDisplayWidget::goToOffset(const size_t offset)
+{
+    selection.begin = std::min(offset, dataSize);
+    selection.end = selection.begin;
+    setCursorPos(selection.begin);
+    scrollToLine(cursorPos.line);
+    take_focus();
+}
+
 void LogDisplayWidget::scrollToLine(size_t lineIndex)
 {
-    vScrollBar->value(lineIndex + 1);
+    if (approximate.active)
+    {
+        if (lineIndex < lines->size())
+        {
+            setApproximateWindow(approximate.windowBegin + (*lines)[lineIndex].first);
+        }
+        return;
+    }
+    if (wrapEnabled)
+    {
+        wrapTop.row = getRowOfLine(lineIndex);
+        wrapTop.subRow = 0;
+        updateVerticalScrollBar();
+    }
+    else
+    {
+        vScrollBar->value(static_cast<int>(getRowOfLine(lineIndex)) + 1);
+    }
     damage(FL_DAMAGE_SCROLL);
 }
 
-void LogDisplayWidget::onCursorPositionChanged(std::function<void(size_t, size_t)> callback)
+size_t LogDisplayWidget::getTopLine() const
+{
+    const size_t numberOfRows = getNumberOfRows();
+    return numberOfRows > 0 ? getLineOfRow(std::min(getIndexOfTopDisplayedRow(), numberOfRows - 1)) : 0;
+}
+
+void LogDisplayWidget::setLineFilter(std::vector<size_t> lineIndices)
+{
+    const size_t topLine = getNumberOfRows() > 0 ? getLineOfRow(getIndexOfTopDisplayedRow()) : 0;
+
+    filterAscending = std::is_sorted(lineIndices.begin(), lineIndices.end());
+    filteredLines = std::make_shared<const std::vector<size_t>>(std::move(lineIndices));
+    filterActive = true;
+    rowsOfLines.clear();
+    if (!filterAscending)
+    {
+        rowsOfLines.assign(lines->size(), NO_ROW);
+        for (size_t row = 0; row < filteredLines->size(); row++)
+        {
+            rowsOfLines[(*filteredLines)[row]] = static_cast<uint32_t>(row);
+        }
+    }
+    resetWrapIndex();
+
+    vScrollBar->value(1, howManyLinesCanFit(), 1, static_cast<int>(getNumberOfRows()));
+    scrollToLine(topLine);
+    damage(FL_DAMAGE_ALL);
+}
+
+void LogDisplayWidget::clearLineFilter()
+{
+    const size_t topLine = getNumberOfRows() > 0 ? getLineOfRow(getIndexOfTopDisplayedRow()) : 0;
+
+    filteredLines.reset();
+    filterActive = false;
+    rowsOfLines = {};
+    resetWrapIndex();
+
+    vScrollBar->value(1, howManyLinesCanFit(), 1, static_cast<int>(getNumberOfRows()));
+    scrollToLine(topLine);
+    damage(FL_DAMAGE_ALL);
+}
+
+bool LogDisplayWidget::isFiltered() const
+{
+    return filterActive;
+}
+
+std::shared_ptr<const std::vector<size_t>> LogDisplayWidget::getFilteredLines() const
+{
+    return filteredLines;
+}
+
+void LogDisplayWidget::setMarkedLines(std::vector<std::pair<size_t, size_t>> ranges, const Fl_Color color)
+{
+    assert(std::is_sorted(ranges.begin(), ranges.end()));
+    markedLines = std::move(ranges);
+    markedLinesColor = color;
+    damage(FL_DAMAGE_ALL);
+}
+
+bool LogDisplayWidget::isMarkedLine(const size_t lineIndex) const
+{
+    // The last range beginning at or before the line
+    const auto range = std::upper_bound(markedLines.begin(), markedLines.end(), lineIndex,
+                                        [](size_t line, const std::pair<size_t, size_t>& r) { return line < r.first; });
+    return range != markedLines.begin() && lineIndex < std::prev(range)->second;
+}
+
+void LogDisplayWidget::setWrapEnabled(const bool enabled)
+{
+    if (approximate.active)
+    {
+        approximate.wrapEnabled = enabled;
+        return;
+    }
+    if (enabled == wrapEnabled)
+    {
+        return;
+    }
+
+    const size_t topRow = getIndexOfTopDisplayedRow();
+    wrapEnabled = enabled;
+    resetWrapIndex();
+    recalcSize();
+    if (getNumberOfRows() > 0)
+    {
+        scrollToLine(getLineOfRow(std::min(topRow, getNumberOfRows() - 1)));
+    }
+    damage(FL_DAMAGE_ALL);
+}
+
+bool LogDisplayWidget::isWrapEnabled() const
+{
+    return approximate.active ? approximate.wrapEnabled : wrapEnabled;
+}
+
+std::pair<size_t, size_t> LogDisplayWidget::getSelection() const
+{
+    return {std::min(selection.begin, selection.end), std::min(std::max(selection.begin, selection.end), dataSize)};
+}
+
+void LogDisplayWidget::onCursorPositionChanged(std::function<void(size_t, size_t, size_t)> callback)
 {
     onCursorPositionChangedCallback = std::move(callback);
 }
 
+void LogDisplayWidget::onViewportChanged(std::function<void(size_t, size_t)> callback)
+{
+    onViewportChangedCallback = std::move(callback);
+}
+
+void LogDisplayWidget::onClipboardLimitExceeded(std::function<void(size_t, size_t)> callback)
+{
+    onClipboardLimitExceededCallback = std::move(callback);
+}
+
+void LogDisplayWidget::onFileDropped(std::function<void(const std::string&)> callback)
+{
+    onFileDroppedCallback = std::move(callback);
+}
+
 void LogDisplayWidget::draw()
 {
     recalcSize();
@@ -140,7 +513,15 @@ void LogDisplayWidget::draw()
         fl_begin_offscreen(offscreenBuffer);
         {
             drawBackground();
-            drawText();
+            if (wrapEnabled)
+            {
+                drawWrappedText();
+            }
+            else
+            {
+                drawText();
+            }
+            notifyViewportChanged();
 
             vScrollBar->damage(FL_DAMAGE_ALL);
             hScrollBar->damage(FL_DAMAGE_ALL);
@@ -184,7 +565,8 @@ int LogDisplayWidget::handle(const int event)
 
 LogDisplayWidget::EventStatus LogDisplayWidget::handleEvent(const int event)
 {
-    if (lines.empty() && event != FL_DND_ENTER && event != FL_DND_DRAG && event != FL_DND_RELEASE && event != FL_PASTE)
+    if (getNumberOfRows() == 0 && event != FL_DND_ENTER && event != FL_DND_DRAG && event != FL_DND_RELEASE &&
+        event != FL_PASTE)
     {
         return EventStatus::NotHandled;
     }
@@ -225,8 +607,7 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleEvent(const int event)
         return EventStatus::Handled;
 
     case FL_PASTE:
-        // TODO: Load new file to the project
-        std::cout << "Drag and dropped: " << Fl::event_text() << std::endl;
+        handleFilesDropped();
         return EventStatus::Handled;
 
     default:
@@ -236,55 +617,273 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleEvent(const int event)
 
 void LogDisplayWidget::drawText()
 {
-    if (data == nullptr || lines.empty())
+    if (data == nullptr || getNumberOfRows() == 0)
     {
         return;
     }
 
     fl_color(textColor);
-    fl_font(textFont, textSize);
+    setTextFont();
 
     const int lineHeight = getLineHeight();
     int baseline = textArea.y + lineHeight - fl_descent();
+    const int textX = textArea.x - getHorizontalOffset();
 
-    const size_t topLineIndex = this->getIndexOfTopDisplayedLine();
-    assert(topLineIndex < lines.size());
-    const size_t howManyLinesToBeDrawn =
-        std::min(static_cast<size_t>(howManyLinesCanFit() + 1), lines.size() - topLineIndex);
-    const size_t bottomLineIndex = topLineIndex + howManyLinesToBeDrawn;
+    const size_t numberOfRows = getNumberOfRows();
+    const size_t topRow = std::min(this->getIndexOfTopDisplayedRow(), numberOfRows - 1);
+    const size_t howManyRowsToBeDrawn = std::min(static_cast<size_t>(howManyLinesCanFit() + 1), numberOfRows - topRow);
+    const size_t bottomRow = topRow + howManyRowsToBeDrawn;
 
     // draw the background for line numbers on the left
     fl_rectf(lineNumbersArea.x, lineNumbersArea.y, lineNumbersArea.w, lineNumbersArea.h, lineNumbersBgColor);
 
-    for (size_t lineIndex = topLineIndex; lineIndex < bottomLineIndex; ++lineIndex)
+    // only the lines on the screen are parsed for field columns
+    if (fieldStore != nullptr && !fieldColumns.empty())
+    {
+        fl_rectf(fieldsArea.x, fieldsArea.y, fieldsArea.w, fieldsArea.h, color());
+        if (!filterActive)
+        {
+            fieldStore->prefetch(topRow, bottomRow);
+        }
+    }
+
+    for (size_t row = topRow; row < bottomRow; ++row)
     {
+        const size_t lineIndex = getLineOfRow(row);
         updateMaxLineWidth(lineIndex);
 
-        const auto [startPos, endPos] = lines[lineIndex];
+        const auto [startPos, endPos] = (*lines)[lineIndex];
         fl_push_clip(textArea.x, textArea.y, textArea.w, textArea.h);
 
         // Clear line
         const bool isCursorInThisLine = lineIndex == cursorPos.line;
-        const Fl_Color bgcolor = isCursorInThisLine ? FL_DARK1 : color();
+        const Fl_Color bgcolor = isCursorInThisLine ? FL_DARK1 : isMarkedLine(lineIndex) ? markedLinesColor : color();
         fl_color(bgcolor);
         fl_rectf(textArea.x, baseline - lineHeight + fl_descent(), textArea.w, lineHeight);
 
-        // Draw selection background
-        drawSelection(startPos, endPos, baseline);
-
-        // Draw text
-        drawTextLine(startPos, endPos, baseline);
+        if (isLongLine(lineIndex))
+        {
+            // Draw only the part of the line that is visible in the text area
+            const std::string_view lineText = getDisplayText(lineIndex);
+            const bool asciiLine = lines->isAsciiLine(lineIndex);
+            const double left = getHorizontalOffset();
+            double partX = 0;
+            const size_t partBegin = lineLayouts.findOffset(lineIndex, lineText, asciiLine, left, &partX);
+            size_t partEnd = lineLayouts.findOffset(lineIndex, lineText, asciiLine, left + textArea.w);
+            if (partEnd < lineText.size())
+            {
+                partEnd = asciiLine ? partEnd + 1 : nextCodePoint(lineText, partEnd);
+            }
+
+            const size_t partBeginIndex = toDataIndex(lineIndex, partBegin);
+            const size_t partEndIndex = toDataIndex(lineIndex, partEnd);
+            drawSelection(lineIndex, partBeginIndex, partEndIndex, textX + static_cast<int>(partX), baseline);
+            drawTextLine(lineIndex, partBeginIndex, partEndIndex, textX + static_cast<int>(partX), baseline);
+        }
+        else
+        {
+            drawSelection(lineIndex, startPos, endPos, textX, baseline);
+            drawTextLine(lineIndex, startPos, endPos, textX, baseline);
+        }
         fl_pop_clip();
 
         // Draw line number
         const int lineNumber = static_cast<int>(lineIndex + 1);
         drawLineNumber(lineNumber, baseline, isCursorInThisLine ? bgcolor : lineNumbersBgColor);
+        drawTimeGap(lineIndex, baseline);
+        drawFieldValues(lineIndex, baseline, bgcolor);
 
         baseline += lineHeight;
     }
 }
 
-void LogDisplayWidget::drawSelection(const size_t startPos, const size_t endPos, const int baseline) const
+void LogDisplayWidget::drawWrappedText()
+{
+    visibleRows.clear();
+    if (data == nullptr || getNumberOfRows() == 0)
+    {
+        return;
+    }
+
+    fl_color(textColor);
+    setTextFont();
+
+    const int lineHeight = getLineHeight();
+    int baseline = textArea.y + lineHeight - fl_descent();
+
+    const size_t numberOfRows = getNumberOfRows();
+    const size_t maxVisualRows = static_cast<size_t>(howManyLinesCanFit() + 1);
+    wrapTop.row = std::min(wrapTop.row, numberOfRows - 1);
+
+    fl_rectf(lineNumbersArea.x, lineNumbersArea.y, lineNumbersArea.w, lineNumbersArea.h, lineNumbersBgColor);
+
+    if (fieldStore != nullptr && !fieldColumns.empty())
+    {
+        fl_rectf(fieldsArea.x, fieldsArea.y, fieldsArea.w, fieldsArea.h, color());
+        if (!filterActive)
+        {
+            fieldStore->prefetch(wrapTop.row, std::min(numberOfRows, wrapTop.row + maxVisualRows));
+        }
+    }
+
+    const size_t selectionBegin = getSelection().first;
+    for (size_t row = wrapTop.row; row < numberOfRows && visibleRows.size() < maxVisualRows; ++row)
+    {
+        const size_t lineIndex = getLineOfRow(row);
+        const size_t lineEnd = (*lines)[lineIndex].second;
+        const std::vector<size_t>& rowBegins = wrapLine(lineIndex);
+        wrapIndex.setNumberOfRows(row, static_cast<uint32_t>(rowBegins.size()));
+
+        // The estimate for the top line might have been too big
+        size_t firstSubRow = 0;
+        if (row == wrapTop.row)
+        {
+            wrapTop.subRow = std::min(wrapTop.subRow, rowBegins.size() - 1);
+            firstSubRow = wrapTop.subRow;
+        }
+
+        const bool isCursorInThisLine = lineIndex == cursorPos.line;
+        const Fl_Color bgcolor = isCursorInThisLine ? FL_DARK1 : isMarkedLine(lineIndex) ? markedLinesColor : color();
+        for (size_t subRow = firstSubRow; subRow < rowBegins.size() && visibleRows.size() < maxVisualRows; ++subRow)
+        {
+            const bool isLastSubRow = subRow + 1 == rowBegins.size();
+            const size_t begin = toDataIndex(lineIndex, rowBegins[subRow]);
+            const size_t end = isLastSubRow ? lineEnd : toDataIndex(lineIndex, rowBegins[subRow + 1]);
+
+            fl_push_clip(textArea.x, textArea.y, textArea.w, textArea.h);
+            fl_color(bgcolor);
+            fl_rectf(textArea.x, baseline - lineHeight + fl_descent(), textArea.w, lineHeight);
+
+            // Selection starting at the end of a piece belongs to the next piece
+            if (isLastSubRow || selectionBegin < end)
+            {
+                drawSelection(lineIndex, begin, end, textArea.x, baseline);
+            }
+            drawTextLine(lineIndex, begin, end, textArea.x, baseline);
+            fl_pop_clip();
+
+            // Line numbers and fields are shown only next to the first piece of a line
+            if (subRow == 0)
+            {
+                drawLineNumber(static_cast<int>(lineIndex + 1), baseline,
+                               isCursorInThisLine ? bgcolor : lineNumbersBgColor);
+                drawTimeGap(lineIndex, baseline);
+                drawFieldValues(lineIndex, baseline, bgcolor);
+            }
+
+            visibleRows.push_back({lineIndex, begin, end});
+            baseline += lineHeight;
+        }
+    }
+
+    // Measuring the lines has refined the estimate of the total number of rows
+    updateVerticalScrollBar();
+}
+
+// Returns the offsets (relative to the beginning of the line) where the visual rows of the line begin.
+const std::vector<size_t>& LogDisplayWidget::wrapLine(const size_t lineIndex)
+{
+    const std::string_view lineText = getDisplayText(lineIndex);
+    const bool asciiLine = lines->isAsciiLine(lineIndex);
+    if (isLongLine(lineIndex))
+    {
+        return lineLayouts.getWrapRows(lineIndex, lineText, asciiLine, textArea.w);
+    }
+
+    wrapRows.clear();
+    size_t rowBegin = 0;
+    do
+    {
+        wrapRows.push_back(rowBegin);
+        rowBegin = textMetrics.findWrapEnd(lineText, rowBegin, textArea.w, asciiLine);
+    } while (rowBegin < lineText.size());
+    return wrapRows;
+}
+
+// Long lines are laid out with cached checkpoints instead of being measured from the beginning
+bool LogDisplayWidget::isLongLine(const size_t lineIndex) const
+{
+    const auto [lineBegin, lineEnd] = (*lines)[lineIndex];
+    return lineEnd - lineBegin > LineLayoutCache::CHECKPOINT_INTERVAL;
+}
+
+// Text of the line as UTF-8, which is the data itself unless the data has another encoding
+std::string_view LogDisplayWidget::getDisplayText(const size_t lineIndex) const
+{
+    const TextEncoding encoding = lines->getEncoding();
+    if (encoding == TextEncoding::Utf8)
+    {
+        return lines->getLineText(lineIndex);
+    }
+    return decodedLines.getText(lineIndex, lines->getLineText(lineIndex), encoding);
+}
+
+// Offset in the display text of the line of the data index, which is clamped to the line
+size_t LogDisplayWidget::toDisplayOffset(const size_t lineIndex, const size_t dataIndex) const
+{
+    const auto [lineBegin, lineEnd] = (*lines)[lineIndex];
+    const size_t offsetInLine = std::clamp(dataIndex, lineBegin, lineEnd) - lineBegin;
+    if (lines->getEncoding() == TextEncoding::Utf8)
+    {
+        return offsetInLine;
+    }
+    return toUtf8Offset(lines->getLineText(lineIndex), lines->getEncoding(), offsetInLine);
+}
+
+size_t LogDisplayWidget::toDataIndex(const size_t lineIndex, const size_t displayOffset) const
+{
+    const size_t lineBegin = (*lines)[lineIndex].first;
+    if (lines->getEncoding() == TextEncoding::Utf8)
+    {
+        return lineBegin + displayOffset;
+    }
+    return lineBegin + fromUtf8Offset(lines->getLineText(lineIndex), lines->getEncoding(), displayOffset);
+}
+
+void LogDisplayWidget::setTextFont()
+{
+    fl_font(textFont, textSize);
+    if (textMetrics.setFont(textFont, textSize))
+    {
+        lineLayouts.clear();
+    }
+}
+
+// Report the range of the data shown in the view, when it has changed
+void LogDisplayWidget::notifyViewportChanged()
+{
+    if (!onViewportChangedCallback || getNumberOfRows() == 0)
+    {
+        return;
+    }
+
+    size_t firstLine = 0;
+    size_t lastLine = 0;
+    if (wrapEnabled && !visibleRows.empty())
+    {
+        firstLine = visibleRows.front().lineIndex;
+        lastLine = visibleRows.back().lineIndex;
+    }
+    else
+    {
+        const size_t topRow = std::min(getIndexOfTopDisplayedRow(), getNumberOfRows() - 1);
+        const size_t bottomRow = std::min(topRow + howManyLinesCanFit(), getNumberOfRows() - 1);
+        firstLine = getLineOfRow(topRow);
+        lastLine = getLineOfRow(bottomRow);
+    }
+
+    const size_t windowBegin = approximate.active ? approximate.windowBegin : 0;
+    const std::pair viewport{windowBegin + (*lines)[firstLine].first, windowBegin + (*lines)[lastLine].second};
+    if (viewport != lastViewport)
+    {
+        lastViewport = viewport;
+        onViewportChangedCallback(viewport.first, viewport.second);
+    }
+}
+
+// Draw the selection background of text [startPos, endPos) drawn at the position textX.
+void LogDisplayWidget::drawSelection(const size_t lineIndex, const size_t startPos, const size_t endPos,
+                                     const int textX, const int baseline) const
 {
     auto selectionStart = selection.begin;
     auto selectionEnd = selection.end;
@@ -296,34 +895,41 @@ void LogDisplayWidget::drawSelection(const size_t startPos, const size_t endPos,
     if (selectionStart < startPos && selectionEnd > startPos)
         selectionStart = startPos;
 
-    const auto selectionLength = static_cast<int>(selectionEnd - selectionStart);
-
     if (selectionStart >= startPos && selectionStart <= endPos)
     {
-        const int textAreaWithOffset = textArea.x - getHorizontalOffset();
+        // Widths are measured in the displayed text
+        const std::string_view text = getDisplayText(lineIndex);
+        const size_t textBegin = toDisplayOffset(lineIndex, startPos);
+        const size_t textSelectionStart = toDisplayOffset(lineIndex, selectionStart);
+        const auto selectionLength = static_cast<int>(toDisplayOffset(lineIndex, selectionEnd) - textSelectionStart);
+
         const int lineHeight = getLineHeight();
         const double selectionOffset =
-            textAreaWithOffset + fl_width(data + startPos, static_cast<int>(selectionStart - startPos));
-        const double selectionWidth = selectionEnd > endPos ? std::max(textArea.w, maxLineWidth)
-                                                            : fl_width(data + selectionStart, selectionLength);
+            textX + fl_width(text.data() + textBegin, static_cast<int>(textSelectionStart - textBegin));
+        const double selectionWidth = selectionEnd > endPos
+                                          ? std::max(textArea.w, maxLineWidth)
+                                          : fl_width(text.data() + textSelectionStart, selectionLength);
         fl_color(selection_color());
         fl_rectf(static_cast<int>(selectionOffset), baseline - lineHeight + fl_descent(),
                  static_cast<int>(selectionWidth), lineHeight);
     }
 }
-void LogDisplayWidget::drawTextLine(const size_t lineBegin, const size_t lineEnd, const int baseline) const
+void LogDisplayWidget::drawTextLine(const size_t lineIndex, const size_t lineBegin, const size_t lineEnd,
+                                    const int textX, const int baseline) const
 {
-    const auto& lineLength = static_cast<int>(lineEnd - lineBegin);
+    const std::string_view text = getDisplayText(lineIndex);
+    const size_t textBegin = toDisplayOffset(lineIndex, lineBegin);
+    const size_t textEnd = toDisplayOffset(lineIndex, lineEnd);
+    const auto& lineLength = static_cast<int>(textEnd - textBegin);
 
     const size_t selectionBegin = std::min(selection.begin, selection.end);
     const size_t selectionEnd = std::max(selection.begin, selection.end);
-    const int textPosition = textArea.x - getHorizontalOffset();
 
     // Selection is in a line above the current one
     if (selectionEnd < lineBegin)
     {
         fl_color(textColor);
-        fl_draw(data + lineBegin, lineLength, textPosition, baseline);
+        fl_draw(text.data() + textBegin, lineLength, textX, baseline);
         return;
     }
 
@@ -331,30 +937,30 @@ void LogDisplayWidget::drawTextLine(const size_t lineBegin, const size_t lineEnd
     if (selectionBegin > lineEnd)
     {
         fl_color(textColor);
-        fl_draw(data + lineBegin, lineLength, textPosition, baseline);
+        fl_draw(text.data() + textBegin, lineLength, textX, baseline);
         return;
     }
 
     // Selection overlaps the line
-    const size_t selectedLineBegin = std::max(selectionBegin, lineBegin);
-    const size_t selectedLineEnd = std::min(selectionEnd, lineEnd);
+    const size_t selectedLineBegin = toDisplayOffset(lineIndex, std::max(selectionBegin, lineBegin));
+    const size_t selectedLineEnd = toDisplayOffset(lineIndex, std::min(selectionEnd, lineEnd));
 
-    const int beforeSelectionLength = static_cast<int>(selectedLineBegin - lineBegin);
+    const int beforeSelectionLength = static_cast<int>(selectedLineBegin - textBegin);
     const int selectionLength = static_cast<int>(selectedLineEnd - selectedLineBegin);
-    const int afterSelectionLength = static_cast<int>(lineEnd - selectedLineEnd);
+    const int afterSelectionLength = static_cast<int>(textEnd - selectedLineEnd);
 
     fl_color(textColor);
-    fl_draw(data + lineBegin, beforeSelectionLength, textPosition, baseline);
+    fl_draw(text.data() + textBegin, beforeSelectionLength, textX, baseline);
 
     // Selected text will have white font color
     fl_color(FL_WHITE);
-    const int selectionOffset = static_cast<int>(fl_width(data + lineBegin, beforeSelectionLength));
-    fl_draw(data + selectedLineBegin, selectionLength, textPosition + selectionOffset, baseline);
+    const int selectionOffset = static_cast<int>(fl_width(text.data() + textBegin, beforeSelectionLength));
+    fl_draw(text.data() + selectedLineBegin, selectionLength, textX + selectionOffset, baseline);
 
     fl_color(textColor);
     const int afterSelectionOffset =
-        static_cast<int>(fl_width(data + lineBegin, beforeSelectionLength + selectionLength));
-    fl_draw(data + selectedLineEnd, afterSelectionLength, textPosition + afterSelectionOffset, baseline);
+        static_cast<int>(fl_width(text.data() + textBegin, beforeSelectionLength + selectionLength));
+    fl_draw(text.data() + selectedLineEnd, afterSelectionLength, textX + afterSelectionOffset, baseline);
 }
 
 void LogDisplayWidget::drawLineNumber(const int lineNumber, const int baseline, const Fl_Color bgcolor) const
@@ -364,13 +970,69 @@ void LogDisplayWidget::drawLineNumber(const int lineNumber, const int baseline,
 
     fl_rectf(lineNumbersArea.x, baseline - lineHeight + fl_descent(), lineNumbersArea.w, lineHeight, bgcolor);
 
-    const std::string lineNumberStr = std::to_string(lineNumber);
+    const std::string lineNumberStr = approximate.active
+                                          ? "~" + std::to_string(getApproximateFirstLine() + lineNumber)
+                                          : std::to_string(lineNumber);
     fl_color(lineNumbersColor);
     fl_draw(lineNumberStr.c_str(), lineNumbersArea.x, baseline - lineHeight + fl_descent(),
-            lineNumbersArea.w - RIGHT_MARGIN, lineHeight, FL_ALIGN_RIGHT);
+            lineNumbersArea.w - RIGHT_MARGIN - getTimeGapsWidth(), lineHeight, FL_ALIGN_RIGHT);
     fl_pop_clip();
 }
 
+void LogDisplayWidget::drawTimeGap(const size_t lineIndex, const int baseline) const
+{
+    if (timeGaps == nullptr || timeGaps->getLargestGaps().empty())
+    {
+        return;
+    }
+    const int64_t gap = timeGaps->getGap(lineIndex);
+    if (gap <= 0)
+    {
+        return;
+    }
+
+    // Logarithmic scale, so that gaps of seconds are visible next to gaps of hours
+    const int64_t largestGap = timeGaps->getLargestGaps().front().milliseconds;
+    const double heat = std::log1p(static_cast<double>(gap)) / std::log1p(static_cast<double>(largestGap));
+    const int lineHeight = getLineHeight();
+    fl_rectf(lineNumbersArea.x + lineNumbersArea.w - TIME_GAPS_WIDTH, baseline - lineHeight + fl_descent(),
+             TIME_GAPS_WIDTH, lineHeight,
+             fl_color_average(timeGapsColor, lineNumbersBgColor, static_cast<float>(std::min(heat, 1.0))));
+}
+
+int LogDisplayWidget::getTimeGapsWidth() const
+{
+    return timeGaps != nullptr ? TIME_GAPS_WIDTH : 0;
+}
+
+void LogDisplayWidget::drawFieldValues(const size_t lineIndex, const int baseline, const Fl_Color bgcolor) const
+{
+    if (fieldStore == nullptr || fieldColumns.empty())
+    {
+        return;
+    }
+
+    const int lineHeight = getLineHeight();
+    const int rowTop = baseline - lineHeight + fl_descent();
+    fl_rectf(fieldsArea.x, rowTop, fieldsArea.w, lineHeight, bgcolor);
+
+    int columnX = fieldsArea.x;
+    for (size_t i = 0; i < fieldColumns.size(); i++)
+    {
+        const int columnWidth = fieldColumnWidths[i];
+        const std::string_view value = fieldStore->getText(lineIndex, fieldColumns[i]);
+
+        fl_push_clip(columnX, fieldsArea.y, columnWidth - RIGHT_MARGIN, fieldsArea.h);
+        fl_color(fieldsColor);
+        fl_draw(value.data(), static_cast<int>(value.size()), columnX + LEFT_MARGIN, baseline);
+        fl_pop_clip();
+
+        columnX += columnWidth;
+        fl_color(lineNumbersBgColor);
+        fl_yxline(columnX - 1, rowTop, rowTop + lineHeight);
+    }
+}
+
 void LogDisplayWidget::recalcSize()
 {
     const int X = x() + Fl::box_dx(box());
@@ -383,25 +1045,85 @@ void LogDisplayWidget::recalcSize()
 
     lineNumbersArea.x = X;
     lineNumbersArea.y = Y;
-    lineNumbersArea.w = lineNumbersWidth + LEFT_MARGIN + RIGHT_MARGIN;
+    lineNumbersArea.w = lineNumbersWidth + LEFT_MARGIN + RIGHT_MARGIN + getTimeGapsWidth();
     lineNumbersArea.h = H - scrollsize;
 
-    textArea.x = X + lineNumbersArea.w + LEFT_MARGIN;
+    fieldsArea.x = lineNumbersArea.x + lineNumbersArea.w;
+    fieldsArea.y = Y;
+    fieldsArea.w = 0;
+    fieldsArea.h = H - scrollsize;
+    for (const int columnWidth : fieldColumnWidths)
+    {
+        fieldsArea.w += columnWidth;
+    }
+
+    textArea.x = X + lineNumbersArea.w + fieldsArea.w + LEFT_MARGIN;
     textArea.y = Y + TOP_MARGIN;
-    textArea.w = W - LEFT_MARGIN - RIGHT_MARGIN - lineNumbersArea.w - scrollsize;
+    textArea.w = W - LEFT_MARGIN - RIGHT_MARGIN - lineNumbersArea.w - fieldsArea.w - scrollsize;
     textArea.h = H - TOP_MARGIN - BOTTOM_MARGIN - scrollsize;
 
     vScrollBar->resize(X + W - scrollsize, textArea.y - TOP_MARGIN, scrollsize,
                        textArea.h + TOP_MARGIN + BOTTOM_MARGIN);
     hScrollBar->resize(X, Y + H - scrollsize, W - scrollsize, scrollsize);
-    vScrollBar->value(vScrollBar->value(), howManyLinesCanFit(), 1, static_cast<int>(lines.size()));
-    hScrollBar->value(hScrollBar->value(), textArea.w, 1, maxLineWidth);
+    if (wrapEnabled)
+    {
+        // The width of rows has changed, so they have to be measured again
+        if (textArea.w != wrapWidth)
+        {
+            wrapWidth = textArea.w;
+            wrapIndex.reset(getNumberOfRows());
+        }
+        hScrollBar->value(1, textArea.w, 1, textArea.w);
+    }
+    else
+    {
+        hScrollBar->value(hScrollBar->value(), textArea.w, 1, maxLineWidth);
+    }
+    updateVerticalScrollBar();
+}
+
+void LogDisplayWidget::updateVerticalScrollBar()
+{
+    if (approximate.active)
+    {
+        // The scroll bar maps to byte offsets, the size of the slider is the estimated size of the screen
+        const auto size = static_cast<double>(std::max<size_t>(approximate.size, 1));
+        const double position = static_cast<double>(approximate.windowBegin) / size;
+        const double screen = std::min(howManyLinesCanFit() * approximate.bytesPerLine / size, 1.0);
+        vScrollBar->value(static_cast<int>(position * APPROXIMATE_SCROLL_STEPS) + 1,
+                          std::max(static_cast<int>(screen * APPROXIMATE_SCROLL_STEPS), 1), 1,
+                          APPROXIMATE_SCROLL_STEPS);
+        return;
+    }
+    if (!wrapEnabled)
+    {
+        vScrollBar->value(vScrollBar->value(), howManyLinesCanFit(), 1, static_cast<int>(getNumberOfRows()));
+        return;
+    }
+
+    constexpr size_t maxRows = std::numeric_limits<int>::max() - 1;
+    const size_t totalRows = std::min(wrapIndex.getTotalRows(), maxRows);
+    const size_t topRow = std::min(wrapIndex.getFirstRowOfLine(wrapTop.row) + wrapTop.subRow, totalRows);
+    vScrollBar->value(static_cast<int>(topRow) + 1, howManyLinesCanFit(), 1, static_cast<int>(totalRows));
+}
+
+void LogDisplayWidget::resetWrapIndex()
+{
+    wrapIndex.reset(getNumberOfRows());
+    wrapTop.row = 0;
+    wrapTop.subRow = 0;
+    visibleRows.clear();
 }
 
 int LogDisplayWidget::calcLineNumberWidth() const
 {
-    const size_t numOfLines = lines.size();
+    const size_t numOfLines =
+        approximate.active ? static_cast<size_t>(approximate.size / approximate.bytesPerLine) : lines->size();
     std::string maxLineNumber = std::to_string(numOfLines);
+    if (approximate.active)
+    {
+        maxLineNumber += '0'; // room for "~"
+    }
     for (char& digit : maxLineNumber)
     {
         digit = '0'; // Probably the widest digit
@@ -432,7 +1154,7 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleMousePressed()
 void LogDisplayWidget::handleMousePressedOnTextArea()
 {
     take_focus();
-    setCursorPos(getDataIndex(getMouseX(), getMouseY()), getLineIndex(getMouseY()));
+    setCursorPos(getDataIndex(getMouseX(), getMouseY()));
 
     // Selection with a shift key being held
     if (Fl::event_shift())
@@ -470,28 +1192,44 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleMouseDragged()
 {
     if (Fl::event_inside(lineNumbersArea.x, lineNumbersArea.y, lineNumbersArea.w, lineNumbersArea.h))
     {
-        const size_t row = getLineIndex(getMouseY());
-        selection.end = lines[row].second + 1;
-        setCursorPos(selection.end, row + 1);
+        selection.end = getLineEndWithNewline(getLineIndex(getMouseY()));
+        setCursorPos(selection.end);
     }
     else
     {
         setSelectionEnd(getMouseX(), getMouseY());
-        setCursorPos(selection.end, getLineIndex(getMouseY()));
+        setCursorPos(selection.end);
     }
     damage(FL_DAMAGE_SCROLL);
     return EventStatus::Handled;
 }
 
-LogDisplayWidget::EventStatus LogDisplayWidget::handleMouseScrolled() const
+LogDisplayWidget::EventStatus LogDisplayWidget::handleMouseScrolled()
 {
-    if (Fl::event_inside(this))
+    if (!Fl::event_inside(this))
+    {
+        return EventStatus::NotHandled;
+    }
+    // The scroll bars scroll themselves
+    if (Fl::event_inside(vScrollBar) || Fl::event_inside(hScrollBar))
     {
         return EventStatus::Handled;
     }
 
-    return EventStatus::NotHandled;
+    // Shift turns the vertical wheel into a horizontal one
+    const int dx = Fl::event_shift() ? Fl::event_dy() : Fl::event_dx();
+    const int dy = Fl::event_shift() ? 0 : Fl::event_dy();
+    if (dy != 0)
+    {
+        scrollRowsBy(static_cast<long long>(dy) * vScrollBar->linesize());
+    }
+    if (dx != 0 && !wrapEnabled)
+    {
+        scrollPixelsBy(dx * hScrollBar->linesize());
+    }
+    return EventStatus::Handled;
 }
+
 LogDisplayWidget::EventStatus LogDisplayWidget::handleMouseMoved() const
 {
     if (Fl::event_inside(textArea.x, textArea.y, textArea.w, textArea.h))
@@ -504,6 +1242,46 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleMouseMoved() const
     return EventStatus::NotHandled;
 }
 
+// Dropped files arrive as a list of paths separated with newlines. On some systems these are file:// URIs.
+void LogDisplayWidget::handleFilesDropped() const
+{
+    if (!onFileDroppedCallback || Fl::event_text() == nullptr)
+    {
+        return;
+    }
+
+    std::string_view text(Fl::event_text(), Fl::event_length());
+    text = text.substr(0, text.find_first_of("\r\n"));
+    std::string path;
+    if (text.starts_with("file://"))
+    {
+        // Skip the host part and decode %XX escapes
+        text.remove_prefix(text.find('/', 7) == std::string_view::npos ? text.size() : text.find('/', 7));
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '%' && i + 2 < text.size() && std::isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+                std::isxdigit(static_cast<unsigned char>(text[i + 2])))
+            {
+                path += static_cast<char>(std::stoi(std::string(text.substr(i + 1, 2)), nullptr, 16));
+                i += 2;
+            }
+            else
+            {
+                path += text[i];
+            }
+        }
+    }
+    else
+    {
+        path = text;
+    }
+
+    if (!path.empty())
+    {
+        onFileDroppedCallback(path);
+    }
+}
+
 LogDisplayWidget::EventStatus LogDisplayWidget::handleKeyboard()
 {
     // Ctrl + C
@@ -521,21 +1299,158 @@ LogDisplayWidget::EventStatus LogDisplayWidget::handleKeyboard()
         return EventStatus::Handled;
     }
 
-    return EventStatus::NotHandled;
+    const long long page = std::max(howManyLinesCanFit() - 1, 1);
+    switch (Fl::event_key())
+    {
+    case FL_Up:
+        scrollRowsBy(-1);
+        return EventStatus::Handled;
+    case FL_Down:
+        scrollRowsBy(1);
+        return EventStatus::Handled;
+    case FL_Page_Up:
+        scrollRowsBy(-page);
+        return EventStatus::Handled;
+    case FL_Page_Down:
+        scrollRowsBy(page);
+        return EventStatus::Handled;
+    case FL_Home:
+        if (approximate.active)
+        {
+            scrollToApproximateOffset(0);
+        }
+        scrollRowsBy(std::numeric_limits<int>::min());
+        scrollPixelsBy(std::numeric_limits<int>::min());
+        return EventStatus::Handled;
+    case FL_End:
+        if (approximate.active)
+        {
+            scrollToApproximateOffset(approximate.size);
+            return EventStatus::Handled;
+        }
+        scrollRowsBy(std::numeric_limits<int>::max());
+        return EventStatus::Handled;
+    case FL_Left:
+        scrollPixelsBy(-hScrollBar->linesize());
+        return EventStatus::Handled;
+    case FL_Right:
+        scrollPixelsBy(hScrollBar->linesize());
+        return EventStatus::Handled;
+    default:
+        return EventStatus::NotHandled;
+    }
+}
+
+// Input events only move the target position. Many events within one frame are merged into one move.
+void LogDisplayWidget::scrollRowsBy(const long long rows)
+{
+    if (approximate.active)
+    {
+        // The top row is always the first line of the window, the target is relative to it
+        targetTopRow = targetTopRow.value_or(0) + rows;
+        scheduleFrame();
+        return;
+    }
+    const long long currentRow = targetTopRow.value_or(vScrollBar->value() - 1);
+    const long long lastTopRow = std::max(static_cast<long long>(vScrollBar->maximum()) - 1, 0LL);
+    targetTopRow = std::clamp(currentRow + rows, 0LL, lastTopRow);
+    scheduleFrame();
+}
+
+void LogDisplayWidget::scrollPixelsBy(const int pixels)
+{
+    if (wrapEnabled)
+    {
+        return;
+    }
+    const long long currentLeft = targetLeft.value_or(hScrollBar->value());
+    const auto minimum = static_cast<long long>(hScrollBar->minimum());
+    const auto maximum = std::max(static_cast<long long>(hScrollBar->maximum()), minimum);
+    targetLeft = static_cast<int>(std::clamp(currentLeft + pixels, minimum, maximum));
+    scheduleFrame();
+}
+
+void LogDisplayWidget::scheduleFrame()
+{
+    if (!frameScheduled)
+    {
+        frameScheduled = true;
+        Fl::add_timeout(FRAME_INTERVAL, frameCallback, this);
+    }
+}
+
+// Apply the target position and redraw, once per frame
+void LogDisplayWidget::frameCallback(void* pThis)
+{
+    auto* widget = static_cast<LogDisplayWidget*>(pThis);
+    widget->frameScheduled = false;
+    if (widget->targetTopRow && widget->approximate.active)
+    {
+        widget->scrollApproximateWindowBy(*widget->targetTopRow);
+        widget->targetTopRow.reset();
+        widget->redrawPending = true;
+    }
+    if (widget->targetTopRow)
+    {
+        // The number of rows may have changed since the target was set
+        const long long lastTopRow = std::max(static_cast<long long>(widget->vScrollBar->maximum()) - 1, 0LL);
+        const auto topRow = static_cast<size_t>(std::min(*widget->targetTopRow, lastTopRow));
+        widget->vScrollBar->value(static_cast<int>(topRow) + 1);
+        if (widget->wrapEnabled)
+        {
+            const auto [row, subRow] = widget->wrapIndex.findLineOfRow(topRow);
+            widget->wrapTop.row = row;
+            widget->wrapTop.subRow = subRow;
+        }
+        widget->targetTopRow.reset();
+        widget->redrawPending = true;
+    }
+    if (widget->targetLeft)
+    {
+        widget->hScrollBar->value(*widget->targetLeft);
+        widget->targetLeft.reset();
+        widget->redrawPending = true;
+    }
+    if (widget->redrawPending)
+    {
+        widget->redrawPending = false;
+        widget->damage(FL_DAMAGE_SCROLL);
+    }
 }
 
 std::string_view LogDisplayWidget::getSelectedText() const
 {
-    const size_t selectionStart = std::min(selection.begin, selection.end);
-    const size_t selectionEnd = std::max(selection.begin, selection.end);
+    const auto [selectionStart, selectionEnd] = getSelection();
     return {data + selectionStart, selectionEnd - selectionStart};
 }
 
 void LogDisplayWidget::copySelectionToClipboard() const
 {
     constexpr int clipboardDestination = 1; // 0 = selection buffer, 1 = clipboard, 2 = both
-    const std::string_view selectedText = getSelectedText();
-    Fl::copy(selectedText.data(), static_cast<int>(selectedText.length()), clipboardDestination);
+    const std::string_view selectedData = getSelectedText();
+    std::string_view selectedText = selectedData;
+    std::string decodedText;
+    if (lines->getEncoding() != TextEncoding::Utf8)
+    {
+        // Only as much text is decoded as could fit into the clipboard
+        decodeToUtf8(selectedData.substr(0, MAX_CLIPBOARD_SIZE), lines->getEncoding(), decodedText);
+        selectedText = decodedText;
+    }
+    size_t copyLength = selectedText.length();
+
+    if (copyLength > MAX_CLIPBOARD_SIZE)
+    {
+        // Do not cut a multi-byte UTF-8 character in half
+        copyLength = alignToCodePoint(selectedText, MAX_CLIPBOARD_SIZE);
+    }
+
+    Fl::copy(selectedText.data(), static_cast<int>(copyLength), clipboardDestination);
+
+    const bool limitExceeded = copyLength < selectedText.length() || selectedData.length() > MAX_CLIPBOARD_SIZE;
+    if (limitExceeded && onClipboardLimitExceededCallback)
+    {
+        onClipboardLimitExceededCallback(copyLength, selectedData.length());
+    }
 }
 
 void LogDisplayWidget::setCursor(const Fl_Cursor cursorType) const
@@ -550,15 +1465,53 @@ int LogDisplayWidget::howManyLinesCanFit() const
     return textArea.h / getLineHeight();
 }
 
-size_t LogDisplayWidget::getIndexOfTopDisplayedLine() const
+size_t LogDisplayWidget::getIndexOfTopDisplayedRow() const
 {
+    if (wrapEnabled)
+    {
+        return wrapTop.row;
+    }
+    if (approximate.active)
+    {
+        return 0;
+    }
     const int index = vScrollBar->value() - 1;
     assert(index >= 0);
     return index;
 }
 
+size_t LogDisplayWidget::getNumberOfRows() const
+{
+    return filterActive ? filteredLines->size() : lines->size();
+}
+
+size_t LogDisplayWidget::getLineOfRow(const size_t row) const
+{
+    return filterActive ? (*filteredLines)[row] : row;
+}
+
+// Returns the row displaying the line or, if the line is filtered out, the first row after it
+size_t LogDisplayWidget::getRowOfLine(const size_t lineIndex) const
+{
+    if (!filterActive)
+    {
+        return lineIndex;
+    }
+    if (!filterAscending)
+    {
+        return lineIndex < rowsOfLines.size() && rowsOfLines[lineIndex] != NO_ROW ? rowsOfLines[lineIndex] : 0;
+    }
+    const auto it = std::lower_bound(filteredLines->begin(), filteredLines->end(), lineIndex);
+    const size_t row = it - filteredLines->begin();
+    return std::min(row, filteredLines->empty() ? 0 : filteredLines->size() - 1);
+}
+
 int LogDisplayWidget::getHorizontalOffset() const
 {
+    if (wrapEnabled)
+    {
+        return 0;
+    }
     return hScrollBar->value() - 1;
 }
 
@@ -570,7 +1523,7 @@ int LogDisplayWidget::getLineHeight() const
 void LogDisplayWidget::findAndSetGlobalMaxLineWidth()
 {
     double maxLineLength = 0;
-    for (const auto& [lineBegin, lineEnd] : lines)
+    for (const auto& [lineBegin, lineEnd] : lines->getLines())
     {
         const size_t lineLength = lineEnd - lineBegin;
         double lineWidth = fl_width(data + lineBegin, static_cast<int>(lineLength));
@@ -582,9 +1535,10 @@ void LogDisplayWidget::findAndSetGlobalMaxLineWidth()
 
 void LogDisplayWidget::updateMaxLineWidth(const size_t lineIndex)
 {
-    const auto [lineBegin, lineEnd] = lines[lineIndex];
-    const size_t lineLength = lineEnd - lineBegin;
-    const double lineWidth = fl_width(data + lineBegin, static_cast<int>(lineLength));
+    const std::string_view lineText = getDisplayText(lineIndex);
+    const double lineWidth = isLongLine(lineIndex)
+                                 ? lineLayouts.getWidth(lineIndex, lineText, lines->isAsciiLine(lineIndex))
+                                 : fl_width(lineText.data(), static_cast<int>(lineText.size()));
 
     if (lineWidth > maxLineWidth)
     {
@@ -593,16 +1547,24 @@ void LogDisplayWidget::updateMaxLineWidth(const size_t lineIndex)
     }
 }
 
-// TODO: Consider taking only dataIndex and calculating lineIndex inside this function
-// This will need a binary search or some other optimization
-void LogDisplayWidget::setCursorPos(size_t dataIndex, size_t lineIndex)
+void LogDisplayWidget::setCursorPos(size_t dataIndex)
 {
+    dataIndex = std::min(dataIndex, dataSize);
+    const size_t lineIndex = lines->findLine(dataIndex);
     cursorPos.pos = dataIndex;
     cursorPos.line = lineIndex;
 
-    if (onCursorPositionChangedCallback && lineIndex < lines.size())
+    if (onCursorPositionChangedCallback && lineIndex < lines->size())
     {
-        onCursorPositionChangedCallback(lineIndex, dataIndex - lines[lineIndex].first);
+        const auto [lineBegin, lineEnd] = (*lines)[lineIndex];
+        const size_t column = lines->getColumn(lineIndex, std::min(dataIndex, lineEnd) - lineBegin);
+        if (approximate.active)
+        {
+            onCursorPositionChangedCallback(getApproximateFirstLine() + lineIndex, column,
+                                            approximate.windowBegin + dataIndex);
+            return;
+        }
+        onCursorPositionChangedCallback(lineIndex, column, dataIndex);
     }
 }
 
@@ -622,111 +1584,162 @@ void LogDisplayWidget::setSelectionEnd(const int mouseX, const int mouseY)
 void LogDisplayWidget::selectWord(const int mouseX, const int mouseY)
 {
     const size_t selectionEndIndex = getDataIndex(mouseX, mouseY);
+    const size_t lineIndex = lines->findLine(selectionEndIndex);
+    if (lineIndex >= lines->size())
+    {
+        return;
+    }
 
-    size_t selectionBegin = selectionEndIndex;
-    size_t selectionEnd = selectionEndIndex;
+    // Words end with the line. They are found in the displayed text.
+    const std::string_view text = getDisplayText(lineIndex);
+    size_t selectionBegin = toDisplayOffset(lineIndex, selectionEndIndex);
+    size_t selectionEnd = selectionBegin;
+    // Bytes of multibyte characters are never separators, so the word never ends inside a character
     // Find word start
-    while (selectionBegin > 0 && !isWordSeparator(data[selectionBegin - 1]))
+    while (selectionBegin > 0 && !isWordSeparator(text[selectionBegin - 1]))
     {
         selectionBegin--;
     }
     // Find word end
-    while (selectionEnd < dataSize && !isWordSeparator(data[selectionEnd]))
+    while (selectionEnd < text.size() && !isWordSeparator(text[selectionEnd]))
     {
         selectionEnd++;
     }
-    selection.begin = selectionBegin;
-    selection.end = selectionEnd;
-    setCursorPos(selection.end, getLineIndex(mouseY));
+    selection.begin = toDataIndex(lineIndex, selectionBegin);
+    selection.end = toDataIndex(lineIndex, selectionEnd);
+    setCursorPos(selection.end);
 }
 void LogDisplayWidget::selectLine(const int mouseY)
 {
-    const size_t row = getLineIndex(mouseY);
-    const size_t lineBegin = lines[row].first;
-    const size_t lineEnd = lines[row].second + 1; // including newline character
-    selection.begin = lineBegin;
-    selection.end = lineEnd;
-    setCursorPos(selection.end, row + 1);
+    const size_t lineIndex = getLineIndex(mouseY);
+    selection.begin = (*lines)[lineIndex].first;
+    selection.end = getLineEndWithNewline(lineIndex);
+    setCursorPos(selection.end);
 }
 
-size_t LogDisplayWidget::getDataIndex(const int mouseX, const int mouseY) const
+// The newline is a whole code unit, e.g. two bytes in UTF-16, so the line ends where the next one begins
+size_t LogDisplayWidget::getLineEndWithNewline(const size_t lineIndex) const
 {
+    return lineIndex + 1 < lines->size() ? (*lines)[lineIndex + 1].first : dataSize;
+}
+
+size_t LogDisplayWidget::getDataIndex(const int mouseX, const int mouseY)
+{
+    if (wrapEnabled && !visibleRows.empty())
+    {
+        const VisualRow& row = visibleRows[getVisualRowAt(mouseY)];
+        return getDataIndexInRange(row.lineIndex, row.begin, row.end, mouseX);
+    }
     const size_t lineIndex = getLineIndex(mouseY);
     return getDataIndexInGivenLine(lineIndex, mouseX);
 }
 
 size_t LogDisplayWidget::getLineIndex(const int mouseY) const
 {
+    if (wrapEnabled && !visibleRows.empty())
+    {
+        return visibleRows[getVisualRowAt(mouseY)].lineIndex;
+    }
     if (mouseY < textArea.y)
     {
-        return 0;
+        return getLineOfRow(0);
     }
     if (mouseY > textArea.y + textArea.h)
     {
-        return lines.size() - 1;
+        return getLineOfRow(getNumberOfRows() - 1);
     }
 
     const int mousePos = mouseY - textArea.y; // relative to text area
-    const int howManyLines = howManyLinesCanFit() + 1;
-    const int lineHeight = getLineHeight();
-    const int topLineIndex = getIndexOfTopDisplayedLine();
-    int rowBegin = 0;
-    int rowEnd = rowBegin;
-
-    // TODO: binary search
-    for (int i = 0; i < howManyLines; i++)
-    {
-        rowBegin = rowEnd;
-        rowEnd += lineHeight;
-        if (mousePos >= rowBegin && mousePos <= rowEnd)
-        {
-            return i + topLineIndex;
-        }
-    }
-    return 0;
+    const size_t row = getIndexOfTopDisplayedRow() + static_cast<size_t>(mousePos / getLineHeight());
+    return getLineOfRow(std::min(row, getNumberOfRows() - 1));
 }
 
 // Return the index of the character in a line pointed by the mouse.
-size_t LogDisplayWidget::getDataIndexInGivenLine(const size_t lineIndex, const int mouseX) const
+size_t LogDisplayWidget::getDataIndexInGivenLine(const size_t lineIndex, const int mouseX)
 {
-    if (lineIndex >= lines.size())
+    if (lineIndex >= lines->size())
     {
         return dataSize;
     }
+    const auto [lineBegin, lineEnd] = (*lines)[lineIndex];
+    if (isLongLine(lineIndex) && mouseX >= textArea.x)
+    {
+        const double mousePos = mouseX - textArea.x + getHorizontalOffset();
+        setTextFont();
+        return toDataIndex(lineIndex, lineLayouts.findOffset(lineIndex, getDisplayText(lineIndex),
+                                                             lines->isAsciiLine(lineIndex), mousePos));
+    }
+    return getDataIndexInRange(lineIndex, lineBegin, lineEnd, mouseX);
+}
+
+// Return the index of the character pointed by the mouse in a piece [begin, end) of a line
+// displayed from the left edge of the text area.
+size_t LogDisplayWidget::getDataIndexInRange(const size_t lineIndex, const size_t begin, const size_t end,
+                                             const int mouseX) const
+{
     if (mouseX < textArea.x)
     {
-        return lines[lineIndex].first;
+        return begin;
     }
 
     const int mousePos =
         mouseX - textArea.x + getHorizontalOffset(); // relative to text area including horizontal offset
-    const auto [lineBegin, lineEnd] = lines[lineIndex];
-
-    const size_t columnBegin = lineBegin;
-    size_t columnEnd = lineBegin;
-    while (columnEnd <= lineEnd)
+    const size_t textBegin = toDisplayOffset(lineIndex, begin);
+    const std::string_view text =
+        getDisplayText(lineIndex).substr(textBegin, toDisplayOffset(lineIndex, end) - textBegin);
+    const bool asciiLine = lines->isAsciiLine(lineIndex);
+
+    // Step over whole characters so that the cursor never lands inside a multibyte character
+    size_t column = 0;
+    double textWidth = 0;
+    while (column < text.size())
     {
-        const int textLength = static_cast<int>(columnEnd - columnBegin);
-        const double textWidth = fl_width(data + columnBegin, textLength);
-        if (mousePos >= textWidth)
+        const size_t nextColumn = asciiLine ? column + 1 : nextCodePoint(text, column);
+        textWidth += fl_width(text.data() + column, static_cast<int>(nextColumn - column));
+        if (mousePos < textWidth)
         {
-            columnEnd++;
-        }
-        else
-        {
-            return columnEnd - 1;
+            return toDataIndex(lineIndex, textBegin + column);
         }
+        column = nextColumn;
     }
 
-    return lineEnd;
+    return end;
 }
 
+// Index of the row in visibleRows under the mouse, clamped to the displayed rows
+size_t LogDisplayWidget::getVisualRowAt(const int mouseY) const
+{
+    const int row = (mouseY - textArea.y) / getLineHeight();
+    return std::clamp<size_t>(std::max(row, 0), 0, visibleRows.size() - 1);
+}
+
+// Moving a scroll bar overrides the target position, the view is redrawn in the next frame
 void LogDisplayWidget::vScrollCallback(Fl_Scrollbar*, LogDisplayWidget* pThis)
 {
-    pThis->damage(FL_DAMAGE_SCROLL);
+    if (pThis->approximate.active)
+    {
+        // Seek to the byte offset, the window is moved right away
+        const double position = static_cast<double>(pThis->vScrollBar->value() - 1) / APPROXIMATE_SCROLL_STEPS;
+        pThis->scrollToApproximateOffset(static_cast<size_t>(position * static_cast<double>(pThis->approximate.size)));
+        pThis->targetTopRow.reset();
+        pThis->redrawPending = true;
+        pThis->scheduleFrame();
+        return;
+    }
+    if (pThis->wrapEnabled)
+    {
+        const auto [row, subRow] = pThis->wrapIndex.findLineOfRow(pThis->vScrollBar->value() - 1);
+        pThis->wrapTop.row = row;
+        pThis->wrapTop.subRow = subRow;
+    }
+    pThis->targetTopRow.reset();
+    pThis->redrawPending = true;
+    pThis->scheduleFrame();
 }
 
 void LogDisplayWidget::hScrollCallback(Fl_Scrollbar*, LogDisplayWidget* pThis)
 {
-    pThis->damage(FL_DAMAGE_SCROLL);
+    pThis->targetLeft.reset();
+    pThis->redrawPending = true;
+    pThis->scheduleFrame();
 }
@@ -1,7 +1,17 @@
 #pragma once
+#include "core/FieldStore.hpp"
+#include "core/LineIndex.hpp"
+#include "core/TimeGaps.hpp"
+#include "core/WrapIndex.hpp"
+#include "widgets/DecodedLineCache.hpp"
+#include "widgets/LineLayoutCache.hpp"
+#include "widgets/TextMetrics.hpp"
+
 #include <FL/Fl_Group.H>
 #include <FL/Fl_Scrollbar.H>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -17,18 +27,91 @@ public:
     LogDisplayWidget(int X, int Y, int W, int H);
     ~LogDisplayWidget() override;
 
-    void setData(const char* data, size_t size);
+    // Display the data with its line index, which is built by the caller (usually in the background).
+    // Setting a bigger index of the same data, e.g. of the whole file after its beginning, keeps the view.
+    void setData(const char* data, size_t size, std::shared_ptr<LineIndex> index);
+
+    // Stop displaying the data and give back its index, e.g. to keep it while another document is displayed
+    std::shared_ptr<LineIndex> takeData();
+
+    // Display the data appended to the displayed data, e.g. text still arriving from a pipe. The data must not
+    // have moved, only the new lines are indexed. If the end of the data was shown, the view follows it.
+    void appendData(size_t size, TaskScheduler* scheduler);
     const char* getData() const;
     size_t getDataSize() const;
     const std::vector<std::pair<size_t, size_t>>& getLines() const;
+    const LineIndex& getIndexedLines() const;
+
+    // The index shared with background work, which keeps it alive until the work stops.
+    // It is extended in place when data is appended.
+    std::shared_ptr<const LineIndex> getSharedIndexedLines() const;
+
+    // Display the data before its line index is built, like "less" does with big files. Only a window of lines
+    // from the top of the view is indexed, the vertical scroll bar positions the view by byte offset and
+    // the line numbers are estimated. Until setData() is called with the index of the same data, getData() and
+    // the other methods refer to the window. Lines are not wrapped in this mode.
+    void setApproximateData(const char* data, size_t size);
+    bool isApproximate() const;
+    size_t getApproximateDataSize() const;
+
+    // Scroll the approximately displayed data to the first line beginning at or after the offset
+    void scrollToApproximateOffset(size_t offset);
 
     void select(size_t startPos, size_t endPos);
     void scrollToLine(size_t lineIndex);
+    size_t getTopLine() const;
+
+    // Put the cursor at the offset and scroll to its line.
+    void goToOffset(size_t offset);
+
+    // Display only the given lines in the given order, usually ascending. Lines in another order,
+    // e.g. sorted by a field, are displayed in that order.
+    void setLineFilter(std::vector<size_t> lineIndices);
+    void clearLineFilter();
+    bool isFiltered() const;
+
+    // Lines displayed by the filter, in the order of the rows, or nothing if no filter is active.
+    // They stay valid after the filter changes, so background work can narrow them.
+    std::shared_ptr<const std::vector<size_t>> getFilteredLines() const;
+
+    // Highlight the lines in the given ranges [begin, end) of line indices, e.g. the differences of two logs.
+    // The ranges must be sorted and must not overlap. Setting other data removes the highlight.
+    void setMarkedLines(std::vector<std::pair<size_t, size_t>> ranges, Fl_Color color);
+
+    // Wrap lines longer than the width of the view instead of scrolling horizontally.
+    void setWrapEnabled(bool enabled);
+    bool isWrapEnabled() const;
+
+    // Show values of structured fields in columns between the line numbers and the text.
+    // The store is not owned by the widget. Passing an empty list of fields hides the columns.
+    void setFieldStore(FieldStore* store);
+    void setFieldColumns(const std::vector<std::string>& fieldNames);
+
+    // Show the time gap before every line as a heat column next to the line numbers, the redder the longer.
+    // The gaps are not owned by the widget and must not be extended while they are set. Passing nullptr
+    // hides the column.
+    void setTimeGaps(const TimeGaps* gaps);
+
+    // Returns the selected range of data as a pair of begin and end offsets (begin <= end).
+    std::pair<size_t, size_t> getSelection() const;
 
     // Set callback for onCursorPositionChanged event.
-    // The callback receives the index of the line where the cursor is
-    // and the index of the character in that line after the cursor.
-    void onCursorPositionChanged(std::function<void(size_t, size_t)>);
+    // The callback receives the index of the line where the cursor is,
+    // the column (in characters) in that line after the cursor and the offset of the cursor in data.
+    void onCursorPositionChanged(std::function<void(size_t, size_t, size_t)>);
+
+    // Set callback for onViewportChanged event.
+    // The callback receives the range of data displayed in the view, from the first to the last visible line.
+    void onViewportChanged(std::function<void(size_t, size_t)>);
+
+    // Set callback for onClipboardLimitExceeded event.
+    // The callback receives the number of bytes copied to the clipboard
+    // and the size of the whole selection that did not fit into it.
+    void onClipboardLimitExceeded(std::function<void(size_t, size_t)>);
+
+    // Set callback for onFileDropped event.
+    // The callback receives the path of a file dragged and dropped onto the widget.
+    void onFileDropped(std::function<void(const std::string&)>);
 
 protected:
     void draw() override;
@@ -37,19 +120,43 @@ protected:
 private:
     void drawBackground() const;
     void drawText();
-    void drawSelection(size_t startPos, size_t endPos, int baseline) const;
-    void drawTextLine(size_t lineBegin, size_t lineEnd, int baseline) const;
+    void drawWrappedText();
+    void notifyViewportChanged();
+    void drawSelection(size_t lineIndex, size_t startPos, size_t endPos, int textX, int baseline) const;
+    void drawTextLine(size_t lineIndex, size_t lineBegin, size_t lineEnd, int textX, int baseline) const;
     void drawLineNumber(int lineNumber, int baseline, Fl_Color bgcolor) const;
+    void drawFieldValues(size_t lineIndex, int baseline, Fl_Color bgcolor) const;
+    void drawTimeGap(size_t lineIndex, int baseline) const;
+    int getTimeGapsWidth() const;
     void recalcSize();
     int calcLineNumberWidth() const;
+    void updateVerticalScrollBar();
+    void resetWrapIndex();
+    const std::vector<size_t>& wrapLine(size_t lineIndex);
+    bool isLongLine(size_t lineIndex) const;
+    std::string_view getDisplayText(size_t lineIndex) const;
+    size_t toDisplayOffset(size_t lineIndex, size_t dataIndex) const;
+    size_t toDataIndex(size_t lineIndex, size_t displayOffset) const;
+    bool isMarkedLine(size_t lineIndex) const;
+    void setTextFont();
+    void setApproximateWindow(size_t begin);
+    void scrollApproximateWindowBy(long long rows);
+    size_t findApproximateLineBegin(size_t offset, size_t linesAbove) const;
+    size_t findApproximateLineStart(size_t offset) const;
+    size_t getApproximateFirstLine() const;
 
     EventStatus handleEvent(int event);
     EventStatus handleMousePressed();
     void handleMousePressedOnTextArea();
     EventStatus handleMouseDragged();
-    EventStatus handleMouseScrolled() const;
+    EventStatus handleMouseScrolled();
     EventStatus handleMouseMoved() const;
     EventStatus handleKeyboard();
+    void handleFilesDropped() const;
+    void scrollRowsBy(long long rows);
+    void scrollPixelsBy(int pixels);
+    void scheduleFrame();
+    static void frameCallback(void* pThis);
 
     void setCursor(Fl_Cursor cursorType) const;
     int howManyLinesCanFit() const;
@@ -58,15 +165,21 @@ private:
     void findAndSetGlobalMaxLineWidth(); // This is slow, dont use for files with more than million lines
     void updateMaxLineWidth(size_t lineIndex);
 
-    void setCursorPos(size_t dataIndex, size_t lineIndex);
+    void setCursorPos(size_t dataIndex);
     void setSelectionStart(int mouseX, int mouseY);
     void setSelectionEnd(int mouseX, int mouseY);
     void selectWord(int mouseX, int mouseY);
     void selectLine(int mouseY);
-    size_t getDataIndex(int mouseX, int mouseY) const;
+    size_t getDataIndex(int mouseX, int mouseY);
     size_t getLineIndex(int mouseY) const;
-    size_t getIndexOfTopDisplayedLine() const;
-    size_t getDataIndexInGivenLine(size_t lineIndex, int mouseX) const;
+    size_t getLineEndWithNewline(size_t lineIndex) const;
+    size_t getIndexOfTopDisplayedRow() const;
+    size_t getNumberOfRows() const;
+    size_t getLineOfRow(size_t row) const;
+    size_t getRowOfLine(size_t lineIndex) const;
+    size_t getDataIndexInGivenLine(size_t lineIndex, int mouseX);
+    size_t getDataIndexInRange(size_t lineIndex, size_t begin, size_t end, int mouseX) const;
+    size_t getVisualRowAt(int mouseY) const;
 
     std::string_view getSelectedText() const;
     void copySelectionToClipboard() const;
@@ -88,6 +201,20 @@ private:
     Fl_Color lineNumbersColor = fl_rgb_color(150, 150, 150);
     Fl_Color lineNumbersBgColor = fl_rgb_color(245, 245, 245);
 
+    // Heat column of time gaps at the right edge of the line numbers
+    const TimeGaps* timeGaps = nullptr;
+    Fl_Color timeGapsColor = FL_RED;
+
+    // Columns with values of structured fields displayed between line numbers and text area
+    struct
+    {
+        int x, y, w, h;
+    } fieldsArea{};
+    FieldStore* fieldStore = nullptr;
+    std::vector<size_t> fieldColumns;
+    std::vector<int> fieldColumnWidths;
+    Fl_Color fieldsColor = fl_rgb_color(0, 90, 140);
+
     // Text data
     const char* data = nullptr;
     size_t dataSize = 0;
@@ -116,9 +243,65 @@ private:
         int x, y;
     } doubleClickPos{};
 
-    // An array of pairs of line start and end positions.
-    // This helper array is created when the data is set.
-    std::vector<std::pair<size_t, size_t>> lines;
+    // Line start and end positions with UTF-8 information.
+    // This helper index is created when the data is set.
+    std::shared_ptr<LineIndex> lines = std::make_shared<LineIndex>();
+
+    // Text of other encodings than UTF-8 is decoded line by line when it is displayed. Selection, cursor and
+    // pieces of wrapped lines are kept as offsets in data, layouts and drawing use offsets in the decoded text.
+    mutable DecodedLineCache decodedLines;
+
+    // Indices of lines displayed when the filter is active.
+    // Rows of the view are mapped to lines through this array. It is shared with work narrowing the filter.
+    std::shared_ptr<const std::vector<size_t>> filteredLines;
+    bool filterActive = false;
+    bool filterAscending = true; // rows of lines are found by a binary search
+    std::vector<uint32_t> rowsOfLines; // row of every line when the filter is not ascending, NO_ROW if filtered out
+
+    // Ranges of highlighted lines
+    std::vector<std::pair<size_t, size_t>> markedLines;
+    Fl_Color markedLinesColor = FL_BACKGROUND_COLOR;
+
+    // Approximate mode, before the whole data is indexed. The window of indexed lines always begins
+    // with the top line of the view, scrolling moves the window.
+    struct
+    {
+        bool active;
+        const char* data;
+        size_t size;
+        size_t windowBegin;
+        double bytesPerLine; // in the first window, used to estimate line numbers
+        bool wrapEnabled;    // restored when the index is set
+    } approximate{};
+
+    // Soft wrap. Rows of the view are measured only when they are displayed, the rest is estimated.
+    // In this mode the top of the view is tracked here and the vertical scroll bar counts visual rows.
+    bool wrapEnabled = false;
+    int wrapWidth = 0;
+    WrapIndex wrapIndex;
+    struct
+    {
+        size_t row, subRow;
+    } wrapTop{0, 0};
+
+    // Pieces of lines displayed in the last frame, used to map mouse positions in wrap mode
+    struct VisualRow
+    {
+        size_t lineIndex, begin, end;
+    };
+    std::vector<VisualRow> visibleRows;
+    std::vector<size_t> wrapRows;
+
+    // Widths of characters and layouts of long lines, measured once and reused between frames
+    TextMetrics textMetrics;
+    LineLayoutCache lineLayouts{textMetrics};
+
+    // Wheel and keyboard scrolling moves these targets, which are applied once per frame.
+    // A burst of input events results in one move of the view and one redraw.
+    std::optional<long long> targetTopRow;
+    std::optional<int> targetLeft;
+    bool frameScheduled = false;
+    bool redrawPending = false;
 
     // Text properties
     Fl_Font textFont;
@@ -130,5 +313,9 @@ private:
     Fl_Scrollbar* hScrollBar;
 
     // Callbacks
-    std::function<void(size_t, size_t)> onCursorPositionChangedCallback;
+    std::function<void(size_t, size_t, size_t)> onCursorPositionChangedCallback;
+    std::function<void(size_t, size_t)> onClipboardLimitExceededCallback;
+    std::function<void(size_t, size_t)> onViewportChangedCallback;
+    std::function<void(const std::string&)> onFileDroppedCallback;
+    std::pair<size_t, size_t> lastViewport{0, 0};
 };
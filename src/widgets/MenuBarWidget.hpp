@@ -1,8 +1,11 @@
 #pragma once
 #include <FL/Fl_Menu_Bar.H>
 #include <FL/Fl_Native_File_Chooser.H>
+#include <FL/Fl_Window.H>
 
+#include <functional>
 #include <iostream>
+#include <string>
 
 class MenuBarWidget : public Fl_Menu_Bar
 {
@@ -14,6 +17,124 @@ public:
         buildMenu();
     }
 
+    // Set callback for the "Open File" menu item.
+    // The callback receives the path of the file chosen by the user.
+    void onOpenFile(std::function<void(const std::string&)> callback)
+    {
+        openFileCallback = std::move(callback);
+    }
+
+    // Set callback for the "Close File" menu item.
+    void onCloseFile(std::function<void()> callback)
+    {
+        closeFileCallback = std::move(callback);
+    }
+
+    // Set callback for the "Compare With" menu item.
+    // The callback receives the path of the file chosen by the user.
+    void onCompareWith(std::function<void(const std::string&)> callback)
+    {
+        compareWithCallback = std::move(callback);
+    }
+
+    // Set callback for the "Export Selection" menu item.
+    // The callback receives the path of the file chosen by the user.
+    void onExportSelection(std::function<void(const std::string&)> callback)
+    {
+        exportSelectionCallback = std::move(callback);
+    }
+
+    // Set callback for the "Export Matching Lines" menu item.
+    // The callback receives the path of the file chosen by the user.
+    void onExportMatchingLines(std::function<void(const std::string&)> callback)
+    {
+        exportMatchingLinesCallback = std::move(callback);
+    }
+
+    // Set callback for the "Field Columns" menu item.
+    void onFieldColumns(std::function<void()> callback)
+    {
+        fieldColumnsCallback = std::move(callback);
+    }
+
+    // Set callback for the "Sort by Field" menu item.
+    void onSortByField(std::function<void()> callback)
+    {
+        sortByFieldCallback = std::move(callback);
+    }
+
+    // Set callback for the "Log Format" menu item.
+    void onLogFormat(std::function<void()> callback)
+    {
+        logFormatCallback = std::move(callback);
+    }
+
+    // Set callback for the "Encoding" menu item.
+    void onEncoding(std::function<void()> callback)
+    {
+        encodingCallback = std::move(callback);
+    }
+
+    // Set callback for the "Memory Budget" menu item.
+    void onMemoryBudget(std::function<void()> callback)
+    {
+        memoryBudgetCallback = std::move(callback);
+    }
+
+    // Set callback for the "Aggregate" menu item.
+    void onAggregate(std::function<void()> callback)
+    {
+        aggregateCallback = std::move(callback);
+    }
+
+    // Set callback for the "Log Templates" menu item.
+    void onLogTemplates(std::function<void()> callback)
+    {
+        logTemplatesCallback = std::move(callback);
+    }
+
+    // Set callback for the "Word Wrap" menu item. The callback receives the new state of the item.
+    void onWordWrap(std::function<void(bool)> callback)
+    {
+        wordWrapCallback = std::move(callback);
+    }
+
+    // Set callback for the "Time Gaps" menu item. The callback receives the new state of the item.
+    void onTimeGaps(std::function<void(bool)> callback)
+    {
+        timeGapsCallback = std::move(callback);
+    }
+
+    // Set callback for the "Search Index" menu item. The callback receives the new state of the item.
+    void onSearchIndex(std::function<void(bool)> callback)
+    {
+        searchIndexCallback = std::move(callback);
+    }
+
+    // Set callback for the "Go To" menu item.
+    void onGoTo(std::function<void()> callback)
+    {
+        goToCallback = std::move(callback);
+    }
+
+    // Set callback for the "Next Largest Gap" menu item.
+    void onNextLargestGap(std::function<void()> callback)
+    {
+        nextLargestGapCallback = std::move(callback);
+    }
+
+    // Set callback for the "Search in Files" menu item.
+    void onSearchInFiles(std::function<void()> callback)
+    {
+        searchInFilesCallback = std::move(callback);
+    }
+
+    // Set callback for the "Clear Filter" menu item.
+    void onClearFilter(std::function<void()> callback)
+    {
+        clearFilterCallback = std::move(callback);
+    }
+
 private:
     void buildMenu()
     {
@@ -21,41 +142,65 @@ private:
         Fl_Callback* noCallback = nullptr;
         constexpr int noShortcut = 0;
 
-        add("File/@fileopen  Open File...", FL_CTRL + 'o', openFileDialog, noUserData, 0);
+        add("File/@fileopen  Open File...", FL_CTRL + 'o', openFileDialog, this, 0);
         add("File/@filesave  Save", FL_CTRL + 's', noCallback, noUserData, FL_MENU_INACTIVE);
         add("File/@filesaveas  Save As...", FL_CTRL + FL_SHIFT + 's', saveFileDialog, noUserData, 0);
-        add("File/Close File", FL_CTRL + 'w', noCallback, noUserData, FL_MENU_INACTIVE);
+        add("File/Compare With...", FL_CTRL + 'd', compareWithDialog, this, 0);
+        add("File/Export Selection...", FL_CTRL + 'e', exportSelectionDialog, this, 0);
+        add("File/Export Matching Lines...", FL_CTRL + FL_SHIFT + 'e', exportMatchingLinesDialog, this, 0);
+        add("File/Close File", FL_CTRL + 'w', invokeCallback, &closeFileCallback, 0);
         add("File/Settings", noShortcut, noCallback, noUserData, FL_MENU_INACTIVE | FL_MENU_DIVIDER);
         add("File/Quit", FL_CTRL + 'q', quitCallback);
         add("_Search", noShortcut, noCallback, noUserData, FL_SUBMENU /* | FL_MENU_INACTIVE */);
         add("Search/Find", FL_CTRL + 'f', noCallback, noUserData, FL_MENU_INACTIVE);
         add("Search/Find All     ", FL_CTRL + FL_SHIFT + 'f', noCallback, noUserData, FL_MENU_INACTIVE);
         add("Search/Filter     ", FL_CTRL + 'g', noCallback, noUserData, FL_MENU_INACTIVE);
+        add("Search/Go To...", FL_CTRL + 'l', invokeCallback, &goToCallback, 0);
+        add("Search/Next Largest Gap", FL_CTRL + 'j', invokeCallback, &nextLargestGapCallback, 0);
+        add("Search/Search in Files...", FL_CTRL + FL_SHIFT + 'o', invokeCallback, &searchInFilesCallback, 0);
+        add("Search/Aggregate...", FL_CTRL + FL_SHIFT + 'a', invokeCallback, &aggregateCallback, 0);
+        add("Search/Sort by Field...", noShortcut, invokeCallback, &sortByFieldCallback, 0);
+        add("Search/Clear Filter", FL_CTRL + FL_SHIFT + 'g', invokeCallback, &clearFilterCallback, FL_MENU_DIVIDER);
+        add("Search/Search Index", noShortcut, invokeToggleCallback, &searchIndexCallback, FL_MENU_TOGGLE);
+        add("View/Field Columns...", FL_CTRL + 'k', invokeCallback, &fieldColumnsCallback, 0);
+        add("View/Log Format...", noShortcut, invokeCallback, &logFormatCallback, 0);
+        add("View/Encoding...", noShortcut, invokeCallback, &encodingCallback, 0);
+        add("View/Log Templates...", FL_CTRL + 't', invokeCallback, &logTemplatesCallback, FL_MENU_DIVIDER);
+        add("View/Word Wrap", FL_ALT + 'z', invokeToggleCallback, &wordWrapCallback, FL_MENU_TOGGLE);
+        add("View/Time Gaps", noShortcut, invokeToggleCallback, &timeGapsCallback, FL_MENU_TOGGLE | FL_MENU_DIVIDER);
+        add("View/Memory Budget...", noShortcut, invokeCallback, &memoryBudgetCallback, 0);
         add("Help/About    ", FL_F + 1, noCallback, noUserData, FL_MENU_INACTIVE);
         global();
     }
 
+    // Hiding all windows ends Fl::run(), so main() returns and the application cleans up after itself
     static void quitCallback(Fl_Widget*, void*)
     {
-        exit(0);
+        while (Fl_Window* window = Fl::first_window())
+        {
+            window->hide();
+        }
     }
 
-    static void openFileDialog(Fl_Widget*, void*)
+    static void openFileDialog(Fl_Widget*, void* pThis)
     {
+        const auto* menuBar = static_cast<MenuBarWidget*>(pThis);
         Fl_Native_File_Chooser fileChooser;
         fileChooser.title(nullptr);
         fileChooser.type(Fl_Native_File_Chooser::BROWSE_FILE);
-        fileChooser.filter("Log Files\t*.log\nLog Viewer Project\t*.lvproj");
+        fileChooser.filter("Log Files\t*.log\nText Files\t*.txt\nLog Viewer Project\t*.lvproj");
         switch (fileChooser.show())
         {
         case -1:
             std::cout << "File Open ERROR: " << fileChooser.errmsg() << std::endl;
             break;
         case 1:
-            std::cout << "File Open CANCELLED" << std::endl;
             break;
         default:
-            std::cout << "File Open OK: " << fileChooser.filename() << std::endl;
+            if (menuBar->openFileCallback)
+            {
+                menuBar->openFileCallback(fileChooser.filename());
+            }
         }
     }
 
@@ -78,4 +223,98 @@ private:
             std::cout << "File Save OK: " << fileChooser.filename() << std::endl;
         }
     }
+
+    static void compareWithDialog(Fl_Widget*, void* pThis)
+    {
+        const auto* menuBar = static_cast<MenuBarWidget*>(pThis);
+        Fl_Native_File_Chooser fileChooser;
+        fileChooser.title("Compare With");
+        fileChooser.type(Fl_Native_File_Chooser::BROWSE_FILE);
+        fileChooser.filter("Log Files\t*.log\nText Files\t*.txt");
+        if (fileChooser.show() == 0 && menuBar->compareWithCallback)
+        {
+            menuBar->compareWithCallback(fileChooser.filename());
+        }
+    }
+
+    static void exportSelectionDialog(Fl_Widget*, void* pThis)
+    {
+        const auto* menuBar = static_cast<MenuBarWidget*>(pThis);
+        const std::string filename = exportFileDialog();
+        if (!filename.empty() && menuBar->exportSelectionCallback)
+        {
+            menuBar->exportSelectionCallback(filename);
+        }
+    }
+
+    static void exportMatchingLinesDialog(Fl_Widget*, void* pThis)
+    {
+        const auto* menuBar = static_cast<MenuBarWidget*>(pThis);
+        const std::string filename = exportFileDialog();
+        if (!filename.empty() && menuBar->exportMatchingLinesCallback)
+        {
+            menuBar->exportMatchingLinesCallback(filename);
+        }
+    }
+
+    // Menu items handled outside of the menu bar get a pointer to their callback as user data
+    static void invokeCallback(Fl_Widget*, void* callback)
+    {
+        const auto* function = static_cast<std::function<void()>*>(callback);
+        if (*function)
+        {
+            (*function)();
+        }
+    }
+
+    // Toggle items pass their new state to the callback
+    static void invokeToggleCallback(Fl_Widget* widget, void* callback)
+    {
+        const auto* menuBar = static_cast<MenuBarWidget*>(widget);
+        const auto* function = static_cast<std::function<void(bool)>*>(callback);
+        if (*function)
+        {
+            (*function)(menuBar->mvalue()->value() != 0);
+        }
+    }
+
+    // Returns the chosen filename or an empty string if the dialog was cancelled.
+    static std::string exportFileDialog()
+    {
+        Fl_Native_File_Chooser fileChooser;
+        fileChooser.title("Export");
+        fileChooser.type(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
+        fileChooser.options(Fl_Native_File_Chooser::SAVEAS_CONFIRM); // Confirm file overwrite.
+        fileChooser.filter("Log Files\t*.log\nText Files\t*.txt");
+        switch (fileChooser.show())
+        {
+        case -1:
+            std::cout << "File Export ERROR: " << fileChooser.errmsg() << std::endl;
+            return {};
+        case 1:
+            return {};
+        default:
+            return fileChooser.filename();
+        }
+    }
+
+    std::function<void(const std::string&)> openFileCallback;
+    std::function<void()> closeFileCallback;
+    std::function<void(const std::string&)> compareWithCallback;
+    std::function<void(const std::string&)> exportSelectionCallback;
+    std::function<void(const std::string&)> exportMatchingLinesCallback;
+    std::function<void()> fieldColumnsCallback;
+    std::function<void()> sortByFieldCallback;
+    std::function<void()> logFormatCallback;
+    std::function<void()> encodingCallback;
+    std::function<void()> aggregateCallback;
+    std::function<void()> clearFilterCallback;
+    std::function<void()> goToCallback;
+    std::function<void()> nextLargestGapCallback;
+    std::function<void()> searchInFilesCallback;
+    std::function<void()> logTemplatesCallback;
+    std::function<void(bool)> wordWrapCallback;
+    std::function<void(bool)> timeGapsCallback;
+    std::function<void(bool)> searchIndexCallback;
+    std::function<void()> memoryBudgetCallback;
 };
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+#include "core/AggregationQuery.hpp"
+
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Flex.H>
+#include <FL/Fl_Hold_Browser.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Window.H>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Window for running aggregation queries and browsing their results.
+// Every result row has a histogram bar, selecting a row reports its key.
+class QueryWindow : public Fl_Window
+{
+public:
+    QueryWindow(const int w, const int h) : Fl_Window(w, h, "Aggregate")
+    {
+        constexpr int margin = 4;
+        constexpr int rowHeight = 25;
+
+        auto* queryRow = new Fl_Flex(margin, margin, w - 2 * margin, rowHeight, Fl_Flex::HORIZONTAL);
+        queryRow->gap(margin);
+        input = new Fl_Input(0, 0, 0, 0);
+        input->value("count by level");
+        input->tooltip("e.g. count by service, minute where level = error\n"
+                       "     p99(latency_ms) by service");
+        input->callback(reinterpret_cast<Fl_Callback*>(runCallback), this);
+        input->when(FL_WHEN_ENTER_KEY_ALWAYS);
+
+        auto* runButton = new Fl_Button(0, 0, 0, 0, "Run");
+        runButton->callback(reinterpret_cast<Fl_Callback*>(runCallback), this);
+        queryRow->fixed(runButton, 60);
+
+        cancelButton = new Fl_Button(0, 0, 0, 0, "Cancel");
+        cancelButton->callback(reinterpret_cast<Fl_Callback*>(cancelCallback), this);
+        cancelButton->deactivate();
+        queryRow->fixed(cancelButton, 60);
+        queryRow->end();
+
+        const int resultsTop = margin + rowHeight + margin;
+        results = new Fl_Hold_Browser(margin, resultsTop, w - 2 * margin, h - resultsTop - rowHeight - margin);
+        results->format_char(0); // keys are displayed as they are
+        results->column_char('\t');
+        results->column_widths(COLUMN_WIDTHS);
+        results->textfont(FL_COURIER);
+        results->callback(reinterpret_cast<Fl_Callback*>(rowSelectedCallback), this);
+
+        status = new Fl_Box(margin, h - rowHeight, w - 2 * margin, rowHeight);
+        status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+
+        resizable(results);
+        end();
+    }
+
+    // Set callback for running a query. The callback receives the text of the query.
+    void onRun(std::function<void(const std::string&)> callback)
+    {
+        runQueryCallback = std::move(callback);
+    }
+
+    void onCancel(std::function<void()> callback)
+    {
+        cancelQueryCallback = std::move(callback);
+    }
+
+    // Set callback for selecting a result row. The callback receives the key of the row.
+    void onRowSelected(std::function<void(const std::string&)> callback)
+    {
+        rowSelectedQueryCallback = std::move(callback);
+    }
+
+    void setRunning(const bool running)
+    {
+        running ? cancelButton->activate() : cancelButton->deactivate();
+    }
+
+    void setStatus(const std::string& text)
+    {
+        status->copy_label(text.c_str());
+        status->redraw();
+    }
+
+    void setResults(const std::vector<AggregationRow>& rows)
+    {
+        results->clear();
+        rowKeys.clear();
+
+        double maxValue = 0;
+        for (const auto& row : rows)
+        {
+            maxValue = std::max(maxValue, std::abs(row.value));
+        }
+
+        for (const auto& row : rows)
+        {
+            const size_t barLength =
+                maxValue > 0 ? static_cast<size_t>(std::lround(std::abs(row.value) / maxValue * MAX_BAR_LENGTH)) : 0;
+            std::string bar;
+            for (size_t i = 0; i < barLength; i++)
+            {
+                bar += "\xe2\x96\x88"; // Full block: U+2588
+            }
+
+            const std::string text = (row.key.empty() ? "(all)" : row.key) + "\t" + formatNumber(row.value) + "\t" +
+                                     std::to_string(row.count) + "\t" + bar;
+            results->add(text.c_str());
+            rowKeys.push_back(row.key);
+        }
+    }
+
+private:
+    static constexpr size_t MAX_BAR_LENGTH = 30;
+    static constexpr int COLUMN_WIDTHS[] = {220, 100, 90, 0};
+
+    static std::string formatNumber(const double value)
+    {
+        char buffer[64];
+        if (value == std::floor(value) && std::abs(value) < 1e15)
+            std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+        else
+            std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    static void runCallback(Fl_Widget*, QueryWindow* pThis)
+    {
+        if (pThis->runQueryCallback)
+        {
+            pThis->runQueryCallback(pThis->input->value());
+        }
+    }
+
+    static void cancelCallback(Fl_Widget*, QueryWindow* pThis)
+    {
+        if (pThis->cancelQueryCallback)
+        {
+            pThis->cancelQueryCallback();
+        }
+    }
+
+    static void rowSelectedCallback(Fl_Hold_Browser* browser, QueryWindow* pThis)
+    {
+        const int row = browser->value();
+        if (row > 0 && static_cast<size_t>(row) <= pThis->rowKeys.size() && pThis->rowSelectedQueryCallback)
+        {
+            pThis->rowSelectedQueryCallback(pThis->rowKeys[row - 1]);
+        }
+    }
+
+    Fl_Input* input = nullptr;
+    Fl_Button* cancelButton = nullptr;
+    Fl_Hold_Browser* results = nullptr;
+    Fl_Box* status = nullptr;
+    std::vector<std::string> rowKeys;
+
+    std::function<void(const std::string&)> runQueryCallback;
+    std::function<void()> cancelQueryCallback;
+    std::function<void(const std::string&)> rowSelectedQueryCallback;
+};
@@ -27,7 +27,7 @@ public:
         fixed(input, 200);
         input->shortcut(FL_CTRL + 'f');
         input->callback(reinterpret_cast<Fl_Callback*>(doTheSearch), this);
-        input->when(FL_WHEN_ENTER_KEY_ALWAYS);
+        input->when(FL_WHEN_CHANGED | FL_WHEN_ENTER_KEY_ALWAYS);
 
         auto findPrevious = new Fl_Button(0, 0, 20, 20, "@8->");
         findPrevious->box(FL_THIN_UP_BOX);
@@ -62,11 +62,23 @@ public:
         searchCallback = std::move(callback);
     }
 
+    // Set callback for the event of the query being edited. The callback is debounced,
+    // it is called once the user stops typing for a moment.
+    void onQueryChanged(std::function<void(const std::string&)> callback)
+    {
+        queryChangedCallback = std::move(callback);
+    }
+
     void onClose(std::function<void()> callback)
     {
         closeCallback = std::move(callback);
     }
 
+    ~SearchBarWidget() override
+    {
+        Fl::remove_timeout(queryChangedTimeout, this);
+    }
+
 private:
     void addMargin(const int width)
     {
@@ -75,14 +87,32 @@ private:
         fixed(margin, width);
     }
 
-    static void doTheSearch(Fl_Input* input, const SearchBarWidget* pThis)
+    static void doTheSearch(Fl_Input* input, SearchBarWidget* pThis)
     {
-        std::cout << "doTheSearch, reason: " << Fl::callback_reason() << std::endl;
-        if (Fl::callback_reason() == FL_REASON_ENTER_KEY && pThis->searchCallback)
+        if (Fl::callback_reason() == FL_REASON_ENTER_KEY)
         {
-            std::cout << "enter key pressed" << std::endl;
-            std::string text(input->value());
-            pThis->searchCallback(text);
+            Fl::remove_timeout(queryChangedTimeout, pThis);
+            if (pThis->searchCallback)
+            {
+                std::string text(input->value());
+                pThis->searchCallback(text);
+            }
+        }
+        else if (Fl::callback_reason() == FL_REASON_CHANGED)
+        {
+            // Restart the timer on every keystroke
+            Fl::remove_timeout(queryChangedTimeout, pThis);
+            Fl::add_timeout(QUERY_CHANGED_DELAY, queryChangedTimeout, pThis);
+        }
+    }
+
+    static void queryChangedTimeout(void* data)
+    {
+        const auto* pThis = static_cast<SearchBarWidget*>(data);
+        if (pThis->queryChangedCallback)
+        {
+            std::string text(pThis->input->value());
+            pThis->queryChangedCallback(text);
         }
     }
 
@@ -103,7 +133,10 @@ private:
         }
     }
 
+    static constexpr double QUERY_CHANGED_DELAY = 0.15; // seconds
+
     Fl_Input* input = nullptr;
     std::function<void(const std::string&)> searchCallback;
+    std::function<void(const std::string&)> queryChangedCallback;
     std::function<void()> closeCallback;
 };
@@ -0,0 +1,64 @@
+#pragma once
+#include <FL/Fl.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Tabs.H>
+
+#include <functional>
+#include <string>
+
+// Tabs of the open documents. The tabs have no content of their own: the log display below the bar
+// is shared by all documents and shows the document of the selected tab.
+class TabBarWidget : public Fl_Tabs
+{
+public:
+    TabBarWidget(const int x, const int y, const int w, const int h) : Fl_Tabs(x, y, w, h)
+    {
+        box(FL_FLAT_BOX);
+        callback(reinterpret_cast<Fl_Callback*>(tabSelected), this);
+        when(FL_WHEN_CHANGED);
+        end();
+    }
+
+    // Add a tab after the others and select it.
+    void addTab(const std::string& label)
+    {
+        // Empty groups right below the bar put the labels of the tabs at the top
+        auto* tab = new Fl_Group(x(), y() + h(), w(), 0);
+        tab->copy_label(label.c_str());
+        tab->end();
+        add(tab);
+        value(tab);
+        redraw();
+    }
+
+    void removeTab(const size_t index)
+    {
+        Fl_Widget* tab = child(static_cast<int>(index));
+        remove(tab);
+        Fl::delete_widget(tab);
+        redraw();
+    }
+
+    void selectTab(const size_t index)
+    {
+        value(child(static_cast<int>(index)));
+        redraw();
+    }
+
+    // Set callback for the event of a tab being selected by the user. The callback receives the index of the tab.
+    void onTabSelected(std::function<void(size_t)> callback)
+    {
+        tabSelectedCallback = std::move(callback);
+    }
+
+private:
+    static void tabSelected(Fl_Tabs* tabs, const TabBarWidget* pThis)
+    {
+        if (tabs->value() != nullptr && pThis->tabSelectedCallback)
+        {
+            pThis->tabSelectedCallback(static_cast<size_t>(tabs->find(tabs->value())));
+        }
+    }
+
+    std::function<void(size_t)> tabSelectedCallback;
+};
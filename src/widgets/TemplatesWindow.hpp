@@ -0,0 +1,131 @@
+#pragma once
+#include "core/TemplateMiner.hpp"
+
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Flex.H>
+#include <FL/Fl_Multi_Browser.H>
+#include <FL/Fl_Window.H>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Window listing message templates found in the log with the number of lines of each one.
+// Selected templates can be shown exclusively or hidden from the main view.
+class TemplatesWindow : public Fl_Window
+{
+public:
+    TemplatesWindow(const int w, const int h) : Fl_Window(w, h, "Log Templates")
+    {
+        constexpr int margin = 4;
+        constexpr int rowHeight = 25;
+
+        templatesList = new Fl_Multi_Browser(margin, margin, w - 2 * margin, h - 2 * rowHeight - 3 * margin);
+        templatesList->format_char(0); // templates are displayed as they are
+        templatesList->column_char('\t');
+        templatesList->column_widths(COLUMN_WIDTHS);
+
+        auto* buttons = new Fl_Flex(margin, h - 2 * rowHeight - margin, w - 2 * margin, rowHeight, Fl_Flex::HORIZONTAL);
+        buttons->gap(margin);
+        addButton("Show Only", [this] { callWithSelection(showOnlyCallback); });
+        addButton("Hide", [this] { callWithSelection(hideCallback); });
+        addButton("Collapse Repeats", [this] {
+            if (collapseCallback)
+                collapseCallback();
+        });
+        addButton("Show All", [this] {
+            if (showAllCallback)
+                showAllCallback();
+        });
+        buttons->end();
+
+        status = new Fl_Box(margin, h - rowHeight, w - 2 * margin, rowHeight);
+        status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+
+        resizable(templatesList);
+        end();
+    }
+
+    // Set callbacks for the buttons. Show Only and Hide receive IDs of the selected templates.
+    void onShowOnly(std::function<void(const std::vector<uint32_t>&)> callback)
+    {
+        showOnlyCallback = std::move(callback);
+    }
+    void onHide(std::function<void(const std::vector<uint32_t>&)> callback)
+    {
+        hideCallback = std::move(callback);
+    }
+    void onCollapseRepeats(std::function<void()> callback)
+    {
+        collapseCallback = std::move(callback);
+    }
+    void onShowAll(std::function<void()> callback)
+    {
+        showAllCallback = std::move(callback);
+    }
+
+    void setStatus(const std::string& text)
+    {
+        status->copy_label(text.c_str());
+        status->redraw();
+    }
+
+    // Display templates from the most frequent one
+    void setTemplates(const std::vector<LogTemplate>& templates)
+    {
+        templatesList->clear();
+        rowTemplates.resize(templates.size());
+        std::iota(rowTemplates.begin(), rowTemplates.end(), 0);
+        std::sort(rowTemplates.begin(), rowTemplates.end(),
+                  [&](uint32_t a, uint32_t b) { return templates[a].count > templates[b].count; });
+
+        for (const uint32_t templateId : rowTemplates)
+        {
+            const auto& logTemplate = templates[templateId];
+            const std::string text = std::to_string(logTemplate.count) + "\t" + logTemplate.text;
+            templatesList->add(text.c_str());
+        }
+    }
+
+private:
+    static constexpr int COLUMN_WIDTHS[] = {90, 0};
+
+    void addButton(const char* label, std::function<void()> action)
+    {
+        auto* button = new Fl_Button(0, 0, 0, 0, label);
+        buttonActions.push_back(std::make_unique<std::function<void()>>(std::move(action)));
+        button->callback(
+            [](Fl_Widget*, void* action) { (*static_cast<std::function<void()>*>(action))(); },
+            buttonActions.back().get());
+    }
+
+    void callWithSelection(const std::function<void(const std::vector<uint32_t>&)>& callback) const
+    {
+        std::vector<uint32_t> selected;
+        for (int row = 1; row <= templatesList->size(); row++)
+        {
+            if (templatesList->selected(row))
+            {
+                selected.push_back(rowTemplates[row - 1]);
+            }
+        }
+        if (callback && !selected.empty())
+        {
+            callback(selected);
+        }
+    }
+
+    Fl_Multi_Browser* templatesList = nullptr;
+    Fl_Box* status = nullptr;
+    std::vector<uint32_t> rowTemplates;
+    std::vector<std::unique_ptr<std::function<void()>>> buttonActions;
+
+    std::function<void(const std::vector<uint32_t>&)> showOnlyCallback;
+    std::function<void(const std::vector<uint32_t>&)> hideCallback;
+    std::function<void()> collapseCallback;
+    std::function<void()> showAllCallback;
+};
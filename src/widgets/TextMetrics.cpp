@@ -0,0 +1,71 @@
+#include "TextMetrics.hpp"
+#include "core/Utf8.hpp"
+
+#include <FL/fl_draw.H>
+
+bool TextMetrics::setFont(const Fl_Font font, const Fl_Fontsize size)
+{
+    if (font == this->font && size == this->size)
+    {
+        return false;
+    }
+
+    this->font = font;
+    this->size = size;
+    otherWidths.clear();
+    for (size_t c = 0; c < asciiWidths.size(); c++)
+    {
+        const char character = static_cast<char>(c);
+        asciiWidths[c] = fl_width(&character, 1);
+    }
+    return true;
+}
+
+double TextMetrics::getCharWidth(std::string_view text, size_t& offset, const bool asciiText)
+{
+    const auto firstByte = static_cast<unsigned char>(text[offset]);
+    if (asciiText || firstByte < 0x80)
+    {
+        offset++;
+        return asciiWidths[firstByte & 0x7F];
+    }
+
+    const size_t begin = offset;
+    offset = nextCodePoint(text, offset);
+
+    uint32_t key = 0;
+    for (size_t i = begin; i < offset; i++)
+    {
+        key = (key << 8) | static_cast<unsigned char>(text[i]);
+    }
+
+    const auto it = otherWidths.find(key);
+    if (it != otherWidths.end())
+    {
+        return it->second;
+    }
+    const double width = fl_width(text.data() + begin, static_cast<int>(offset - begin));
+    otherWidths.emplace(key, width);
+    return width;
+}
+
+size_t TextMetrics::findWrapEnd(std::string_view text, const size_t begin, const double width, const bool asciiText)
+{
+    size_t offset = begin;
+    size_t lastBreak = begin; // position after the last space
+    double textWidth = 0;
+    while (offset < text.size())
+    {
+        const size_t charBegin = offset;
+        textWidth += getCharWidth(text, offset, asciiText);
+        if (textWidth > width && charBegin > begin)
+        {
+            return lastBreak > begin ? lastBreak : charBegin;
+        }
+        if (text[charBegin] == ' ')
+        {
+            lastBreak = offset;
+        }
+    }
+    return text.size();
+}
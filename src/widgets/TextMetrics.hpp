@@ -0,0 +1,29 @@
+#pragma once
+#include <FL/Enumerations.H>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+// Widths of the characters of a font. Each character is measured once, widths of longer pieces
+// of text are summed from the cache instead of passing the whole text to the font engine.
+class TextMetrics
+{
+public:
+    // Must be called with the font being current (fl_font). Clears the cache if the font has changed.
+    // Returns true if the font has changed.
+    bool setFont(Fl_Font font, Fl_Fontsize size);
+
+    // Width of the character beginning at the offset. The offset is moved to the next character.
+    double getCharWidth(std::string_view text, size_t& offset, bool asciiText);
+
+    // Offset of the end of the longest piece of text starting at the given offset that fits in the width.
+    // The text is preferably broken after a space. At least one character is always taken.
+    size_t findWrapEnd(std::string_view text, size_t begin, double width, bool asciiText);
+
+private:
+    Fl_Font font = -1;
+    Fl_Fontsize size = -1;
+    std::array<double, 128> asciiWidths{};
+    std::unordered_map<uint32_t, double> otherWidths; // the key is made of the bytes of a character
+};